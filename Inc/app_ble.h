@@ -29,6 +29,7 @@ extern "C" {
 
 /* Includes ------------------------------------------------------------------*/
 #include "hci_tl.h"
+#include "tx_power.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
@@ -49,11 +50,60 @@ extern "C" {
     } APP_BLE_ConnStatus_t;
     
 /* USER CODE BEGIN ET */
+    typedef enum
+    {
+      APP_BLE_LINK_IDLE,
+      APP_BLE_LINK_MTU,
+      APP_BLE_LINK_MTU_WAIT,
+      APP_BLE_LINK_DATA_LENGTH,
+      APP_BLE_LINK_PHY,
+      APP_BLE_LINK_DONE
+    } APP_BLE_LinkStep_t;
+
+    /**
+     * Link parameters of one connection, they start at the Bluetooth
+     * defaults and follow the events of its negotiation
+     */
+    typedef struct
+    {
+      APP_BLE_LinkStep_t Step;
+      uint16_t Att_Mtu;
+      uint16_t Max_Tx_Octets;
+      uint16_t Max_Rx_Octets;
+      uint8_t Tx_Phy;
+      uint8_t Rx_Phy;
+      uint8_t Mtu_Status;
+      uint8_t Data_Length_Status;
+      uint8_t Phy_Status;
+    } APP_BLE_LinkParams_t;
 
 /* USER CODE END ET */  
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+#define APP_BLE_DEFAULT_ATT_MTU        23
+#define APP_BLE_DEFAULT_TX_OCTETS      27
+/* largest LL payload and the time it takes on the 1M PHY, (251 + 14) * 8 us */
+#define APP_BLE_MAX_TX_OCTETS          251
+#define APP_BLE_MAX_TX_TIME            2120
+/* L2CAP header plus ATT notification header in front of the value */
+#define APP_BLE_NOTIFY_OVERHEAD        7
+/**
+ * Transport layer record of APP_BLE_Tl_Stats_Encode(), little endian
+ *  0     record version, APP_BLE_TL_STATS_VERSION
+ *  1     event buffers held at once, most
+ *  2-3   event bytes held at once, most
+ *  4     CFG_TLBLE_EVT_QUEUE_LENGTH
+ *  5     queue length the peak calls for
+ *  6     user events queued in the HCI layer, most
+ *  7     command events queued in the HCI layer, most
+ *  8-11  events received
+ *  12-13 events CPU2 had to deliver in a spare buffer
+ *  14-15 times the event task was left with events to re-arm
+ *  16-19 IPCC interrupt to end of handler, longest, us
+ */
+#define APP_BLE_TL_STATS_VERSION       1
+#define APP_BLE_TL_STATS_SIZE          20
 
 /* USER CODE END EC */
 
@@ -73,6 +123,18 @@ extern "C" {
   APP_BLE_ConnStatus_t APP_BLE_Get_Server_Connection_Status(void);
 
 /* USER CODE BEGIN EF */
+  const APP_BLE_LinkParams_t *APP_BLE_Get_Link_Params(uint16_t Connection_Handle);
+  uint16_t APP_BLE_Get_Notify_Payload_Max(void);
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+  void APP_BLE_Get_Tx_Power_Stats(TxPowerStats *pStats);
+#endif
+#if (CFG_BLE_TL_DIAG != 0)
+  uint8_t APP_BLE_Tl_Stats_Encode(uint8_t *pValue);
+  void APP_BLE_Tl_Stats_Reset(void);
+#endif
+#if (CFG_BLE_HR_BROADCAST != 0)
+  void APP_BLE_Broadcast_Update(uint8_t ucHR, uint8_t ucSPO2);
+#endif
 
 /* USER CODE END EF */
 
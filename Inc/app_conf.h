@@ -33,6 +33,10 @@
  * Define Tx Power
  */   
 #define CFG_TX_POWER                      (0x18) /**< 0dbm */
+/**
+ * TX power follows the RSSI of the connected centrals, CFG_TX_POWER is the ceiling
+ */
+#define CFG_BLE_TX_POWER_CONTROL          (1)
 
 /**
  * Define Advertising parameters
@@ -43,6 +47,12 @@
 #define CFG_LP_CONN_ADV_INTERVAL_MIN      (0x640) /**< 1s */
 #define CFG_LP_CONN_ADV_INTERVAL_MAX      (0xfa0) /**< 2.5s */
 
+/**
+ * Heart rate record in the advertising manufacturer data, for scanners that
+ * do not connect
+ */
+#define CFG_BLE_HR_BROADCAST              (1)
+
 /**
  * Define IO Authentication
  */
@@ -126,13 +136,8 @@
 #define CONN_L(x) ((int)((x)/0.625f))
 #define CONN_P(x) ((int)((x)/1.25f))
 
-  /*  L2CAP Connection Update request parameters used for test only with smart Phone */
-#define L2CAP_REQUEST_NEW_CONN_PARAM             0
-
-#define L2CAP_INTERVAL_MIN              CONN_P(1000) /* 1s */
-#define L2CAP_INTERVAL_MAX              CONN_P(1000) /* 1s */
-#define L2CAP_SLAVE_LATENCY             0x0000
-#define L2CAP_TIMEOUT_MULTIPLIER        0x1F4
+  /*  L2CAP Connection Update requests following the streaming demand, profiles in conn_governor.c */
+#define L2CAP_REQUEST_NEW_CONN_PARAM             1
 
 /******************************************************************************
  * BLE Stack
@@ -268,6 +273,24 @@
 #define CFG_TLBLE_MOST_EVENT_PAYLOAD_SIZE 255   /**< Set to 255 with the memory manager and the mailbox */
 
 #define TL_BLE_EVENT_FRAME_SIZE ( TL_EVT_HDR_SIZE + CFG_TLBLE_MOST_EVENT_PAYLOAD_SIZE )
+
+/**
+ * Event pool and HCI queue statistics, readable on the diagnostics characteristic
+ */
+#define CFG_BLE_TL_DIAG 1
+
+/**
+ * Cycle profile of the scheduler tasks and the interrupt handlers, dumped
+ * with SMART_WATCH_DIAG_PROFILE. Costs a few cycles per run when set
+ */
+#define CFG_CYCLE_PROF 0
+
+/**
+ * Earliest deadline first among the ready periodic tasks of
+ * APPE_Periodic_Register(). When 0 they run in round robin like the others,
+ * releases and deadline misses are counted either way
+ */
+#define CFG_SCH_PERIODIC 1
 /******************************************************************************
  * UART interfaces
  ******************************************************************************/
@@ -292,8 +315,18 @@
 /**
  *  When set to 1, the low power mode is enable
  *  When set to 0, the device stays in RUN mode
+ *  The traces keep it off below, a build without them goes to Stop2 in SCH_Idle()
  */
-#define CFG_LPM_SUPPORTED    0
+#define CFG_LPM_SUPPORTED    1
+
+/**
+ * The configuration shipped: the traces and the debugger in low power modes
+ * off, so that CFG_LPM_SUPPORTED holds. Build with CFG_LOW_POWER=0 for the
+ * UART traces, the device then stays in RUN mode
+ */
+#ifndef CFG_LOW_POWER
+#define CFG_LOW_POWER    1
+#endif
 
 /******************************************************************************
  * Timer Server
@@ -412,6 +445,15 @@ typedef enum
 #define CFG_LPM_SUPPORTED   0
 #endif
 
+#if (CFG_LOW_POWER != 0)
+#undef CFG_DEBUG_BLE_TRACE
+#undef CFG_DEBUG_APP_TRACE
+#undef CFG_DEBUGGER_SUPPORTED
+#define CFG_DEBUG_BLE_TRACE     0
+#define CFG_DEBUG_APP_TRACE     0
+#define CFG_DEBUGGER_SUPPORTED    0
+#endif
+
 #if (CFG_DEBUG_APP_TRACE != 0)
 #define APP_DBG_MSG                 PRINT_MESG_DBG
 #else
@@ -460,6 +502,9 @@ typedef enum
   //CFG_MY_TASK_NOTIFY_HR,
   //CFG_MY_TASK_NOTIFY_SPO2,
   CFG_MY_TASK_NOTIFY_DATA,
+  CFG_TASK_LINK_SETUP_ID,
+  CFG_TASK_LINK_TICK_ID,
+  CFG_TASK_SENSOR_DRAIN_ID,     /* may update the advertising data */
 /* USER CODE END CFG_Task_Id_With_HCI_Cmd_t */
     CFG_LAST_TASK_ID_WITH_HCICMD,                                               /**< Shall be LAST in the list */
 } CFG_Task_Id_With_HCI_Cmd_t;
@@ -470,6 +515,8 @@ typedef enum
     CFG_FIRST_TASK_ID_WITH_NO_HCICMD = CFG_LAST_TASK_ID_WITH_HCICMD - 1,        /**< Shall be FIRST in the list */
     CFG_TASK_SYSTEM_HCI_ASYNCH_EVT_ID,
 /* USER CODE BEGIN CFG_Task_Id_With_NO_HCI_Cmd_t */
+  CFG_TASK_DISPLAY_ID,
+  CFG_TASK_SCH_PERIODIC_ID,
 
 /* USER CODE END CFG_Task_Id_With_NO_HCI_Cmd_t */
     CFG_LAST_TASK_ID_WITHO_NO_HCICMD                                            /**< Shall be LAST in the list */
@@ -57,6 +57,8 @@ extern "C" {
 /* Exported functions ---------------------------------------------*/
   void APPE_Init( void );
 /* USER CODE BEGIN EF */
+  uint8_t APPE_Periodic_Register( uint8_t task_id, uint32_t period_ms, uint32_t deadline_ms );
+  void APPE_Periodic_Enable( uint8_t task_id, uint8_t enable );
 
 /* USER CODE END EF */
 
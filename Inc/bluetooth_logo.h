@@ -1,21 +1,25 @@
-/* USER CODE BEGIN */
-#ifndef BLUETOOTH_LOGO_H
-#define BLUETOOTH_LOGO_H
-
-/* C++ detection */
-#ifdef __cplusplus
-extern C {
-#endif
-
-#define BLUETOOTH_LOGO_WIDTH  22
-#define BLUETOOTH_LOGO_HEIGHT 32
-
-extern const long int bluetooth_logo[];
-
-/* C++ detection */
-#ifdef __cplusplus
-}
-#endif
-
-#endif
-/* USER CODE END */
+/* USER CODE BEGIN */
+#ifndef BLUETOOTH_LOGO_H
+#define BLUETOOTH_LOGO_H
+
+/* C++ detection */
+#ifdef __cplusplus
+extern C {
+#endif
+
+#include <stdint.h>
+
+#define BLUETOOTH_LOGO_WIDTH  22
+#define BLUETOOTH_LOGO_HEIGHT 32
+#define BLUETOOTH_LOGO_PAGES  (BLUETOOTH_LOGO_HEIGHT / 8)
+
+/* Page major RLE stream, see SSD1306_DrawRle() */
+extern const uint8_t bluetooth_logo_rle[];
+
+/* C++ detection */
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* USER CODE END */
@@ -0,0 +1,69 @@
+/*
+ * conn_governor.h
+ *
+ * Picks the connection parameters a link should run with from what is being
+ * streamed over it. Builds on a host with nothing but <stdint.h>.
+ *
+ *   IDLE     nothing subscribed, long interval with peripheral latency
+ *   SUMMARY  only HR / SpO2 values, a few per second, still with latency
+ *   STREAM   PPG waveform over extended data length, short interval
+ *   BURST    PPG waveform on 27 byte payloads or with the queue backing up,
+ *            shortest interval
+ *
+ * A faster profile is taken as soon as it is needed, a slower one only after
+ * the demand stayed lower for CONN_GOV_HOLD_MS, so a short pause in the
+ * stream does not cost two parameter updates. The queue has its own band,
+ * BURST is entered at CONN_GOV_DEPTH_HIGH and left at CONN_GOV_DEPTH_LOW.
+ * Requests go out one at a time and at least CONN_GOV_REQUEST_GAP_MS apart.
+ */
+
+#ifndef CONN_GOVERNOR_H_
+#define CONN_GOVERNOR_H_
+#include <stdint.h>
+
+#define CONN_GOV_HOLD_MS 5000
+#define CONN_GOV_REQUEST_GAP_MS 2000
+// no L2CAP response within this, the request is taken as lost
+#define CONN_GOV_RESPONSE_TIMEOUT_MS 30000
+#define CONN_GOV_DEPTH_HIGH 3
+#define CONN_GOV_DEPTH_LOW 1
+// below this a notification does not fit one extended LL payload
+#define CONN_GOV_SHORT_PAYLOAD 100
+
+typedef enum {
+	CONN_GOV_IDLE,
+	CONN_GOV_SUMMARY,
+	CONN_GOV_STREAM,
+	CONN_GOV_BURST,
+	CONN_GOV_PROFILES,
+	CONN_GOV_NONE = CONN_GOV_PROFILES,
+} ConnGovProfile;
+
+typedef enum {
+	CONN_GOV_DEMAND_NONE,
+	CONN_GOV_DEMAND_SUMMARY,
+	CONN_GOV_DEMAND_WAVEFORM,
+} ConnGovDemand;
+
+typedef struct {
+	uint8_t ucDemand;      // ConnGovDemand
+	uint8_t ucDepth;       // values waiting in the notification queue
+	uint16_t usPayloadMax; // largest notification value on the open links
+} ConnGovInput;
+
+// as aci_l2cap_connection_parameter_update_req() takes them
+typedef struct {
+	uint16_t usIntervalMin; // 1.25 ms units
+	uint16_t usIntervalMax;
+	uint16_t usLatency;
+	uint16_t usTimeout;     // 10 ms units
+} ConnGovParams;
+
+void vConnGovInit(void);
+uint8_t ucConnGovEvaluate(const ConnGovInput *in, uint32_t uiNow);
+uint8_t ucConnGovMayRequest(uint32_t uiNow);
+void vConnGovRequested(uint32_t uiNow);
+void vConnGovAnswered(void);
+const ConnGovParams *pConnGovParams(uint8_t ucProfile);
+
+#endif /* CONN_GOVERNOR_H_ */
@@ -0,0 +1,77 @@
+/*
+ * cycle_prof.h
+ *
+ * Cycle accounting of the scheduler tasks and the interrupt handlers. Builds
+ * on a host with nothing but <stdint.h>.
+ *
+ * Each entry keeps the number of runs, the total and the longest run in
+ * cycles, and a histogram with one bucket per power of two. Bucket b counts
+ * the runs of 2^(b + CYCLE_PROF_HIST_SHIFT) cycles up to twice that, the first
+ * bucket also takes the shorter runs and the last one the longer.
+ *
+ * Time is read with CYCLE_PROF_NOW(), DWT->CYCCNT unless the includer defines
+ * it first, a host build puts its own clock there. The CYCLE_PROF_x() macros
+ * compile to nothing unless CFG_CYCLE_PROF is set. A run includes whatever
+ * preempts it, interrupts within a task and nested SCH_Run() tasks.
+ */
+
+#ifndef CYCLE_PROF_H_
+#define CYCLE_PROF_H_
+#include <stdint.h>
+
+#define CYCLE_PROF_TASKS 16           // scheduler task ids profiled
+#define CYCLE_PROF_HIST_BUCKETS 16
+#define CYCLE_PROF_HIST_SHIFT 4       // first bucket up to 31 cycles
+
+// after the scheduler tasks, which take the entries 0 to CYCLE_PROF_TASKS - 1
+enum {
+	CYCLE_PROF_ISR_IPCC_RX = CYCLE_PROF_TASKS,
+	CYCLE_PROF_ISR_IPCC_TX,
+	CYCLE_PROF_ISR_RTC_WKUP,
+	CYCLE_PROF_ISR_TIM16,
+	CYCLE_PROF_ISR_EXTI0,
+	CYCLE_PROF_ISR_EXTI2,
+	CYCLE_PROF_ISR_EXTI4,
+	CYCLE_PROF_ISR_DMA1_CH1,
+	CYCLE_PROF_ISR_ADC1,
+	CYCLE_PROF_ISR_USART1,
+	CYCLE_PROF_ENTRIES
+};
+
+typedef struct {
+	uint32_t uiCount;
+	uint64_t ulTotal;
+	uint32_t uiMax;
+	uint32_t auiHist[CYCLE_PROF_HIST_BUCKETS];
+} CycleProfEntry;
+
+// called by vCycleProfDump() for each entry that ran, pName NULL for a task
+typedef void (*CycleProfPrint)(uint8_t ucId, const char *pName, const CycleProfEntry *pEntry);
+
+#ifndef CYCLE_PROF_NOW
+#define CYCLE_PROF_NOW() (DWT->CYCCNT)
+#endif
+
+#if defined(CFG_CYCLE_PROF) && (CFG_CYCLE_PROF != 0)
+// a call measured as a whole
+#define CYCLE_PROF_CALL(id, call) do { \
+		uint32_t uiCycleProfStart = CYCLE_PROF_NOW(); \
+		call; \
+		vCycleProfRecord((id), CYCLE_PROF_NOW() - uiCycleProfStart); \
+	} while (0)
+// BEGIN and END in the same block, for handlers split over USER CODE sections
+#define CYCLE_PROF_BEGIN() uint32_t uiCycleProfStart = CYCLE_PROF_NOW()
+#define CYCLE_PROF_END(id) vCycleProfRecord((id), CYCLE_PROF_NOW() - uiCycleProfStart)
+#else
+#define CYCLE_PROF_CALL(id, call) call
+#define CYCLE_PROF_BEGIN()
+#define CYCLE_PROF_END(id)
+#endif
+
+void vCycleProfReset(void);
+void vCycleProfRecord(uint8_t ucId, uint32_t uiCycles);
+const CycleProfEntry *pCycleProfGet(uint8_t ucId);
+const char *pCycleProfName(uint8_t ucId);
+void vCycleProfDump(CycleProfPrint pfPrint);
+
+#endif /* CYCLE_PROF_H_ */
@@ -0,0 +1,70 @@
+/*
+ * history.h
+ *
+ * Summary records kept in RAM while no phone listens, and the cursor that
+ * hands them to a central in bulk. Builds on a host with nothing but
+ * <stdint.h>.
+ *
+ * One record per second, numbered by a sequence that never restarts while
+ * the watch runs. The ring keeps the last HISTORY_RECORDS of them, an older
+ * sequence is gone for good.
+ *
+ * Frame, little endian, as long as the link payload allows:
+ *   0-3  sequence of the first record
+ *   then per record, HISTORY_RECORD_SIZE bytes
+ *     0-3  seconds since boot
+ *     4    HR in bpm, 0 without a finger on
+ *     5    SpO2 in %, 0 without a finger on
+ *     6    SQI in %, share of the readings of that second with a finger on
+ *          and HR within HISTORY_SQI_BAND of the reading before
+ *     7    temperature in degC, HISTORY_TEMP_NONE when not measured
+ * A frame without records closes the range, its sequence is the end.
+ *
+ * Control point, written by the central:
+ *   HISTORY_CP_START first(4) count(4)  send from first, count 0 for all up
+ *                                       to the newest record at this point
+ *   HISTORY_CP_ACK next(4)              every record below next arrived
+ *   HISTORY_CP_STOP                     drop the transfer
+ * and read back as the status: oldest(4) next to record(4) acked(4) state(1).
+ *
+ * Frames already handed out when the link goes are lost. The transfer then
+ * pauses and picks up again from the last acknowledged sequence, frames
+ * after it are sent again and the central drops the sequences it holds, so
+ * each record is kept once.
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+#include <stdint.h>
+
+#define HISTORY_RECORDS 1800          // 30 min
+#define HISTORY_PERIOD_MS 1000
+#define HISTORY_RECORD_SIZE 8
+#define HISTORY_FRAME_HEADER 4
+#define HISTORY_SQI_BAND 5            // bpm
+#define HISTORY_TEMP_NONE ((int8_t) 0x7F)
+#define HISTORY_STATUS_SIZE 13
+
+#define HISTORY_CP_START 0x01
+#define HISTORY_CP_ACK 0x02
+#define HISTORY_CP_STOP 0x03
+
+typedef enum {
+	HISTORY_SYNC_IDLE,
+	HISTORY_SYNC_SENDING,
+	HISTORY_SYNC_DONE,    // closing frame handed out, waiting for the last ACK
+	HISTORY_SYNC_PAUSED,  // nobody listens, resumes from the last ACK
+} HistorySyncState;
+
+void vHistoryInit(void);
+void vHistorySample(uint8_t ucHR, uint8_t ucSpO2, int8_t cTemp, uint32_t uiNow);
+uint32_t uiHistoryOldest(void);
+uint32_t uiHistoryNext(void);
+uint8_t ucHistoryControl(const uint8_t *pCmd, uint16_t usLength);
+uint16_t usHistoryFrame(uint8_t *pFrame, uint16_t usMax);
+void vHistorySyncPause(void);
+uint8_t ucHistorySyncResume(void);
+uint8_t ucHistorySyncState(void);
+uint16_t usHistoryStatus(uint8_t *pStatus);
+
+#endif /* HISTORY_H_ */
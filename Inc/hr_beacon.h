@@ -0,0 +1,31 @@
+/*
+ * hr_beacon.h
+ *
+ * Heart rate record carried in the advertising manufacturer data, readable by
+ * scanners that never connect. Builds on a host with nothing but <stdint.h>.
+ *
+ * The record is HR_BEACON_RECORD_SIZE bytes:
+ *   HR in bpm, 0 without a finger on
+ *   SpO2 in %, 0 without a finger on
+ *   confidence in %, share of the last 8 readings that held steady
+ *   sequence, bumped on every new record so a receiver can drop repeats
+ *
+ * A new record is due when HR or SpO2 moved past its deadband since the last
+ * one went out, or the finger came or went, and at most once per advertising
+ * interval since the stack would not show it earlier anyway.
+ */
+
+#ifndef HR_BEACON_H_
+#define HR_BEACON_H_
+#include <stdint.h>
+
+#define HR_BEACON_RECORD_SIZE 4
+#define HR_BEACON_HR_DEADBAND 2   // bpm
+#define HR_BEACON_SPO2_DEADBAND 1 // %
+
+void vHrBeaconInit(void);
+uint8_t ucHrBeaconSample(uint8_t ucHR, uint8_t ucSPO2, uint32_t uiNow,
+		uint32_t uiInterval);
+void vHrBeaconEncode(uint8_t *pRecord);
+
+#endif /* HR_BEACON_H_ */
@@ -47,9 +47,9 @@
  *****************************************************************************/
 /**
  * The user may define the maximum number of virtual timers supported.
- * It shall not exceed 255
+ * It shall not exceed 255. Starting, stopping and expiring a timer does not depend on that number
  */
-#define CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER  6
+#define CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER  16
 
 /**
  * The user may define the priority in the NVIC of the RTC_WKUP interrupt handler that is used to manage the
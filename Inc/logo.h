@@ -1,6 +1,6 @@
 //------------------------------------------------------------------------------
-// File generated by LCD Assistant
-// http://en.radzio.dxp.pl/bitmap_converter/
+// Generated from tools/bitmaps/logo.h (LCD Assistant output):
+//   tools/bitmap_rle.py rows tools/bitmaps/logo.h 128 64 logo_rle
 //------------------------------------------------------------------------------
 
 //Leroy, Connor, MameMor, Nicole, Justin
@@ -8,72 +8,34 @@
 #ifndef LOGO
 #define LOGO
 
-static const unsigned char logo [] = {
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xFF, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xFF, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0xC0, 0xFC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x00, 0x3E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x01, 0x80, 0x00, 0x03, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x07, 0x80, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x03, 0xE0, 0x00, 0x0F, 0x80, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x01, 0xF0, 0x00, 0x1F, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x07, 0x80, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x3E, 0x00, 0x00,
-0x00, 0x00, 0x0F, 0xC0, 0x00, 0x80, 0x03, 0x80, 0x00, 0x38, 0x00, 0x7C, 0x00, 0x7C, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x60, 0x00, 0x80, 0x03, 0x80, 0x00, 0x60, 0x00, 0x3E, 0x00, 0xF8, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x20, 0x00, 0x80, 0x03, 0x80, 0x00, 0x40, 0x00, 0x1F, 0x01, 0xF0, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x20, 0x00, 0x80, 0x01, 0xC0, 0x00, 0x40, 0x00, 0x0F, 0x83, 0xE0, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x22, 0x10, 0x8F, 0x81, 0xC0, 0x00, 0x40, 0x00, 0x03, 0xC7, 0xC0, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x62, 0x10, 0x98, 0x01, 0xE0, 0x01, 0xE1, 0xF0, 0x01, 0xFF, 0x80, 0x00, 0x00,
-0x00, 0x00, 0x08, 0xC2, 0x10, 0x98, 0x00, 0xF0, 0x00, 0x43, 0x10, 0x01, 0xFF, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x0F, 0x82, 0x10, 0x8C, 0x00, 0xFC, 0x00, 0x42, 0x18, 0x00, 0xFE, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x02, 0x10, 0x87, 0x00, 0xFF, 0xC0, 0x46, 0x08, 0x00, 0x7E, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x02, 0x10, 0x81, 0x80, 0xFC, 0x00, 0x47, 0xF8, 0x00, 0xFF, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x02, 0x10, 0x80, 0x80, 0xF8, 0x00, 0x46, 0x00, 0x01, 0xFF, 0x80, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x02, 0x30, 0x80, 0x80, 0xF0, 0x00, 0x46, 0x00, 0x03, 0xE7, 0xC0, 0x00, 0x00,
-0x00, 0x00, 0x08, 0x03, 0xE0, 0x9F, 0x81, 0xC0, 0x00, 0x42, 0x00, 0x07, 0xC3, 0xE0, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x43, 0xB0, 0x0F, 0x81, 0xF0, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0xE0, 0x1F, 0x00, 0xF8, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x3E, 0x00, 0x7C, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x7C, 0x00, 0x3E, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x1F, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0xF0, 0x00, 0x0F, 0x80, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x01, 0xE0, 0x00, 0x07, 0x80, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x03, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0xC0, 0xFC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xFF, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xFF, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-};
+#include <stdint.h>
+
+#define LOGO_WIDTH  128
+#define LOGO_PAGES  8
 
+// Page major RLE stream, see SSD1306_DrawRle()
+// 128x64, 1024 page bytes packed to 308
+static const uint8_t logo_rle[] = {
+  0xC0, 0x00, 0x84, 0x80, 0xED, 0x00, 0x08, 0x80, 0xC0, 0xE0, 0xF0, 0x38, 0x1C, 0x1E, 0x0E, 0x0F,
+  0x80, 0x07, 0x84, 0x03, 0x80, 0x07, 0x08, 0x0F, 0x0E, 0x1E, 0x3C, 0x78, 0xF0, 0xE0, 0xC0, 0x80,
+  0xD3, 0x00, 0x00, 0x80, 0x8A, 0x00, 0x01, 0xC0, 0xFC, 0x80, 0xFF, 0x00, 0x01, 0x94, 0x00, 0x01,
+  0x01, 0x03, 0x80, 0x07, 0x08, 0x02, 0x00, 0x30, 0x78, 0xF8, 0xF0, 0xE0, 0xC0, 0x80, 0x8B, 0x00,
+  0x06, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0x78, 0x30, 0xA1, 0x00, 0x00, 0xFF, 0x81, 0x81, 0x02, 0xC1,
+  0x63, 0x3E, 0x81, 0x00, 0x00, 0xF0, 0x82, 0x00, 0x00, 0xF0, 0x82, 0x00, 0x00, 0xFF, 0x80, 0x00,
+  0x02, 0x60, 0xF0, 0x90, 0x81, 0x10, 0x83, 0x00, 0x05, 0x07, 0x3F, 0xFF, 0xF8, 0xE0, 0xC0, 0x80,
+  0x80, 0x87, 0x00, 0x80, 0x20, 0x01, 0xFE, 0x23, 0x80, 0x01, 0x02, 0x00, 0xC0, 0x60, 0x81, 0x20,
+  0x01, 0xE0, 0x80, 0x82, 0x00, 0x02, 0x01, 0x03, 0x07, 0x80, 0x0F, 0x03, 0x1E, 0x7C, 0xF8, 0xF0,
+  0x81, 0xE0, 0x08, 0xF0, 0xF8, 0x7C, 0x3E, 0x1F, 0x0F, 0x07, 0x03, 0x01, 0xA4, 0x00, 0x00, 0x1F,
+  0x87, 0x00, 0x00, 0x1F, 0x81, 0x10, 0x01, 0x18, 0x0F, 0x82, 0x00, 0x00, 0x1F, 0x80, 0x00, 0x80,
+  0x10, 0x80, 0x11, 0x01, 0x13, 0x1E, 0x83, 0x00, 0x03, 0x80, 0xF0, 0xFF, 0x3F, 0x80, 0x0F, 0x01,
+  0x07, 0x03, 0x82, 0x01, 0x85, 0x00, 0x00, 0x3F, 0x81, 0x00, 0x07, 0x0F, 0x3F, 0x22, 0x62, 0x42,
+  0x62, 0x22, 0x03, 0x83, 0x00, 0x08, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0x7C, 0x3E, 0x1F, 0x0F, 0x80,
+  0x07, 0x08, 0x0F, 0x1F, 0x3E, 0x7C, 0xF8, 0xF0, 0xE0, 0xC0, 0x80, 0xC5, 0x00, 0x01, 0x0C, 0x7F,
+  0x80, 0xFF, 0x00, 0x80, 0x95, 0x00, 0x01, 0x80, 0xC0, 0x80, 0xE0, 0x08, 0x40, 0x00, 0x18, 0x1E,
+  0x1F, 0x0F, 0x07, 0x03, 0x01, 0x8A, 0x00, 0x06, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x1E, 0x0C, 0xC4,
+  0x00, 0x07, 0x01, 0x07, 0x0F, 0x1E, 0x38, 0x70, 0xF0, 0xE0, 0x81, 0xC0, 0x84, 0x80, 0x81, 0xC0,
+  0x08, 0xE0, 0xF0, 0x78, 0x3C, 0x1E, 0x0F, 0x07, 0x03, 0x01, 0xE9, 0x00, 0x80, 0x01, 0x85, 0x03,
+  0x81, 0x01, 0xB3, 0x00,
+};
 
 #endif // LOGO
@@ -82,6 +82,8 @@ extern typedefBleData bleData;
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+#define MAX_BPM_THRESHOLD 130
+#define MIN_BPM_THRESHOLD 60
 
 /* USER CODE END EC */
 
@@ -129,7 +131,6 @@ int getMedianNum(int*);
 #define OLED_STATUS_BLE  5
 #define OLED_STATUS_SHUT_DOWN 6
 #define OLED_COUNTER_TIME_OUT  10
-#define OLED_COUNTER_TIME_OUT_MAX30102 3
 
 #define MAX30102_BIT_POSITION 5
 
@@ -0,0 +1,63 @@
+/*
+ * notify_queue.h
+ *
+ * Bounded queue of characteristic values waiting for the BLE stack.
+ *
+ * Values are copied in and sent in order while the stack takes them. When an
+ * update is refused for lack of TX buffers the head stays queued and the queue
+ * stalls until the stack reports its TX pool available again, nothing is lost
+ * until the queue itself is full. A value pushed into a full queue is dropped
+ * and counted, so the counters tell when the link is asked for more than it
+ * can carry.
+ *
+ * A sender that hands the value to an asynchronous command returns
+ * BLE_STATUS_PENDING, the head then waits in place for vNotifyQueueSent().
+ *
+ * Producers can also write in place with pNotifyQueueSlot(), which coalesces a
+ * value with the one of the same characteristic still waiting, or puts an
+ * urgent value ahead of the others.
+ */
+
+#ifndef NOTIFY_QUEUE_H_
+#define NOTIFY_QUEUE_H_
+#include "main.h"
+
+#define NOTIFY_QUEUE_SLOTS 4
+// one notification in a 251 byte LL payload, same as PPG_STREAM_FRAME_MAX
+#define NOTIFY_QUEUE_VALUE_MAX 244
+
+typedef enum {
+	NOTIFY_QUEUE_APPEND,
+	NOTIFY_QUEUE_LATEST,
+	NOTIFY_QUEUE_URGENT,
+} NotifyQueueMode;
+
+typedef struct {
+	uint32_t uiQueued;     // values accepted by push
+	uint32_t uiSent;       // values taken by the stack
+	uint32_t uiDropped;    // pushed into a full queue
+	uint32_t uiCoalesced;  // written over a value still waiting
+	uint32_t uiFailed;     // refused by the stack for another reason than TX buffers
+	uint32_t uiStalls;     // times the stack ran out of TX buffers
+	uint16_t usPoolBuffers;// buffers reported by the last TX pool event
+	uint8_t ucDepth;
+	uint8_t ucHighWater;   // deepest the queue has been since init
+} NotifyQueueStats;
+
+/* pfSend returns a tBleStatus, the characteristic id is passed through as pushed */
+void vNotifyQueueInit(uint8_t (*pfSend)(uint16_t usChar, uint8_t *pData,
+		uint16_t usLength));
+uint8_t ucNotifyQueuePush(uint16_t usChar, const uint8_t *pData,
+		uint16_t usLength);
+uint8_t *pNotifyQueueSlot(uint16_t usChar, uint8_t ucMode);
+void vNotifyQueueCommit(uint16_t usLength);
+uint8_t ucNotifyQueueFree(void);
+uint8_t ucNotifyQueueStalled(void);
+void vNotifyQueueDrain(void);
+void vNotifyQueueSent(uint8_t status);
+void vNotifyQueueResume(uint16_t usBuffers);
+void vNotifyQueueFlush(void);
+uint8_t ucNotifyQueueFlushChar(uint16_t usChar);
+void vNotifyQueueGetStats(NotifyQueueStats *stats);
+
+#endif /* NOTIFY_QUEUE_H_ */
@@ -0,0 +1,46 @@
+/*
+ * notify_sched.h
+ *
+ * One scheduler for the notifications of every characteristic, in front of
+ * the notification queue. A characteristic registers a period, a class and a
+ * producer that writes its latest value, one timer tick and the queue's own
+ * completions drive vNotifySchedRun().
+ *
+ * Due values go out by class, then earliest deadline, then registration order:
+ *   ALARM    ahead of everything waiting in the queue, into the first slot
+ *            that frees when it is full, nothing queued is pushed out
+ *   SUMMARY  periodic values, a value still waiting in the queue is
+ *            overwritten with the newer one rather than queued twice
+ *   BULK     every value queued, waveform frames, never more than
+ *            NOTIFY_QUEUE_SLOTS - NOTIFY_SCHED_BULK_RESERVE of them so a
+ *            summary always finds room
+ * A periodic value that fell behind goes out once with the latest data, its
+ * next deadline is then counted from now. An entry with period 0 only goes
+ * out when raised and stays due until its producer has nothing left.
+ */
+
+#ifndef NOTIFY_SCHED_H_
+#define NOTIFY_SCHED_H_
+#include <stdint.h>
+
+#define NOTIFY_SCHED_MAX 8
+#define NOTIFY_SCHED_BULK_RESERVE 1
+
+typedef enum {
+	NOTIFY_SCHED_ALARM,
+	NOTIFY_SCHED_SUMMARY,
+	NOTIFY_SCHED_BULK,
+} NotifySchedClass;
+
+// writes the latest value to pValue, returns its length, 0 when there is none
+typedef uint16_t (*NotifySchedProducer)(uint8_t *pValue, uint16_t usMax);
+
+void vNotifySchedInit(void);
+uint8_t ucNotifySchedRegister(uint16_t usChar, uint32_t uiPeriod,
+		uint8_t ucClass, NotifySchedProducer pfProduce);
+void vNotifySchedEnable(uint16_t usChar, uint8_t ucEnable, uint32_t uiNow);
+void vNotifySchedRaise(uint16_t usChar, uint32_t uiNow);
+void vNotifySchedAlarm(uint16_t usChar, uint32_t uiNow);
+void vNotifySchedRun(uint32_t uiNow);
+
+#endif /* NOTIFY_SCHED_H_ */
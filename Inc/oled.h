@@ -21,7 +21,11 @@ void vOledClear(void);
 void vOledShowString(OledFonts font, uint8_t x, uint8_t y, uint8_t *str);
 void vOledSetPos(uint8_t x, uint8_t y);
 void vOledShowNum(uint8_t which, uint8_t num);
+void vOledShowDigit(uint8_t start, uint8_t page, uint8_t num);
 void vOledDrawChart(float value);
+void vOledWaveformStart(void);
+void vOledWaveformStop(void);
+uint8_t ucOledWaveformPush(float value);
 void vWriteToScreen(I2C_HandleTypeDef *hi2c);
 
 //Ble related
@@ -33,6 +37,8 @@ void vOledBlePrintSi7021(float temperature, float humidity);
 void vOledBlePrintGSR(float gsr);
 void vOledBlePrintData(void);
 void vOledBleClearScreen(void);
+void vOledScreenProcess(uint8_t status, uint8_t hr, uint8_t spo2,
+		uint16_t diff);
 
 // Sensor related
 
@@ -41,6 +47,9 @@ void vSetBPM(void);
 void vSetPercentage(void);
 void vSetSPO2(void);
 void vMax30102String(void);
+void vMax30003String(void);
+void vOledShowHR(void);
+void vOledShowRR(void);
 void vOledBleMaxInit30102(void);
 void vOledBlePrintMax30003(uint32_t ecg, uint32_t hr, uint32_t rr);
 
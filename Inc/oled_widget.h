@@ -0,0 +1,49 @@
+#ifndef __OLED_WIDGET_H
+#define __OLED_WIDGET_H
+#include "main.h"
+#include "fonts.h"
+
+// Retained screens: every widget owns a rectangle of the framebuffer and is
+// bound to a data source. ucOledScreenUpdate() polls the sources and only
+// widgets whose value changed are redrawn and flushed, so an unchanged screen
+// costs no drawing and no I2C traffic.
+
+// Macro definitions
+#define OLED_WIDGET_STATIC 0xFFFFFFFF // value of widgets without a source
+
+//typedef defs
+typedef enum {
+	OLED_WIDGET_LABEL,      // pvArg: const char*, or const char* const[] indexed by the source,
+	                        // pFont NULL draws with the 6x8 page font (ucY on a page)
+	OLED_WIDGET_BIG_NUMBER, // pvArg: const uint8_t[] digit columns, uiParam: digit count
+	OLED_WIDGET_ICON,       // pvArg: page major bitmap (ucY on a page), hidden while the source returns 0
+	OLED_WIDGET_BAR,        // uiParam: source value of a full bar
+	OLED_WIDGET_SPARKLINE   // scrolling waveform, see ucOledWaveformPush()
+} OledWidgetType;
+
+typedef struct {
+	OledWidgetType eType;
+	uint8_t ucX;            // pixel rectangle owned by the widget
+	uint8_t ucY;
+	uint8_t ucW;
+	uint8_t ucH;
+	uint32_t (*pfSource)(void);
+	const void *pvArg;
+	FontDef_t *pFont;
+	uint32_t uiParam;
+	uint32_t uiValue;       // value currently on the panel
+} OledWidget;
+
+typedef struct {
+	OledWidget *pWidgets;
+	uint8_t ucCount;
+} OledScreen;
+
+//function prototypes
+void vOledScreenEnter(OledScreen *screen);
+uint8_t ucOledScreenUpdate(OledScreen *screen);
+void vOledScreenLeave(void);
+OledScreen *pOledScreenCurrent(void);
+uint32_t uiOledScreenRedraws(void);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * ppg_codec.h
+ *
+ * Delta coding of red / IR sample pairs, written so the decoder builds on a
+ * host with nothing but <stdint.h>.
+ *
+ * A coded body starts with the first pair raw (18 + 18 bits), the base. Each
+ * following pair is coded against the one before it in blocks of up to
+ * PPG_CODEC_BLOCK pairs:
+ *   3 bits  pairs in the block - 1
+ *   5 bits  width wr of the red codes
+ *   5 bits  width wi of the IR codes
+ *   n times red code (wr bits), IR code (wi bits)
+ * A code is the zigzag of the delta, (d << 1) ^ (d >> 31). The all ones code
+ * is an escape and is followed by the 18 bit raw sample, so one outlier does
+ * not widen the whole block. A width of 0 means every delta is 0. Widths are
+ * picked per block and channel for the fewest bits. Everything is MSB first.
+ */
+
+#ifndef PPG_CODEC_H_
+#define PPG_CODEC_H_
+#include <stdint.h>
+
+#define PPG_CODEC_SAMPLE_BITS 18
+// bits of a sample above these 18 are not coded
+#define PPG_CODEC_SAMPLE_MASK ((1UL << PPG_CODEC_SAMPLE_BITS) - 1)
+#define PPG_CODEC_BASE_BITS (2 * PPG_CODEC_SAMPLE_BITS)
+#define PPG_CODEC_BLOCK 8
+#define PPG_CODEC_LEN_BITS 3
+#define PPG_CODEC_WIDTH_BITS 5
+#define PPG_CODEC_BLOCK_HEADER_BITS (PPG_CODEC_LEN_BITS + 2 * PPG_CODEC_WIDTH_BITS)
+// zigzag of an 18 bit delta always fits, no escape needed at this width
+#define PPG_CODEC_WIDTH_MAX (PPG_CODEC_SAMPLE_BITS + 1)
+// base plus one pair at the widest code
+#define PPG_CODEC_MIN_BITS (PPG_CODEC_BASE_BITS + PPG_CODEC_BLOCK_HEADER_BITS + 2 * PPG_CODEC_WIDTH_MAX)
+
+void vPpgCodecPut(uint8_t *buf, uint16_t bit, uint8_t width, uint32_t value);
+uint32_t uiPpgCodecGet(const uint8_t *buf, uint16_t bit, uint8_t width);
+uint16_t usPpgCodecPutBase(uint8_t *buf, uint16_t bit, uint32_t red,
+		uint32_t ired);
+uint16_t usPpgCodecBlockBits(const uint32_t *red, const uint32_t *ired,
+		uint8_t n, uint32_t prevRed, uint32_t prevIred, uint8_t *wRed,
+		uint8_t *wIred);
+uint16_t usPpgCodecPutBlock(uint8_t *buf, uint16_t bit, const uint32_t *red,
+		const uint32_t *ired, uint8_t n, uint8_t wRed, uint8_t wIred,
+		uint32_t *prevRed, uint32_t *prevIred);
+uint8_t ucPpgCodecDecode(const uint8_t *buf, uint16_t bits, uint8_t count,
+		uint32_t *red, uint32_t *ired);
+
+#endif /* PPG_CODEC_H_ */
@@ -0,0 +1,67 @@
+/*
+ * ppg_stream.h
+ *
+ * Batches every raw MAX30102 red / IR sample into frames for the DATA
+ * characteristic, so the central gets the full waveform at the sensor rate.
+ *
+ * Frame layout, multi byte fields big endian like the rest of the DATA char:
+ *   [0..1]  sequence number, +1 per frame, a gap means frames were lost
+ *   [2..5]  HAL tick (ms) of the first sample
+ *   [6]     bit 7 set: body is delta coded, bits 6..0: sample pairs in the frame
+ *   [7]     sample rate in Hz
+ *   [8..]   coded: ppg_codec.h body
+ *           raw: pairs of 18 bit red, 18 bit IR, packed MSB first without padding
+ */
+
+#ifndef PPG_STREAM_H_
+#define PPG_STREAM_H_
+#include "main.h"
+#include "ppg_codec.h"
+
+/* 1: frames carry delta coded bodies, 0: raw 18 bit pairs */
+#define PPG_STREAM_DELTA_CODED 1
+
+#define PPG_STREAM_HEADER_SIZE 8
+#define PPG_STREAM_SAMPLE_BITS PPG_CODEC_SAMPLE_BITS
+#define PPG_STREAM_PAIR_BITS (2 * PPG_STREAM_SAMPLE_BITS)
+// largest frame, one notification in a 251 byte LL payload (L2CAP 4 + ATT 3)
+#define PPG_STREAM_FRAME_MAX 244
+#define PPG_STREAM_FRAME_MIN (PPG_STREAM_HEADER_SIZE + (PPG_CODEC_MIN_BITS + 7) / 8)
+#define PPG_STREAM_PAIRS(size) ((((size) - PPG_STREAM_HEADER_SIZE) * 8) / PPG_STREAM_PAIR_BITS)
+#define PPG_STREAM_CODED 0x80
+#define PPG_STREAM_COUNT_MASK 0x7F
+// SPO2_CONFIGURATION 0x63 runs the sensor at 50 sps
+#define PPG_STREAM_RATE_HZ 50
+// a frame that is not full is sent anyway once its first sample is this old
+#define PPG_STREAM_DEADLINE_MS 500
+// frames waiting for the BLE stack, the oldest is dropped when all are taken
+#define PPG_STREAM_FRAMES 3
+
+typedef struct {
+	uint16_t usSeq;
+	uint32_t uiTimestamp;
+	uint8_t ucCount;
+	uint8_t ucCoded;
+	uint8_t ucRate;
+} PpgStreamHeader;
+
+typedef struct {
+	uint32_t uiFrames;
+	uint32_t uiSamples;
+	uint32_t uiDropped;
+	uint32_t uiBodyBits;      // bits of the closed frame bodies, the ratio is samples * 36 / this
+	uint32_t uiEncodeCycles;  // DWT cycles spent coding blocks
+} PpgStreamStats;
+
+void vPpgStreamStart(uint16_t frameSize, void (*pfReady)(void));
+void vPpgStreamResize(uint16_t frameSize);
+void vPpgStreamStop(void);
+void vPpgStreamPush(uint32_t red, uint32_t ired);
+void vPpgStreamPoll(void);
+uint8_t *pPpgStreamPeek(uint16_t *len);
+void vPpgStreamRelease(void);
+void vPpgStreamGetStats(PpgStreamStats *stats);
+uint8_t ucPpgStreamDecode(const uint8_t *frame, uint16_t len,
+		PpgStreamHeader *header, uint32_t *red, uint32_t *ired);
+
+#endif /* PPG_STREAM_H_ */
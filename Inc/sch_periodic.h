@@ -0,0 +1,45 @@
+/*
+ * sch_periodic.h
+ *
+ * Periodic scheduler tasks with a relative deadline. Builds on a host with
+ * nothing but <stdint.h>, time is in ms.
+ *
+ * A task registered here is released every period, its task bit is set and
+ * the job is due release + deadline. Whatever runs the task next serves the
+ * job, also a run posted by someone else. The job misses when it finishes
+ * after its deadline, or when the next release comes while it still waits,
+ * the two then share one run. Releases skipped for a late timer count as
+ * misses too.
+ *
+ * Among the ready tasks of one priority the pending job with the earliest
+ * deadline runs first. Event tasks ready at the same priority keep the round
+ * robin and go ahead.
+ */
+
+#ifndef SCH_PERIODIC_H_
+#define SCH_PERIODIC_H_
+#include <stdint.h>
+
+#define SCH_PERIODIC_MAX 8
+#define SCH_PERIODIC_NONE 0xFF
+// uiSchPeriodicNext() with nothing enabled
+#define SCH_PERIODIC_IDLE 0xFFFFFFFF
+
+typedef struct {
+	uint32_t uiReleases;
+	uint32_t uiMisses;
+	uint32_t uiLatencyMax;   // release to start of the run
+	uint32_t uiResponseMax;  // release to end of the run
+} SchPeriodicStats;
+
+void vSchPeriodicInit(void);
+uint8_t ucSchPeriodicRegister(uint8_t ucTask, uint32_t uiPeriod, uint32_t uiDeadline);
+void vSchPeriodicEnable(uint8_t ucTask, uint8_t ucEnable, uint32_t uiNow);
+uint32_t uiSchPeriodicRelease(uint32_t uiNow);
+uint32_t uiSchPeriodicNext(uint32_t uiNow);
+uint8_t ucSchPeriodicPick(uint32_t uiReady);
+void vSchPeriodicStart(uint8_t ucTask, uint32_t uiNow);
+void vSchPeriodicDone(uint8_t ucTask, uint32_t uiNow);
+uint8_t ucSchPeriodicGetStats(uint8_t ucTask, SchPeriodicStats *pStats);
+
+#endif /* SCH_PERIODIC_H_ */
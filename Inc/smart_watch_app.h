@@ -6,14 +6,18 @@ extern "C" {
 #endif
 
   /* Includes ------------------------------------------------------------------*/
+#include "conn_governor.h"
   /* Exported types ------------------------------------------------------------*/
   /* Exported constants --------------------------------------------------------*/
   /* External variables --------------------------------------------------------*/
   /* Exported macros -----------------------------------------------------------*/
   /* Exported functions ------------------------------------------------------- */
   void SMART_WATCH_APP_Init( void );
-#define CFG_MY_TASK_NOTIFY_DATA 1
-#define CFG_MY_TASK_NOTIFY_HR 2
+  void SMART_WATCH_APP_Link_Update( uint16_t usPayloadMax );
+  void SMART_WATCH_APP_Disconnected( void );
+  void SMART_WATCH_APP_Get_Conn_Demand( ConnGovInput *pDemand );
+/* 1: DATA notifies raw PPG frames (ppg_stream.h), 0: one HR/SpO2/IR/red summary per timer tick */
+#define SMART_WATCH_DATA_STREAM_PPG 1
 
 #ifdef __cplusplus
 }
@@ -52,6 +52,8 @@ SDA        |PB7          |Serial data line
 #include "stdlib.h"
 #include "string.h"
 
+#include "ssd1306_conf.h"
+
 /* I2C address */
 #ifndef SSD1306_I2C_ADDR
 #define SSD1306_I2C_ADDR         0x78
@@ -65,8 +67,27 @@ SDA        |PB7          |Serial data line
 #endif
 /* SSD1306 LCD height in pixels */
 #ifndef SSD1306_HEIGHT
-#define SSD1306_HEIGHT           32
+#define SSD1306_HEIGHT           64
+#endif
+/* SSD1306 number of GDDRAM pages */
+#ifndef SSD1306_PAGES
+#define SSD1306_PAGES            (SSD1306_HEIGHT / 8)
 #endif
+/* SSD1306 framebuffer size in bytes */
+#define SSD1306_BUFFER_SIZE      (SSD1306_WIDTH * SSD1306_PAGES)
+
+#ifndef SSD1306_FRAME_STATS
+#define SSD1306_FRAME_STATS      0
+#endif
+
+/**
+ * @brief  Panel cost counters, see @ref SSD1306_StatsGet()
+ */
+typedef struct {
+	uint32_t Bytes;        /*!< I2C bytes sent, control bytes included */
+	uint32_t Transactions; /*!< I2C transfers started */
+	uint32_t Cycles;       /*!< CPU cycles since @ref SSD1306_StatsReset() */
+} SSD1306_Stats_t;
 
 /**
  * @brief  SSD1306 color enumeration
@@ -93,6 +114,36 @@ uint8_t SSD1306_Init(void);
  */
 void SSD1306_UpdateScreen(void);
 
+/**
+ * @brief  Updates a range of pages from internal RAM to LCD
+ * @param  first: First page to send, 0 to SSD1306_PAGES - 1
+ * @param  last: Last page to send, first to SSD1306_PAGES - 1
+ * @retval None
+ */
+void SSD1306_UpdatePages(uint8_t first, uint8_t last);
+
+/**
+ * @brief  Updates a rectangle of columns and pages from internal RAM to LCD
+ * @note   Used to flush only the part of the screen that changed
+ * @param  x0: First column, 0 to SSD1306_WIDTH - 1
+ * @param  x1: Last column, x0 to SSD1306_WIDTH - 1
+ * @param  first: First page to send, 0 to SSD1306_PAGES - 1
+ * @param  last: Last page to send, first to SSD1306_PAGES - 1
+ * @retval 0 if the shared bus was busy and nothing was sent, 1 otherwise
+ */
+uint8_t SSD1306_UpdateRect(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last);
+
+/**
+ * @brief  Returns the shared framebuffer
+ * @note   The buffer is SSD1306_PAGES pages of SSD1306_WIDTH bytes each, laid out
+ *         exactly as the controller GDDRAM (one byte = 8 vertical pixels, LSB on top).
+ *         Page based drawing code writes into it directly and then calls
+ *         @ref SSD1306_UpdateScreen()
+ * @param  None
+ * @retval Pointer to SSD1306_BUFFER_SIZE bytes
+ */
+uint8_t* SSD1306_GetBuffer(void);
+
 /**
  * @brief  Toggles pixels invertion inside internal RAM
  * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
@@ -219,6 +270,51 @@ void SSD1306_DrawCircle(int16_t x0, int16_t y0, int16_t r, SSD1306_COLOR_t c);
  */
 void SSD1306_DrawFilledCircle(int16_t x0, int16_t y0, int16_t r, SSD1306_COLOR_t c);
 
+/**
+ * @brief  Decodes a page major RLE bitmap straight into STM buffer
+ * @note   The stream is the GDDRAM byte layout of the bitmap, packed as
+ *         0x00..0x7F: copy next n + 1 bytes, 0x80..0xFF: repeat next byte n - 0x80 + 2 times.
+ *         Streams are generated by tools/bitmap_rle.py. Every pixel of the area is written.
+ *         @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @param  x: Left column. Valid input is 0 to SSD1306_WIDTH - w
+ * @param  page: Top page. Valid input is 0 to SSD1306_PAGES - pages
+ * @param  w: Bitmap width in units of pixels
+ * @param  pages: Bitmap height in units of pages
+ * @param  *rle: Pointer to the packed stream
+ * @retval None
+ */
+void SSD1306_DrawRle(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t* rle);
+
+/**
+ * @brief  Draws a row-major 1bpp bitmap (MSB first, rows padded to whole bytes) to STM buffer
+ * @note   Only set bits are drawn, cleared bits leave the buffer untouched.
+ *         @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @param  x: Top left X start point. Valid input is 0 to SSD1306_WIDTH - 1
+ * @param  y: Top left Y start point. Valid input is 0 to SSD1306_HEIGHT - 1
+ * @param  *bitmap: Pointer to bitmap data
+ * @param  w: Bitmap width in units of pixels
+ * @param  h: Bitmap height in units of pixels
+ * @param  c: Color to be used. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
+ * @retval None
+ */
+void SSD1306_DrawBitmap(uint16_t x, uint16_t y, const unsigned char* bitmap, uint16_t w, uint16_t h, SSD1306_COLOR_t c);
+
+/**
+ * @brief  Clears the panel cost counters and starts the cycle count
+ * @note   Bracket a screen function with this and @ref SSD1306_StatsGet() to get its cost.
+ *         Does nothing unless SSD1306_FRAME_STATS is set
+ * @param  None
+ * @retval None
+ */
+void SSD1306_StatsReset(void);
+
+/**
+ * @brief  Reads the panel cost counters accumulated since @ref SSD1306_StatsReset()
+ * @param  *stats: Filled with the counters, all zero unless SSD1306_FRAME_STATS is set
+ * @retval None
+ */
+void SSD1306_StatsGet(SSD1306_Stats_t* stats);
+
 #ifndef ssd1306_I2C_TIMEOUT
 #define ssd1306_I2C_TIMEOUT					20000
 #endif
@@ -1,40 +1,18 @@
 /**
- * Private configuration file for the SSD1306 library.
- * This example is configured for STM32F0, I2C and including all fonts.
+ * Panel configuration for the SSD1306 display stack.
+ *
+ * This is the single source of geometry for the panel. The framebuffer in
+ * ssd1306.c, the controller init sequence and the page based drawing in
+ * oled.c are all sized from the values below.
  */
 
 #ifndef __SSD1306_CONF_H__
 #define __SSD1306_CONF_H__
 
-// Choose a microcontroller family
-#define STM32WB
-//#define STM32F1
-//#define STM32F4
-//#define STM32L0
-//#define STM32L1
-//#define STM32L4
-//#define STM32F3
-//#define STM32H7
-//#define STM32F7
-//#define STM32G0
-
-// Choose a bus
-#define SSD1306_USE_I2C
-//#define SSD1306_USE_SPI
-
 // I2C Configuration
 #define SSD1306_I2C_PORT        hi2c3
 #define SSD1306_I2C_ADDR        (0x3C << 1)
 
-// SPI Configuration
-//#define SSD1306_SPI_PORT        hspi1
-//#define SSD1306_CS_Port         OLED_CS_GPIO_Port
-//#define SSD1306_CS_Pin          OLED_CS_Pin
-//#define SSD1306_DC_Port         OLED_DC_GPIO_Port
-//#define SSD1306_DC_Pin          OLED_DC_Pin
-//#define SSD1306_Reset_Port      OLED_Res_GPIO_Port
-//#define SSD1306_Reset_Pin       OLED_Res_Pin
-
 // Mirror the screen if needed
 // #define SSD1306_MIRROR_VERT
 // #define SSD1306_MIRROR_HORIZ
@@ -42,27 +20,17 @@
 // Set inverse color if needed
 // # define SSD1306_INVERSE_COLOR
 
-// Include only needed fonts
-#define SSD1306_INCLUDE_FONT_6x8
-#define SSD1306_INCLUDE_FONT_7x10
-#define SSD1306_INCLUDE_FONT_11x18
-#define SSD1306_INCLUDE_FONT_16x26
-
-#define SSD1306_INCLUDE_FONT_16x24
-
-#define SSD1306_INCLUDE_FONT_16x15
-
-// The width of the screen can be set using this
-// define. The default value is 128.
+// The width of the screen in pixels.
 #define SSD1306_WIDTH           128
 
-// If your screen horizontal axis does not start
-// in column 0 you can use this define to
-// adjust the horizontal offset
-// #define SSD1306_X_OFFSET
-
-// The height can be changed as well if necessary.
-// It can be 32, 64 or 128. The default value is 64.
+// The height of the screen in pixels. It can be 32 or 64.
 #define SSD1306_HEIGHT          64
 
+// Number of 8 pixel high GDDRAM pages.
+#define SSD1306_PAGES           (SSD1306_HEIGHT / 8)
+
+// Set to 1 to count I2C bytes, transactions and CPU cycles spent on the
+// panel, see SSD1306_StatsReset() / SSD1306_StatsGet(). Costs nothing at 0.
+#define SSD1306_FRAME_STATS     0
+
 #endif /* __SSD1306_CONF_H__ */
@@ -57,6 +57,7 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void EXTI0_IRQHandler(void);
 void EXTI4_IRQHandler(void);
 void EXTI2_IRQHandler(void);
 void DMA1_Channel1_IRQHandler(void);
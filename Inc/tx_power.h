@@ -0,0 +1,54 @@
+/*
+ * tx_power.h
+ *
+ * TX power control from the RSSI of the connected centrals. Builds on a host
+ * with nothing but <stdint.h>.
+ *
+ * The RSSI measured here is the central's signal, our own power does not move
+ * it. With the central assumed to send at TX_POWER_CENTRAL_DBM the path loss
+ * follows, and from it what the central receives from us at each level. The
+ * controller runs the lowest level that keeps that estimate above
+ * TX_POWER_TARGET_DBM.
+ *
+ * The RSSI is averaged over about 4 samples. The level goes up one step as soon
+ * as the estimate falls below the target, and down one step only when the
+ * lower level still clears the target by TX_POWER_HYSTERESIS_DB and the last
+ * change is TX_POWER_HOLD samples old. The step down is judged on the worst
+ * average, which follows a fade at once and recovers over about
+ * TX_POWER_RELEASE samples, so a signal that keeps fading holds the level
+ * that covers the fades instead of stepping down and back up each time. A sign of loss, a failed read or a link
+ * lost on timeout, jumps straight to the ceiling and holds there for
+ * TX_POWER_LOSS_HOLD samples.
+ */
+
+#ifndef TX_POWER_H_
+#define TX_POWER_H_
+#include <stdint.h>
+
+#define TX_POWER_CENTRAL_DBM 0
+#define TX_POWER_TARGET_DBM (-70)
+#define TX_POWER_HYSTERESIS_DB 6
+#define TX_POWER_HOLD 4
+#define TX_POWER_LOSS_HOLD 10
+#define TX_POWER_RELEASE 16
+// hci_read_rssi() when the controller has no value
+#define TX_POWER_RSSI_NONE 127
+#define TX_POWER_STEPS 12
+
+typedef struct {
+	uint8_t ucLevel;                     // PA level applied
+	int16_t sPower;                      // its output, 0.1 dBm
+	int16_t sRssi;                       // averaged RSSI, 0.1 dBm
+	uint32_t uiChanges;
+	uint32_t uiLosses;
+	uint32_t uiTimeAt[TX_POWER_STEPS];   // ms spent at each step, lowest first
+} TxPowerStats;
+
+void vTxPowerInit(uint8_t ucMaxLevel, uint32_t uiNow);
+uint8_t ucTxPowerSample(int8_t cRssi, uint32_t uiNow);
+uint8_t ucTxPowerLoss(uint32_t uiNow);
+uint8_t ucTxPowerReset(uint32_t uiNow);
+uint8_t ucTxPowerLevel(void);
+void vTxPowerGetStats(TxPowerStats *stats, uint32_t uiNow);
+
+#endif /* TX_POWER_H_ */
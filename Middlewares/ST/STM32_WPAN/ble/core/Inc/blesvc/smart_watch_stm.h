@@ -30,6 +30,7 @@ typedef struct {
 /* External variables --------------------------------------------------------*/
 /* Exported macros -----------------------------------------------------------*/
 
+#define SWITCH_HISTORY 0x0008
 #define SWITCH_DATA 0x0007
 #define SWITCH_GSR 0x0006
 #define SWITCH_SPO2 0x0005
@@ -38,6 +39,33 @@ typedef struct {
 #define SWITCH_HUM 0x0002
 #define SWITCH_TEMP 0x0001
 #define SWITCH_EGR 0x0000
+/* Highest SWITCH_x */
+#define SMART_WATCH_SWITCH_MAX SWITCH_HISTORY
+
+/* EGR, temperature, humidity and GSR characteristics */
+#define SMART_WATCH_SENSOR_CHARS 0
+/* HR characteristic, notified every second and at once when HR rises above MAX_BPM_THRESHOLD */
+#define SMART_WATCH_HR_CHAR 1
+/* Read only diagnostics characteristic, writing SMART_WATCH_DIAG_RESET to it clears the counters */
+#define SMART_WATCH_DIAG_CHAR 1
+#define SMART_WATCH_DIAG_RESET 0x01
+/* DIAG write: cycle profile to the trace, then restarted */
+#define SMART_WATCH_DIAG_PROFILE 0x02
+/* HISTORY records streamed on request through the HISTORY_CP control point, see history.h */
+#define SMART_WATCH_HISTORY_CHARS 1
+
+/* Declared value size of each characteristic, in octets */
+#define SMART_WATCH_EGR_CHAR_SIZE 8
+#define SMART_WATCH_TEMP_CHAR_SIZE 4
+#define SMART_WATCH_HUM_CHAR_SIZE 4
+#define SMART_WATCH_GSR_CHAR_SIZE 4
+#define SMART_WATCH_HR_CHAR_SIZE 16
+#define SMART_WATCH_DATA_CHAR_SIZE 450
+#define SMART_WATCH_DIAG_CHAR_SIZE 20
+#define SMART_WATCH_HISTORY_CHAR_SIZE 244
+#define SMART_WATCH_HISTORY_CP_CHAR_SIZE 13
+/* Longest attribute value allowed by ATT */
+#define SMART_WATCH_ATT_VALUE_MAX 512
 /* Exported functions ------------------------------------------------------- */
 void SMART_WATCH_STM_Init(void);
 void SMART_WATCH_STM_App_Notification_EGR(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
@@ -48,7 +76,26 @@ void SMART_WATCH_STM_App_Notification_GSR(SMART_WATCH_STM_App_Notification_evt_t
 void SMART_WATCH_STM_App_Notification_HR(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
 void SMART_WATCH_STM_App_Notification_SPO2(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
 void SMART_WATCH_STM_App_Notification_Data(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
+/* Display on the first subscription and the last unsubscription of a client */
+void SMART_WATCH_STM_App_Screen_Sensor(uint8_t Enabled);
+void SMART_WATCH_STM_App_Screen_HR(uint8_t Enabled);
+void SMART_WATCH_STM_App_Screen_Data(uint8_t Enabled);
+#if (SMART_WATCH_DIAG_CHAR != 0)
+void SMART_WATCH_STM_App_Notification_Diag(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
+uint16_t SMART_WATCH_STM_App_Read_Diag(uint8_t *pValue, uint16_t Max);
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+void SMART_WATCH_STM_App_Notification_History(SMART_WATCH_STM_App_Notification_evt_t *pNotification);
+uint16_t SMART_WATCH_STM_App_Read_History(uint8_t *pValue, uint16_t Max);
+#endif
+void SMART_WATCH_STM_App_Tx_Pool_Available(uint16_t ConnectionHandle, uint16_t AvailableBuffers);
 tBleStatus SMART_WATCH_STM_App_Update_Char(uint16_t UUID, uint8_t *pPayload);
+tBleStatus SMART_WATCH_STM_App_Update_Data(uint8_t *pPayload, uint16_t Length);
+tBleStatus SMART_WATCH_STM_App_Update_Value(uint16_t UUID, uint8_t *pPayload, uint16_t Length, uint8_t *pPending);
+tBleStatus SMART_WATCH_STM_App_Update_Value_Async(uint16_t UUID, uint8_t *pPayload, uint16_t Length,
+		uint8_t *pPending, void (*pfDone)(tBleStatus Status));
+uint8_t SMART_WATCH_STM_Subscribers(uint16_t UUID);
+void SMART_WATCH_STM_Disconnected(uint16_t ConnHandle);
 #ifdef __cplusplus
 }
 #endif
@@ -1,23 +1,45 @@
 /* Includes ------------------------------------------------------------------*/
 #include "common_blesvc.h"
-#include "hal_lcd.h"
 #include "smart_watch_stm.h"
-#include "main.h"
-#include "oled.h"
+#include "hci_tl.h"
+
+#include <string.h>
 /* Private typedef -----------------------------------------------------------*/
+/**
+ * One row per characteristic of the service. SVCCTL_InitSmartWatchSvc() adds
+ * them in order and maps the value and CCCD attributes of each row, so the
+ * event handler finds the row of an attribute without comparing handles.
+ */
 typedef struct {
-	uint16_t SmartWatchSvcHdle; /**< Service handle */
-	uint16_t SmartWatchWriteClientToServerCharHdle; /**< Characteristic handle */
-	uint16_t SmartWatchNotifyEGRCharHdle; /**< EGR Characteristic handle handle */
-	uint16_t SmartWatchNotifyTemperatureCharHdle;/**< Temperature Characteristic handle handle */
-	uint16_t SmartWatchNotifyHumidityCharHdle;/**< Humidity Characteristic handle handle */
-	//uint16_t SmartWatchNotifyLUXCharHdle;/**< LUX Characteristic handle handle */
-	uint16_t SmartWatchNotifyGSRCharHdle;/**< GSR Characteristic handle handle */
-	uint16_t SmartWatchNotifyHRCharHdle;/**< SPO2 Characteristic handle handle  */
-	//uint16_t SmartWatchNotifySPO2CharHdle;/**< SPO2 Characteristic handle handle  */
-	uint16_t SmartWatchNotifyDataCharHdle;/**< Data Characteristic handle handle */
-	uint16_t RebootReqCharHdle; /**< Characteristic handle */
-} SmartWatchContext_t;
+	uint16_t Id; /**< SWITCH_x, SMART_WATCH_CHAR_NO_ID for a write only characteristic */
+	uint8_t Uuid[16]; /**< 128 bits UUID, LSB first */
+	uint16_t Size; /**< Declared value size */
+	uint8_t Properties; /**< CHAR_PROP_x */
+	void (*pfNotification)(SMART_WATCH_STM_App_Notification_evt_t *pNotification); /**< Application handler */
+	void (*pfScreen)(uint8_t Enabled); /**< Display on a subscription change, may be NULL */
+	void (*pfWrite)(aci_gatt_attribute_modified_event_rp0 *pModified); /**< Value written by a client, may be NULL */
+	uint16_t (*pfRead)(uint8_t *pValue, uint16_t Max); /**< Value produced on each read, NULL for a stored value */
+} SmartWatchCharDef_t;
+
+/**
+ * Update sent with SMART_WATCH_STM_App_Update_Value_Async(), one command at a
+ * time, each completion queues the next
+ */
+typedef struct {
+	uint8_t Busy;
+	uint16_t Id; /**< SWITCH_x */
+	uint16_t CharHdle;
+	uint8_t *pPayload; /**< Read until Done is called */
+	uint16_t Length;
+	uint16_t Offset; /**< Start of the chunk in flight */
+	uint8_t *pPending;
+	void (*pfDone)(tBleStatus Status);
+} SmartWatchAsync_t;
+
+typedef struct {
+	uint16_t ConnHandle; /**< SMART_WATCH_LINK_FREE when the slot is unused */
+	uint16_t SubscribedMask; /**< bit SWITCH_x set while this link has notifications on */
+} SmartWatchLink_t;
 
 /* Private defines -----------------------------------------------------------*/
 #define UUID_128_SUPPORTED  1
@@ -29,51 +51,457 @@ typedef struct {
 #endif
 
 #define BM_REQ_CHAR_SIZE    (3)
-#if(BLE_CFG_OTA_REBOOT_CHAR != 0)
-#if (UUID_128_SUPPORTED == 1)
-static const uint8_t BM_REQ_CHAR_UUID[16] = {0x19, 0xed, 0x82, 0xae,
-	0xed, 0x21, 0x4c, 0x9d,
-	0x41, 0x45, 0x22, 0x8e,
-	0x11, 0xFE, 0x00, 0x00};
-#else
-static const uint8_t BM_REQ_CHAR_UUID[2] = {0x11, 0xFE};
+
+/* aci_gatt_update_char_value_ext() carries 12 octets of parameters ahead of the value */
+#define SMART_WATCH_EXT_HDR_SIZE    (12)
+#define SMART_WATCH_EXT_CHUNK_MAX   (BLE_CMD_MAX_PARAM_LEN - SMART_WATCH_EXT_HDR_SIZE)
+#define SMART_WATCH_UPDATE_NOTIFY   (0x01)
+#define SMART_WATCH_UPDATE_NONE     (0x00)
+#define SMART_WATCH_LINK_FREE       (0xFFFF)
+#define SMART_WATCH_UPDATE_OPCODE   ((0x3F << 10) | 0x12C) /* aci_gatt_update_char_value_ext */
+/* Completion context of an asynchronous chunk, link slots below these */
+#define SMART_WATCH_ASYNC_CHUNK     (0xFE) /* leading chunk, written once */
+#define SMART_WATCH_ASYNC_STORE     (0xFD) /* last chunk, nobody to notify */
+
+#define SMART_WATCH_CHAR_NO_ID      (0xFFFF)
+/* Longest value a pfRead producer may write, the buffer is on the event task stack */
+#define SMART_WATCH_READ_VALUE_MAX  (32)
+#define SMART_WATCH_ROW_NONE        (0xFF)
+/* Attribute map entries, row << 2 | kind, 0 for an attribute nobody handles */
+#define SMART_WATCH_ATTR_VALUE      (0x01)
+#define SMART_WATCH_ATTR_CCCD       (0x02)
+#define SMART_WATCH_ATTR_KIND_MASK  (0x03)
+#define SMART_WATCH_ATTR_ROW(entry) ((entry) >> 2)
+
+#if (SMART_WATCH_EXT_CHUNK_MAX > 255)
+#error "aci_gatt_update_char_value_ext Value_Length is 8 bit, a chunk cannot exceed 255 octets"
+#endif
+#if (SMART_WATCH_EGR_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_TEMP_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_HUM_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_GSR_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_HR_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_DATA_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_DIAG_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX) || \
+    (SMART_WATCH_HISTORY_CHAR_SIZE > SMART_WATCH_ATT_VALUE_MAX)
+#error "A smart watch characteristic is declared longer than an ATT value can be"
 #endif
+#if (SMART_WATCH_DATA_CHAR_SIZE > (CFG_BLE_MAX_ATT_MTU - 3))
+#error "SMART_WATCH_DATA_CHAR_SIZE does not fit one notification at CFG_BLE_MAX_ATT_MTU"
+#endif
+#if (SMART_WATCH_HISTORY_CHAR_SIZE > (CFG_BLE_MAX_ATT_MTU - 3))
+#error "SMART_WATCH_HISTORY_CHAR_SIZE does not fit one notification at CFG_BLE_MAX_ATT_MTU"
 #endif
 
-PLACE_IN_SECTION("BLE_DRIVER_CONTEXT") static SmartWatchContext_t aSmartWatchContext;
+/* Hardware Characteristics Service */
+/*
+ The following 128bits UUIDs have been generated from the random UUID
+ generator:
+ D973F2E0-B19E-11E2-9E96-0800200C9A66: Service 128bits UUID
+ D973F2E1-B19E-11E2-9E96-0800200C9A66: Characteristic_1 128bits UUID
+ D973F2E2-B19E-11E2-9E96-0800200C9A66: Characteristic_2 128bits UUID
+ */
+#define UUID_128(uuid_15, uuid_14, uuid_13, uuid_12, uuid_11, uuid_10, uuid_9, uuid_8, uuid_7, uuid_6, uuid_5, uuid_4, uuid_3, uuid_2, uuid_1, uuid_0) \
+	{ uuid_0, uuid_1, uuid_2, uuid_3, uuid_4, uuid_5, uuid_6, uuid_7, \
+	  uuid_8, uuid_9, uuid_10, uuid_11, uuid_12, uuid_13, uuid_14, uuid_15 }
+
+#define SMART_WATCH_SERVICE_UUID       UUID_128(0x94,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x8a,0x34,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_TEMPERATURE_UUID   UUID_128(0x94,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x90,0xA4,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_EGR_SENOR_UUID     UUID_128(0x84,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0xA4,0xB4,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_HUMIDITY_UUID      UUID_128(0x74,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_LUX_UUID           UUID_128(0x64,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_GSR_UUID           UUID_128(0x14,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_HR_UUID            UUID_128(0x54,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_SPO2_UUID          UUID_128(0x34,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_DATA_UUID          UUID_128(0x24,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_HISTORY_UUID       UUID_128(0x04,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_HISTORY_CP_UUID    UUID_128(0x05,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_DIAG_UUID          UUID_128(0x44,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+#define SMART_WATCH_BM_REQ_UUID        UUID_128(0x00,0x00,0xFE,0x11,0x8e,0x22,0x45,0x41,0x9d,0x4c,0x21,0xed,0xae,0x82,0xed,0x19)
 
 /* Private function prototypes -----------------------------------------------*/
 static SVCCTL_EvtAckStatus_t SmartWatch_Event_Handler(void *pckt);
+static tBleStatus SmartWatch_Update_Char_Ext(uint16_t CharHdle, uint16_t CharSize, uint8_t *pPayload, uint16_t Length, uint8_t *pPending);
+static uint8_t SmartWatch_Char_Info(uint16_t UUID, uint16_t *pCharHdle, uint16_t *pCharSize);
+static tBleStatus SmartWatch_Async_Next(void);
+static void SmartWatch_Async_Complete(uint16_t Opcode, uint8_t Status, uint32_t Context);
+static void SmartWatch_Async_Finish(tBleStatus Status);
+static SmartWatchLink_t *SmartWatch_Link(uint16_t ConnHandle, uint8_t Create);
+static uint8_t SmartWatch_Demand(uint16_t UUID);
+static uint8_t SmartWatch_Subscribe(uint16_t ConnHandle, uint16_t UUID, uint8_t Enable);
+static void SmartWatch_Cccd_Written(uint8_t Row, uint16_t ConnHandle, uint8_t Enabled);
+static void SmartWatch_Read_Permit(aci_gatt_read_permit_req_event_rp0 *pRead);
+static void SmartWatch_Write_Evt(aci_gatt_attribute_modified_event_rp0 *pModified,
+		void (*pfNotification)(SMART_WATCH_STM_App_Notification_evt_t *pNotification));
+static void SmartWatch_Data_Written(aci_gatt_attribute_modified_event_rp0 *pModified);
+#if (SMART_WATCH_DIAG_CHAR != 0)
+static void SmartWatch_Diag_Written(aci_gatt_attribute_modified_event_rp0 *pModified);
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+static void SmartWatch_History_Written(aci_gatt_attribute_modified_event_rp0 *pModified);
+#endif
+#if(BLE_CFG_OTA_REBOOT_CHAR != 0)
+static void SmartWatch_Reboot_Written(aci_gatt_attribute_modified_event_rp0 *pModified);
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+/**
+ * Characteristics of the service, in the order they are added. EGR,
+ * temperature, humidity and GSR only exist with SMART_WATCH_SENSOR_CHARS, HR
+ * with SMART_WATCH_HR_CHAR, LUX and SPO2 have no application handler yet. DIAG is read only with
+ * SMART_WATCH_DIAG_CHAR, HISTORY and its control point come with
+ * SMART_WATCH_HISTORY_CHARS.
+ */
+static const SmartWatchCharDef_t aSmartWatchChars[] = {
+#if (SMART_WATCH_SENSOR_CHARS != 0)
+	{ SWITCH_TEMP, SMART_WATCH_TEMPERATURE_UUID, SMART_WATCH_TEMP_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_TEMPERATURE, SMART_WATCH_STM_App_Screen_Sensor, NULL, NULL },
+	{ SWITCH_HUM, SMART_WATCH_HUMIDITY_UUID, SMART_WATCH_HUM_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_HUMIDITY, SMART_WATCH_STM_App_Screen_Sensor, NULL, NULL },
+	{ SWITCH_EGR, SMART_WATCH_EGR_SENOR_UUID, SMART_WATCH_EGR_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_EGR, SMART_WATCH_STM_App_Screen_Sensor, NULL, NULL },
+	{ SWITCH_GSR, SMART_WATCH_GSR_UUID, SMART_WATCH_GSR_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_GSR, SMART_WATCH_STM_App_Screen_Sensor, NULL, NULL },
+#endif
+#if (SMART_WATCH_HR_CHAR != 0)
+	{ SWITCH_HR, SMART_WATCH_HR_UUID, SMART_WATCH_HR_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_HR, SMART_WATCH_STM_App_Screen_HR, NULL, NULL },
+#endif
+	{ SWITCH_DATA, SMART_WATCH_DATA_UUID, SMART_WATCH_DATA_CHAR_SIZE, CHAR_PROP_NOTIFY | CHAR_PROP_WRITE,
+	  SMART_WATCH_STM_App_Notification_Data, SMART_WATCH_STM_App_Screen_Data, SmartWatch_Data_Written, NULL },
+#if (SMART_WATCH_DIAG_CHAR != 0)
+	{ SMART_WATCH_CHAR_NO_ID, SMART_WATCH_DIAG_UUID, SMART_WATCH_DIAG_CHAR_SIZE, CHAR_PROP_READ | CHAR_PROP_WRITE,
+	  SMART_WATCH_STM_App_Notification_Diag, NULL, SmartWatch_Diag_Written, SMART_WATCH_STM_App_Read_Diag },
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+	{ SWITCH_HISTORY, SMART_WATCH_HISTORY_UUID, SMART_WATCH_HISTORY_CHAR_SIZE, CHAR_PROP_NOTIFY,
+	  SMART_WATCH_STM_App_Notification_History, NULL, NULL, NULL },
+	{ SMART_WATCH_CHAR_NO_ID, SMART_WATCH_HISTORY_CP_UUID, SMART_WATCH_HISTORY_CP_CHAR_SIZE, CHAR_PROP_READ | CHAR_PROP_WRITE,
+	  SMART_WATCH_STM_App_Notification_History, NULL, SmartWatch_History_Written, SMART_WATCH_STM_App_Read_History },
+#endif
+#if(BLE_CFG_OTA_REBOOT_CHAR != 0)
+	{ SMART_WATCH_CHAR_NO_ID, SMART_WATCH_BM_REQ_UUID, BM_REQ_CHAR_SIZE, CHAR_PROP_WRITE_WITHOUT_RESP,
+	  SMART_WATCH_STM_App_Notification_EGR, NULL, SmartWatch_Reboot_Written, NULL },
+#endif
+};
+
+#define SMART_WATCH_CHAR_COUNT    ((uint8_t) (sizeof(aSmartWatchChars) / sizeof(aSmartWatchChars[0])))
+/* service declaration, then declaration, value and CCCD of each characteristic */
+#define SMART_WATCH_ATTR_RECORDS  (1 + 3 * SMART_WATCH_CHAR_COUNT)
+
+typedef struct {
+	uint16_t SmartWatchSvcHdle; /**< Service handle */
+	uint16_t CharHdle[SMART_WATCH_CHAR_COUNT]; /**< Characteristic handle of each row */
+	uint8_t AttrMap[SMART_WATCH_ATTR_RECORDS]; /**< Attr_Handle - SmartWatchSvcHdle to row and kind */
+	uint8_t RowById[SMART_WATCH_SWITCH_MAX + 1]; /**< SWITCH_x to row, SMART_WATCH_ROW_NONE when absent */
+} SmartWatchContext_t;
+
+PLACE_IN_SECTION("BLE_DRIVER_CONTEXT") static SmartWatchContext_t aSmartWatchContext;
+static SmartWatchLink_t aSmartWatchLinks[CFG_BLE_NUM_LINK];
+static SmartWatchAsync_t SmartWatchAsync;
 
 /* Functions Definition ------------------------------------------------------*/
 /* Private functions ----------------------------------------------------------*/
 
-#define COPY_UUID_128(uuid_struct, uuid_15, uuid_14, uuid_13, uuid_12, uuid_11, uuid_10, uuid_9, uuid_8, uuid_7, uuid_6, uuid_5, uuid_4, uuid_3, uuid_2, uuid_1, uuid_0) \
-do {\
-    uuid_struct[0] = uuid_0; uuid_struct[1] = uuid_1; uuid_struct[2] = uuid_2; uuid_struct[3] = uuid_3; \
-        uuid_struct[4] = uuid_4; uuid_struct[5] = uuid_5; uuid_struct[6] = uuid_6; uuid_struct[7] = uuid_7; \
-            uuid_struct[8] = uuid_8; uuid_struct[9] = uuid_9; uuid_struct[10] = uuid_10; uuid_struct[11] = uuid_11; \
-                uuid_struct[12] = uuid_12; uuid_struct[13] = uuid_13; uuid_struct[14] = uuid_14; uuid_struct[15] = uuid_15; \
-}while(0)
+/**
+ * @brief  Writes a characteristic value of any declared size
+ * @note   The value goes down in SMART_WATCH_EXT_CHUNK_MAX pieces, only the last
+ *         one asks the stack to notify so the client sees a single complete value.
+ *         The last one is sent to each link still set in *pPending and its bit
+ *         cleared once the stack takes it, so a refused link can be retried
+ *         without notifying the others twice. Every call stores the leading
+ *         chunks again from offset 0, a retry rewrites the same bytes
+ * @param  CharHdle: Handle of the characteristic
+ * @param  CharSize: Declared size of the characteristic
+ * @param  pPayload: New value
+ * @param  Length: New length of the value, at most CharSize
+ * @param  pPending: Link slots to notify, see SMART_WATCH_STM_Subscribers()
+ * @retval Status of the first chunk that failed, BLE_STATUS_SUCCESS otherwise
+ */
+static tBleStatus SmartWatch_Update_Char_Ext(uint16_t CharHdle, uint16_t CharSize, uint8_t *pPayload, uint16_t Length, uint8_t *pPending) {
+	tBleStatus result = BLE_STATUS_SUCCESS;
+	uint16_t offset = 0;
+	uint8_t chunk;
+	uint8_t link;
+
+	if (Length > CharSize)
+		return BLE_STATUS_INVALID_PARAMS;
+
+	for (;;) {
+		chunk = (Length - offset > SMART_WATCH_EXT_CHUNK_MAX) ? SMART_WATCH_EXT_CHUNK_MAX : Length - offset;
+		if (offset + chunk == Length)
+			break;
+		result = aci_gatt_update_char_value_ext(0x0000,
+				aSmartWatchContext.SmartWatchSvcHdle, CharHdle,
+				SMART_WATCH_UPDATE_NONE,
+				Length, /* Char_Length */
+				offset, /* Value_Offset */
+				chunk, pPayload + offset);
+		if (result != BLE_STATUS_SUCCESS)
+			return result;
+		offset += chunk;
+	}
 
-/* Hardware Characteristics Service */
-/*
- The following 128bits UUIDs have been generated from the random UUID
- generator:
- D973F2E0-B19E-11E2-9E96-0800200C9A66: Service 128bits UUID
- D973F2E1-B19E-11E2-9E96-0800200C9A66: Characteristic_1 128bits UUID
- D973F2E2-B19E-11E2-9E96-0800200C9A66: Characteristic_2 128bits UUID
+	/* nobody listening, the value is still kept for reads */
+	if (*pPending == 0)
+		return aci_gatt_update_char_value_ext(0x0000,
+				aSmartWatchContext.SmartWatchSvcHdle, CharHdle,
+				SMART_WATCH_UPDATE_NONE, Length, offset, chunk, pPayload + offset);
+
+	for (link = 0; link < CFG_BLE_NUM_LINK; link++) {
+		if (!(*pPending & (1 << link)))
+			continue;
+		result = aci_gatt_update_char_value_ext(aSmartWatchLinks[link].ConnHandle,
+				aSmartWatchContext.SmartWatchSvcHdle, CharHdle,
+				SMART_WATCH_UPDATE_NOTIFY, Length, offset, chunk, pPayload + offset);
+		if (result != BLE_STATUS_SUCCESS)
+			return result;
+		*pPending &= ~(1 << link);
+	}
+
+	return result;
+}
+
+
+/**
+ * @brief  Queues the next command of the asynchronous update
+ * @note   Same order as SmartWatch_Update_Char_Ext(), the leading chunks, then
+ *         the last one to each link still pending. A link that left meanwhile
+ *         is skipped.
+ * @retval BLE_STATUS_PENDING when a command was queued
+ */
+static tBleStatus SmartWatch_Async_Next(void) {
+	aci_gatt_update_char_value_ext_cp0 *cp0;
+	uint16_t conn = 0x0000;
+	uint8_t update = SMART_WATCH_UPDATE_NONE;
+	uint8_t context = SMART_WATCH_ASYNC_CHUNK;
+	uint8_t chunk;
+	uint8_t link;
+
+	chunk = (SmartWatchAsync.Length - SmartWatchAsync.Offset > SMART_WATCH_EXT_CHUNK_MAX) ?
+			SMART_WATCH_EXT_CHUNK_MAX : SmartWatchAsync.Length - SmartWatchAsync.Offset;
+	if (SmartWatchAsync.Offset + chunk == SmartWatchAsync.Length) {
+		*SmartWatchAsync.pPending &= SMART_WATCH_STM_Subscribers(SmartWatchAsync.Id);
+		context = SMART_WATCH_ASYNC_STORE;
+		for (link = 0; link < CFG_BLE_NUM_LINK; link++) {
+			if (*SmartWatchAsync.pPending & (1 << link)) {
+				conn = aSmartWatchLinks[link].ConnHandle;
+				update = SMART_WATCH_UPDATE_NOTIFY;
+				context = link;
+				break;
+			}
+		}
+	}
+
+	/* serialised in place, straight into the mailbox when the link to CPU2 is idle */
+	cp0 = (aci_gatt_update_char_value_ext_cp0*) hci_async_reserve();
+	if (cp0 == NULL)
+		return BLE_STATUS_BUSY;
+	cp0->Conn_Handle_To_Notify = conn;
+	cp0->Service_Handle = aSmartWatchContext.SmartWatchSvcHdle;
+	cp0->Char_Handle = SmartWatchAsync.CharHdle;
+	cp0->Update_Type = update;
+	cp0->Char_Length = SmartWatchAsync.Length;
+	cp0->Value_Offset = SmartWatchAsync.Offset;
+	cp0->Value_Length = chunk;
+	memcpy(cp0->Value, SmartWatchAsync.pPayload + SmartWatchAsync.Offset, chunk);
+	hci_async_commit(SMART_WATCH_UPDATE_OPCODE, SMART_WATCH_EXT_HDR_SIZE + chunk,
+			SmartWatch_Async_Complete, context);
+	return BLE_STATUS_PENDING;
+}
+
+static void SmartWatch_Async_Complete(uint16_t Opcode, uint8_t Status, uint32_t Context) {
+	uint16_t chunk;
+	tBleStatus result;
+
+	if (Status != BLE_STATUS_SUCCESS) {
+		SmartWatch_Async_Finish(Status);
+		return;
+	}
+	if (Context == SMART_WATCH_ASYNC_STORE) {
+		SmartWatch_Async_Finish(BLE_STATUS_SUCCESS);
+		return;
+	}
+	if (Context == SMART_WATCH_ASYNC_CHUNK) {
+		chunk = SmartWatchAsync.Length - SmartWatchAsync.Offset;
+		SmartWatchAsync.Offset += (chunk > SMART_WATCH_EXT_CHUNK_MAX) ? SMART_WATCH_EXT_CHUNK_MAX : chunk;
+	} else {
+		*SmartWatchAsync.pPending &= ~(1 << Context);
+		if ((*SmartWatchAsync.pPending & SMART_WATCH_STM_Subscribers(SmartWatchAsync.Id)) == 0) {
+			SmartWatch_Async_Finish(BLE_STATUS_SUCCESS);
+			return;
+		}
+	}
+	result = SmartWatch_Async_Next();
+	if (result != BLE_STATUS_PENDING)
+		SmartWatch_Async_Finish(result);
+}
+
+static void SmartWatch_Async_Finish(tBleStatus Status) {
+	SmartWatchAsync.Busy = 0;
+	SmartWatchAsync.pfDone(Status);
+}
+
+/**
+ * @brief  Handle and declared size of a notify characteristic
+ * @retval 0 when the characteristic does not exist in this build
+ */
+static uint8_t SmartWatch_Char_Info(uint16_t UUID, uint16_t *pCharHdle, uint16_t *pCharSize) {
+	uint8_t row;
+
+	if (UUID > SMART_WATCH_SWITCH_MAX)
+		return 0;
+	row = aSmartWatchContext.RowById[UUID];
+	if (row == SMART_WATCH_ROW_NONE)
+		return 0;
+	*pCharHdle = aSmartWatchContext.CharHdle[row];
+	*pCharSize = aSmartWatchChars[row].Size;
+	return 1;
+}
+
+/**
+ * @brief  Subscription slot of a connection
+ * @param  Create: take a free slot when the connection has none yet
+ * @retval NULL when there is no slot for it
+ */
+static SmartWatchLink_t *SmartWatch_Link(uint16_t ConnHandle, uint8_t Create) {
+	SmartWatchLink_t *free_link = NULL;
+	uint8_t link;
+
+	for (link = 0; link < CFG_BLE_NUM_LINK; link++) {
+		if (aSmartWatchLinks[link].ConnHandle == ConnHandle)
+			return &aSmartWatchLinks[link];
+		if (free_link == NULL && aSmartWatchLinks[link].ConnHandle == SMART_WATCH_LINK_FREE)
+			free_link = &aSmartWatchLinks[link];
+	}
+	if (!Create || free_link == NULL)
+		return NULL;
+	free_link->ConnHandle = ConnHandle;
+	free_link->SubscribedMask = 0;
+	return free_link;
+}
+
+/**
+ * @brief  Whether any link is subscribed to the characteristic
  */
-#define COPY_SMART_WATCH_SERVICE_UUID(uuid_struct)       	 COPY_UUID_128(uuid_struct,0x94,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x8a,0x34,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_WRITE_CHAR_UUID(uuid_struct)    	 COPY_UUID_128(uuid_struct,0x00,0x00,0xAA,0xCC,0x8e,0x22,0x45,0x41,0x9d,0x4c,0x21,0xed,0xae,0x82,0xed,0x19)
-#define COPY_SMART_WATCH_TEMPERATURE_UUID(uuid_struct)   	 COPY_UUID_128(uuid_struct,0x94,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x90,0xA4,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_EGR_SENOR_CHAR_UUID(uuid_struct)    COPY_UUID_128(uuid_struct,0x84,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0xA4,0xB4,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_HUMIDITY_UUID(uuid_struct)      	 COPY_UUID_128(uuid_struct,0x74,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_LUX_UUID(uuid_struct)      	 	 COPY_UUID_128(uuid_struct,0x64,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_GSR_UUID(uuid_struct)      	 	 COPY_UUID_128(uuid_struct,0x14,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_HR_UUID(uuid_struct)      	 	 	 COPY_UUID_128(uuid_struct,0x54,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_SPO2_UUID(uuid_struct)      	 	 COPY_UUID_128(uuid_struct,0x34,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
-#define COPY_SMART_WATCH_DATA_UUID(uuid_struct)      	 	 COPY_UUID_128(uuid_struct,0x24,0x53,0x8a,0xee,0xdd,0x71,0x11,0xe9,0x98,0xA9,0x2a,0x2a,0xe2,0xdb,0xcc,0xe4)
+static uint8_t SmartWatch_Demand(uint16_t UUID) {
+	return SMART_WATCH_STM_Subscribers(UUID) != 0;
+}
+
+/**
+ * @brief  Records a CCCD write of one link
+ * @retval 1 when the first link subscribed or the last one left, the
+ *         application only hears about those two transitions
+ */
+static uint8_t SmartWatch_Subscribe(uint16_t ConnHandle, uint16_t UUID, uint8_t Enable) {
+	SmartWatchLink_t *link;
+	uint8_t before;
+
+	link = SmartWatch_Link(ConnHandle, Enable);
+	if (link == NULL)
+		return 0;
+	before = SmartWatch_Demand(UUID);
+	if (Enable)
+		link->SubscribedMask |= (1 << UUID);
+	else
+		link->SubscribedMask &= ~(1 << UUID);
+	if (link->SubscribedMask == 0)
+		link->ConnHandle = SMART_WATCH_LINK_FREE;
+	return before != SmartWatch_Demand(UUID);
+}
+
+
+/**
+ * @brief  CCCD written by a client
+ * @note   Only the first link subscribing and the last one leaving reach the
+ *         display and the application
+ */
+static void SmartWatch_Cccd_Written(uint8_t Row, uint16_t ConnHandle, uint8_t Enabled) {
+	const SmartWatchCharDef_t *pChar = &aSmartWatchChars[Row];
+	SMART_WATCH_STM_App_Notification_evt_t Notification;
+
+	if (!SmartWatch_Subscribe(ConnHandle, pChar->Id, Enabled))
+		return;
+	APP_DBG_MSG("-- GATT : char %d notification %s\n", pChar->Id,
+			Enabled ? "enabled" : "disabled");
+	if (pChar->pfScreen != NULL)
+		pChar->pfScreen(Enabled);
+	Notification.SMART_WATCH_Evt_Opcode = Enabled ?
+			SMART_WATCH_STM_NOTIFY_ENABLED_EVT : SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
+	Notification.ConnectionHandle = ConnHandle;
+	pChar->pfNotification(&Notification);
+}
+
+/**
+ * @brief  Hands a written value to the application as SMART_WATCH_STM_WRITE_EVT
+ */
+static void SmartWatch_Write_Evt(aci_gatt_attribute_modified_event_rp0 *pModified,
+		void (*pfNotification)(SMART_WATCH_STM_App_Notification_evt_t *pNotification)) {
+	SMART_WATCH_STM_App_Notification_evt_t Notification;
+
+	Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_WRITE_EVT;
+	Notification.DataTransfered.Length = pModified->Attr_Data_Length;
+	Notification.DataTransfered.pPayload = pModified->Attr_Data;
+	Notification.ConnectionHandle = pModified->Connection_Handle;
+	pfNotification(&Notification);
+}
+
+static void SmartWatch_Data_Written(aci_gatt_attribute_modified_event_rp0 *pModified) {
+	SmartWatch_Write_Evt(pModified, SMART_WATCH_STM_App_Notification_Data);
+}
+
+#if (SMART_WATCH_DIAG_CHAR != 0)
+static void SmartWatch_Diag_Written(aci_gatt_attribute_modified_event_rp0 *pModified) {
+	SmartWatch_Write_Evt(pModified, SMART_WATCH_STM_App_Notification_Diag);
+}
+#endif
+
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+static void SmartWatch_History_Written(aci_gatt_attribute_modified_event_rp0 *pModified) {
+	SmartWatch_Write_Evt(pModified, SMART_WATCH_STM_App_Notification_History);
+}
+#endif
+
+/**
+ * @brief  Read of a characteristic with a producer, the value is refreshed
+ *         before the stack is allowed to answer
+ * @param  pRead: Read permit request, Attribute_Handle is the value handle
+ */
+static void SmartWatch_Read_Permit(aci_gatt_read_permit_req_event_rp0 *pRead) {
+	uint8_t value[SMART_WATCH_READ_VALUE_MAX];
+	const SmartWatchCharDef_t *pChar;
+	uint16_t offset, length;
+	uint8_t entry;
+
+	offset = pRead->Attribute_Handle - aSmartWatchContext.SmartWatchSvcHdle;
+	if (pRead->Attribute_Handle < aSmartWatchContext.SmartWatchSvcHdle
+			|| offset >= SMART_WATCH_ATTR_RECORDS)
+		return;
+	entry = aSmartWatchContext.AttrMap[offset];
+	pChar = &aSmartWatchChars[SMART_WATCH_ATTR_ROW(entry)];
+	if ((entry & SMART_WATCH_ATTR_KIND_MASK) != SMART_WATCH_ATTR_VALUE || pChar->pfRead == NULL)
+		return;
+	/* only the first read of a long value refreshes it, the following ones continue it */
+	if (pRead->Offset == 0) {
+		length = pChar->pfRead(value, (pChar->Size < SMART_WATCH_READ_VALUE_MAX) ? pChar->Size : SMART_WATCH_READ_VALUE_MAX);
+		aci_gatt_update_char_value(aSmartWatchContext.SmartWatchSvcHdle,
+				aSmartWatchContext.CharHdle[SMART_WATCH_ATTR_ROW(entry)], 0, length, value);
+	}
+	aci_gatt_allow_read(pRead->Connection_Handle);
+}
+
+#if(BLE_CFG_OTA_REBOOT_CHAR != 0)
+static void SmartWatch_Reboot_Written(aci_gatt_attribute_modified_event_rp0 *pModified) {
+	SMART_WATCH_STM_App_Notification_evt_t Notification;
+
+	APP_DBG_MSG("-- GATT : REBOOT REQUEST RECEIVED\n");
+	Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_BOOT_REQUEST_EVT;
+	Notification.DataTransfered.Length = pModified->Attr_Data_Length;
+	Notification.DataTransfered.pPayload = pModified->Attr_Data;
+	Notification.ConnectionHandle = pModified->Connection_Handle;
+	SMART_WATCH_STM_App_Notification_EGR(&Notification);
+}
+#endif
 
 /**
  * @brief  Event handler
@@ -85,7 +513,8 @@ static SVCCTL_EvtAckStatus_t SmartWatch_Event_Handler(void *Event) {
 	hci_event_pckt *event_pckt;
 	evt_blue_aci *blue_evt;
 	aci_gatt_attribute_modified_event_rp0 * attribute_modified;
-	SMART_WATCH_STM_App_Notification_evt_t Notification;
+	uint16_t offset;
+	uint8_t entry;
 	return_value = SVCCTL_EvtNotAck;
 	event_pckt = (hci_event_pckt *) (((hci_uart_pckt*) Event)->data);
 
@@ -93,162 +522,38 @@ static SVCCTL_EvtAckStatus_t SmartWatch_Event_Handler(void *Event) {
 	case EVT_VENDOR: {
 		blue_evt = (evt_blue_aci*) event_pckt->data;
 		switch (blue_evt->ecode) {
+		case EVT_BLUE_GATT_TX_POOL_AVAILABLE: {
+			aci_gatt_tx_pool_available_event_rp0 *tx_pool_available;
+
+			/* not acked, other handlers may wait for buffers as well */
+			tx_pool_available = (aci_gatt_tx_pool_available_event_rp0*) blue_evt->data;
+			SMART_WATCH_STM_App_Tx_Pool_Available(tx_pool_available->Connection_Handle,
+					tx_pool_available->Available_Buffers);
+		}
+			break;
 		case EVT_BLUE_GATT_ATTRIBUTE_MODIFIED: {
 			attribute_modified = (aci_gatt_attribute_modified_event_rp0*) blue_evt->data;
-			if(attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyDataCharHdle + 1)){
-				ucOledStatusFlag = attribute_modified->Attr_Data[0] & 0x0F;// first 4 bit contains the number of screen
-				setActiveSensor(attribute_modified->Attr_Data[0]); // last 4 bit for the active sensor value
-				vOledBleClearScreen();
-			}
-			if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyEGRCharHdle + 2)) {
-
-				/**
-				 * Descriptor handle
-				 */
-				return_value = SVCCTL_EvtAckFlowEnable;
-				/**
-				 * Notify to application
-				 */
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : EGR char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleClearScreen();
-					SMART_WATCH_STM_App_Notification_EGR(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : EGR char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_EGR(&Notification);
-				}
-			}
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyTemperatureCharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : Temperature char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleClearScreen();
-					SMART_WATCH_STM_App_Notification_TEMPERATURE(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : Temperature char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_TEMPERATURE(&Notification);
-				}
-			}
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyHumidityCharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : Humidity  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleClearScreen();
-					SMART_WATCH_STM_App_Notification_HUMIDITY(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : Humidity  char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_HUMIDITY(&Notification);
-				}
-			}
-			/*
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyLUXCharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : LUX  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					SMART_WATCH_STM_App_Notification_LUX(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : LUX  char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_LUX(&Notification);
-				}
-			}
-			*/
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyGSRCharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : GSR  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleClearScreen();
-					SMART_WATCH_STM_App_Notification_GSR(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : GSR  char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_GSR(&Notification);
-				}
-			}
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyHRCharHdle + 2)){
+			/* attributes of other services fall outside the map */
+			offset = attribute_modified->Attr_Handle - aSmartWatchContext.SmartWatchSvcHdle;
+			if (attribute_modified->Attr_Handle < aSmartWatchContext.SmartWatchSvcHdle
+					|| offset >= SMART_WATCH_ATTR_RECORDS)
+				break;
+			entry = aSmartWatchContext.AttrMap[offset];
+			if ((entry & SMART_WATCH_ATTR_KIND_MASK) == SMART_WATCH_ATTR_CCCD) {
 				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- GATT : HR  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleMaxInit30102();
-					SMART_WATCH_STM_App_Notification_HR(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : HR  char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_HR(&Notification);
-				}
-			}
-			/*
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifySPO2CharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("--GATT : SPO2  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					SMART_WATCH_STM_App_Notification_SPO2(&Notification);
-				} else {
-					APP_DBG_MSG("-- GATT : SPO2  char notification disabled\n");
-					vOledBleClearScreen();
-					LCD_Print("SELECT", "CHARACTER");
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					SMART_WATCH_STM_App_Notification_SPO2(&Notification);
-				}
-			}
-			*/
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyDataCharHdle + 2)){
-				return_value = SVCCTL_EvtAckFlowEnable;
-				if (attribute_modified->Attr_Data[0] & COMSVC_Notification) {
-					APP_DBG_MSG("-- Data : Data  char notification enabled\n");
-					Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_ENABLED_EVT;
-					vOledBleClearScreen();
-					ucOledStatusFlag = OLED_STATUS_BLE;
-					SMART_WATCH_STM_App_Notification_Data(&Notification);
-
-				} else {
-					APP_DBG_MSG("-- GATT : Data  char notification disabled\n");
-					vOledBleClearScreen();
-					ucOledStatusFlag = OLED_STATUS_DEF;
-					Notification.SMART_WATCH_Evt_Opcode = 	SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
-					vOledBleClearScreen();
-					SMART_WATCH_STM_App_Notification_Data(&Notification);
-				}
-			}
-			else if (attribute_modified->Attr_Handle == (aSmartWatchContext.SmartWatchNotifyEGRCharHdle+ 1)) {
-				APP_DBG_MSG("-- GATT : WRITE CHAR INFO RECEIVED\n");
-				Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_WRITE_EVT;
-				Notification.DataTransfered.Length = attribute_modified->Attr_Data_Length;
-				Notification.DataTransfered.pPayload = attribute_modified->Attr_Data;
-				SMART_WATCH_STM_App_Notification_EGR(&Notification);
-			}
-			else if (attribute_modified->Attr_Handle
-					== (aSmartWatchContext.RebootReqCharHdle + 1)) {
-				APP_DBG_MSG("-- GATT : REBOOT REQUEST RECEIVED\n");
-				Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_BOOT_REQUEST_EVT;
-				Notification.DataTransfered.Length = attribute_modified->Attr_Data_Length;
-				Notification.DataTransfered.pPayload = attribute_modified->Attr_Data;
-				SMART_WATCH_STM_App_Notification_EGR(&Notification);
+				/* values only go out as notifications, asking for indications subscribes as well */
+				SmartWatch_Cccd_Written(SMART_WATCH_ATTR_ROW(entry),
+						attribute_modified->Connection_Handle,
+						(attribute_modified->Attr_Data[0] & (COMSVC_Notification | COMSVC_Indication)) != 0);
+			} else if ((entry & SMART_WATCH_ATTR_KIND_MASK) == SMART_WATCH_ATTR_VALUE
+					&& aSmartWatchChars[SMART_WATCH_ATTR_ROW(entry)].pfWrite != NULL) {
+				aSmartWatchChars[SMART_WATCH_ATTR_ROW(entry)].pfWrite(attribute_modified);
 			}
 		}
 			break;
+		case EVT_BLUE_GATT_READ_PERMIT_REQ:
+			SmartWatch_Read_Permit((aci_gatt_read_permit_req_event_rp0*) blue_evt->data);
+			break;
 		default:
 			break;
 		}
@@ -266,239 +571,186 @@ static SVCCTL_EvtAckStatus_t SmartWatch_Event_Handler(void *Event) {
 
 /**
  * @brief  Service initialization
+ * @note   Adds every row of aSmartWatchChars and maps its attributes
  * @param  None
  * @retval None
  */
 void SVCCTL_InitSmartWatchSvc(void) {
-
+	static const uint8_t ServiceUuid[16] = SMART_WATCH_SERVICE_UUID;
+	const SmartWatchCharDef_t *pChar;
 	Char_UUID_t uuid16;
+	uint16_t offset;
+	uint8_t link, row;
+
+	for (link = 0; link < CFG_BLE_NUM_LINK; link++) {
+		aSmartWatchLinks[link].ConnHandle = SMART_WATCH_LINK_FREE;
+		aSmartWatchLinks[link].SubscribedMask = 0;
+	}
+	memset(aSmartWatchContext.AttrMap, 0, sizeof(aSmartWatchContext.AttrMap));
+	memset(aSmartWatchContext.RowById, SMART_WATCH_ROW_NONE, sizeof(aSmartWatchContext.RowById));
 
 	/**
 	 *	Register the event handler to the BLE controller
 	 */
 	SVCCTL_RegisterSvcHandler(SmartWatch_Event_Handler);
 
-	/**
-	 *  Peer To Peer Service
-	 *
-	 * Max_Attribute_Records = 2*no_of_char + 1
-	 * service_max_attribute_record = 1 for Template service +
-	 *                                2 for Template Write characteristic +
-	 *                                2 for Template Notify characteristic +
-	 *                                1 for client char configuration descriptor +
-	 *
-	 */
-
-	COPY_SMART_WATCH_SERVICE_UUID(uuid16.Char_UUID_128);
+	memcpy(uuid16.Char_UUID_128, ServiceUuid, sizeof(ServiceUuid));
 	aci_gatt_add_service(UUID_TYPE_128, (Service_UUID_t *) &uuid16,
-	PRIMARY_SERVICE, 100, /*Max_Attribute_Records*/
+	PRIMARY_SERVICE, SMART_WATCH_ATTR_RECORDS, /*Max_Attribute_Records*/
 	&(aSmartWatchContext.SmartWatchSvcHdle));
 
-	/**
-	 *  Add Write Characteristic
-
-	COPY_SMART_WATCH_WRITE_CHAR_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 4,
-	CHAR_PROP_WRITE_WITHOUT_ RESP | CHAR_PROP_READ | CHAR_PROP_NOTIFY,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchWriteClientToServerCharHdle));
+	for (row = 0; row < SMART_WATCH_CHAR_COUNT; row++) {
+		pChar = &aSmartWatchChars[row];
+		memcpy(uuid16.Char_UUID_128, pChar->Uuid, sizeof(pChar->Uuid));
+		if (aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
+		UUID_TYPE_128, &uuid16, pChar->Size,
+		pChar->Properties,
+		ATTR_PERMISSION_NONE,
+		(pChar->pfRead != NULL) ? (GATT_NOTIFY_ATTRIBUTE_WRITE | GATT_NOTIFY_READ_REQ_AND_WAIT_FOR_APPL_RESP)
+				: GATT_NOTIFY_ATTRIBUTE_WRITE, /* gattEvtMask */
+		10, /* encryKeySize */
+		1, /* isVariable: 1 */
+		&(aSmartWatchContext.CharHdle[row])) != BLE_STATUS_SUCCESS) {
+			APP_DBG_MSG("-- GATT : characteristic %d not added\n", row);
+			continue;
+		}
 
-	 */
-	/**
-	 *   Add Temperature Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_TEMPERATURE_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 4,
-	CHAR_PROP_NOTIFY ,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyTemperatureCharHdle));
+		/* value right after the declaration, the CCCD after the value */
+		offset = aSmartWatchContext.CharHdle[row] - aSmartWatchContext.SmartWatchSvcHdle;
+		if (offset + 2 >= SMART_WATCH_ATTR_RECORDS)
+			continue;
+		aSmartWatchContext.AttrMap[offset + 1] = (row << 2) | SMART_WATCH_ATTR_VALUE;
+		if (pChar->Properties & (CHAR_PROP_NOTIFY | CHAR_PROP_INDICATE))
+			aSmartWatchContext.AttrMap[offset + 2] = (row << 2) | SMART_WATCH_ATTR_CCCD;
+		if (pChar->Id <= SMART_WATCH_SWITCH_MAX)
+			aSmartWatchContext.RowById[pChar->Id] = row;
+	}
 
-	/**
-	 *   Add Humidity Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_HUMIDITY_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 4,
-	CHAR_PROP_NOTIFY,// | CHAR_PROP_READ | CHAR_PROP_WRITE,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyHumidityCharHdle));
-	/**
-	 *   Add EGR Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_EGR_SENOR_CHAR_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 8,
-	CHAR_PROP_NOTIFY ,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyEGRCharHdle));
+	return;
+}
 
-	/**
-	 *   LUX Temperature Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_LUX_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 4,
-	CHAR_PROP_NOTIFY,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyLUXCharHdle));
-	*/
+/**
+ * @brief  Characteristic update, notified to every subscribed link
+ * @param  UUID: UUID of the characteristic
+ * @param  pPayload: Value of the declared size
+ *
+ */
+tBleStatus SMART_WATCH_STM_App_Update_Char(uint16_t UUID, uint8_t *pPayload) {
+	uint16_t hdle, size;
+	uint8_t pending = SMART_WATCH_STM_Subscribers(UUID);
 
-	/**
-	 *   Add GSR Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_GSR_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 4,
-	CHAR_PROP_NOTIFY,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyGSRCharHdle));
-	/**
-	 *   Add HR Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_HR_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 16,
-	CHAR_PROP_NOTIFY ,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifyHRCharHdle));
+	if (!SmartWatch_Char_Info(UUID, &hdle, &size))
+		return BLE_STATUS_INVALID_PARAMS;
+	return SmartWatch_Update_Char_Ext(hdle, size, pPayload, size, &pending);
+}
 
-	/**
-	 *   Add SPO2 Characteristic
-	 */
-	/*
-	COPY_SMART_WATCH_SPO2_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 16,
-	CHAR_PROP_NOTIFY,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE,
-	10,
-	1,
-	&(aSmartWatchContext.SmartWatchNotifySPO2CharHdle));
-	*/
-	/**
-	 *   Add DATA Characteristic
-	 */
-	COPY_SMART_WATCH_DATA_UUID(uuid16.Char_UUID_128);
-	aci_gatt_add_char(aSmartWatchContext.SmartWatchSvcHdle,
-	UUID_TYPE_128, &uuid16, 450,
-	CHAR_PROP_NOTIFY | CHAR_PROP_WRITE,
-	ATTR_PERMISSION_NONE,
-	GATT_NOTIFY_ATTRIBUTE_WRITE, /* gattEvtMask */
-	10, /* encryKeySize */
-	1, /* isVariable: 1 */
-	&(aSmartWatchContext.SmartWatchNotifyDataCharHdle));
+/**
+ * @brief  DATA characteristic update with an explicit length
+ * @param  pPayload: Value to notify
+ * @param  Length: Number of bytes, the characteristic is variable length
+ *
+ */
+tBleStatus SMART_WATCH_STM_App_Update_Data(uint8_t *pPayload, uint16_t Length) {
+	uint8_t pending = SMART_WATCH_STM_Subscribers(SWITCH_DATA);
 
-	return;
+	return SMART_WATCH_STM_App_Update_Value(SWITCH_DATA, pPayload, Length, &pending);
 }
 
 /**
- * @brief  Characteristic update
+ * @brief  Characteristic update to a chosen set of links
  * @param  UUID: UUID of the characteristic
- * @param  Service_Instance: Instance of the service to which the characteristic belongs
+ * @param  pPayload: Value to notify
+ * @param  Length: Number of bytes, at most the declared size
+ * @param  pPending: Link slots still to notify, the bits of the links that took
+ *         the value are cleared so a refused update is retried on the rest only
  *
  */
-tBleStatus SMART_WATCH_STM_App_Update_Char(uint16_t UUID, uint8_t *pPayload) {
-	tBleStatus result = BLE_STATUS_INVALID_PARAMS;
-	switch (UUID) {
-	case SWITCH_EGR:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyEGRCharHdle, 0, /* charValOffset */
-				8, /* charValueLen */
-				(uint8_t *) pPayload);
-
-		break;
+tBleStatus SMART_WATCH_STM_App_Update_Value(uint16_t UUID, uint8_t *pPayload, uint16_t Length, uint8_t *pPending) {
+	uint16_t hdle, size;
 
-	case SWITCH_TEMP:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyTemperatureCharHdle, 0, /* charValOffset */
-				4, /* charValueLen */
-				(uint8_t *) pPayload);
-		break;
+	if (!SmartWatch_Char_Info(UUID, &hdle, &size))
+		return BLE_STATUS_INVALID_PARAMS;
+	return SmartWatch_Update_Char_Ext(hdle, size, pPayload, Length, pPending);
+}
 
-	case SWITCH_HUM:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyHumidityCharHdle, 0, /* charValOffset */
-				4, /* charValueLen */
-				(uint8_t *) pPayload);
-		break;
+/**
+ * @brief  Characteristic update that does not wait for the stack
+ * @note   The commands are queued with hci_send_req_async() one after the
+ *         other. pPayload and pPending are used until pfDone is called with
+ *         the status of the first command that failed, BLE_STATUS_SUCCESS
+ *         otherwise. One update at a time.
+ * @param  UUID: UUID of the characteristic
+ * @param  pPayload: Value to notify
+ * @param  Length: Number of bytes, at most the declared size
+ * @param  pPending: Link slots still to notify, see SMART_WATCH_STM_App_Update_Value()
+ * @param  pfDone: Completion, called from the HCI event processing
+ * @retval BLE_STATUS_PENDING when started, the reason otherwise and pfDone is not called
+ */
+tBleStatus SMART_WATCH_STM_App_Update_Value_Async(uint16_t UUID, uint8_t *pPayload, uint16_t Length,
+		uint8_t *pPending, void (*pfDone)(tBleStatus Status)) {
+	uint16_t hdle, size;
+	tBleStatus result;
+
+	if (!SmartWatch_Char_Info(UUID, &hdle, &size) || Length > size || Length == 0)
+		return BLE_STATUS_INVALID_PARAMS;
+	if (SmartWatchAsync.Busy)
+		return BLE_STATUS_BUSY;
+	SmartWatchAsync.Id = UUID;
+	SmartWatchAsync.CharHdle = hdle;
+	SmartWatchAsync.pPayload = pPayload;
+	SmartWatchAsync.Length = Length;
+	SmartWatchAsync.Offset = 0;
+	SmartWatchAsync.pPending = pPending;
+	SmartWatchAsync.pfDone = pfDone;
+	result = SmartWatch_Async_Next();
+	if (result == BLE_STATUS_PENDING)
+		SmartWatchAsync.Busy = 1;
+	return result;
+}
 
-/*
-	case SWITCH_LUX:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyLUXCharHdle, 0,
-				4,
-				(uint8_t *) pPayload);
-		break;
-*/
-	case SWITCH_HR:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyHRCharHdle, 0, /* charValOffset */
-				16, /* charValueLen */
-				(uint8_t *) pPayload);
-		break;
-/*
-	case SWITCH_SPO2:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifySPO2CharHdle, 0,
-				16,
-				(uint8_t *) pPayload);
-		break;
-*/
-	case SWITCH_GSR:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyGSRCharHdle, 0, /* charValOffset */
-				4, /* charValueLen */
-				(uint8_t *) pPayload);
-		break;
+/**
+ * @brief  Link slots subscribed to a characteristic
+ * @param  UUID: UUID of the characteristic
+ * @retval Bit n set when slot n has notifications on
+ */
+uint8_t SMART_WATCH_STM_Subscribers(uint16_t UUID) {
+	uint8_t link, mask = 0;
 
-	case SWITCH_DATA:
-		result = aci_gatt_update_char_value(
-				aSmartWatchContext.SmartWatchSvcHdle,
-				aSmartWatchContext.SmartWatchNotifyDataCharHdle, 0, /* charValOffset */
-				450, /* charValueLen */
-				(uint8_t *) pPayload);
-	default:
-		break;
+	for (link = 0; link < CFG_BLE_NUM_LINK; link++) {
+		if (aSmartWatchLinks[link].ConnHandle != SMART_WATCH_LINK_FREE
+				&& (aSmartWatchLinks[link].SubscribedMask & (1 << UUID)))
+			mask |= (1 << link);
 	}
+	return mask;
+}
 
-	return result;
+/**
+ * @brief  Drops the subscriptions of a closed connection
+ * @note   The CCCDs of a link that goes away are never written back, the
+ *         application is told about every characteristic nobody listens to anymore
+ * @param  ConnHandle: Handle of the connection that was closed
+ *
+ */
+void SMART_WATCH_STM_Disconnected(uint16_t ConnHandle) {
+	SMART_WATCH_STM_App_Notification_evt_t Notification;
+	SmartWatchLink_t *link;
+	uint16_t mask;
+	uint16_t uuid;
+
+	link = SmartWatch_Link(ConnHandle, 0);
+	if (link == NULL)
+		return;
+	mask = link->SubscribedMask;
+	link->ConnHandle = SMART_WATCH_LINK_FREE;
+	link->SubscribedMask = 0;
+
+	Notification.SMART_WATCH_Evt_Opcode = SMART_WATCH_STM_NOTIFY_DISABLED_EVT;
+	Notification.ConnectionHandle = ConnHandle;
+	for (uuid = SWITCH_EGR; uuid <= SMART_WATCH_SWITCH_MAX; uuid++) {
+		if ((mask & (1 << uuid)) && !SmartWatch_Demand(uuid)
+				&& aSmartWatchContext.RowById[uuid] != SMART_WATCH_ROW_NONE)
+			aSmartWatchChars[aSmartWatchContext.RowById[uuid]].pfNotification(&Notification);
+	}
 }
 
-/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
\ No newline at end of file
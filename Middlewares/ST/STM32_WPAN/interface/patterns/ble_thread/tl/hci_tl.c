@@ -29,6 +29,23 @@
 
 
 /* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  HCI_TL_CmdCallBack_t pfCallBack;
+  uint32_t context;
+  uint16_t opcode;
+  uint8_t plen;
+  uint8_t in_mailbox; /**< parameters were written straight into pCmdBuffer */
+  uint8_t param[BLE_CMD_MAX_PARAM_LEN];
+} HciAsyncCmd_t;
+
+typedef enum
+{
+  HCI_TL_ASYNC_NOT_RESERVED,
+  HCI_TL_ASYNC_RESERVED_SLOT,
+  HCI_TL_ASYNC_RESERVED_MAILBOX,
+} HciAsyncReserve_t;
+
 /* Private defines -----------------------------------------------------------*/
 
 /**
@@ -37,6 +54,18 @@
 #define HCI_TL_DEFAULT_TIMEOUT (33000)
 
 /* Private macros ------------------------------------------------------------*/
+/**
+ * Event latency is timed with the DWT cycle counter unless the build
+ * provides its own clock
+ */
+#ifndef HCI_TL_CYCLES
+#define HCI_TL_CYCLES() (DWT->CYCCNT)
+#define HCI_TL_CYCLES_START() do { \
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+  } while (0)
+#endif
+
 /* Public variables ---------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /**
@@ -55,12 +84,44 @@ static tHciContext hciContext;
 static tListNode HciCmdEventQueue;
 static void (* StatusNotCallBackFunction) (HCI_TL_CmdStatus_t status);
 
+/**
+ * Asynchronous commands, the head is the one sent when AsyncAwaiting is set.
+ * AsyncCredit follows numcmd, AsyncSyncActive is set while hci_send_req()
+ * owns the command buffer.
+ */
+static HciAsyncCmd_t AsyncQueue[HCI_TL_ASYNC_QUEUE_SIZE];
+static uint8_t AsyncHead;
+static uint8_t AsyncCount;
+static volatile uint8_t AsyncAwaiting;
+static uint8_t AsyncCredit;
+static volatile uint8_t AsyncSyncActive;
+static HciAsyncReserve_t AsyncReserved;
+
+/**
+ * Arrivals are counted in the IPCC interrupt, completions in the background,
+ * the difference is the queue depth without sharing a counter. UserEvtStamp
+ * keeps the arrival cycle of the last HCI_TL_STATS_DEPTH user events.
+ */
+static HCI_TL_Stats_t Stats;
+static volatile uint32_t UserEvtArrived;
+static uint32_t UserEvtDone;
+static volatile uint32_t CmdEvtArrived;
+static uint32_t CmdEvtDone;
+static volatile uint32_t UserEvtStamp[HCI_TL_STATS_DEPTH];
+
 /* Private function prototypes -----------------------------------------------*/
 static void Cmd_SetStatus(HCI_TL_CmdStatus_t hcicmdstatus);
 static HCI_TL_CmdStatus_t CmdGetStatus( void );
 static void SendCmd(uint16_t opcode, uint8_t plen, void *param);
+static void SendCmdInPlace(uint16_t opcode, uint8_t plen);
 static void TlEvtReceived(TL_EvtPacket_t *hcievt);
 static void TlInit( TL_CmdPacket_t * p_cmdbuffer );
+static void AsyncKick( void );
+static void AsyncSendHead( void );
+static void AsyncCmdEvtProc( void );
+static void AsyncFlush( void );
+static void NotifyAsynchEvt( void );
+static void StatsUserEvtDone( void );
 
 /* Interface ------- ---------------------------------------------------------*/
 void hci_init(void(* UserEvtRx)(void* pData), void* pConf)
@@ -80,6 +141,15 @@ void hci_user_evt_proc(void)
   TL_EvtPacket_t *phcievtbuffer;
   tHCI_UserEvtRxParam UserEvtRxParam;
 
+  /**
+   * Responses to asynchronous commands are resolved here, out of the IPCC interrupt
+   */
+  if (AsyncSyncActive == FALSE)
+  {
+    AsyncCmdEvtProc();
+    AsyncKick();
+  }
+
   /**
    * It is more secure to use LST_remove_head()/LST_insert_head() compare to LST_get_next_node()/LST_remove_node()
    * in case the user overwrite the header where the next/prev pointers are located
@@ -100,6 +170,7 @@ void hci_user_evt_proc(void)
 
     if(UserEventFlow != HCI_TL_UserEventFlow_Disable)
     {
+      StatsUserEvtDone();
       TL_MM_EvtDone( phcievtbuffer );
     }
     else
@@ -108,6 +179,7 @@ void hci_user_evt_proc(void)
        * put back the event in the queue
        */
       LST_insert_head ( &HciAsynchEventQueue, (tListNode *)phcievtbuffer );
+      Stats.Rearmed++;
     }
   }
 
@@ -122,7 +194,7 @@ void hci_resume_flow( void )
    * It is better to go through the background process as it is not sure from which context this API may
    * be called
    */
-  hci_notify_asynch_evt((void*) &HciAsynchEventQueue);
+  NotifyAsynchEvt();
 
   return;
 }
@@ -136,6 +208,12 @@ int hci_send_req(struct hci_request *p_cmd, BOOL async)
   uint8_t hci_cmd_complete_return_parameters_length;
 
   Cmd_SetStatus(HCI_TL_CmdBusy);
+  AsyncSyncActive = TRUE;
+  /**
+   * Commands queued before this one go first
+   */
+  AsyncFlush();
+
   opcode = ((p_cmd->ocf) & 0x03ff) | ((p_cmd->ogf) << 10);
   SendCmd(opcode, p_cmd->clen, p_cmd->cparam);
 
@@ -149,6 +227,7 @@ int hci_send_req(struct hci_request *p_cmd, BOOL async)
     while(LST_is_empty(&HciCmdEventQueue) == FALSE)
     {
       LST_remove_head (&HciCmdEventQueue, (tListNode **)&pevtpacket);
+      CmdEvtDone++;
 
       if(pevtpacket->evtserial.evt.evtcode == TL_BLEEVT_CS_OPCODE)
       {
@@ -182,9 +261,97 @@ int hci_send_req(struct hci_request *p_cmd, BOOL async)
     }
   }
 
+  AsyncCredit = TRUE;
+  AsyncSyncActive = FALSE;
+  AsyncKick();
+
+  return 0;
+}
+
+int hci_send_req_async(uint16_t opcode, uint8_t plen, const void *param,
+                       HCI_TL_CmdCallBack_t pfCallBack, uint32_t context)
+{
+  uint8_t *pparam;
+
+  pparam = hci_async_reserve();
+  if (pparam == NULL)
+  {
+    return -1;
+  }
+  memcpy(pparam, param, plen);
+
+  return hci_async_commit(opcode, plen, pfCallBack, context);
+}
+
+uint8_t *hci_async_reserve(void)
+{
+  if (AsyncCount == HCI_TL_ASYNC_QUEUE_SIZE)
+  {
+    return NULL;
+  }
+
+  /**
+   * Nothing ahead of it and the command buffer free, the parameters go
+   * straight where CPU2 reads them
+   */
+  if ((AsyncCount == 0) && (AsyncAwaiting == FALSE) && (AsyncCredit != FALSE) && (AsyncSyncActive == FALSE))
+  {
+    AsyncReserved = HCI_TL_ASYNC_RESERVED_MAILBOX;
+    return pCmdBuffer->cmdserial.cmd.payload;
+  }
+
+  AsyncReserved = HCI_TL_ASYNC_RESERVED_SLOT;
+  return AsyncQueue[(AsyncHead + AsyncCount) % HCI_TL_ASYNC_QUEUE_SIZE].param;
+}
+
+int hci_async_commit(uint16_t opcode, uint8_t plen, HCI_TL_CmdCallBack_t pfCallBack, uint32_t context)
+{
+  HciAsyncCmd_t *pcmd;
+
+  if (AsyncReserved == HCI_TL_ASYNC_NOT_RESERVED)
+  {
+    return -1;
+  }
+
+  pcmd = &AsyncQueue[(AsyncHead + AsyncCount) % HCI_TL_ASYNC_QUEUE_SIZE];
+  pcmd->pfCallBack = pfCallBack;
+  pcmd->context = context;
+  pcmd->opcode = opcode;
+  pcmd->plen = plen;
+  pcmd->in_mailbox = (AsyncReserved == HCI_TL_ASYNC_RESERVED_MAILBOX);
+  AsyncReserved = HCI_TL_ASYNC_NOT_RESERVED;
+  AsyncCount++;
+
+  AsyncKick();
+
   return 0;
 }
 
+uint8_t hci_async_free(void)
+{
+  return HCI_TL_ASYNC_QUEUE_SIZE - AsyncCount;
+}
+
+void hci_get_stats(HCI_TL_Stats_t *p_stats)
+{
+  *p_stats = Stats;
+
+  return;
+}
+
+void hci_reset_stats(void)
+{
+  Stats.UserEvtReceived = 0;
+  Stats.Armed = 0;
+  Stats.Rearmed = 0;
+  Stats.LatencyMax = 0;
+  Stats.LatencyUntimed = 0;
+  Stats.UserEvtQueuedMax = 0;
+  Stats.CmdEvtQueuedMax = 0;
+
+  return;
+}
+
 /* Private functions ---------------------------------------------------------*/
 static void TlInit( TL_CmdPacket_t * p_cmdbuffer )
 {
@@ -201,6 +368,20 @@ static void TlInit( TL_CmdPacket_t * p_cmdbuffer )
 
   Cmd_SetStatus(HCI_TL_CmdAvailable);
 
+  AsyncHead = 0;
+  AsyncCount = 0;
+  AsyncAwaiting = FALSE;
+  AsyncCredit = TRUE;
+  AsyncSyncActive = FALSE;
+  AsyncReserved = HCI_TL_ASYNC_NOT_RESERVED;
+
+  UserEvtArrived = 0;
+  UserEvtDone = 0;
+  CmdEvtArrived = 0;
+  CmdEvtDone = 0;
+  hci_reset_stats();
+  HCI_TL_CYCLES_START();
+
   UserEventFlow = HCI_TL_UserEventFlow_Enable;
 
   /* Initialize low level driver */
@@ -221,10 +402,20 @@ static HCI_TL_CmdStatus_t CmdGetStatus(void)
 }
 
 static void SendCmd(uint16_t opcode, uint8_t plen, void *param)
+{
+  memcpy( pCmdBuffer->cmdserial.cmd.payload, param, plen );
+  SendCmdInPlace(opcode, plen);
+
+  return;
+}
+
+/**
+ * The parameters are already in pCmdBuffer
+ */
+static void SendCmdInPlace(uint16_t opcode, uint8_t plen)
 {
   pCmdBuffer->cmdserial.cmd.cmdcode = opcode;
   pCmdBuffer->cmdserial.cmd.plen = plen;
-  memcpy( pCmdBuffer->cmdserial.cmd.payload, param, plen );
 
   hciContext.io.Send(0,0);
 
@@ -255,15 +446,188 @@ static void Cmd_SetStatus(HCI_TL_CmdStatus_t hcicmdstatus)
 
 static void TlEvtReceived(TL_EvtPacket_t *hcievt)
 {
+  uint32_t depth;
+
   if ( ((hcievt->evtserial.evt.evtcode) == TL_BLEEVT_CS_OPCODE) || ((hcievt->evtserial.evt.evtcode) == TL_BLEEVT_CC_OPCODE ) )
   {
+    depth = ++CmdEvtArrived - CmdEvtDone;
+    if (depth > Stats.CmdEvtQueuedMax)
+    {
+      Stats.CmdEvtQueuedMax = (depth > 0xFF) ? 0xFF : depth;
+    }
     LST_insert_tail(&HciCmdEventQueue, (tListNode *)hcievt);
     hci_cmd_resp_release(0); /**< Notify the application a full Cmd Event has been received */
+    if ((AsyncAwaiting != FALSE) && (AsyncSyncActive == FALSE))
+    {
+      NotifyAsynchEvt(); /**< Nobody waits for it, resolve it from the background */
+    }
   }
   else
   {
+    UserEvtStamp[UserEvtArrived % HCI_TL_STATS_DEPTH] = HCI_TL_CYCLES();
+    depth = ++UserEvtArrived - UserEvtDone;
+    if (depth > Stats.UserEvtQueuedMax)
+    {
+      Stats.UserEvtQueuedMax = (depth > 0xFF) ? 0xFF : depth;
+    }
+    Stats.UserEvtReceived++;
     LST_insert_tail(&HciAsynchEventQueue, (tListNode *)hcievt);
-    hci_notify_asynch_evt((void*) &HciAsynchEventQueue); /**< Notify the application a full HCI event has been received */
+    NotifyAsynchEvt(); /**< Notify the application a full HCI event has been received */
+  }
+
+  return;
+}
+
+static void NotifyAsynchEvt( void )
+{
+  uint32_t primask_bit;
+
+  /**
+   * Called from the IPCC RX interrupt and from the background
+   */
+  primask_bit = __get_PRIMASK();
+  __disable_irq();
+  Stats.Armed++;
+  __set_PRIMASK(primask_bit);
+  hci_notify_asynch_evt((void*) &HciAsynchEventQueue);
+
+  return;
+}
+
+/**
+ * The oldest queued user event has been handled. Its stamp is only valid
+ * while fewer than HCI_TL_STATS_DEPTH events arrived after it, the stamp is
+ * read before the arrival count is checked.
+ */
+static void StatsUserEvtDone( void )
+{
+  uint32_t latency;
+
+  latency = HCI_TL_CYCLES() - UserEvtStamp[UserEvtDone % HCI_TL_STATS_DEPTH];
+  if ((UserEvtArrived - UserEvtDone) <= HCI_TL_STATS_DEPTH)
+  {
+    if (latency > Stats.LatencyMax)
+    {
+      Stats.LatencyMax = latency;
+    }
+  }
+  else
+  {
+    Stats.LatencyUntimed++;
+  }
+  UserEvtDone++;
+
+  return;
+}
+
+/**
+ * Sends the head of the asynchronous queue when the command buffer is free.
+ * The status callback is not told, tasks keep running while it is in flight.
+ */
+static void AsyncKick( void )
+{
+  if ((AsyncSyncActive != FALSE) || (AsyncAwaiting != FALSE) || (AsyncCredit == FALSE) || (AsyncCount == 0))
+  {
+    return;
+  }
+
+  AsyncSendHead();
+
+  return;
+}
+
+static void AsyncSendHead( void )
+{
+  HciAsyncCmd_t *pcmd;
+
+  pcmd = &AsyncQueue[AsyncHead];
+  AsyncAwaiting = TRUE;
+  AsyncCredit = FALSE;
+  if (pcmd->in_mailbox != FALSE)
+  {
+    SendCmdInPlace(pcmd->opcode, pcmd->plen);
+  }
+  else
+  {
+    SendCmd(pcmd->opcode, pcmd->plen, pcmd->param);
+  }
+
+  return;
+}
+
+static void AsyncCmdEvtProc( void )
+{
+  TL_EvtPacket_t *pevtpacket;
+  TL_CsEvt_t *pcommand_status_event;
+  TL_CcEvt_t *pcommand_complete_event;
+  HCI_TL_CmdCallBack_t pfcallback;
+  uint32_t context;
+  uint16_t opcode;
+  uint8_t status;
+  uint8_t numcmd;
+
+  while(LST_is_empty(&HciCmdEventQueue) == FALSE)
+  {
+    LST_remove_head (&HciCmdEventQueue, (tListNode **)&pevtpacket);
+    CmdEvtDone++;
+
+    if(pevtpacket->evtserial.evt.evtcode == TL_BLEEVT_CS_OPCODE)
+    {
+      pcommand_status_event = (TL_CsEvt_t*)pevtpacket->evtserial.evt.payload;
+      opcode = pcommand_status_event->cmdcode;
+      status = pcommand_status_event->status;
+      numcmd = pcommand_status_event->numcmd;
+    }
+    else
+    {
+      pcommand_complete_event = (TL_CcEvt_t*)pevtpacket->evtserial.evt.payload;
+      opcode = pcommand_complete_event->cmdcode;
+      status = pcommand_complete_event->payload[0];
+      numcmd = pcommand_complete_event->numcmd;
+    }
+
+    if(numcmd != 0)
+    {
+      AsyncCredit = TRUE;
+    }
+
+    if((AsyncAwaiting != FALSE) && (opcode == AsyncQueue[AsyncHead].opcode))
+    {
+      /**
+       * The slot is released before the callback so it can queue again
+       */
+      pfcallback = AsyncQueue[AsyncHead].pfCallBack;
+      context = AsyncQueue[AsyncHead].context;
+      AsyncHead = (AsyncHead + 1) % HCI_TL_ASYNC_QUEUE_SIZE;
+      AsyncCount--;
+      AsyncAwaiting = FALSE;
+
+      if(pfcallback != NULL)
+      {
+        pfcallback(opcode, status, context);
+      }
+    }
+  }
+
+  return;
+}
+
+/**
+ * Called by hci_send_req() with the command tasks paused, sends and completes
+ * everything still queued so the synchronous command keeps its place in line
+ */
+static void AsyncFlush( void )
+{
+  AsyncCmdEvtProc();
+
+  while((AsyncCount != 0) || (AsyncAwaiting != FALSE))
+  {
+    if((AsyncAwaiting == FALSE) && (AsyncCredit != FALSE))
+    {
+      AsyncSendHead();
+    }
+    hci_cmd_resp_wait(HCI_TL_DEFAULT_TIMEOUT);
+    AsyncCmdEvtProc();
   }
 
   return;
@@ -79,6 +79,44 @@ typedef struct
   void (* StatusNotCallBack) (HCI_TL_CmdStatus_t status);
 } HCI_TL_HciInitConf_t;
 
+/**
+ * @brief Completion of a command sent with hci_send_req_async().
+ *        status is the status of the Command Status event or the first return
+ *        parameter of the Command Complete event, context is passed through
+ */
+typedef void (* HCI_TL_CmdCallBack_t) (uint16_t opcode, uint8_t status, uint32_t context);
+
+/**
+ * Commands hci_send_req_async() can hold, each one keeps a full parameter buffer
+ */
+#ifndef HCI_TL_ASYNC_QUEUE_SIZE
+#define HCI_TL_ASYNC_QUEUE_SIZE   (4)
+#endif
+
+/**
+ * User events whose arrival time is kept for the latency measurement, an
+ * event that waited behind more of them is counted as untimed
+ */
+#ifndef HCI_TL_STATS_DEPTH
+#define HCI_TL_STATS_DEPTH        (8)
+#endif
+
+/**
+ * @brief Load of the HCI event queues. The latency of a user event runs from
+ *        the IPCC interrupt handing it over to the return of UserEvtRx(), in
+ *        DWT cycles
+ */
+typedef struct
+{
+  uint32_t UserEvtReceived;
+  uint32_t Armed;          /**< hci_notify_asynch_evt() calls */
+  uint32_t Rearmed;        /**< hci_user_evt_proc() left events queued, the application stopped the flow */
+  uint32_t LatencyMax;
+  uint32_t LatencyUntimed;
+  uint8_t UserEvtQueuedMax; /**< HciAsynchEventQueue */
+  uint8_t CmdEvtQueuedMax;  /**< HciCmdEventQueue */
+} HCI_TL_Stats_t;
+
 /**
  * @brief  Register IO bus services.
  * @param  fops The HCI IO structure managing the IO BUS
@@ -175,6 +213,66 @@ void hci_user_evt_proc(void);
  */
 void hci_init(void(* UserEvtRx)(void* pData), void* pConf);
 
+/**
+ * @brief  Queues a prebuilt command and returns without waiting for its response.
+ *         Commands go down one at a time in the order they were queued, a
+ *         synchronous hci_send_req() first sends and completes all of them.
+ *         The callback runs from hci_user_evt_proc(), or from hci_send_req()
+ *         when that one drains the queue, so it shall only queue commands.
+ *
+ * @param  opcode: OGF << 10 | OCF
+ * @param  plen: Parameter length, at most BLE_CMD_MAX_PARAM_LEN
+ * @param  param: Parameters, copied
+ * @param  pfCallBack: Completion callback, may be NULL
+ * @param  context: Passed back to the callback
+ * @retval 0 when queued, -1 when the queue is full
+ */
+int hci_send_req_async(uint16_t opcode, uint8_t plen, const void *param,
+                       HCI_TL_CmdCallBack_t pfCallBack, uint32_t context);
+
+/**
+ * @brief  Parameter buffer for the next asynchronous command, to be filled in
+ *         place and handed over with hci_async_commit() before any other
+ *         command is sent. When nothing is queued or in flight this is the
+ *         mailbox command buffer itself and the parameters are never copied.
+ *
+ * @param  None
+ * @retval BLE_CMD_MAX_PARAM_LEN bytes, NULL when the queue is full
+ */
+uint8_t *hci_async_reserve(void);
+
+/**
+ * @brief  Queues the command whose parameters were written to hci_async_reserve()
+ *
+ * @param  opcode: OGF << 10 | OCF
+ * @param  plen: Parameter length
+ * @param  pfCallBack: Completion callback, may be NULL
+ * @param  context: Passed back to the callback
+ * @retval 0 when queued, -1 without a reservation
+ */
+int hci_async_commit(uint16_t opcode, uint8_t plen, HCI_TL_CmdCallBack_t pfCallBack, uint32_t context);
+
+/**
+ * @brief  Number of commands hci_send_req_async() can still queue
+ * @param  None
+ * @retval Free slots
+ */
+uint8_t hci_async_free(void);
+
+/**
+ * @brief  Snapshot of the event queue statistics
+ * @param  p_stats: Filled with the counters since the last hci_reset_stats()
+ * @retval None
+ */
+void hci_get_stats(HCI_TL_Stats_t *p_stats);
+
+/**
+ * @brief  Clears the counters and the high-water marks
+ * @param  None
+ * @retval None
+ */
+void hci_reset_stats(void);
+
 /**
  * END OF SECTION - INTERFACES USED BY THE BLE DRIVER
  *********************************************************************************************************************
@@ -177,6 +177,21 @@ typedef struct
   uint32_t TracesEvtPoolSize;
 } TL_MM_Config_t;
 
+/**
+ * Event buffers on the CPU1 side, from the mailbox queue they arrive in to
+ * their release to CPU2. The spare buffers are only used by CPU2 when the
+ * pool is exhausted.
+ */
+typedef struct
+{
+  uint32_t EvtReceived;     /**< BLE and system events */
+  uint32_t SpareUsed;       /**< events delivered in a spare buffer */
+  uint16_t Held;            /**< buffers not given back yet */
+  uint16_t HeldMax;
+  uint16_t BytesHeld;       /**< header and payload of these buffers */
+  uint16_t BytesHeldMax;
+} TL_MM_Stats_t;
+
 typedef struct
 {
   uint8_t *p_ThreadOtCmdRspBuffer;
@@ -254,6 +269,8 @@ void TL_THREAD_CliNotReceived( TL_EvtPacket_t * Notbuffer );
  ******************************************************************************/
 void TL_MM_Init( TL_MM_Config_t *p_Config );
 void TL_MM_EvtDone( TL_EvtPacket_t * hcievt );
+void TL_MM_GetStats( TL_MM_Stats_t *p_Stats );
+void TL_MM_ResetStats( void );
 
 /******************************************************************************
  * TRACES
@@ -54,11 +54,14 @@ static void (* BLE_IoBusEvtCallBackFunction) (TL_EvtPacket_t *phcievt);
 static void (* BLE_IoBusAclDataTxAck) ( void );
 static void (* SYS_CMD_IoBusCallBackFunction) (TL_EvtPacket_t *phcievt);
 static void (* SYS_EVT_IoBusCallBackFunction) (TL_EvtPacket_t *phcievt);
+static TL_MM_Stats_t MM_Stats;
 
 
 /* Global variables ----------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 static void SendFreeBuf( void );
+static void MM_EvtReceived( TL_EvtPacket_t *p_evt );
+static uint16_t MM_EvtSize( TL_EvtPacket_t *p_evt );
 
 /* Public Functions Definition ------------------------------------------------------*/
 
@@ -132,6 +135,7 @@ void HW_IPCC_BLE_RxEvtNot(void)
   {
     LST_remove_head (&EvtQueue, (tListNode **)&phcievt);
 
+    MM_EvtReceived(phcievt);
     BLE_IoBusEvtCallBackFunction(phcievt);
   }
 
@@ -199,6 +203,7 @@ void HW_IPCC_SYS_EvtNot( void )
   while(LST_is_empty(&SystemEvtQueue) == FALSE)
   {
     LST_remove_head (&SystemEvtQueue, (tListNode **)&p_evt);
+    MM_EvtReceived(p_evt);
     SYS_EVT_IoBusCallBackFunction( p_evt );
   }
 
@@ -358,6 +363,8 @@ void TL_MM_Init( TL_MM_Config_t *p_Config )
   p_mem_manager_table->traces_evt_pool = p_Config->p_TracesEvtPool;
   p_mem_manager_table->tracespoolsize = p_Config->TracesEvtPoolSize;
 
+  memset(&MM_Stats, 0, sizeof(MM_Stats));
+
   return;
 }
 
@@ -370,19 +377,102 @@ void TL_MM_EvtDone(TL_EvtPacket_t * phcievt)
   return;
 }
 
+void TL_MM_GetStats( TL_MM_Stats_t *p_Stats )
+{
+  uint32_t primask_bit;
+
+  primask_bit = __get_PRIMASK();
+  __disable_irq();
+  *p_Stats = MM_Stats;
+  __set_PRIMASK(primask_bit);
+
+  return;
+}
+
+/**
+ * Starts a new measurement, the buffers still held are carried over
+ */
+void TL_MM_ResetStats( void )
+{
+  uint32_t primask_bit;
+
+  primask_bit = __get_PRIMASK();
+  __disable_irq();
+  MM_Stats.EvtReceived = 0;
+  MM_Stats.SpareUsed = 0;
+  MM_Stats.HeldMax = MM_Stats.Held;
+  MM_Stats.BytesHeldMax = MM_Stats.BytesHeld;
+  __set_PRIMASK(primask_bit);
+
+  return;
+}
+
 static void SendFreeBuf( void )
 {
   tListNode *p_node;
+  uint32_t primask_bit;
+  uint16_t size;
 
   while ( FALSE == LST_is_empty (&LocalFreeBufQueue) )
   {
     LST_remove_head( &LocalFreeBufQueue, (tListNode **)&p_node );
+    size = MM_EvtSize((TL_EvtPacket_t *)p_node);
     LST_insert_tail( (tListNode*)(TL_RefTable.p_mem_manager_table->pevt_free_buffer_queue), p_node );
+
+    primask_bit = __get_PRIMASK();
+    __disable_irq();
+    MM_Stats.Held--;
+    MM_Stats.BytesHeld -= size;
+    __set_PRIMASK(primask_bit);
+  }
+
+  return;
+}
+
+/**
+ * Called from the IPCC interrupt for each event taken from a mailbox queue.
+ * Command events come back in the command and CS buffers, not in the pool,
+ * and are never released.
+ */
+static void MM_EvtReceived( TL_EvtPacket_t *p_evt )
+{
+  uint32_t primask_bit;
+  MB_MemManagerTable_t *p_mem_manager_table = TL_RefTable.p_mem_manager_table;
+
+  if ( ((uint8_t *)p_evt == TL_RefTable.p_ble_table->pcmd_buffer) ||
+       ((uint8_t *)p_evt == TL_RefTable.p_ble_table->pcs_buffer) )
+  {
+    return;
+  }
+
+  primask_bit = __get_PRIMASK();
+  __disable_irq();
+  MM_Stats.EvtReceived++;
+  if ( ((uint8_t *)p_evt == p_mem_manager_table->spare_ble_buffer) ||
+       ((uint8_t *)p_evt == p_mem_manager_table->spare_sys_buffer) )
+  {
+    MM_Stats.SpareUsed++;
   }
+  MM_Stats.Held++;
+  MM_Stats.BytesHeld += MM_EvtSize(p_evt);
+  if ( MM_Stats.Held > MM_Stats.HeldMax )
+  {
+    MM_Stats.HeldMax = MM_Stats.Held;
+  }
+  if ( MM_Stats.BytesHeld > MM_Stats.BytesHeldMax )
+  {
+    MM_Stats.BytesHeldMax = MM_Stats.BytesHeld;
+  }
+  __set_PRIMASK(primask_bit);
 
   return;
 }
 
+static uint16_t MM_EvtSize( TL_EvtPacket_t *p_evt )
+{
+  return sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + p_evt->evtserial.evt.plen;
+}
+
 
 /******************************************************************************
  * TRACES
@@ -22,6 +22,8 @@
 #include "utilities_common.h"
 
 #include "scheduler.h"
+#include "cycle_prof.h"
+#include "sch_periodic.h"
 
 /* Private typedef -----------------------------------------------------------*/
 typedef struct
@@ -31,6 +33,10 @@ uint32_t round_robin;
 } SCH_Priority_t;
 
 /* Private defines -----------------------------------------------------------*/
+#if (CFG_CYCLE_PROF != 0) && (SCH_CONF_TASK_NBR > CYCLE_PROF_TASKS)
+#error "CYCLE_PROF_TASKS is too small for SCH_CONF_TASK_NBR"
+#endif
+
 /* Private macros ------------------------------------------------------------*/
 
 #if( __CORTEX_M != 0 )
@@ -71,6 +77,9 @@ void SCH_Run( uint32_t mask_bm )
   uint32_t counter;
   uint32_t current_task_set;
   uint32_t super_mask_backup;
+#if (CFG_SCH_PERIODIC != 0)
+  uint32_t periodic_task;
+#endif
 
   BACKUP_PRIMASK();
 
@@ -121,6 +130,15 @@ void SCH_Run( uint32_t mask_bm )
     /** read the flag index of the task to be executed */
     bit_nbr = COUNT_LEAD_ZERO(current_task_set & TaskPrio[counter].round_robin);
 
+#if (CFG_SCH_PERIODIC != 0)
+    /** a pending periodic job goes earliest deadline first when only periodic tasks are ready */
+    periodic_task = ucSchPeriodicPick(current_task_set);
+    if (periodic_task != SCH_PERIODIC_NONE)
+    {
+      bit_nbr = 31 - periodic_task;
+    }
+#endif
+
     /** remove from the roun_robin mask the task that has been selected to be executed */
     TaskPrio[counter].round_robin &= ~(1 << (31 - bit_nbr));
 
@@ -134,7 +152,9 @@ void SCH_Run( uint32_t mask_bm )
     }
     RESTORE_PRIMASK();
     /** Execute the task */
-    TaskCb[31 - bit_nbr]();
+    vSchPeriodicStart(31 - bit_nbr, HAL_GetTick());
+    CYCLE_PROF_CALL(31 - bit_nbr, TaskCb[31 - bit_nbr]());
+    vSchPeriodicDone(31 - bit_nbr, HAL_GetTick());
   }
 
   DISABLE_IRQ();
@@ -41,6 +41,10 @@
 #include "hal_lcd.h"
 #include "smart_watch_app.h"
 #include "oled.h"
+#include "hr_beacon.h"
+#include "conn_governor.h"
+#include "tx_power.h"
+#include "app_entry.h"
 /* USER CODE END Includes */
 static int siCounterTogleLed=0;
 /* Private typedef -----------------------------------------------------------*/
@@ -181,10 +185,16 @@ typedef struct
 #define APPBLE_GAP_DEVICE_NAME_LENGTH 7
 #define FAST_ADV_TIMEOUT               (30*1000*1000/CFG_TS_TICK_VAL) /**< 30s */
 #define INITIAL_ADV_TIMEOUT            (60*1000*1000/CFG_TS_TICK_VAL) /**< 60s */
+#define LINK_TICK_PERIOD               500 /**< ms, also the deadline */
 
 #define BD_ADDR_SIZE_LOCAL    6
 
 /* USER CODE BEGIN PD */
+#ifndef EVT_LE_DATA_LENGTH_CHANGE
+#define EVT_LE_DATA_LENGTH_CHANGE      0x07
+#endif
+#define LINK_PHY_1M                    0x01
+#define LINK_PHY_2M                    0x02
 
 /* USER CODE END PD */
 
@@ -224,24 +234,31 @@ static const uint8_t BLE_CFG_ER_VALUE[16] = CFG_BLE_ERK;
  * The MagicKeywordvalue is checked in the ble_ota application
  */
 PLACE_IN_SECTION("TAG_OTA_END") const uint32_t MagicKeywordValue = 0x94448A29 ;
-PLACE_IN_SECTION("TAG_OTA_START") const uint32_t MagicKeywordAddress = (uint32_t)&MagicKeywordValue;
+PLACE_IN_SECTION("TAG_OTA_START") const uint32_t * const MagicKeywordAddress = &MagicKeywordValue;
 
 PLACE_IN_SECTION("BLE_APP_CONTEXT") static BleApplicationContext_t BleApplicationContext;
 PLACE_IN_SECTION("BLE_APP_CONTEXT") static uint16_t AdvIntervalMin, AdvIntervalMax;
 
 
 #if L2CAP_REQUEST_NEW_CONN_PARAM != 0
-#define SIZE_TAB_CONN_INT            2
-float tab_conn_interval[SIZE_TAB_CONN_INT] = {50, 1000} ; /* ms */
-uint8_t index_con_int, mutex; 
+/* profile each link was asked to run with, CONN_GOV_NONE before the first request */
+static uint8_t Link_Profile[CFG_BLE_NUM_LINK];
+static uint8_t Link_Profile_Req[CFG_BLE_NUM_LINK];
 #endif 
 
 /**
  * Advertising Data
+ * flags (3) + local name (10) + manufacturer data fill the 31 bytes of ADV_IND
  */
+#define MANUF_DATA_ST_SIZE 14
+#if (CFG_BLE_HR_BROADCAST != 0)
+#define MANUF_DATA_BROADCAST_SIZE HR_BEACON_RECORD_SIZE
+#else
+#define MANUF_DATA_BROADCAST_SIZE 0
+#endif
 #if (P2P_SERVER1 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME ,'P','U','L','S','E', 'F', 'E', 'X'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER1 /* STM32WB - P2P Server 1*/,
@@ -262,7 +279,7 @@ uint8_t manuf_data[14] = {
  */
 #if (P2P_SERVER2 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'P', '2', 'P', 'S', 'R', 'V', '2'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER2 /* STM32WB - P2P Server 2*/,
@@ -282,7 +299,7 @@ uint8_t manuf_data[14] = {
 
 #if (P2P_SERVER3 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'P', '2', 'P', 'S', 'R', 'V', '3'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER3 /* STM32WB - P2P Server 3*/,
@@ -301,7 +318,7 @@ uint8_t manuf_data[14] = {
 
 #if (P2P_SERVER4 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'P', '2', 'P', 'S', 'R', 'V', '4'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER4 /* STM32WB - P2P Server 4*/,
@@ -320,7 +337,7 @@ uint8_t manuf_data[14] = {
 
 #if (P2P_SERVER5 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'P', '2', 'P', 'S', 'R', 'V', '5'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER5 /* STM32WB - P2P Server 5*/,
@@ -339,7 +356,7 @@ uint8_t manuf_data[14] = {
 
 #if (P2P_SERVER6 != 0)
 static const char local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'P', '2', 'P', 'S', 'R', 'V', '6'};
-uint8_t manuf_data[14] = {
+uint8_t manuf_data[MANUF_DATA_ST_SIZE + MANUF_DATA_BROADCAST_SIZE] = {
     sizeof(manuf_data)-1, AD_TYPE_MANUFACTURER_SPECIFIC_DATA, 
     0x01/*SKD version */,
     CFG_DEV_ID_P2P_SERVER6 /* STM32WB - P2P Server 1*/,
@@ -356,6 +373,10 @@ uint8_t manuf_data[14] = {
 };
 #endif
 /* USER CODE BEGIN PV */
+/* every open link, 0xFFFF when free, its negotiation and the largest notification it takes */
+static uint16_t Link_Handles[CFG_BLE_NUM_LINK];
+static APP_BLE_LinkParams_t LinkParams[CFG_BLE_NUM_LINK];
+static uint16_t Link_Payload[CFG_BLE_NUM_LINK];
 
 /* USER CODE END PV */
 
@@ -371,9 +392,21 @@ static void Adv_Cancel_Req( void );
 static void Switch_OFF_GPIO( void );
 #if(L2CAP_REQUEST_NEW_CONN_PARAM != 0)  
 static void BLE_SVC_L2CAP_Conn_Update(uint16_t Connection_Handle);
+static void Conn_Governor( void );
 #endif
 
 /* USER CODE BEGIN PFP */
+static void Link_Reset( uint8_t slot );
+static void Link_Setup( void );
+static void Link_Setup_Step( uint8_t slot );
+static void Link_Changed( uint8_t slot );
+static uint8_t Link_Slot( uint16_t Connection_Handle );
+static void Adv_Resume( void );
+static void Link_Tick( void );
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+static void Tx_Power_Control( void );
+static void Tx_Power_Apply( uint8_t Changed );
+#endif
 
 /* USER CODE END PFP */
 
@@ -381,6 +414,8 @@ static void BLE_SVC_L2CAP_Conn_Update(uint16_t Connection_Handle);
 void APP_BLE_Init( void )
 {
 /* USER CODE BEGIN APP_BLE_Init_1 */
+  uint8_t slot;
+
   /* Initialize the LCD */
   //LCD_Init();
 
@@ -452,20 +487,33 @@ void APP_BLE_Init( void )
    * From here, all initialization are BLE application specific
    */
   SCH_RegTask(CFG_TASK_ADV_CANCEL_ID, Adv_Cancel);
+  SCH_RegTask(CFG_TASK_LINK_SETUP_ID, Link_Setup);
+#if (CFG_BLE_HR_BROADCAST != 0)
+  vHrBeaconInit();
+#endif
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    Link_Handles[slot] = 0xFFFF;
+    Link_Reset(slot);
+  }
   /**
    * Initialization of ADV - Ad Manufacturer Element - Support OTA Bit Mask
    */
 #if(BLE_CFG_OTA_REBOOT_CHAR != 0)  
-    manuf_data[sizeof(manuf_data)-8] = CFG_FEATURE_OTA_REBOOT;
+    manuf_data[MANUF_DATA_ST_SIZE-8] = CFG_FEATURE_OTA_REBOOT;
 #endif
 #if(RADIO_ACTIVITY_EVENT != 0)  
   aci_hal_set_radio_activity_mask(0x0006);
 #endif  
   
 #if (L2CAP_REQUEST_NEW_CONN_PARAM != 0 )
-  index_con_int = 0; 
-  mutex = 1; 
+  vConnGovInit();
+#endif
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+  vTxPowerInit(CFG_TX_POWER, HAL_GetTick());
 #endif
+  SCH_RegTask(CFG_TASK_LINK_TICK_ID, Link_Tick);
+  APPE_Periodic_Register(CFG_TASK_LINK_TICK_ID, LINK_TICK_PERIOD, LINK_TICK_PERIOD);
 
   /**
    * Initialize Custom Server Application
@@ -508,6 +556,7 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification( void *pckt )
   hci_event_pckt *event_pckt;
   evt_le_meta_event *meta_evt;
   evt_blue_aci *blue_evt;
+  uint8_t slot;
 
   event_pckt = (hci_event_pckt*) ((hci_uart_pckt *) pckt)->data;
 
@@ -518,10 +567,51 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification( void *pckt )
       hci_disconnection_complete_event_rp0 *disconnection_complete_event;
       disconnection_complete_event = (hci_disconnection_complete_event_rp0 *) event_pckt->data;
 
+      slot = Link_Slot(disconnection_complete_event->Connection_Handle);
+      if (slot < CFG_BLE_NUM_LINK)
+      {
+        Link_Handles[slot] = 0xFFFF;
+        Link_Reset(slot);
+#if (L2CAP_REQUEST_NEW_CONN_PARAM != 0 )
+        Link_Profile[slot] = CONN_GOV_NONE;
+        Link_Profile_Req[slot] = CONN_GOV_NONE;
+#endif
+      }
+      SMART_WATCH_STM_Disconnected(disconnection_complete_event->Connection_Handle);
+      /* another central is still there, it becomes the link the status refers to */
+      for (slot = 0; slot < CFG_BLE_NUM_LINK && Link_Handles[slot] == 0xFFFF; slot++);
+      if (slot < CFG_BLE_NUM_LINK)
+      {
+        if (disconnection_complete_event->Connection_Handle == BleApplicationContext.BleApplicationContext_legacy.connectionHandle)
+        {
+          BleApplicationContext.BleApplicationContext_legacy.connectionHandle = Link_Handles[slot];
+        }
+        SMART_WATCH_APP_Link_Update(APP_BLE_Get_Notify_Payload_Max());
+        SMART_WATCH_APP_Disconnected();
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+        /* lost on supervision timeout, the remaining link may be fading as well */
+        if (disconnection_complete_event->Reason == ERR_CONNECTION_TIMEOUT)
+        {
+          Tx_Power_Apply(ucTxPowerLoss(HAL_GetTick()));
+        }
+#endif
+        Adv_Resume();
+        break;
+      }
       if (disconnection_complete_event->Connection_Handle == BleApplicationContext.BleApplicationContext_legacy.connectionHandle)
       {
         BleApplicationContext.BleApplicationContext_legacy.connectionHandle = 0;
         BleApplicationContext.Device_Connection_Status = APP_BLE_IDLE;
+        SMART_WATCH_APP_Link_Update(APP_BLE_Get_Notify_Payload_Max());
+        APPE_Periodic_Enable(CFG_TASK_LINK_TICK_ID, 0);
+#if (L2CAP_REQUEST_NEW_CONN_PARAM != 0 )
+        vConnGovInit();
+#endif
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+        /* advertising goes out at full power again */
+        Tx_Power_Apply(ucTxPowerReset(HAL_GetTick()));
+#endif
+        SMART_WATCH_APP_Disconnected();
         //TODO add screen process
         vOledBleClearScreen();
         LCD_BLE_PrintStatus((char *)"ADVERTISING");
@@ -586,11 +676,70 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification( void *pckt )
 * SPECIFIC to P2P Server APP
 */             
           /* USER CODE BEGIN HCI_EVT_LE_CONN_COMPLETE */
+          /* MTU, data length and PHY are requested from the task, one command per step */
+          slot = Link_Slot(0xFFFF);
+          if (slot < CFG_BLE_NUM_LINK)
+          {
+            Link_Handles[slot] = connection_complete_event->Connection_Handle;
+            Link_Reset(slot);
+            LinkParams[slot].Step = APP_BLE_LINK_MTU;
+            SCH_SetTask(1 << CFG_TASK_LINK_SETUP_ID, CFG_SCH_PRIO_0);
+#if (L2CAP_REQUEST_NEW_CONN_PARAM != 0 )
+            Link_Profile[slot] = CONN_GOV_NONE;
+            Link_Profile_Req[slot] = CONN_GOV_NONE;
+#endif
+            APPE_Periodic_Enable(CFG_TASK_LINK_TICK_ID, 1);
+            Link_Changed(slot);
+          }
+          /* a second central may still join, the first one keeps its subscriptions */
+          if (Link_Slot(0xFFFF) < CFG_BLE_NUM_LINK)
+          {
+            Adv_Resume();
+          }
 
           /* USER CODE END HCI_EVT_LE_CONN_COMPLETE */
           }
         break; /* HCI_EVT_LE_CONN_COMPLETE */
 
+        case EVT_LE_DATA_LENGTH_CHANGE:
+          {
+          hci_le_data_length_change_event_rp0 *data_length_change_event;
+
+          data_length_change_event = (hci_le_data_length_change_event_rp0 *) meta_evt->data;
+          slot = Link_Slot(data_length_change_event->Connection_Handle);
+          if (slot < CFG_BLE_NUM_LINK)
+          {
+            LinkParams[slot].Max_Tx_Octets = data_length_change_event->MaxTxOctets;
+            LinkParams[slot].Max_Rx_Octets = data_length_change_event->MaxRxOctets;
+#if(CFG_DEBUG_APP_TRACE != 0)
+            APP_DBG_MSG("\r\n\r** DATA LENGTH 0x%x tx %d rx %d \n", Link_Handles[slot],
+                        LinkParams[slot].Max_Tx_Octets, LinkParams[slot].Max_Rx_Octets);
+#endif
+            Link_Changed(slot);
+          }
+          }
+          break; /* EVT_LE_DATA_LENGTH_CHANGE */
+
+        case EVT_LE_PHY_UPDATE_COMPLETE:
+          {
+          hci_le_phy_update_complete_event_rp0 *phy_update_complete_event;
+
+          phy_update_complete_event = (hci_le_phy_update_complete_event_rp0 *) meta_evt->data;
+          slot = Link_Slot(phy_update_complete_event->Connection_Handle);
+          /* a failed update leaves the link on the PHY it had */
+          if (phy_update_complete_event->Status == BLE_STATUS_SUCCESS && slot < CFG_BLE_NUM_LINK)
+          {
+            LinkParams[slot].Tx_Phy = phy_update_complete_event->TX_PHY;
+            LinkParams[slot].Rx_Phy = phy_update_complete_event->RX_PHY;
+          }
+#if(CFG_DEBUG_APP_TRACE != 0)
+          APP_DBG_MSG("\r\n\r** PHY UPDATE 0x%x status 0x%x tx %d rx %d \n",
+                      phy_update_complete_event->Connection_Handle, phy_update_complete_event->Status,
+                      phy_update_complete_event->TX_PHY, phy_update_complete_event->RX_PHY);
+#endif
+          }
+          break; /* EVT_LE_PHY_UPDATE_COMPLETE */
+
         default:
           /* USER CODE BEGIN SUBEVENT_DEFAULT */
 
@@ -608,6 +757,59 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification( void *pckt )
       switch (blue_evt->ecode)
       {
       /* USER CODE BEGIN ecode */
+        case EVT_BLUE_ATT_EXCHANGE_MTU_RESP:
+          {
+          aci_att_exchange_mtu_resp_event_rp0 *exchange_mtu_resp;
+
+          /* also sent when the central starts the exchange itself */
+          exchange_mtu_resp = (aci_att_exchange_mtu_resp_event_rp0 *) blue_evt->data;
+          slot = Link_Slot(exchange_mtu_resp->Connection_Handle);
+          if (slot < CFG_BLE_NUM_LINK)
+          {
+            LinkParams[slot].Att_Mtu = exchange_mtu_resp->Server_RX_MTU;
+            if (LinkParams[slot].Att_Mtu > CFG_BLE_MAX_ATT_MTU)
+            {
+              LinkParams[slot].Att_Mtu = CFG_BLE_MAX_ATT_MTU;
+            }
+#if(CFG_DEBUG_APP_TRACE != 0)
+            APP_DBG_MSG("\r\n\r** ATT MTU 0x%x %d \n", Link_Handles[slot], LinkParams[slot].Att_Mtu);
+#endif
+            Link_Changed(slot);
+          }
+          }
+          break; /* EVT_BLUE_ATT_EXCHANGE_MTU_RESP */
+
+        case EVT_BLUE_GATT_PROCEDURE_COMPLETE:
+          {
+          aci_gatt_proc_complete_event_rp0 *proc_complete;
+
+          proc_complete = (aci_gatt_proc_complete_event_rp0 *) blue_evt->data;
+          slot = Link_Slot(proc_complete->Connection_Handle);
+          if (slot < CFG_BLE_NUM_LINK && LinkParams[slot].Step == APP_BLE_LINK_MTU_WAIT)
+          {
+            LinkParams[slot].Mtu_Status = proc_complete->Error_Code;
+            LinkParams[slot].Step = APP_BLE_LINK_DATA_LENGTH;
+            SCH_SetTask(1 << CFG_TASK_LINK_SETUP_ID, CFG_SCH_PRIO_0);
+          }
+          }
+          break; /* EVT_BLUE_GATT_PROCEDURE_COMPLETE */
+
+        case EVT_BLUE_GATT_PROCEDURE_TIMEOUT:
+          {
+          aci_gatt_proc_timeout_event_rp0 *proc_timeout;
+
+          /* no answer to the exchange, carry on with the default MTU */
+          proc_timeout = (aci_gatt_proc_timeout_event_rp0 *) blue_evt->data;
+          slot = Link_Slot(proc_timeout->Connection_Handle);
+          if (slot < CFG_BLE_NUM_LINK && LinkParams[slot].Step == APP_BLE_LINK_MTU_WAIT)
+          {
+            LinkParams[slot].Mtu_Status = BLE_STATUS_TIMEOUT;
+            LinkParams[slot].Step = APP_BLE_LINK_DATA_LENGTH;
+            SCH_SetTask(1 << CFG_TASK_LINK_SETUP_ID, CFG_SCH_PRIO_0);
+          }
+          }
+          break; /* EVT_BLUE_GATT_PROCEDURE_TIMEOUT */
+
 
       /* USER CODE END ecode */
 /*
@@ -615,7 +817,22 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification( void *pckt )
 */
         case EVT_BLUE_L2CAP_CONNECTION_UPDATE_RESP:
 #if (L2CAP_REQUEST_NEW_CONN_PARAM != 0 )
-          mutex = 1;
+          {
+          aci_l2cap_connection_update_resp_event_rp0 *update_resp;
+
+          /* a refused profile is not asked for again until the target moves */
+          update_resp = (aci_l2cap_connection_update_resp_event_rp0 *) blue_evt->data;
+          slot = Link_Slot(update_resp->Connection_Handle);
+          if (slot < CFG_BLE_NUM_LINK)
+          {
+            Link_Profile[slot] = Link_Profile_Req[slot];
+          }
+          vConnGovAnswered();
+#if(CFG_DEBUG_APP_TRACE != 0)
+          APP_DBG_MSG("\r\n\r** L2CAP UPDATE RESP 0x%x result %d \n",
+                      update_resp->Connection_Handle, update_resp->Result);
+#endif
+          }
 #endif
       /* USER CODE BEGIN EVT_BLUE_L2CAP_CONNECTION_UPDATE_RESP */
 
@@ -662,6 +879,184 @@ APP_BLE_ConnStatus_t APP_BLE_Get_Server_Connection_Status(void)
 }
 
 /* USER CODE BEGIN FD*/
+/* NULL when the handle is not an open link */
+const APP_BLE_LinkParams_t *APP_BLE_Get_Link_Params(uint16_t Connection_Handle)
+{
+  uint8_t slot = Link_Slot(Connection_Handle);
+
+  return slot < CFG_BLE_NUM_LINK ? &LinkParams[slot] : NULL;
+}
+
+/**
+ * Largest value one notification can carry on every open link. A link is
+ * bounded by its ATT MTU and, once the data length is extended, by a single
+ * LL payload so a notification is never split. Without the extension the 27
+ * byte payloads fragment anyway and only the MTU counts. Values are fanned out
+ * unchanged, so the smallest link sets the size for all of them.
+ */
+uint16_t APP_BLE_Get_Notify_Payload_Max(void)
+{
+  uint16_t payload = CFG_BLE_MAX_ATT_MTU - 3;
+  uint8_t slot, open = 0;
+
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    if (Link_Handles[slot] != 0xFFFF)
+    {
+      open = 1;
+      if (Link_Payload[slot] < payload)
+      {
+        payload = Link_Payload[slot];
+      }
+    }
+  }
+  return open ? payload : APP_BLE_DEFAULT_ATT_MTU - 3;
+}
+
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+/**
+ * Level in use and the time spent at each step, for energy accounting
+ */
+void APP_BLE_Get_Tx_Power_Stats(TxPowerStats *pStats)
+{
+  vTxPowerGetStats(pStats, HAL_GetTick());
+
+  return;
+}
+#endif
+
+#if (CFG_BLE_TL_DIAG != 0)
+/**
+ * Writes the transport layer record described in app_ble.h. The suggested
+ * queue length holds twice the peak seen here, CPU2 fills buffers before it
+ * hands them over and those never show on this side. An event in a spare
+ * buffer means the pool ran dry, the length then grows by one at least.
+ */
+uint8_t APP_BLE_Tl_Stats_Encode(uint8_t *pValue)
+{
+  TL_MM_Stats_t mm;
+  HCI_TL_Stats_t hci;
+  uint32_t latency, length;
+  uint16_t spare, rearmed;
+
+  TL_MM_GetStats(&mm);
+  hci_get_stats(&hci);
+
+  length = DIVC(2 * (uint32_t)mm.BytesHeldMax, DIVC(sizeof(TL_PacketHeader_t) + TL_BLE_EVENT_FRAME_SIZE, 4U) * 4U);
+  if ((mm.SpareUsed != 0) && (length <= CFG_TLBLE_EVT_QUEUE_LENGTH))
+  {
+    length = CFG_TLBLE_EVT_QUEUE_LENGTH + 1;
+  }
+  if (length == 0)
+  {
+    length = 1;
+  }
+  latency = hci.LatencyMax / (SystemCoreClock / 1000000);
+  spare = (mm.SpareUsed > 0xFFFF) ? 0xFFFF : mm.SpareUsed;
+  rearmed = (hci.Rearmed > 0xFFFF) ? 0xFFFF : hci.Rearmed;
+
+  pValue[0] = APP_BLE_TL_STATS_VERSION;
+  pValue[1] = (mm.HeldMax > 0xFF) ? 0xFF : mm.HeldMax;
+  pValue[2] = (uint8_t)mm.BytesHeldMax;
+  pValue[3] = (uint8_t)(mm.BytesHeldMax >> 8);
+  pValue[4] = CFG_TLBLE_EVT_QUEUE_LENGTH;
+  pValue[5] = (length > 0xFF) ? 0xFF : length;
+  pValue[6] = hci.UserEvtQueuedMax;
+  pValue[7] = hci.CmdEvtQueuedMax;
+  pValue[8] = (uint8_t)mm.EvtReceived;
+  pValue[9] = (uint8_t)(mm.EvtReceived >> 8);
+  pValue[10] = (uint8_t)(mm.EvtReceived >> 16);
+  pValue[11] = (uint8_t)(mm.EvtReceived >> 24);
+  pValue[12] = (uint8_t)spare;
+  pValue[13] = (uint8_t)(spare >> 8);
+  pValue[14] = (uint8_t)rearmed;
+  pValue[15] = (uint8_t)(rearmed >> 8);
+  pValue[16] = (uint8_t)latency;
+  pValue[17] = (uint8_t)(latency >> 8);
+  pValue[18] = (uint8_t)(latency >> 16);
+  pValue[19] = (uint8_t)(latency >> 24);
+
+  return APP_BLE_TL_STATS_SIZE;
+}
+
+/**
+ * Starts a new measurement, the counters of the one ending go to the trace
+ */
+void APP_BLE_Tl_Stats_Reset(void)
+{
+#if(CFG_DEBUG_APP_TRACE != 0)
+  TL_MM_Stats_t mm;
+  HCI_TL_Stats_t hci;
+
+  TL_MM_GetStats(&mm);
+  hci_get_stats(&hci);
+  APP_DBG_MSG("TL pool: %lu events, held %d buffers %d bytes at most, %lu spare\n",
+              mm.EvtReceived, mm.HeldMax, mm.BytesHeldMax, mm.SpareUsed);
+  APP_DBG_MSG("HCI: %lu user events, queued %d user %d cmd at most, armed %lu rearmed %lu, latency %lu cycles max %lu untimed\n",
+              hci.UserEvtReceived, hci.UserEvtQueuedMax, hci.CmdEvtQueuedMax,
+              hci.Armed, hci.Rearmed, hci.LatencyMax, hci.LatencyUntimed);
+#endif
+  TL_MM_ResetStats();
+  hci_reset_stats();
+
+  return;
+}
+#endif
+
+#if (CFG_BLE_HR_BROADCAST != 0)
+/**
+ * Refreshes the heart rate record in the advertising data when it moved past
+ * its deadband, at most once per advertising interval. Nothing goes out while
+ * the device does not advertise.
+ */
+void APP_BLE_Broadcast_Update(uint8_t ucHR, uint8_t ucSPO2)
+{
+  uint16_t interval;
+  tBleStatus ret;
+
+  switch (BleApplicationContext.Device_Connection_Status)
+  {
+    case APP_BLE_FAST_ADV:
+      interval = AdvIntervalMax;
+      break;
+
+    case APP_BLE_LP_ADV:
+      interval = CFG_LP_CONN_ADV_INTERVAL_MAX;
+      break;
+
+    case APP_BLE_CONNECTED_SERVER:
+    case APP_BLE_CONNECTED_CLIENT:
+      /* Adv_Resume() keeps advertising while a slot is free */
+      if (Link_Slot(0xFFFF) == CFG_BLE_NUM_LINK)
+      {
+        return;
+      }
+      interval = CFG_LP_CONN_ADV_INTERVAL_MAX;
+      break;
+
+    default:
+      return;
+  }
+
+  /* 0.625 ms units */
+  if (ucHrBeaconSample(ucHR, ucSPO2, HAL_GetTick(), (interval * 5) / 8) == 0)
+  {
+    return;
+  }
+  vHrBeaconEncode(&manuf_data[MANUF_DATA_ST_SIZE]);
+  ret = aci_gap_update_adv_data(sizeof(manuf_data), (uint8_t*) manuf_data);
+#if(CFG_DEBUG_APP_TRACE != 0)
+  if (ret != BLE_STATUS_SUCCESS)
+  {
+    APP_DBG_MSG("APP_BLE_Broadcast_Update(), adv data update failed 0x%x \r\n\r", ret);
+  }
+#else
+  (void) ret;
+#endif
+
+  return;
+}
+#endif
 
 /* USER CODE END FD*/
 /*************************************************************
@@ -705,12 +1100,12 @@ static void Ble_Tl_Init( void )
                             (uint8_t*) bd_addr);
 
   /* BLE MAC in ADV Packet */
-  manuf_data[ sizeof(manuf_data)-6] = bd_addr[5];
-  manuf_data[ sizeof(manuf_data)-5] = bd_addr[4];
-  manuf_data[ sizeof(manuf_data)-4] = bd_addr[3];
-  manuf_data[ sizeof(manuf_data)-3] = bd_addr[2];
-  manuf_data[ sizeof(manuf_data)-2] = bd_addr[1];
-  manuf_data[ sizeof(manuf_data)-1] = bd_addr[0];
+  manuf_data[ MANUF_DATA_ST_SIZE-6] = bd_addr[5];
+  manuf_data[ MANUF_DATA_ST_SIZE-5] = bd_addr[4];
+  manuf_data[ MANUF_DATA_ST_SIZE-4] = bd_addr[3];
+  manuf_data[ MANUF_DATA_ST_SIZE-3] = bd_addr[2];
+  manuf_data[ MANUF_DATA_ST_SIZE-2] = bd_addr[1];
+  manuf_data[ MANUF_DATA_ST_SIZE-1] = bd_addr[0];
   
   /**
    * Static random Address
@@ -964,6 +1359,159 @@ const uint8_t* BleGetBdAddress( void )
 }
 
 /* USER CODE BEGIN FD_LOCAL_FUNCTION */
+static void Link_Reset( uint8_t slot )
+{
+  LinkParams[slot].Step = APP_BLE_LINK_IDLE;
+  LinkParams[slot].Att_Mtu = APP_BLE_DEFAULT_ATT_MTU;
+  LinkParams[slot].Max_Tx_Octets = APP_BLE_DEFAULT_TX_OCTETS;
+  LinkParams[slot].Max_Rx_Octets = APP_BLE_DEFAULT_TX_OCTETS;
+  LinkParams[slot].Tx_Phy = LINK_PHY_1M;
+  LinkParams[slot].Rx_Phy = LINK_PHY_1M;
+  LinkParams[slot].Mtu_Status = BLE_STATUS_SUCCESS;
+  LinkParams[slot].Data_Length_Status = BLE_STATUS_SUCCESS;
+  LinkParams[slot].Phy_Status = BLE_STATUS_SUCCESS;
+
+  return;
+}
+
+/**
+ * Post connection negotiation, runs as a task because the commands wait for
+ * their status. Every open link is taken one step further, a link waiting for
+ * its MTU exchange does not hold up the setup of the other one.
+ */
+static void Link_Setup( void )
+{
+  uint8_t slot;
+
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    if (Link_Handles[slot] != 0xFFFF)
+    {
+      Link_Setup_Step(slot);
+    }
+  }
+
+  return;
+}
+
+/**
+ * A step that is refused keeps the default for that parameter and moves on,
+ * the MTU step waits for the end of the ATT procedure so the data length and
+ * PHY commands do not go out on that link while it is pending.
+ */
+static void Link_Setup_Step( uint8_t slot )
+{
+  APP_BLE_LinkParams_t *link = &LinkParams[slot];
+  uint16_t handle = Link_Handles[slot];
+  tBleStatus result;
+
+  switch (link->Step)
+  {
+    case APP_BLE_LINK_MTU:
+      result = aci_gatt_exchange_config(handle);
+      if (result == BLE_STATUS_SUCCESS)
+      {
+        link->Step = APP_BLE_LINK_MTU_WAIT;
+        break;
+      }
+      link->Mtu_Status = result;
+#if(CFG_DEBUG_APP_TRACE != 0)
+      APP_DBG_MSG("Link_Setup(), 0x%x MTU exchange refused 0x%x \r\n\r", handle, result);
+#endif
+      /* fall through */
+    case APP_BLE_LINK_DATA_LENGTH:
+      result = hci_le_set_data_length(handle, APP_BLE_MAX_TX_OCTETS, APP_BLE_MAX_TX_TIME);
+      link->Data_Length_Status = result;
+#if(CFG_DEBUG_APP_TRACE != 0)
+      if (result != BLE_STATUS_SUCCESS)
+      {
+        APP_DBG_MSG("Link_Setup(), 0x%x data length refused 0x%x \r\n\r", handle, result);
+      }
+#endif
+      /* fall through */
+    case APP_BLE_LINK_PHY:
+      result = hci_le_set_phy(handle, 0, LINK_PHY_2M, LINK_PHY_2M, 0);
+      link->Phy_Status = result;
+#if(CFG_DEBUG_APP_TRACE != 0)
+      if (result != BLE_STATUS_SUCCESS)
+      {
+        APP_DBG_MSG("Link_Setup(), 0x%x 2M PHY refused 0x%x \r\n\r", handle, result);
+      }
+#endif
+      link->Step = APP_BLE_LINK_DONE;
+      break;
+
+    default:
+      break;
+  }
+
+  return;
+}
+
+/* the open link in slot takes the limit of its parameters */
+static void Link_Changed( uint8_t slot )
+{
+  uint16_t payload = LinkParams[slot].Att_Mtu - 3;
+
+  if (LinkParams[slot].Max_Tx_Octets > APP_BLE_DEFAULT_TX_OCTETS &&
+      LinkParams[slot].Max_Tx_Octets - APP_BLE_NOTIFY_OVERHEAD < payload)
+  {
+    payload = LinkParams[slot].Max_Tx_Octets - APP_BLE_NOTIFY_OVERHEAD;
+  }
+  Link_Payload[slot] = payload;
+  SMART_WATCH_APP_Link_Update(APP_BLE_Get_Notify_Payload_Max());
+
+  return;
+}
+
+/* returns CFG_BLE_NUM_LINK when the handle is not open, 0xFFFF finds a free slot */
+static uint8_t Link_Slot( uint16_t Connection_Handle )
+{
+  uint8_t slot;
+
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    if (Link_Handles[slot] == Connection_Handle)
+    {
+      break;
+    }
+  }
+  return slot;
+}
+
+/**
+ * Keeps a slot reachable while a central is connected, low power intervals and
+ * no timeout. Status and screen stay on the open link.
+ */
+static void Adv_Resume( void )
+{
+  tBleStatus ret;
+
+  ret = aci_gap_set_discoverable(
+      ADV_IND,
+      CFG_LP_CONN_ADV_INTERVAL_MIN,
+      CFG_LP_CONN_ADV_INTERVAL_MAX,
+      PUBLIC_ADDR,
+      NO_WHITE_LIST_USE,
+      sizeof(local_name),
+      (uint8_t*) &local_name,
+      BleApplicationContext.BleApplicationContext_legacy.advtServUUIDlen,
+      BleApplicationContext.BleApplicationContext_legacy.advtServUUID,
+      0,
+      0);
+  if (ret == BLE_STATUS_SUCCESS)
+  {
+    ret = aci_gap_update_adv_data(sizeof(manuf_data), (uint8_t*) manuf_data);
+  }
+#if(CFG_DEBUG_APP_TRACE != 0)
+  if (ret != BLE_STATUS_SUCCESS)
+  {
+    APP_DBG_MSG("Adv_Resume(), advertising for another central failed 0x%x \r\n\r", ret);
+  }
+#endif
+
+  return;
+}
 
 /* USER CODE END FD_LOCAL_FUNCTION */
 
@@ -1029,41 +1577,159 @@ static void Switch_OFF_GPIO(){
 }
 
 #if(L2CAP_REQUEST_NEW_CONN_PARAM != 0)  
+/**
+ * Asks the central of Connection_Handle for the parameters of the profile the
+ * governor has set for its slot
+ */
 void BLE_SVC_L2CAP_Conn_Update(uint16_t Connection_Handle)
 {
 /* USER CODE BEGIN BLE_SVC_L2CAP_Conn_Update_1 */
 
 /* USER CODE END BLE_SVC_L2CAP_Conn_Update_1 */
-  if(mutex == 1) { 
-    mutex = 0;
-    index_con_int = (index_con_int + 1)%SIZE_TAB_CONN_INT;
-    uint16_t interval_min = CONN_P(tab_conn_interval[index_con_int]);
-    uint16_t interval_max = CONN_P(tab_conn_interval[index_con_int]);
-    uint16_t slave_latency = L2CAP_SLAVE_LATENCY;
-    uint16_t timeout_multiplier = L2CAP_TIMEOUT_MULTIPLIER;
-    tBleStatus result;
-
-    result = aci_l2cap_connection_parameter_update_req(BleApplicationContext.BleApplicationContext_legacy.connectionHandle,
-                                                       interval_min, interval_max,
-                                                       slave_latency, timeout_multiplier);
-    if( result == BLE_STATUS_SUCCESS )
-    {
+  const ConnGovParams *params;
+  uint8_t slot;
+  tBleStatus result;
+
+  slot = Link_Slot(Connection_Handle);
+  if (slot == CFG_BLE_NUM_LINK)
+  {
+    return;
+  }
+  params = pConnGovParams(Link_Profile_Req[slot]);
+  result = aci_l2cap_connection_parameter_update_req(Connection_Handle,
+                                                     params->usIntervalMin, params->usIntervalMax,
+                                                     params->usLatency, params->usTimeout);
+  if( result == BLE_STATUS_SUCCESS )
+  {
+    vConnGovRequested(HAL_GetTick());
 #if(CFG_DEBUG_APP_TRACE != 0)
-      APP_DBG_MSG("BLE_SVC_L2CAP_Conn_Update(), Successfully \r\n\r");
+    APP_DBG_MSG("BLE_SVC_L2CAP_Conn_Update(), Successfully \r\n\r");
 #endif
-    }
-    else
-    {
+  }
+  else
+  {
+    /* not sent, the next tick asks again */
+    Link_Profile_Req[slot] = Link_Profile[slot];
 #if(CFG_DEBUG_APP_TRACE != 0)
-      APP_DBG_MSG("BLE_SVC_L2CAP_Conn_Update(), Failed \r\n\r");
+    APP_DBG_MSG("BLE_SVC_L2CAP_Conn_Update(), Failed \r\n\r");
 #endif
-    }
   }
 /* USER CODE BEGIN BLE_SVC_L2CAP_Conn_Update_2 */
 
 /* USER CODE END BLE_SVC_L2CAP_Conn_Update_2 */
   return;
 }
+
+/**
+ * Runs from Link_Tick(). Links catch up with the target one request at a
+ * time, each once its link setup is done.
+ */
+static void Conn_Governor( void )
+{
+  ConnGovInput demand;
+  uint32_t now;
+  uint8_t target, slot;
+
+  now = HAL_GetTick();
+  SMART_WATCH_APP_Get_Conn_Demand(&demand);
+  demand.usPayloadMax = APP_BLE_Get_Notify_Payload_Max();
+  target = ucConnGovEvaluate(&demand, now);
+
+  if (ucConnGovMayRequest(now) == 0)
+  {
+    return;
+  }
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    if (Link_Handles[slot] != 0xFFFF && LinkParams[slot].Step == APP_BLE_LINK_DONE &&
+        Link_Profile[slot] != target)
+    {
+      Link_Profile_Req[slot] = target;
+      BLE_SVC_L2CAP_Conn_Update(Link_Handles[slot]);
+      break;
+    }
+  }
+
+  return;
+}
+
+#endif
+
+/**
+ * Runs every LINK_TICK_PERIOD while a central is connected
+ */
+static void Link_Tick( void )
+{
+#if (L2CAP_REQUEST_NEW_CONN_PARAM != 0)
+  Conn_Governor();
+#endif
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+  Tx_Power_Control();
+#endif
+
+  return;
+}
+
+#if (CFG_BLE_TX_POWER_CONTROL != 0)
+/**
+ * The PA level is shared by all links, it follows the weakest one. A link
+ * whose RSSI cannot be read counts as a loss.
+ */
+static void Tx_Power_Control( void )
+{
+  uint8_t slot, rssi, lost = 0, open = 0;
+  int8_t weakest = 0;
+
+  for (slot = 0; slot < CFG_BLE_NUM_LINK; slot++)
+  {
+    if (Link_Handles[slot] == 0xFFFF)
+    {
+      continue;
+    }
+    if (hci_read_rssi(Link_Handles[slot], &rssi) != BLE_STATUS_SUCCESS ||
+        (int8_t) rssi == TX_POWER_RSSI_NONE)
+    {
+      lost = 1;
+    }
+    else if (open == 0 || (int8_t) rssi < weakest)
+    {
+      weakest = (int8_t) rssi;
+    }
+    open = 1;
+  }
+  if (open == 0)
+  {
+    return;
+  }
+  if (lost != 0)
+  {
+    Tx_Power_Apply(ucTxPowerLoss(HAL_GetTick()));
+  }
+  else
+  {
+    Tx_Power_Apply(ucTxPowerSample(weakest, HAL_GetTick()));
+  }
+
+  return;
+}
+
+static void Tx_Power_Apply( uint8_t Changed )
+{
+  tBleStatus ret;
+
+  if (Changed == 0)
+  {
+    return;
+  }
+  ret = aci_hal_set_tx_power_level(1, ucTxPowerLevel());
+#if(CFG_DEBUG_APP_TRACE != 0)
+  APP_DBG_MSG("Tx_Power_Apply(), PA level 0x%x status 0x%x \r\n\r", ucTxPowerLevel(), ret);
+#else
+  (void) ret;
+#endif
+
+  return;
+}
 #endif
 
 /* USER CODE BEGIN FD_SPECIFIC_FUNCTIONS */
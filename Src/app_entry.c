@@ -34,6 +34,7 @@
 /* Private includes -----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include <stdio.h>
+#include "sch_periodic.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,11 +47,14 @@ extern RTC_HandleTypeDef hrtc;
 #define POOL_SIZE (CFG_TLBLE_EVT_QUEUE_LENGTH*4U*DIVC(( sizeof(TL_PacketHeader_t) + TL_BLE_EVENT_FRAME_SIZE ), 4U))
 
 /* USER CODE BEGIN PD */
+/* Rounded up, a timer that expires short of the release would only re-arm */
+#define PERIODIC_TICKS(ms) (((ms)*1000 + CFG_TS_TICK_VAL - 1)/CFG_TS_TICK_VAL)
 
 /* USER CODE END PD */
 
 /* Private macros ------------------------------------------------------------*/
 /* USER CODE BEGIN PM */
+#define RTC_BCD2BIN(__VALUE__) ((((__VALUE__) >> 4) * 10) + ((__VALUE__) & 0x0F))
 
 /* USER CODE END PM */
 
@@ -61,6 +65,10 @@ PLACE_IN_SECTION("MB_MEM2") ALIGN(4) static uint8_t SystemSpareEvtBuffer[sizeof(
 PLACE_IN_SECTION("MB_MEM2") ALIGN(4) static uint8_t BleSpareEvtBuffer[sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + 255];
 
 /* USER CODE BEGIN PV */
+#if (CFG_LPM_SUPPORTED == 1)
+static uint32_t StopEntryMs;
+#endif
+static uint8_t PeriodicTimerId;
 
 /* USER CODE END PV */
 
@@ -79,6 +87,9 @@ extern void MX_USART1_UART_Init(void);
 #endif
 
 /* USER CODE BEGIN PFP */
+static void Periodic_Release( void );
+static void Periodic_Arm( void );
+static void Periodic_Timer( void );
 
 /* USER CODE END PFP */
 
@@ -90,6 +101,9 @@ void APPE_Init( void )
   HW_TS_Init(hw_ts_InitMode_Full, &hrtc); /**< Initialize the TimerServer */
 
 /* USER CODE BEGIN APPE_Init_1 */
+  vSchPeriodicInit();
+  SCH_RegTask(CFG_TASK_SCH_PERIODIC_ID, Periodic_Release);
+  HW_TS_Create(CFG_TIM_PROC_ID_ISR, &PeriodicTimerId, hw_ts_SingleShot, Periodic_Timer);
 
 #if (CFG_DEBUG_APP_TRACE != 0)
   /* Don't use standard buffer (for proper DBG traces output) */
@@ -115,7 +129,23 @@ void APPE_Init( void )
    return;
 }
 /* USER CODE BEGIN FD */
+/**
+ * Makes a scheduler task periodic, released every period_ms and due
+ * deadline_ms after each release. Disabled until APPE_Periodic_Enable()
+ */
+uint8_t APPE_Periodic_Register( uint8_t task_id, uint32_t period_ms, uint32_t deadline_ms )
+{
+  return ucSchPeriodicRegister(task_id, period_ms, deadline_ms);
+}
 
+/**
+ * The first release comes one period after enabling. Thread mode only
+ */
+void APPE_Periodic_Enable( uint8_t task_id, uint8_t enable )
+{
+  vSchPeriodicEnable(task_id, enable, HAL_GetTick());
+  Periodic_Arm();
+}
 
 
 /* USER CODE END FD */
@@ -252,6 +282,66 @@ static void APPE_SysUserEvtRx( void * pPayload )
 }
 
 /* USER CODE BEGIN FD_LOCAL_FUNCTIONS */
+/**
+ * One timer for all periodic tasks, set to the next release. A late run of
+ * this task is accounted by the releases, the phase of each task is kept
+ */
+static void Periodic_Release( void )
+{
+  uint32_t released = uiSchPeriodicRelease(HAL_GetTick());
+
+  if (released)
+  {
+    SCH_SetTask(released, CFG_SCH_PRIO_0);
+  }
+  Periodic_Arm();
+}
+
+static void Periodic_Arm( void )
+{
+  uint32_t next = uiSchPeriodicNext(HAL_GetTick());
+
+  if (next == SCH_PERIODIC_IDLE)
+  {
+    HW_TS_Stop(PeriodicTimerId);
+  }
+  else if (next == 0)
+  {
+    SCH_SetTask(1 << CFG_TASK_SCH_PERIODIC_ID, CFG_SCH_PRIO_0);
+  }
+  else
+  {
+    HW_TS_Start(PeriodicTimerId, PERIODIC_TICKS(next));
+  }
+}
+
+static void Periodic_Timer( void )
+{
+  SCH_SetTask(1 << CFG_TASK_SCH_PERIODIC_ID, CFG_SCH_PRIO_0);
+}
+
+#if (CFG_LPM_SUPPORTED == 1)
+/**
+ * Time of day from the RTC in ms. The timer server bypasses the shadow
+ * registers, TR and SSR are read again until they agree
+ */
+static uint32_t Rtc_Time_Ms( void )
+{
+  uint32_t tr, ssr, prediv_s, sec;
+
+  do
+  {
+    tr = RTC->TR;
+    ssr = RTC->SSR & RTC_SSR_SS;
+  } while ((tr != RTC->TR) || (ssr != (RTC->SSR & RTC_SSR_SS)));
+  prediv_s = RTC->PRER & RTC_PRER_PREDIV_S;
+
+  sec = RTC_BCD2BIN((tr >> 16) & 0x3F) * 3600
+      + RTC_BCD2BIN((tr >> 8) & 0x7F) * 60
+      + RTC_BCD2BIN(tr & 0x7F);
+  return sec * 1000 + ((prediv_s - ssr) * 1000) / (prediv_s + 1);
+}
+#endif
 
 /* USER CODE END FD_LOCAL_FUNCTIONS */
 
@@ -275,6 +365,12 @@ void LPM_EnterStopMode(void)
    * This function is called from CRITICAL SECTION
    */
 
+/* USER CODE BEGIN LPM_EnterStopMode */
+#if (CFG_LPM_SUPPORTED == 1)
+  StopEntryMs = Rtc_Time_Ms();
+#endif
+/* USER CODE END LPM_EnterStopMode */
+
   while( LL_HSEM_1StepLock( HSEM, CFG_HW_RCC_SEMID ) );
 
   if ( ! LL_HSEM_1StepLock( HSEM, CFG_HW_ENTRY_STOP_MODE_SEMID ) )
@@ -332,6 +428,13 @@ void LPM_ExitStopMode(void)
     LL_HSEM_ReleaseLock( HSEM, CFG_HW_RCC_SEMID, 0 );
   }
 
+/* USER CODE BEGIN LPM_ExitStopMode */
+#if (CFG_LPM_SUPPORTED == 1)
+  /* SysTick stood still in Stop2, HAL_GetTick() catches up on the RTC */
+  uwTick += (Rtc_Time_Ms() + 86400000UL - StopEntryMs) % 86400000UL;
+#endif
+/* USER CODE END LPM_ExitStopMode */
+
   return;
 }
 
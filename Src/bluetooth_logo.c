@@ -1,39 +1,15 @@
-/* USER CODE BEGIN */
-
-#include "bluetooth_logo.h"
-
-const long int bluetooth_logo[] = {
-  0x0003FF00, // ......##########........
-  0x000FFFC0, // ....##############......
-  0x001FFFE0, // ...################.....
-  0x003FFFF0, // ..##################....
-  0x003FFFF0, // ..##################....
-  0x007F9FF8, // .########..##########...
-  0x007F8FF8, // .########...#########...
-  0x00FF87FC, // #########....#########..
-  0x00FF93FC, // #########..#..########..
-  0x00FF99FC, // #########..##..#######..
-  0x00F39CFC, // ####..###..###..######..
-  0x00F99CFC, // #####..##..###..######..
-  0x00FC99FC, // ######..#..##..#######..
-  0x00FE13FC, // #######....#..########..
-  0x00FF07FC, // ########.....#########..
-  0x00FF8FFC, // #########...##########..
-  0x00FF8FFC, // #########...##########..
-  0x00FF07FC, // ########.....#########..
-  0x00FE13FC, // #######....#..########..
-  0x00FC99FC, // ######..#..##..#######..
-  0x00F99CFC, // #####..##..###..######..
-  0x00F39CFC, // ####..###..###..######..
-  0x00FF99FC, // #########..##..#######..
-  0x00FF93FC, // #########..#..########..
-  0x00FF87FC, // #########....#########..
-  0x007F8FF8, // .########...#########...
-  0x007F9FF8, // .########..##########...
-  0x003FFFF0, // ..##################....
-  0x003FFFF0, // ..##################....
-  0x001FFFE0, // ...################.....
-  0x000FFFC0, // ....##############......
-  0x0003FF00 // ......##########........
-};
-/* USER CODE END */
+/* USER CODE BEGIN */
+
+#include "bluetooth_logo.h"
+
+// Generated from tools/bitmaps/bluetooth_logo.c:
+//   tools/bitmap_rle.py words tools/bitmaps/bluetooth_logo.c 22 32 bluetooth_logo_rle --bits 24
+// 22x32, 88 page bytes packed to 80
+const uint8_t bluetooth_logo_rle[] = {
+  0x03, 0x80, 0xE0, 0xF8, 0xFC, 0x80, 0xFE, 0x81, 0xFF, 0x80, 0x1F, 0x01, 0x3F, 0x7F, 0x81, 0xFF,
+  0x80, 0xFE, 0x03, 0xFC, 0xF8, 0xE0, 0x80, 0x82, 0xFF, 0x04, 0xFB, 0xF3, 0xE7, 0xCF, 0x9F, 0x80,
+  0x00, 0x04, 0x3F, 0x9E, 0xCC, 0xE1, 0xF3, 0x88, 0xFF, 0x04, 0xDF, 0xCF, 0xE7, 0xF3, 0xF9, 0x80,
+  0x00, 0x04, 0xFC, 0x79, 0x33, 0x87, 0xCF, 0x84, 0xFF, 0x03, 0x01, 0x07, 0x1F, 0x3F, 0x80, 0x7F,
+  0x81, 0xFF, 0x80, 0xF8, 0x01, 0xFC, 0xFE, 0x81, 0xFF, 0x80, 0x7F, 0x03, 0x3F, 0x1F, 0x07, 0x01,
+};
+/* USER CODE END */
@@ -0,0 +1,94 @@
+/*
+ * conn_governor.c
+ *
+ * Connection parameter policy, see conn_governor.h. Fed from thread mode only.
+ * A supervision timeout always covers two full latency periods at the
+ * longest interval.
+ */
+
+#include "conn_governor.h"
+
+static const ConnGovParams aProfiles[CONN_GOV_PROFILES] = {
+	[CONN_GOV_IDLE] = { 400, 800, 2, 700 },     // 500 ms - 1 s, 7 s
+	[CONN_GOV_SUMMARY] = { 160, 200, 3, 400 },  // 200 - 250 ms, 4 s
+	[CONN_GOV_STREAM] = { 6, 12, 0, 200 },      // 7.5 - 15 ms, 2 s
+	[CONN_GOV_BURST] = { 6, 6, 0, 200 },        // 7.5 ms, 2 s
+};
+
+static uint8_t ucTarget = CONN_GOV_IDLE;
+static uint8_t ucSlower = 0;       // demand below ucTarget since uiSlowerSince
+static uint32_t uiSlowerSince = 0;
+static uint8_t ucOutstanding = 0;  // request sent, no L2CAP response yet
+static uint8_t ucRequestedOnce = 0;
+static uint32_t uiRequestedAt = 0;
+
+// local function prototypes
+static uint8_t ucConnGovWanted(const ConnGovInput *in);
+
+//local functions
+static uint8_t ucConnGovWanted(const ConnGovInput *in) {
+	uint8_t depth = ucTarget == CONN_GOV_BURST ?
+			CONN_GOV_DEPTH_LOW + 1 : CONN_GOV_DEPTH_HIGH;
+
+	switch (in->ucDemand) {
+	case CONN_GOV_DEMAND_WAVEFORM:
+		if (in->usPayloadMax < CONN_GOV_SHORT_PAYLOAD || in->ucDepth >= depth)
+			return CONN_GOV_BURST;
+		return CONN_GOV_STREAM;
+	case CONN_GOV_DEMAND_SUMMARY:
+		return CONN_GOV_SUMMARY;
+	default:
+		return CONN_GOV_IDLE;
+	}
+}
+
+// Global Function Definitions
+void vConnGovInit(void) {
+	ucTarget = CONN_GOV_IDLE;
+	ucSlower = 0;
+	uiSlowerSince = 0;
+	ucOutstanding = 0;
+	ucRequestedOnce = 0;
+	uiRequestedAt = 0;
+}
+
+// profile the links should run with at uiNow (ms)
+uint8_t ucConnGovEvaluate(const ConnGovInput *in, uint32_t uiNow) {
+	uint8_t wanted = ucConnGovWanted(in);
+
+	if (wanted >= ucTarget) {
+		ucTarget = wanted;
+		ucSlower = 0;
+	} else if (!ucSlower) {
+		ucSlower = 1;
+		uiSlowerSince = uiNow;
+	} else if (uiNow - uiSlowerSince >= CONN_GOV_HOLD_MS) {
+		ucTarget = wanted;
+		ucSlower = 0;
+	}
+	return ucTarget;
+}
+
+// returns 1 when a parameter update request may go out at uiNow
+uint8_t ucConnGovMayRequest(uint32_t uiNow) {
+	if (!ucRequestedOnce)
+		return 1;
+	if (ucOutstanding && uiNow - uiRequestedAt < CONN_GOV_RESPONSE_TIMEOUT_MS)
+		return 0;
+	return uiNow - uiRequestedAt >= CONN_GOV_REQUEST_GAP_MS;
+}
+
+void vConnGovRequested(uint32_t uiNow) {
+	ucOutstanding = 1;
+	ucRequestedOnce = 1;
+	uiRequestedAt = uiNow;
+}
+
+// EVT_BLUE_L2CAP_CONNECTION_UPDATE_RESP, accepted or not
+void vConnGovAnswered(void) {
+	ucOutstanding = 0;
+}
+
+const ConnGovParams *pConnGovParams(uint8_t ucProfile) {
+	return &aProfiles[ucProfile < CONN_GOV_PROFILES ? ucProfile : CONN_GOV_IDLE];
+}
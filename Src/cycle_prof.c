@@ -0,0 +1,76 @@
+/*
+ * cycle_prof.c
+ *
+ * Per entry cycle counts and log2 histograms, see cycle_prof.h. An entry is
+ * only written from its own context, the dump may catch one mid update.
+ */
+
+#include "cycle_prof.h"
+#include <stddef.h>
+
+static CycleProfEntry aEntries[CYCLE_PROF_ENTRIES];
+
+static const char *const apNames[CYCLE_PROF_ENTRIES - CYCLE_PROF_TASKS] = {
+	"IPCC RX", "IPCC TX", "RTC WKUP", "TIM16", "EXTI0", "EXTI2", "EXTI4",
+	"DMA1 CH1", "ADC1", "USART1",
+};
+
+// local function prototypes
+static uint8_t ucCycleProfBucket(uint32_t uiCycles);
+
+//local functions
+static uint8_t ucCycleProfBucket(uint32_t uiCycles) {
+	uint8_t log2;
+
+	if (uiCycles >> (CYCLE_PROF_HIST_SHIFT + 1) == 0)
+		return 0;
+	log2 = 31 - __builtin_clz(uiCycles);
+	if (log2 - CYCLE_PROF_HIST_SHIFT >= CYCLE_PROF_HIST_BUCKETS)
+		return CYCLE_PROF_HIST_BUCKETS - 1;
+	return log2 - CYCLE_PROF_HIST_SHIFT;
+}
+
+// Global Function Definitions
+void vCycleProfReset(void) {
+	uint8_t i, b;
+
+	for (i = 0; i < CYCLE_PROF_ENTRIES; i++) {
+		aEntries[i].uiCount = 0;
+		aEntries[i].ulTotal = 0;
+		aEntries[i].uiMax = 0;
+		for (b = 0; b < CYCLE_PROF_HIST_BUCKETS; b++)
+			aEntries[i].auiHist[b] = 0;
+	}
+}
+
+void vCycleProfRecord(uint8_t ucId, uint32_t uiCycles) {
+	CycleProfEntry *e;
+
+	if (ucId >= CYCLE_PROF_ENTRIES)
+		return;
+	e = &aEntries[ucId];
+	e->uiCount++;
+	e->ulTotal += uiCycles;
+	if (uiCycles > e->uiMax)
+		e->uiMax = uiCycles;
+	e->auiHist[ucCycleProfBucket(uiCycles)]++;
+}
+
+const CycleProfEntry *pCycleProfGet(uint8_t ucId) {
+	return ucId < CYCLE_PROF_ENTRIES ? &aEntries[ucId] : NULL;
+}
+
+const char *pCycleProfName(uint8_t ucId) {
+	if (ucId < CYCLE_PROF_TASKS || ucId >= CYCLE_PROF_ENTRIES)
+		return NULL;
+	return apNames[ucId - CYCLE_PROF_TASKS];
+}
+
+void vCycleProfDump(CycleProfPrint pfPrint) {
+	uint8_t i;
+
+	for (i = 0; i < CYCLE_PROF_ENTRIES; i++) {
+		if (aEntries[i].uiCount)
+			pfPrint(i, pCycleProfName(i), &aEntries[i]);
+	}
+}
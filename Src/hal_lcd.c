@@ -109,7 +109,7 @@ void LCD_PrintLabel(char * label)
 void LCD_THREAD_PrintRLOC(uint16_t rloc)
 {
   sprintf(tempLcdBuffer, "0x%04X", rloc);
-  SSD1306_DrawFilledRectangle(80,20,52,12,SSD1306_COLOR_BLACK);
+  SSD1306_DrawFilledRectangle(80,20,52,11,SSD1306_COLOR_BLACK);
   SSD1306_GotoXY(82,22);
   SSD1306_Puts(tempLcdBuffer, &Font_7x10, SSD1306_COLOR_WHITE);
   SSD1306_UpdateScreen();
@@ -126,8 +126,8 @@ void LCD_THREAD_PrintPanId(uint16_t panId)
 
 void LCD_THREAD_PrintRole(char * role)
 {
-  SSD1306_DrawFilledRectangle(0,20,80,12,SSD1306_COLOR_BLACK);
-  SSD1306_DrawFilledRectangle(0,20,5 + (strlen(role) * 7),12,SSD1306_COLOR_WHITE);
+  SSD1306_DrawFilledRectangle(0,20,80,11,SSD1306_COLOR_BLACK);
+  SSD1306_DrawFilledRectangle(0,20,5 + (strlen(role) * 7),11,SSD1306_COLOR_WHITE);
   SSD1306_GotoXY(3,22);
   SSD1306_Puts(role, &Font_7x10, SSD1306_COLOR_BLACK);
   SSD1306_UpdateScreen();
@@ -143,22 +143,14 @@ void LCD_BLE_PrintLocalName(const char * name)
 
 void LCD_BLE_PrintLogo(void)
 {
-  uint16_t x, y;
-
-  for (y = 0; y < BLUETOOTH_LOGO_HEIGHT; y++)
-  {
-    for (x = 0; x < (BLUETOOTH_LOGO_WIDTH); x++)
-    {
-      SSD1306_DrawPixel(22 - x, y, (SSD1306_COLOR_t)((bluetooth_logo[y] >> (x + 2)) & 0x00000001));
-    }
-  }
+  SSD1306_DrawRle(1, 0, BLUETOOTH_LOGO_WIDTH, BLUETOOTH_LOGO_PAGES, bluetooth_logo_rle);
   SSD1306_UpdateScreen();
 }
 
 void LCD_BLE_PrintStatus(char * status)
 {
-  SSD1306_DrawFilledRectangle(31,20,100,12,SSD1306_COLOR_BLACK);
-  SSD1306_DrawFilledRectangle(31,20,5 + (strlen(status) * 7),12,SSD1306_COLOR_WHITE);
+  SSD1306_DrawFilledRectangle(31,20,100,11,SSD1306_COLOR_BLACK);
+  SSD1306_DrawFilledRectangle(31,20,5 + (strlen(status) * 7),11,SSD1306_COLOR_WHITE);
   SSD1306_GotoXY(34,22);
   SSD1306_Puts(status, &Font_7x10, SSD1306_COLOR_BLACK);
   SSD1306_UpdateScreen();
@@ -166,8 +158,8 @@ void LCD_BLE_PrintStatus(char * status)
 
 void LCD_BLE_HRS_PrintBPM(uint8_t BPM)
 {
-  SSD1306_DrawFilledRectangle(0,20,80,12,SSD1306_COLOR_BLACK);
-  //SSD1306_DrawFilledRectangle(0,20,5 + (strlen(role) * 7),12,SSD1306_COLOR_WHITE);
+  SSD1306_DrawFilledRectangle(0,20,80,11,SSD1306_COLOR_BLACK);
+  //SSD1306_DrawFilledRectangle(0,20,5 + (strlen(role) * 7),11,SSD1306_COLOR_WHITE);
   SSD1306_GotoXY(3,22);
   //SSD1306_Puts(role, &Font_7x10, SSD1306_COLOR_BLACK);
   SSD1306_UpdateScreen();
@@ -176,7 +168,7 @@ void LCD_BLE_HRS_PrintBPM(uint8_t BPM)
 void LCD_BLE_HTS_PrintTemperature(uint8_t temperature)
 {
   //sprintf(tempLcdBuffer, "#%02d", errId);
-  SSD1306_DrawFilledRectangle(0,0,128,32,SSD1306_COLOR_WHITE);
+  SSD1306_DrawFilledRectangle(0,0,128,31,SSD1306_COLOR_WHITE);
   SSD1306_GotoXY(7,8);
   SSD1306_Puts("ERROR", &Font_11x18, SSD1306_COLOR_BLACK);
   SSD1306_GotoXY(66,9);
@@ -187,7 +179,7 @@ void LCD_BLE_HTS_PrintTemperature(uint8_t temperature)
 void LCD_BLE_TPS_PrintRSSI(uint8_t RSSI)
 {
   //sprintf(tempLcdBuffer, "#%02d", errId);
-  SSD1306_DrawFilledRectangle(0,0,128,32,SSD1306_COLOR_WHITE);
+  SSD1306_DrawFilledRectangle(0,0,128,31,SSD1306_COLOR_WHITE);
   SSD1306_GotoXY(7,8);
   SSD1306_Puts("ERROR", &Font_11x18, SSD1306_COLOR_BLACK);
   SSD1306_GotoXY(66,9);
@@ -0,0 +1,222 @@
+/*
+ * history.c
+ *
+ * Summary record ring and bulk sync cursor, see history.h. Fed from thread
+ * mode only.
+ */
+
+#include "history.h"
+
+typedef struct {
+	uint32_t uiTime;  // s since boot
+	uint8_t ucHR;
+	uint8_t ucSpO2;
+	uint8_t ucSqi;
+	int8_t cTemp;
+} HistoryRecord;
+
+static HistoryRecord aRecords[HISTORY_RECORDS];
+static uint32_t uiHead = 0;          // sequence of the next record
+
+// readings of the second being summed up
+static uint32_t uiWindowStart = 0;
+static uint8_t ucWindowOpen = 0;
+static uint16_t usReadings = 0;
+static uint16_t usSteady = 0;
+static uint8_t ucLastHR = 0;
+static uint8_t ucLastSpO2 = 0;
+static int8_t cLastTemp = HISTORY_TEMP_NONE;
+
+static uint8_t ucState = HISTORY_SYNC_IDLE;
+static uint32_t uiSend = 0;          // next sequence to hand out
+static uint32_t uiEnd = 0;           // end of the range, excluded
+static uint32_t uiAcked = 0;
+
+// local function prototypes
+static void vHistoryStore(uint32_t uiNow);
+static void vHistoryCatchUp(void);
+static uint32_t uiHistoryGet32(const uint8_t *p);
+static void vHistoryPut32(uint8_t *p, uint32_t v);
+
+//local functions
+static void vHistoryStore(uint32_t uiNow) {
+	HistoryRecord *r = &aRecords[uiHead % HISTORY_RECORDS];
+
+	r->uiTime = uiNow / 1000;
+	r->ucHR = ucLastHR;
+	r->ucSpO2 = ucLastSpO2;
+	r->ucSqi = usReadings ? (uint8_t) (usSteady * 100u / usReadings) : 0;
+	r->cTemp = cLastTemp;
+	uiHead++;
+}
+
+// records the ring overwrote are skipped, the central sees the gap in the sequences
+static void vHistoryCatchUp(void) {
+	uint32_t oldest = uiHistoryOldest();
+
+	if (uiAcked < oldest)
+		uiAcked = oldest;
+	if (uiSend < oldest)
+		uiSend = oldest;
+	if (uiEnd < uiSend)
+		uiEnd = uiSend;
+}
+
+static uint32_t uiHistoryGet32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void vHistoryPut32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+// Global Function Definitions
+void vHistoryInit(void) {
+	uiHead = 0;
+	ucWindowOpen = 0;
+	usReadings = 0;
+	usSteady = 0;
+	ucLastHR = 0;
+	ucLastSpO2 = 0;
+	cLastTemp = HISTORY_TEMP_NONE;
+	ucState = HISTORY_SYNC_IDLE;
+	uiSend = 0;
+	uiEnd = 0;
+	uiAcked = 0;
+}
+
+// every reading, a record is stored once HISTORY_PERIOD_MS has gone by
+void vHistorySample(uint8_t ucHR, uint8_t ucSpO2, int8_t cTemp, uint32_t uiNow) {
+	uint8_t diff;
+
+	if (!ucWindowOpen) {
+		ucWindowOpen = 1;
+		uiWindowStart = uiNow;
+	} else if (uiNow - uiWindowStart >= HISTORY_PERIOD_MS) {
+		vHistoryStore(uiNow);
+		usReadings = 0;
+		usSteady = 0;
+		uiWindowStart += HISTORY_PERIOD_MS;
+		// after a stall the next record counts from now
+		if (uiNow - uiWindowStart >= HISTORY_PERIOD_MS)
+			uiWindowStart = uiNow;
+	}
+
+	diff = ucHR > ucLastHR ? ucHR - ucLastHR : ucLastHR - ucHR;
+	if (usReadings < 0xFFFF) {
+		usReadings++;
+		if (ucHR != 0 && ucLastHR != 0 && diff <= HISTORY_SQI_BAND)
+			usSteady++;
+	}
+	ucLastHR = ucHR;
+	ucLastSpO2 = ucSpO2;
+	cLastTemp = cTemp;
+}
+
+uint32_t uiHistoryOldest(void) {
+	return uiHead > HISTORY_RECORDS ? uiHead - HISTORY_RECORDS : 0;
+}
+
+uint32_t uiHistoryNext(void) {
+	return uiHead;
+}
+
+// control point write, returns 1 when frames are due
+uint8_t ucHistoryControl(const uint8_t *pCmd, uint16_t usLength) {
+	uint32_t first, count, next;
+
+	if (usLength == 0)
+		return 0;
+	switch (pCmd[0]) {
+	case HISTORY_CP_START:
+		if (usLength < 9)
+			return 0;
+		first = uiHistoryGet32(&pCmd[1]);
+		count = uiHistoryGet32(&pCmd[5]);
+		if (first < uiHistoryOldest())
+			first = uiHistoryOldest();
+		if (first > uiHead)
+			first = uiHead;
+		uiEnd = (count == 0 || count > uiHead - first) ? uiHead : first + count;
+		uiSend = first;
+		uiAcked = first;
+		ucState = HISTORY_SYNC_SENDING;
+		return 1;
+	case HISTORY_CP_ACK:
+		if (usLength < 5 || ucState == HISTORY_SYNC_IDLE)
+			return 0;
+		next = uiHistoryGet32(&pCmd[1]);
+		if (next >= uiAcked && next <= uiSend)
+			uiAcked = next;
+		if (ucState == HISTORY_SYNC_DONE && uiAcked == uiEnd)
+			ucState = HISTORY_SYNC_IDLE;
+		return 0;
+	case HISTORY_CP_STOP:
+		ucState = HISTORY_SYNC_IDLE;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+// next frame of the range, 0 when there is nothing to send
+uint16_t usHistoryFrame(uint8_t *pFrame, uint16_t usMax) {
+	HistoryRecord *r;
+	uint32_t n, i;
+	uint8_t *p;
+
+	if (ucState != HISTORY_SYNC_SENDING || usMax < HISTORY_FRAME_HEADER)
+		return 0;
+	vHistoryCatchUp();
+	n = (usMax - HISTORY_FRAME_HEADER) / HISTORY_RECORD_SIZE;
+	if (n > uiEnd - uiSend)
+		n = uiEnd - uiSend;
+
+	vHistoryPut32(pFrame, uiSend);
+	p = pFrame + HISTORY_FRAME_HEADER;
+	for (i = 0; i < n; i++, p += HISTORY_RECORD_SIZE) {
+		r = &aRecords[(uiSend + i) % HISTORY_RECORDS];
+		vHistoryPut32(p, r->uiTime);
+		p[4] = r->ucHR;
+		p[5] = r->ucSpO2;
+		p[6] = r->ucSqi;
+		p[7] = (uint8_t) r->cTemp;
+	}
+	uiSend += n;
+	if (n == 0)
+		ucState = HISTORY_SYNC_DONE;
+	return HISTORY_FRAME_HEADER + n * HISTORY_RECORD_SIZE;
+}
+
+// the last listener left, whatever was not acknowledged goes again
+void vHistorySyncPause(void) {
+	if (ucState != HISTORY_SYNC_SENDING && ucState != HISTORY_SYNC_DONE)
+		return;
+	uiSend = uiAcked;
+	ucState = HISTORY_SYNC_PAUSED;
+}
+
+// returns 1 when a paused transfer goes on
+uint8_t ucHistorySyncResume(void) {
+	if (ucState != HISTORY_SYNC_PAUSED)
+		return 0;
+	ucState = HISTORY_SYNC_SENDING;
+	return 1;
+}
+
+uint8_t ucHistorySyncState(void) {
+	return ucState;
+}
+
+uint16_t usHistoryStatus(uint8_t *pStatus) {
+	if (ucState != HISTORY_SYNC_IDLE)
+		vHistoryCatchUp();
+	vHistoryPut32(&pStatus[0], uiHistoryOldest());
+	vHistoryPut32(&pStatus[4], uiHead);
+	vHistoryPut32(&pStatus[8], uiAcked);
+	pStatus[12] = ucState;
+	return HISTORY_STATUS_SIZE;
+}
@@ -0,0 +1,88 @@
+/*
+ * hr_beacon.c
+ *
+ * Record and update policy of the advertised heart rate, see hr_beacon.h.
+ * Fed from thread mode only.
+ */
+
+#include "hr_beacon.h"
+
+#define HR_BEACON_WINDOW 8
+
+static uint8_t ucHR = 0;
+static uint8_t ucSPO2 = 0;
+static uint8_t ucSteady = 0;   // last HR_BEACON_WINDOW readings, bit set when steady
+static uint8_t ucSeq = 0;
+static uint8_t ucSentHR = 0;   // values of the record on air
+static uint8_t ucSentSPO2 = 0;
+static uint8_t ucSentOnce = 0;
+static uint32_t uiSentAt = 0;
+
+// local function prototypes
+static uint8_t ucHrBeaconMoved(uint8_t cur, uint8_t sent, uint8_t deadband);
+static uint8_t ucHrBeaconConfidence(void);
+
+//local functions
+static uint8_t ucHrBeaconMoved(uint8_t cur, uint8_t sent, uint8_t deadband) {
+	if ((cur == 0) != (sent == 0))
+		return 1;
+	return (cur > sent ? cur - sent : sent - cur) > deadband;
+}
+
+static uint8_t ucHrBeaconConfidence(void) {
+	uint8_t bits = ucSteady, n = 0;
+
+	while (bits) {
+		bits &= bits - 1;
+		n++;
+	}
+	return n * 100 / HR_BEACON_WINDOW;
+}
+
+// Global Function Definitions
+void vHrBeaconInit(void) {
+	ucHR = 0;
+	ucSPO2 = 0;
+	ucSteady = 0;
+	ucSeq = 0;
+	ucSentHR = 0;
+	ucSentSPO2 = 0;
+	ucSentOnce = 0;
+	uiSentAt = 0;
+}
+
+/*
+ * Takes a reading at uiNow (ms), returns 1 when a new record is due, the
+ * caller then encodes and publishes it. uiInterval is the advertising interval
+ * in ms.
+ */
+uint8_t ucHrBeaconSample(uint8_t hr, uint8_t spo2, uint32_t uiNow,
+		uint32_t uiInterval) {
+	uint8_t steady;
+
+	steady = hr && spo2 && !ucHrBeaconMoved(hr, ucHR, HR_BEACON_HR_DEADBAND)
+			&& !ucHrBeaconMoved(spo2, ucSPO2, HR_BEACON_SPO2_DEADBAND);
+	ucSteady = (uint8_t) (ucSteady << 1) | steady;
+	ucHR = hr;
+	ucSPO2 = spo2;
+
+	if (ucSentOnce && uiNow - uiSentAt < uiInterval)
+		return 0;
+	if (ucSentOnce && !ucHrBeaconMoved(hr, ucSentHR, HR_BEACON_HR_DEADBAND)
+			&& !ucHrBeaconMoved(spo2, ucSentSPO2, HR_BEACON_SPO2_DEADBAND))
+		return 0;
+	ucSentHR = hr;
+	ucSentSPO2 = spo2;
+	ucSentOnce = 1;
+	uiSentAt = uiNow;
+	ucSeq++;
+	return 1;
+}
+
+// record of the last reading that was due
+void vHrBeaconEncode(uint8_t *pRecord) {
+	pRecord[0] = ucSentHR;
+	pRecord[1] = ucSentSPO2;
+	pRecord[2] = ucHrBeaconConfidence();
+	pRecord[3] = ucSeq;
+}
@@ -29,12 +29,6 @@ typedef enum
   TimerID_Running
 }TimerIDStatus_t;
 
-typedef enum
-{
-  SSR_Read_Requested,
-  SSR_Read_Not_Requested
-}RequestReadSSR_t;
-
 typedef enum
 {
   WakeupTimerValue_Overpassed,
@@ -45,19 +39,51 @@ typedef struct
 {
   HW_TS_pTimerCb_t  pTimerCallBack;
   uint32_t        CounterInit;
-  uint32_t        CountLeft;
+  uint64_t        Expiry;
   TimerIDStatus_t     TimerIDStatus;
   HW_TS_Mode_t   TimerMode;
   uint32_t        TimerProcessID;
   uint8_t         PreviousID;
   uint8_t         NextID;
+  uint8_t         ListID;
 }TimerContext_t;
 
 /* Private defines -----------------------------------------------------------*/
 #define SSR_FORBIDDEN_VALUE   0xFFFFFFFF
 #define TIMER_LIST_EMPTY      0xFFFF
 
+/**
+ * The running timers are kept in a hierarchical timer wheel on an absolute 64 bits time base counted in
+ * wakeup timer ticks. Level L has TIMER_WHEEL_SLOTS slots of 2^(L*TIMER_WHEEL_BITS) ticks each. A timer is
+ * linked on the level of the highest digit where its expiry differs from WheelTime, in the slot of that
+ * digit. When the wheel time reaches the start of a slot, its timers move to a lower level, or to the due
+ * list when they expire on that tick. Each timer moves at most TIMER_WHEEL_LEVELS times, start, stop and
+ * expiry do not depend on the number of timers.
+ * The wakeup timer counts to the first expiry rather than to the start of a slot, so the timers move down the
+ * wheel when it wakes up for an expiry. A timer expiring before the head of its slot becomes the head, so the
+ * head expires first until it is stopped while other timers stay in the slot. Only the start of such a slot
+ * is known and the wakeup timer counts to it when it is the first, its timers then move down and the count
+ * is exact again. Nothing is searched, every critical section is the same length whatever the number of
+ * timers.
+ * Seven levels of five bits cover the 0xFFFF0000 ticks allowed by HW_TS_Start() plus the elapsed time
+ */
+#define TIMER_WHEEL_BITS      5
+#define TIMER_WHEEL_SLOTS     (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS    7
+#define TIMER_LIST_DUE        (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+#define TIMER_LIST_NBR        (TIMER_LIST_DUE + 1)
+#define TIMER_ID_NONE         CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER
+#define WHEEL_TIME_NONE       0xFFFFFFFFFFFFFFFFULL
+
 /* Private macros ------------------------------------------------------------*/
+#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
+#define TIMER_ENTER_CRITICAL_SECTION( )   primask_bit = __get_PRIMASK(); __disable_irq()
+#define TIMER_EXIT_CRITICAL_SECTION( )    __set_PRIMASK(primask_bit)
+#else
+#define TIMER_ENTER_CRITICAL_SECTION( )
+#define TIMER_EXIT_CRITICAL_SECTION( )
+#endif
+
 /* Private variables ---------------------------------------------------------*/
 
 /**
@@ -65,8 +91,13 @@ typedef struct
  */
 
 PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile TimerContext_t aTimerContext[CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER];
-PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint8_t CurrentRunningTimerID;
-PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint8_t PreviousRunningTimerID;
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint8_t aListHead[TIMER_LIST_NBR];
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint32_t aLevelMap[TIMER_WHEEL_LEVELS];   /**< One bit per non empty slot */
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint32_t aLevelHeadFirst[TIMER_WHEEL_LEVELS];   /**< One bit per slot whose head expires first */
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint64_t WheelTime;     /**< Every timer on the wheel expires after it */
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint64_t SetupTime;     /**< Time at SSRValueOnLastSetup */
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint64_t WakeupTarget;  /**< Event the wakeup timer counts to */
+PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint8_t InWakeupHandler;
 PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile uint32_t SSRValueOnLastSetup;
 PLACE_IN_SECTION("TIMERSERVER_CONTEXT") static volatile WakeupTimerLimitation_Status_t  WakeupTimerLimitation;
 
@@ -84,11 +115,14 @@ static volatile uint16_t MaxWakeupTimerSetup;
 /* Private function prototypes -----------------------------------------------*/
 static void RestartWakeupCounter(uint16_t Value);
 static uint16_t ReturnTimeElapsed(void);
-static void RescheduleTimerList(void);
-static void UnlinkTimer(uint8_t TimerID, RequestReadSSR_t RequestReadSSR);
-static void LinkTimerBefore(uint8_t TimerID, uint8_t RefTimerID);
-static void LinkTimerAfter(uint8_t TimerID, uint8_t RefTimerID);
-static uint16_t linkTimer(uint8_t TimerID);
+static uint64_t ReturnWheelTime(void);
+static uint8_t WheelListID(uint64_t Expiry);
+static uint64_t NextWheelEvent(uint8_t *pListID);
+static uint64_t NextExpiry(void);
+static void LinkTimer(uint8_t TimerID, uint8_t ListID);
+static void UnlinkTimer(uint8_t TimerID);
+static void RescheduleWakeupTimer(uint64_t Event);
+static void StopWakeupTimer(void);
 static uint32_t ReadRtcSsrValue(void);
 
 __weak void HW_TS_RTC_CountUpdated_AppNot(void);
@@ -121,162 +155,226 @@ static uint32_t ReadRtcSsrValue(void)
   return second_read;
 }
 
+
 /**
- * @brief  Insert a Timer in the list after the Timer ID specified
- * @param  TimerID:   The ID of the Timer
- * @param  RefTimerID: The ID of the Timer to be linked after
- * @retval None
+ * @brief  Return the list a timer shall be linked in
+ * @param  Expiry: Time the timer expires
+ * @retval Slot of the wheel or TIMER_LIST_DUE
  */
-static void LinkTimerAfter(uint8_t TimerID, uint8_t RefTimerID)
+static uint8_t WheelListID(uint64_t Expiry)
 {
-  uint8_t next_id;
+  uint64_t diff;
+  uint32_t high_word;
+  uint8_t msb;
+  uint8_t level;
 
-  next_id = aTimerContext[RefTimerID].NextID;
+  if(Expiry <= WheelTime)
+  {
+    return TIMER_LIST_DUE;
+  }
 
-  if(next_id != CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER)
+  /**
+   * The level is the one of the highest digit that differs from the wheel time
+   */
+  diff = Expiry ^ WheelTime;
+  high_word = (uint32_t)(diff >> 32);
+  if(high_word != 0)
+  {
+    msb = 63 - __CLZ(high_word);
+  }
+  else
   {
-    aTimerContext[next_id].PreviousID = TimerID;
+    msb = 31 - __CLZ((uint32_t)diff);
   }
-  aTimerContext[TimerID].NextID = next_id;
-  aTimerContext[TimerID].PreviousID = RefTimerID ;
-  aTimerContext[RefTimerID].NextID = TimerID;
+  level = msb / TIMER_WHEEL_BITS;
 
-  return;
+  return (level * TIMER_WHEEL_SLOTS) + ((uint32_t)(Expiry >> (level * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SLOTS - 1));
 }
 
 /**
- * @brief  Insert a Timer in the list before the ID specified
- * @param  TimerID:   The ID of the Timer
- * @param  RefTimerID: The ID of the Timer to be linked before
- * @retval None
+ * @brief  Return the next time the wheel shall be processed
+ * @note  On a level, every slot set is at or after the digit of the wheel time so the first one is the earliest.
+ *    A slot at the digit of the wheel time is being moved down and comes before the due list
+ * @param  pListID: List to process at that time
+ * @retval Time of the next event, WHEEL_TIME_NONE when no timer is running
  */
-static void LinkTimerBefore(uint8_t TimerID, uint8_t RefTimerID)
+static uint64_t NextWheelEvent(uint8_t *pListID)
 {
-  uint8_t previous_id;
+  uint64_t event;
+  uint64_t candidate;
+  uint32_t slot;
+  uint8_t level;
+  uint8_t shift;
 
-  if(RefTimerID != CurrentRunningTimerID)
+  event = WHEEL_TIME_NONE;
+  *pListID = TIMER_LIST_DUE;
+
+  for(level = 0; level < TIMER_WHEEL_LEVELS; level++)
   {
-    previous_id = aTimerContext[RefTimerID].PreviousID;
+    if(aLevelMap[level] != 0)
+    {
+      shift = level * TIMER_WHEEL_BITS;
+      slot = __CLZ(__RBIT(aLevelMap[level]));
+      candidate = ((WheelTime >> (shift + TIMER_WHEEL_BITS)) << (shift + TIMER_WHEEL_BITS)) | ((uint64_t)slot << shift);
 
-    aTimerContext[previous_id].NextID = TimerID;
-    aTimerContext[TimerID].NextID = RefTimerID;
-    aTimerContext[TimerID].PreviousID = previous_id ;
-    aTimerContext[RefTimerID].PreviousID = TimerID;
+      if(candidate < event)
+      {
+        event = candidate;
+        *pListID = (level * TIMER_WHEEL_SLOTS) + slot;
+      }
+    }
   }
-  else
+
+  if((aListHead[TIMER_LIST_DUE] != TIMER_ID_NONE) && (event > WheelTime))
   {
-    aTimerContext[TimerID].NextID = RefTimerID;
-    aTimerContext[RefTimerID].PreviousID = TimerID;
+    event = WheelTime;
+    *pListID = TIMER_LIST_DUE;
   }
 
-  return;
+  return event;
 }
 
 /**
- * @brief  Insert a Timer in the list
+ * @brief  Return the time the wakeup timer shall count to
+ * @note  Per level, the expiry of the head of the first slot set when it expires first, the start of that
+ *    slot otherwise. That is the first expiry unless the head of that slot has been stopped
+ * @param  None
+ * @retval No running timer expires before, WHEEL_TIME_NONE when no timer is running
+ */
+static uint64_t NextExpiry(void)
+{
+  uint64_t expiry;
+  uint64_t candidate;
+  uint32_t slot;
+  uint8_t level;
+  uint8_t shift;
+
+  if(aListHead[TIMER_LIST_DUE] != TIMER_ID_NONE)
+  {
+    return WheelTime;
+  }
+
+  expiry = WHEEL_TIME_NONE;
+
+  for(level = 0; level < TIMER_WHEEL_LEVELS; level++)
+  {
+    if(aLevelMap[level] != 0)
+    {
+      shift = level * TIMER_WHEEL_BITS;
+      slot = __CLZ(__RBIT(aLevelMap[level]));
+      candidate = ((WheelTime >> (shift + TIMER_WHEEL_BITS)) << (shift + TIMER_WHEEL_BITS)) | ((uint64_t)slot << shift);
+
+      if((aLevelHeadFirst[level] & (1UL << slot)) != 0)
+      {
+        candidate = aTimerContext[aListHead[(level * TIMER_WHEEL_SLOTS) + slot]].Expiry;
+      }
+
+      if(candidate < expiry)
+      {
+        expiry = candidate;
+      }
+    }
+  }
+
+  return expiry;
+}
+
+/**
+ * @brief  Link a Timer at the end of a list
+ * @note  The lists are circular, the previous of the head is the last timer
  * @param  TimerID:   The ID of the Timer
+ * @param  ListID:    Slot of the wheel or TIMER_LIST_DUE
  * @retval None
  */
-static uint16_t linkTimer(uint8_t TimerID)
+static void LinkTimer(uint8_t TimerID, uint8_t ListID)
 {
-  uint32_t time_left;
-  uint16_t time_elapsed;
-  uint8_t timer_id_lookup;
-  uint8_t next_id;
+  uint8_t head_id;
+  uint8_t last_id;
+  uint8_t level;
+  uint32_t slot_bit;
+
+  head_id = aListHead[ListID];
+  level = ListID / TIMER_WHEEL_SLOTS;
+  slot_bit = 1UL << (ListID % TIMER_WHEEL_SLOTS);
 
-  if(CurrentRunningTimerID == CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER)
+  if(head_id == TIMER_ID_NONE)
   {
-    /**
-     * No timer in the list
-     */
-    PreviousRunningTimerID = CurrentRunningTimerID;
-    CurrentRunningTimerID = TimerID;
-    aTimerContext[TimerID].NextID = CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER;
+    aListHead[ListID] = TimerID;
+    aTimerContext[TimerID].NextID = TimerID;
+    aTimerContext[TimerID].PreviousID = TimerID;
 
-    SSRValueOnLastSetup = SSR_FORBIDDEN_VALUE;
-    time_elapsed = 0;
+    if(ListID != TIMER_LIST_DUE)
+    {
+      aLevelMap[level] |= slot_bit;
+      aLevelHeadFirst[level] |= slot_bit;
+    }
   }
   else
   {
-    time_elapsed = ReturnTimeElapsed();
+    last_id = aTimerContext[head_id].PreviousID;
 
-    /**
-     * update count of the timer to be linked
-     */
-    aTimerContext[TimerID].CountLeft += time_elapsed;
-    time_left = aTimerContext[TimerID].CountLeft;
+    aTimerContext[last_id].NextID = TimerID;
+    aTimerContext[TimerID].PreviousID = last_id;
+    aTimerContext[TimerID].NextID = head_id;
+    aTimerContext[head_id].PreviousID = TimerID;
 
     /**
-     * Search for index where the new timer shall be linked
+     * Between the last timer and the head, the timer becomes the head when it expires before it
      */
-    if(aTimerContext[CurrentRunningTimerID].CountLeft <= time_left)
-    {
-      /**
-       * Search for the ID after the first one
-       */
-      timer_id_lookup = CurrentRunningTimerID;
-      next_id = aTimerContext[timer_id_lookup].NextID;
-      while((next_id != CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER) && (aTimerContext[next_id].CountLeft <= time_left))
-      {
-        timer_id_lookup = aTimerContext[timer_id_lookup].NextID;
-        next_id = aTimerContext[timer_id_lookup].NextID;
-      }
-
-      /**
-       * Link after the ID
-       */
-      LinkTimerAfter(TimerID, timer_id_lookup);
-    }
-    else
+    if((ListID != TIMER_LIST_DUE) && ((aLevelHeadFirst[level] & slot_bit) != 0) &&
+       (aTimerContext[TimerID].Expiry < aTimerContext[head_id].Expiry))
     {
-      /**
-       * Link before the first ID
-       */
-      LinkTimerBefore(TimerID, CurrentRunningTimerID);
-      PreviousRunningTimerID = CurrentRunningTimerID;
-      CurrentRunningTimerID = TimerID;
+      aListHead[ListID] = TimerID;
     }
   }
 
-  return time_elapsed;
+  aTimerContext[TimerID].ListID = ListID;
+
+  return;
 }
 
 /**
- * @brief  Remove a Timer from the list
+ * @brief  Remove a Timer from its list
  * @param  TimerID:   The ID of the Timer
- * @param  RequestReadSSR: Request to read the SSR register or not
  * @retval None
  */
-static void UnlinkTimer(uint8_t TimerID, RequestReadSSR_t RequestReadSSR)
+static void UnlinkTimer(uint8_t TimerID)
 {
+  uint8_t list_id;
   uint8_t previous_id;
   uint8_t next_id;
 
-  if(TimerID == CurrentRunningTimerID)
+  list_id = aTimerContext[TimerID].ListID;
+  next_id = aTimerContext[TimerID].NextID;
+
+  if(next_id == TimerID)
   {
-    PreviousRunningTimerID = CurrentRunningTimerID;
-    CurrentRunningTimerID = aTimerContext[TimerID].NextID;
+    aListHead[list_id] = TIMER_ID_NONE;
+
+    if(list_id != TIMER_LIST_DUE)
+    {
+      aLevelMap[list_id / TIMER_WHEEL_SLOTS] &= ~(1UL << (list_id % TIMER_WHEEL_SLOTS));
+    }
   }
   else
   {
     previous_id = aTimerContext[TimerID].PreviousID;
-    next_id = aTimerContext[TimerID].NextID;
 
-    aTimerContext[previous_id].NextID = aTimerContext[TimerID].NextID;
-    if(next_id != CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER)
-    {
-      aTimerContext[next_id].PreviousID = aTimerContext[TimerID].PreviousID;
-    }
-  }
+    aTimerContext[previous_id].NextID = next_id;
+    aTimerContext[next_id].PreviousID = previous_id;
 
-  /**
-   * Timer is out of the list
-   */
-  aTimerContext[TimerID].TimerIDStatus = TimerID_Created;
+    if(aListHead[list_id] == TimerID)
+    {
+      aListHead[list_id] = next_id;
 
-  if((CurrentRunningTimerID == CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER) && (RequestReadSSR == SSR_Read_Requested))
-  {
-    SSRValueOnLastSetup = SSR_FORBIDDEN_VALUE;
+      /**
+       * The next timer is not known to expire first
+       */
+      if(list_id != TIMER_LIST_DUE)
+      {
+        aLevelHeadFirst[list_id / TIMER_WHEEL_SLOTS] &= ~(1UL << (list_id % TIMER_WHEEL_SLOTS));
+      }
+    }
   }
 
   return;
@@ -323,6 +421,27 @@ static uint16_t ReturnTimeElapsed(void)
   return (uint16_t)return_value;
 }
 
+/**
+ * @brief  Return the current time on the wheel time base
+ * @note  The time stands still while no timer is running. It never goes back behind the wheel time, which
+ *    may be one tick ahead of the SSR reading once an expiry has been handled
+ * @param  None
+ * @retval Current time in Ticks
+ */
+static uint64_t ReturnWheelTime(void)
+{
+  uint64_t now;
+
+  now = SetupTime + ReturnTimeElapsed();
+
+  if(now < WheelTime)
+  {
+    now = WheelTime;
+  }
+
+  return now;
+}
+
 /**
  * @brief  Set the wakeup counter
  * @note  The API is writing the counter value so that the value is decreased by one to cope with the fact
@@ -384,18 +503,15 @@ static void RestartWakeupCounter(uint16_t Value)
 }
 
 /**
- * @brief  Reschedule the list of timer
- * @note  1) Update the count left for each timer in the list
- *    2) Setup the wakeuptimer
- * @param  None
+ * @brief  Setup the wakeuptimer to an event
+ * @note  The wheel shall not be empty and no timer shall expire before the event
+ * @param  Event: Time to count to
  * @retval None
  */
-static void RescheduleTimerList(void)
+static void RescheduleWakeupTimer(uint64_t Event)
 {
-  uint8_t   localTimerID;
-  uint32_t  timecountleft;
-  uint16_t  wakeup_timer_value;
-  uint16_t  time_elapsed;
+  uint64_t now;
+  uint16_t wakeup_timer_value;
 
   /**
    * The wakeuptimer is disabled now to reduce the time to poll the WUTWF
@@ -410,19 +526,9 @@ static void RescheduleTimerList(void)
   }
   __HAL_RTC_WAKEUPTIMER_DISABLE(phrtc);   /**<  Disable the Wakeup Timer */
 
-  localTimerID = CurrentRunningTimerID;
-
-  /**
-   * Calculate what will be the value to write in the wakeuptimer
-   */
-  timecountleft = aTimerContext[localTimerID].CountLeft;
-
-  /**
-   * Read how much has been counted
-   */
-  time_elapsed = ReturnTimeElapsed();
+  now = ReturnWheelTime();
 
-  if(timecountleft < time_elapsed )
+  if(Event <= now)
   {
     /**
      * There is no tick left to count
@@ -430,45 +536,66 @@ static void RescheduleTimerList(void)
     wakeup_timer_value = 0;
     WakeupTimerLimitation = WakeupTimerValue_LargeEnough;
   }
+  else if((Event - now) > MaxWakeupTimerSetup)
+  {
+    /**
+     * The number of tick left is greater than the Wakeuptimer maximum value
+     */
+    wakeup_timer_value = MaxWakeupTimerSetup;
+    WakeupTimerLimitation = WakeupTimerValue_Overpassed;
+  }
   else
   {
-    if(timecountleft > (time_elapsed + MaxWakeupTimerSetup))
-    {
-      /**
-       * The number of tick left is greater than the Wakeuptimer maximum value
-       */
-      wakeup_timer_value = MaxWakeupTimerSetup;
+    wakeup_timer_value = (uint16_t)(Event - now);
+    WakeupTimerLimitation = WakeupTimerValue_LargeEnough;
+  }
 
-      WakeupTimerLimitation = WakeupTimerValue_Overpassed;
-    }
-    else
-    {
-      wakeup_timer_value = timecountleft - time_elapsed;
-      WakeupTimerLimitation = WakeupTimerValue_LargeEnough;
-    }
+  SetupTime = now;
+  WakeupTarget = Event;
 
-  }
+  /**
+   * Write next count
+   */
+  RestartWakeupCounter(wakeup_timer_value);
+
+  return ;
+}
+
+/**
+ * @brief  Stop the wakeuptimer when the wheel is empty
+ * @param  None
+ * @retval None
+ */
+static void StopWakeupTimer(void)
+{
+  SetupTime = ReturnWheelTime();
+  SSRValueOnLastSetup = SSR_FORBIDDEN_VALUE;
+  WakeupTarget = WHEEL_TIME_NONE;
 
   /**
-   * update ticks left to be counted for each timer
+   * Disable the timer
    */
-  while(localTimerID != CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER)
+  if((READ_BIT(RTC->CR, RTC_CR_WUTE) == (RTC_CR_WUTE)) == SET)
   {
-    if (aTimerContext[localTimerID].CountLeft < time_elapsed)
-    {
-      aTimerContext[localTimerID].CountLeft = 0;
-    }
-    else
-    {
-      aTimerContext[localTimerID].CountLeft -= time_elapsed;
-    }
-    localTimerID = aTimerContext[localTimerID].NextID;
+    /**
+     * Wait for the flag to be back to 0 when the wakeup timer is enabled
+     */
+    while(__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTWF) == SET);
   }
+  __HAL_RTC_WAKEUPTIMER_DISABLE(phrtc);   /**<  Disable the Wakeup Timer */
+
+  while(__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTWF) == RESET);
 
   /**
-   * Write next count
+   * make sure to clear the flags after checking the WUTWF.
+   * It takes 2 RTCCLK between the time the WUTE bit is disabled and the
+   * time the timer is disabled. The WUTWF bit somehow guarantee the system is stable
+   * Otherwise, when the timer is periodic with 1 Tick, it may generate an extra interrupt in between
+   * due to the autoreload feature
    */
-  RestartWakeupCounter(wakeup_timer_value);
+  __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(phrtc, RTC_FLAG_WUTF);   /**<  Clear flag in RTC module */
+  __HAL_RTC_WAKEUPTIMER_EXTI_CLEAR_FLAG(); /**<  Clear flag in EXTI module */
+  HAL_NVIC_ClearPendingIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID);   /**<  Clear pending bit in NVIC */
 
   return ;
 }
@@ -482,19 +609,26 @@ static void RescheduleTimerList(void)
  * in case some new implementation is coming in the future
  */
 
+/**
+ * Every event up to the current time is handled in one call. The timers of a slot reached by the wheel time are
+ * moved one per critical section, the expired ones are notified in the order they expire, outside the critical
+ * section. Timers started or stopped meanwhile, from the callbacks as well, are taken into account and the
+ * wakeuptimer is written once at the end
+ */
 void HW_TS_RTC_Wakeup_Handler(void)
 {
   HW_TS_pTimerCb_t ptimer_callback;
   uint32_t timer_process_id;
-  uint8_t local_current_running_timer_id;
+  uint64_t now;
+  uint64_t event;
+  uint8_t list_id;
+  uint8_t timer_id;
+  uint8_t expired;
 #if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
   uint32_t primask_bit;
 #endif
 
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-  primask_bit = __get_PRIMASK();  /**< backup PRIMASK bit */
-  __disable_irq();          /**< Disable all interrupts by setting PRIMASK bit on Cortex*/
-#endif
+  TIMER_ENTER_CRITICAL_SECTION();
 
 /* Disable the write protection for RTC registers */
   __HAL_RTC_WRITEPROTECTION_DISABLE( phrtc );
@@ -506,81 +640,99 @@ void HW_TS_RTC_Wakeup_Handler(void)
    */
   __HAL_RTC_WAKEUPTIMER_DISABLE(phrtc);
 
-  local_current_running_timer_id = CurrentRunningTimerID;
+  InWakeupHandler = 1;
+
+  now = ReturnWheelTime();
 
-  if(aTimerContext[local_current_running_timer_id].TimerIDStatus == TimerID_Running)
+  /**
+   * Due to the inaccuracy of the reading of the time elapsed, it may return there is 1 tick
+   * to be left whereas the count is over. When the full count has been written in the
+   * wakeuptimer and it expired, the target is reached
+   */
+  if((WakeupTimerLimitation != WakeupTimerValue_Overpassed) && (WakeupTarget != WHEEL_TIME_NONE) && (now < WakeupTarget) &&
+     (__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTF) != RESET))
   {
-    ptimer_callback = aTimerContext[local_current_running_timer_id].pTimerCallBack;
-    timer_process_id = aTimerContext[local_current_running_timer_id].TimerProcessID;
+    now = WakeupTarget;
+  }
 
-    /**
-     * It should be good to check whether the TimeElapsed is greater or not than the tick left to be counted
-     * However, due to the inaccuracy of the reading of the time elapsed, it may return there is 1 tick
-     * to be left whereas the count is over
-     * A more secure implementation has been done with a flag to state whereas the full count has been written
-     * in the wakeuptimer or not
-     */
-    if(WakeupTimerLimitation != WakeupTimerValue_Overpassed)
+  TIMER_EXIT_CRITICAL_SECTION();
+
+  do
+  {
+    expired = 0;
+
+    TIMER_ENTER_CRITICAL_SECTION();
+
+    event = NextWheelEvent(&list_id);
+
+    if(event <= now)
     {
-      if(aTimerContext[local_current_running_timer_id].TimerMode == hw_ts_Repeated)
-      {
-        UnlinkTimer(local_current_running_timer_id, SSR_Read_Not_Requested);
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-        __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
-        HW_TS_Start(local_current_running_timer_id, aTimerContext[local_current_running_timer_id].CounterInit);
+      WheelTime = event;
+      timer_id = aListHead[list_id];
+      UnlinkTimer(timer_id);
 
-        /* Disable the write protection for RTC registers */
-        __HAL_RTC_WRITEPROTECTION_DISABLE( phrtc );
-        }
+      if(list_id != TIMER_LIST_DUE)
+      {
+        /**
+         * Move the timer down the wheel, to the due list when it expires now
+         */
+        LinkTimer(timer_id, WheelListID(aTimerContext[timer_id].Expiry));
+      }
       else
       {
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-        __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
-        HW_TS_Stop(local_current_running_timer_id);
-
-        /* Disable the write protection for RTC registers */
-        __HAL_RTC_WRITEPROTECTION_DISABLE( phrtc );
+        ptimer_callback = aTimerContext[timer_id].pTimerCallBack;
+        timer_process_id = aTimerContext[timer_id].TimerProcessID;
+        expired = 1;
+
+        if(aTimerContext[timer_id].TimerMode == hw_ts_Repeated)
+        {
+          /**
+           * Restart from the expiry so that the period does not drift. When the expiry is too late
+           * for that, restart from now
+           */
+          aTimerContext[timer_id].Expiry += aTimerContext[timer_id].CounterInit;
+          if(aTimerContext[timer_id].Expiry <= now)
+          {
+            aTimerContext[timer_id].Expiry = now + aTimerContext[timer_id].CounterInit;
+          }
+          LinkTimer(timer_id, WheelListID(aTimerContext[timer_id].Expiry));
         }
-
-      HW_TS_RTC_Int_AppNot(timer_process_id, local_current_running_timer_id, ptimer_callback);
+        else
+        {
+          aTimerContext[timer_id].TimerIDStatus = TimerID_Created;
+        }
+      }
     }
-    else
+
+    TIMER_EXIT_CRITICAL_SECTION();
+
+    if(expired != 0)
     {
-      RescheduleTimerList();
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-      __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
+      HW_TS_RTC_Int_AppNot(timer_process_id, timer_id, ptimer_callback);
     }
+  } while(event <= now);
+
+  TIMER_ENTER_CRITICAL_SECTION();
+
+  /* Disable the write protection for RTC registers, the callbacks may have enabled it */
+  __HAL_RTC_WRITEPROTECTION_DISABLE( phrtc );
+
+  InWakeupHandler = 0;
+
+  if(NextWheelEvent(&list_id) == WHEEL_TIME_NONE)
+  {
+    StopWakeupTimer();
   }
   else
   {
-    /**
-     * We should never end up in this case
-     * However, if due to any bug in the timer server this is the case, the mistake may not impact the user.
-     * We could just clean the interrupt flag and get out from this unexpected interrupt
-     */
-    while(__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTWF) == RESET);
-
-    /**
-     * make sure to clear the flags after checking the WUTWF.
-     * It takes 2 RTCCLK between the time the WUTE bit is disabled and the
-     * time the timer is disabled. The WUTWF bit somehow guarantee the system is stable
-     * Otherwise, when the timer is periodic with 1 Tick, it may generate an extra interrupt in between
-     * due to the autoreload feature
-     */
-    __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(phrtc, RTC_FLAG_WUTF);   /**<  Clear flag in RTC module */
-    __HAL_RTC_WAKEUPTIMER_EXTI_CLEAR_FLAG(); /**<  Clear flag in EXTI module */
-
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-    __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
+    RescheduleWakeupTimer(NextExpiry());
   }
 
   /* Enable the write protection for RTC registers */
   __HAL_RTC_WRITEPROTECTION_ENABLE( phrtc );
 
+  TIMER_EXIT_CRITICAL_SECTION();
+
   return;
 }
 
@@ -642,7 +794,21 @@ void HW_TS_Init(HW_TS_InitMode_t TimerInitMode, RTC_HandleTypeDef *hrtc)
       aTimerContext[loop].TimerIDStatus = TimerID_Free;
     }
 
-    CurrentRunningTimerID = CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER;   /**<  Set ID to non valid value */
+    for(loop = 0; loop < TIMER_LIST_NBR; loop++)
+    {
+      aListHead[loop] = TIMER_ID_NONE;
+    }
+
+    for(loop = 0; loop < TIMER_WHEEL_LEVELS; loop++)
+    {
+      aLevelMap[loop] = 0;
+      aLevelHeadFirst[loop] = 0;
+    }
+
+    WheelTime = 0;
+    SetupTime = 0;
+    WakeupTarget = WHEEL_TIME_NONE;
+    InWakeupHandler = 0;
 
     __HAL_RTC_WAKEUPTIMER_DISABLE(phrtc);                       /**<  Disable the Wakeup Timer */
     __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(phrtc, RTC_FLAG_WUTF);     /**<  Clear flag in RTC module */
@@ -726,16 +892,12 @@ void HW_TS_Delete(uint8_t timer_id)
 
 void HW_TS_Stop(uint8_t timer_id)
 {
-  uint8_t localcurrentrunningtimerid;
-
+  uint8_t list_id;
 #if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
   uint32_t primask_bit;
 #endif
 
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-  primask_bit = __get_PRIMASK();  /**< backup PRIMASK bit */
-  __disable_irq();          /**< Disable all interrupts by setting PRIMASK bit on Cortex*/
-#endif
+  TIMER_ENTER_CRITICAL_SECTION();
 
   HAL_NVIC_DisableIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID);    /**<  Disable NVIC */
 
@@ -744,43 +906,23 @@ void HW_TS_Stop(uint8_t timer_id)
 
   if(aTimerContext[timer_id].TimerIDStatus == TimerID_Running)
   {
-    UnlinkTimer(timer_id, SSR_Read_Requested);
-    localcurrentrunningtimerid = CurrentRunningTimerID;
+    UnlinkTimer(timer_id);
+    aTimerContext[timer_id].TimerIDStatus = TimerID_Created;
 
-    if(localcurrentrunningtimerid == CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER)
+    /**
+     * The wakeup handler writes the wakeuptimer itself when it is done. Otherwise it is written only when the
+     * timer expiring first is stopped
+     */
+    if(InWakeupHandler == 0)
     {
-      /**
-       * List is empty
-       */
-
-      /**
-       * Disable the timer
-       */
-      if((READ_BIT(RTC->CR, RTC_CR_WUTE) == (RTC_CR_WUTE)) == SET)
+      if(NextWheelEvent(&list_id) == WHEEL_TIME_NONE)
       {
-        /**
-         * Wait for the flag to be back to 0 when the wakeup timer is enabled
-         */
-        while(__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTWF) == SET);
+        StopWakeupTimer();
+      }
+      else if(aTimerContext[timer_id].Expiry <= WakeupTarget)
+      {
+        RescheduleWakeupTimer(NextExpiry());
       }
-      __HAL_RTC_WAKEUPTIMER_DISABLE(phrtc);   /**<  Disable the Wakeup Timer */
-
-      while(__HAL_RTC_WAKEUPTIMER_GET_FLAG(phrtc, RTC_FLAG_WUTWF) == RESET);
-
-      /**
-       * make sure to clear the flags after checking the WUTWF.
-       * It takes 2 RTCCLK between the time the WUTE bit is disabled and the
-       * time the timer is disabled. The WUTWF bit somehow guarantee the system is stable
-       * Otherwise, when the timer is periodic with 1 Tick, it may generate an extra interrupt in between
-       * due to the autoreload feature
-       */
-      __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(phrtc, RTC_FLAG_WUTF);   /**<  Clear flag in RTC module */
-      __HAL_RTC_WAKEUPTIMER_EXTI_CLEAR_FLAG(); /**<  Clear flag in EXTI module */
-      HAL_NVIC_ClearPendingIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID);   /**<  Clear pending bit in NVIC */
-    }
-    else if(PreviousRunningTimerID != localcurrentrunningtimerid)
-    {
-      RescheduleTimerList();
     }
   }
 
@@ -789,18 +931,13 @@ void HW_TS_Stop(uint8_t timer_id)
 
   HAL_NVIC_EnableIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID); /**<  Enable NVIC */
 
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-  __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
+  TIMER_EXIT_CRITICAL_SECTION();
 
   return;
 }
 
 void HW_TS_Start(uint8_t timer_id, uint32_t timeout_ticks)
 {
-  uint16_t time_elapsed;
-  uint8_t localcurrentrunningtimerid;
-
 #if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
   uint32_t primask_bit;
 #endif
@@ -810,10 +947,7 @@ void HW_TS_Start(uint8_t timer_id, uint32_t timeout_ticks)
     HW_TS_Stop( timer_id );
   }
 
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-  primask_bit = __get_PRIMASK();  /**< backup PRIMASK bit */
-  __disable_irq();          /**< Disable all interrupts by setting PRIMASK bit on Cortex*/
-#endif
+  TIMER_ENTER_CRITICAL_SECTION();
 
   HAL_NVIC_DisableIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID);    /**<  Disable NVIC */
 
@@ -822,20 +956,17 @@ void HW_TS_Start(uint8_t timer_id, uint32_t timeout_ticks)
 
   aTimerContext[timer_id].TimerIDStatus = TimerID_Running;
 
-  aTimerContext[timer_id].CountLeft = timeout_ticks;
   aTimerContext[timer_id].CounterInit = timeout_ticks;
+  aTimerContext[timer_id].Expiry = ReturnWheelTime() + timeout_ticks;
 
-  time_elapsed =  linkTimer(timer_id);
+  LinkTimer(timer_id, WheelListID(aTimerContext[timer_id].Expiry));
 
-  localcurrentrunningtimerid = CurrentRunningTimerID;
-
-  if(PreviousRunningTimerID != localcurrentrunningtimerid)
-  {
-    RescheduleTimerList();
-  }
-  else
+  /**
+   * The wakeuptimer is written only when the timer expires before the first one, it is then the first
+   */
+  if((InWakeupHandler == 0) && (aTimerContext[timer_id].Expiry < WakeupTarget))
   {
-    aTimerContext[timer_id].CountLeft -= time_elapsed;
+    RescheduleWakeupTimer(aTimerContext[timer_id].Expiry);
   }
 
   /* Enable the write protection for RTC registers */
@@ -843,9 +974,7 @@ void HW_TS_Start(uint8_t timer_id, uint32_t timeout_ticks)
 
   HAL_NVIC_EnableIRQ(CFG_HW_TS_RTC_WAKEUP_HANDLER_ID); /**<  Enable NVIC */
 
-#if (CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION == 1)
-  __set_PRIMASK(primask_bit); /**< Restore PRIMASK bit*/
-#endif
+  TIMER_EXIT_CRITICAL_SECTION();
 
   return;
 }
@@ -42,7 +42,8 @@
 #include "scheduler.h"
 #include "logo.h"
 #include "ssd1306.h"
-#include "ssd1306_fonts.h"
+#include "app_common.h"
+#include "app_ble.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -50,6 +51,8 @@
 #include "max30102.h"
 #include "tmp102.h"
 #include "oled.h"
+#include "history.h"
+#include "cycle_prof.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -58,11 +61,9 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+#define DISPLAY_PERIOD 50 /*ms, also the deadline*/
 
 uint16_t RxCounter;
-#define MAX_BPM_THRESHOLD 130
-#define MIN_BPM_THRESHOLD 60
 uint8_t ucHighBPMDetected = 0;
 uint8_t ucLowBPMDetected = 0;
 /* USER CODE END PD */
@@ -109,13 +110,12 @@ static void MX_TIM17_Init(void);
 /* USER CODE BEGIN PFP */
 
 volatile uint32_t uiTimer16Counter = 0;
-volatile uint8_t ucSensorReadFlag = 0;
 volatile uint8_t ecgFIFOIntFlag = 0;
 uint8_t ucOledStatusFlag = 7;
-uint8_t ucPrintCounter=0;
 uint8_t ucIsMax30102Active = 1;
 typedefBleData bleData;
 void checkBPMAndControlLED(uint8_t bpm);
+static void vDisplayTask(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -125,14 +125,12 @@ void checkBPMAndControlLED(uint8_t bpm);
 ADC_HandleTypeDef AdcHandle;
 
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-	if (htim->Instance == TIM16) {
-		ucSensorReadFlag = 1;
-	}
+// MAX30102 INT goes low with new samples in the FIFO, the drain runs as a task
+void HAL_GPIO_EXTI_Callback( uint16_t GPIO_Pin )	{
+	if (GPIO_Pin == MAX30102_INT_Pin)
+		SCH_SetTask(1 << CFG_TASK_SENSOR_DRAIN_ID, CFG_SCH_PRIO_0);
 }
 
-void HAL_GPIO_EXTI_Callback( uint16_t GPIO_Pin )	{}
-
 void initTimer() {
 	//HAL_TIM_PWM_Start(&htim17, TIM_CHANNEL_1);
 	//HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_3);
@@ -145,14 +143,9 @@ void initTimer() {
 }
 
 
-void initInterrupts() {
-	HAL_TIM_Base_Start_IT(&htim16);
-}
-
 void systemInit(void) {
 	HAL_NVIC_SetPriority(SysTick_IRQn, 0 ,0);
 	initTimer();
-	initInterrupts();
 	vMax30102Init();
 	vOledInit();
 }
@@ -160,16 +153,30 @@ void systemInit(void) {
 
 
 
+// sensor drain task, posted from the MAX30102 INT edge
 void vReadSensorData(void){
-	if(ucSensorReadFlag == 1){
-		if(ucIsMax30102Active)
-			vMax30102ReadData();
-		ucSensorReadFlag=0;
-		vShowOledScreenProcess(ucOledStatusFlag);
-	}
-
+	uint8_t heartRate;
+
+	if (!ucIsMax30102Active)
+		return;
+	vMax30102ReadData();
+	heartRate = ucGetMax30102HR();
+	checkBPMAndControlLED(heartRate);
+	// TMP102 is not polled, records carry no temperature
+	vHistorySample(heartRate, ucGetMax30102SPO2(), HISTORY_TEMP_NONE, HAL_GetTick());
+#if (CFG_BLE_HR_BROADCAST != 0)
+	APP_BLE_Broadcast_Update(heartRate, ucGetMax30102SPO2());
+#endif
 }
 
+// display task, every DISPLAY_PERIOD
+static void vDisplayTask(void) {
+	vShowOledScreenProcess(ucOledStatusFlag);
+	// INT already low when the edge was enabled never gives one, drain it from here
+	if (ucIsMax30102Active
+			&& HAL_GPIO_ReadPin(MAX30102_INT_GPIO_Port, MAX30102_INT_Pin) == GPIO_PIN_RESET)
+		SCH_SetTask(1 << CFG_TASK_SENSOR_DRAIN_ID, CFG_SCH_PRIO_0);
+}
 
 void vPrintSensorData(uint32_t data){
 	unsigned char text[20];
@@ -203,25 +210,8 @@ void vPrintTMP102Data(float temp,int status) {
 
 
 void vShowOledScreenProcess(uint8_t status) {
-	if (status == OLED_STATUS_DEF) {
-		ucPrintCounter = 0;
-	}else if (status == OLED_STATUS_SHUT_DOWN){
-		ucPrintCounter = 0;
-		vOledBleClearScreen();
-	} else if (status == OLED_STATUS_MAX30102) {
-		if (ucPrintCounter >= OLED_COUNTER_TIME_OUT_MAX30102) {
-			vOledBlePrintMax30102(ucGetMax30102HR(), ucGetMax30102SPO2(),
-					usGetMax30102Diff());
-			ucPrintCounter = 0;
-		}
-	} else if (status == OLED_STATUS_BLE) {
-		if (ucPrintCounter >= OLED_COUNTER_TIME_OUT) {
-			vOledBlePrintData();
-			ucPrintCounter = 0;
-		}
-
-	}
-	ucPrintCounter++;
+	vOledScreenProcess(status, ucGetMax30102HR(), ucGetMax30102SPO2(),
+			usGetMax30102Diff());
 }
 
 void setActiveSensor(uint8_t data) {
@@ -245,8 +235,6 @@ void setActiveSensor(uint8_t data) {
  */
  int main(void) {
 	/* USER CODE BEGIN 1 */
-	 uint8_t heartRate=0;
-
 	 booting();
 	/* USER CODE END 1 */
 
@@ -282,27 +270,32 @@ void setActiveSensor(uint8_t data) {
 	HAL_GPIO_WritePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin, GPIO_PIN_RESET);
 	HAL_Delay(250);
 	systemInit();
-	ssd1306_Init();
-	ssd1306_DrawBitmap(0,0,logo,128,64,1);
-	ssd1306_UpdateScreen();
+	SSD1306_DrawRle(0, 0, LOGO_WIDTH, LOGO_PAGES, logo_rle);
+	SSD1306_UpdateScreen();
 	HAL_Delay(2000); // Display pulsefex logo for 2 seconds
-	ssd1306_Init();
+	vOledBleClearScreen();
 	setActiveSensor(1 << MAX30102_BIT_POSITION);
+	vHistoryInit();
+#if (CFG_CYCLE_PROF != 0)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	vCycleProfReset();
+#endif
 
 	/* USER CODE END 2 */
 	APPE_Init();
 	/* Infinite loop */
 	/* USER CODE BEGIN WHILE */
+	// all the work runs as tasks, SCH_Idle() sleeps in between
+	SCH_RegTask(CFG_TASK_SENSOR_DRAIN_ID, vReadSensorData);
+	SCH_RegTask(CFG_TASK_DISPLAY_ID, vDisplayTask);
+	APPE_Periodic_Register(CFG_TASK_DISPLAY_ID, DISPLAY_PERIOD, DISPLAY_PERIOD);
+	APPE_Periodic_Enable(CFG_TASK_DISPLAY_ID, 1);
+	SCH_SetTask(1 << CFG_TASK_SENSOR_DRAIN_ID, CFG_SCH_PRIO_0);
 	while (1) {
 		/* USER CODE END WHILE */
 		/* USER CODE BEGIN 3 */
 		SCH_Run(~0);
-		vReadSensorData();
-	       if (ucIsMax30102Active) {
-	            heartRate = ucGetMax30102HR();
-	            checkBPMAndControlLED(heartRate);
-	        }
-		vShowOledScreenProcess(OLED_STATUS_MAX30102);
 		//float temp=0.0;
 		//int result;
 		//result = TMP102_ReadTemperature(&temp);
@@ -877,9 +870,9 @@ static void MX_GPIO_Init(void) {
 	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
 	HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
-	/*Configure GPIO pin : MAX30102_INT_Pin */
+	/*Configure GPIO pin : MAX30102_INT_Pin, active low */
 	GPIO_InitStruct.Pin = MAX30102_INT_Pin;
-	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
 	GPIO_InitStruct.Pull = GPIO_NOPULL;
 	HAL_GPIO_Init(MAX30102_INT_GPIO_Port, &GPIO_InitStruct);
 
@@ -890,6 +883,9 @@ static void MX_GPIO_Init(void) {
 	HAL_NVIC_SetPriority(EXTI2_IRQn, 11, 0);
 	HAL_NVIC_EnableIRQ(EXTI2_IRQn);
 
+	HAL_NVIC_SetPriority(EXTI0_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+
 /*
 	HAL_NVIC_SetPriority(EXTI1_IRQn, 0, 0);
 	HAL_NVIC_EnableIRQ(EXTI1_IRQn);
@@ -6,6 +6,7 @@
  */
 
 #include "max30102.h"
+#include "ppg_stream.h"
 
 
 //local function prototypes
@@ -16,6 +17,8 @@ volatile typedef_max30102 mMax30102Sensor;
 // local variables
 #define FILTER_LEVEL 8 /*????*/
 #define BUFF_SIZE 50
+// samples taken per FIFO read, the FIFO itself holds up to 32
+#define FIFO_CHUNK 5
 SAMPLE sampleBuff[BUFF_SIZE];
 
 uint16_t redAC = 0;
@@ -24,7 +27,7 @@ uint16_t iRedAC = 0;
 uint32_t iRedDC = 0;
 
 uint8_t unreadSampleCount = 0;
-SAMPLE sampleBuffTemp[5];
+SAMPLE sampleBuffTemp[FIFO_CHUNK];
 
 uint8_t wr = 0, rd = 0;
 uint8_t dataInit =0;
@@ -102,9 +105,9 @@ void calAcDc(uint16_t *rac, uint32_t *rdc, uint16_t *iac, uint32_t *idc) {
 }
 
 void max30102_getFIFO(SAMPLE *data, uint8_t sampleCount) {
-	uint8_t dataTemp[5 * 6];
-	if (sampleCount > 5)
-		sampleCount = 5;
+	uint8_t dataTemp[FIFO_CHUNK * 6];
+	if (sampleCount > FIFO_CHUNK)
+		sampleCount = FIFO_CHUNK;
 	i2c_read(MAX30102_ADDR_READ,RES_FIFO_DATA_REGISTER,dataTemp, 6 * sampleCount);
 	char debugMsg[128];
 	uint8_t i;
@@ -211,61 +214,65 @@ void vMax30102ReadData(void) {
 
 	if (HAL_GPIO_ReadPin(MAX30102_INT_GPIO_Port, MAX30102_INT_Pin)	== GPIO_PIN_RESET) {
 
-		unreadSampleCount = max30102_getUnreadSampleCount();
-		if(unreadSampleCount == 0 )
-			return;
-		max30102_getFIFO(sampleBuffTemp, unreadSampleCount);
-
 		static uint8_t eachBeatSampleCount = 0;    //????????????
 		static uint8_t lastTenBeatSampleCount[10]; //?????????????
 		static uint32_t last_iRed = 0;             //???????,????
-		uint8_t i, ii;
-		for (i = 0; i < unreadSampleCount; i++) {
-			if (sampleBuffTemp[i].iRed < 40000) //??????,??
-					{
-				mMax30102Sensor.ucHR = 0;
-				mMax30102Sensor.ucSPO2 = 0;
-				mMax30102Sensor.usDiff = 0;
-				mMax30102Sensor.uiIRed = 0;
-				mMax30102Sensor.uiRed = 0;
-				continue;
-			}
-			mMax30102Sensor.uiIRed = sampleBuffTemp[i].iRed;
-			mMax30102Sensor.uiRed = sampleBuffTemp[i].red;
-			buffInsert(sampleBuffTemp[i]);
-			calAcDc(&redAC, &redDC, &iRedAC, &iRedDC);
-			filter(&sampleBuffTemp[i]);
-			//??spo2
-			float R = (((float) (redAC)) / ((float) (redDC)))
-					/ (((float) (iRedAC)) / ((float) (iRedDC)));
-			if (R >= 0.36 && R < 0.66)
-				mMax30102Sensor.ucSPO2 = (uint8_t) (107 - 20 * R);
-			else if (R >= 0.66 && R < 1)
-				mMax30102Sensor.ucSPO2 = (uint8_t) (129.64 - 54 * R);
-			//????,30-250ppm  count:200-12
-			mMax30102Sensor.usDiff = last_iRed - sampleBuffTemp[i].iRed;
-			// bpm temp
-			/*
-			if (ucCheckForBeat(sampleBuffTemp[i].iRed)){
-				  long delta = HAL_GetTick() - lastBeat;                   //Measure duration between two beats
-				    lastBeat = HAL_GetTick();
-				mMax30102Sensor.ucHR  = 60 / (delta / 1000.0);
-			}
-			*/
-
-			// bpm temp
-			if (mMax30102Sensor.usDiff > 50 && eachBeatSampleCount > 12) {
-				for (ii = 9; ii > 0; ii--)
-					lastTenBeatSampleCount[i] = lastTenBeatSampleCount[i - 1];
-				lastTenBeatSampleCount[0] = eachBeatSampleCount;
-				uint32_t totalTime = 0;
-				for (ii = 0; ii < 10; ii++)
-					totalTime += lastTenBeatSampleCount[i];
-				mMax30102Sensor.ucHR = (uint8_t) (60.0 * 10 / 0.02	/ ((float) totalTime));
-				eachBeatSampleCount = 0;
+		uint8_t i, ii, chunk;
+
+		unreadSampleCount = max30102_getUnreadSampleCount();
+		// up to 32 samples wait after a stall, drained FIFO_CHUNK at a time
+		for (; unreadSampleCount > 0; unreadSampleCount -= chunk) {
+			chunk = unreadSampleCount < FIFO_CHUNK ? unreadSampleCount : FIFO_CHUNK;
+			max30102_getFIFO(sampleBuffTemp, chunk);
+			for (i = 0; i < chunk; i++) {
+				// every raw sample goes out, also the ones without a finger on
+				vPpgStreamPush(sampleBuffTemp[i].red, sampleBuffTemp[i].iRed);
+				if (sampleBuffTemp[i].iRed < 40000) //??????,??
+						{
+					mMax30102Sensor.ucHR = 0;
+					mMax30102Sensor.ucSPO2 = 0;
+					mMax30102Sensor.usDiff = 0;
+					mMax30102Sensor.uiIRed = 0;
+					mMax30102Sensor.uiRed = 0;
+					continue;
+				}
+				mMax30102Sensor.uiIRed = sampleBuffTemp[i].iRed;
+				mMax30102Sensor.uiRed = sampleBuffTemp[i].red;
+				buffInsert(sampleBuffTemp[i]);
+				calAcDc(&redAC, &redDC, &iRedAC, &iRedDC);
+				filter(&sampleBuffTemp[i]);
+				//??spo2
+				float R = (((float) (redAC)) / ((float) (redDC)))
+						/ (((float) (iRedAC)) / ((float) (iRedDC)));
+				if (R >= 0.36 && R < 0.66)
+					mMax30102Sensor.ucSPO2 = (uint8_t) (107 - 20 * R);
+				else if (R >= 0.66 && R < 1)
+					mMax30102Sensor.ucSPO2 = (uint8_t) (129.64 - 54 * R);
+				//????,30-250ppm  count:200-12
+				mMax30102Sensor.usDiff = last_iRed - sampleBuffTemp[i].iRed;
+				// bpm temp
+				/*
+				if (ucCheckForBeat(sampleBuffTemp[i].iRed)){
+					  long delta = HAL_GetTick() - lastBeat;                   //Measure duration between two beats
+					    lastBeat = HAL_GetTick();
+					mMax30102Sensor.ucHR  = 60 / (delta / 1000.0);
+				}
+				*/
+
+				// bpm temp
+				if (mMax30102Sensor.usDiff > 50 && eachBeatSampleCount > 12) {
+					for (ii = 9; ii > 0; ii--)
+						lastTenBeatSampleCount[ii] = lastTenBeatSampleCount[ii - 1];
+					lastTenBeatSampleCount[0] = eachBeatSampleCount;
+					uint32_t totalTime = 0;
+					for (ii = 0; ii < 10; ii++)
+						totalTime += lastTenBeatSampleCount[ii];
+					mMax30102Sensor.ucHR = (uint8_t) (60.0 * 10 / 0.02	/ ((float) totalTime));
+					eachBeatSampleCount = 0;
+				}
+				last_iRed = sampleBuffTemp[i].iRed;
+				eachBeatSampleCount++;
 			}
-			last_iRed = sampleBuffTemp[i].iRed;
-			eachBeatSampleCount++;
 		}
 
 	}
@@ -0,0 +1,262 @@
+/*
+ * notify_queue.c
+ *
+ * Values are pushed and drained from scheduler tasks and the TX pool event is
+ * handled in the HCI event task, all in thread mode so no locking.
+ */
+
+#include "notify_queue.h"
+#include "app_common.h"
+#include "ble.h"
+
+#include <string.h>
+
+typedef struct {
+	uint16_t usChar;
+	uint16_t usLength;
+	uint8_t ucUrgent;
+	uint8_t aValue[NOTIFY_QUEUE_VALUE_MAX];
+} NotifyQueueSlot;
+
+static NotifyQueueSlot aSlots[NOTIFY_QUEUE_SLOTS];
+static uint8_t ucHead = 0;     // oldest value
+static uint8_t ucCount = 0;
+static uint8_t ucStalled = 0;  // stack out of TX buffers, wait for the pool event
+static uint8_t ucInFlight = 0; // head handed over, its status comes with vNotifyQueueSent()
+static uint8_t ucDiscard = 0;  // head flushed while in flight, dropped once the stack is done
+static uint8_t ucOpen = 0xFF; // position handed out by pNotifyQueueSlot(), 0xFF for none
+static uint8_t ucOpenNew = 0;  // the position was inserted for it
+static uint8_t (*pfQueueSend)(uint16_t usChar, uint8_t *pData, uint16_t usLength);
+static NotifyQueueStats tStats;
+
+#define NOTIFY_QUEUE_AT(pos) (&aSlots[(ucHead + (pos)) % NOTIFY_QUEUE_SLOTS])
+
+// local function prototypes
+static uint8_t ucNotifyQueueResult(uint8_t status);
+static void vNotifyQueueInsert(uint8_t pos);
+static void vNotifyQueueRemove(uint8_t pos);
+
+//local functions
+// returns 0 when the head stays queued for the pool event
+static uint8_t ucNotifyQueueResult(uint8_t status) {
+	if (status == BLE_STATUS_INSUFFICIENT_RESOURCES && !ucDiscard) {
+		ucStalled = 1;
+		tStats.uiStalls++;
+		return 0;
+	}
+	// any other refusal would block the queue forever, that value goes
+	if (status == BLE_STATUS_SUCCESS)
+		tStats.uiSent++;
+	else
+		tStats.uiFailed++;
+	ucDiscard = 0;
+	ucHead = (ucHead + 1) % NOTIFY_QUEUE_SLOTS;
+	ucCount--;
+	return 1;
+}
+
+// opens position pos, the values from there on move one back, there has to be room
+static void vNotifyQueueInsert(uint8_t pos) {
+	uint8_t i;
+
+	for (i = ucCount; i > pos; i--)
+		*NOTIFY_QUEUE_AT(i) = *NOTIFY_QUEUE_AT(i - 1);
+	ucCount++;
+}
+
+static void vNotifyQueueRemove(uint8_t pos) {
+	uint8_t i;
+
+	ucCount--;
+	for (i = pos; i < ucCount; i++)
+		*NOTIFY_QUEUE_AT(i) = *NOTIFY_QUEUE_AT(i + 1);
+}
+
+// Global Function Definitions
+void vNotifyQueueInit(uint8_t (*pfSend)(uint16_t usChar, uint8_t *pData,
+		uint16_t usLength)) {
+	pfQueueSend = pfSend;
+	ucHead = 0;
+	ucCount = 0;
+	ucStalled = 0;
+	ucInFlight = 0;
+	ucDiscard = 0;
+	ucOpen = 0xFF;
+	memset(&tStats, 0, sizeof(tStats));
+}
+
+// returns 0 when the value was dropped, the queue is left as it was
+uint8_t ucNotifyQueuePush(uint16_t usChar, const uint8_t *pData,
+		uint16_t usLength) {
+	NotifyQueueSlot *slot;
+
+	if (usLength > NOTIFY_QUEUE_VALUE_MAX || ucCount == NOTIFY_QUEUE_SLOTS) {
+		tStats.uiDropped++;
+		return 0;
+	}
+	slot = NOTIFY_QUEUE_AT(ucCount);
+	slot->usChar = usChar;
+	slot->usLength = usLength;
+	slot->ucUrgent = 0;
+	memcpy(slot->aValue, pData, usLength);
+	ucCount++;
+	tStats.uiQueued++;
+	if (ucCount > tStats.ucHighWater)
+		tStats.ucHighWater = ucCount;
+	return 1;
+}
+
+/*
+ * Buffer of NOTIFY_QUEUE_VALUE_MAX bytes for the next value of usChar, to be
+ * written in place and closed with vNotifyQueueCommit() before anything else
+ * touches the queue. NULL when the mode finds no room, nothing is counted then.
+ *   APPEND  behind everything queued
+ *   LATEST  over a value of usChar still waiting, else as APPEND
+ *   URGENT  ahead of everything waiting but earlier urgent values, it waits
+ *           for a free slot like the others, what is queued was already
+ *           taken from its producer and is never pushed out
+ */
+uint8_t *pNotifyQueueSlot(uint16_t usChar, uint8_t ucMode) {
+	NotifyQueueSlot *slot;
+	uint8_t pos;
+
+	ucOpen = 0xFF;
+	pos = ucInFlight ? 1 : 0;
+	if (ucMode == NOTIFY_QUEUE_LATEST) {
+		for (; pos < ucCount; pos++) {
+			if (NOTIFY_QUEUE_AT(pos)->usChar == usChar) {
+				ucOpen = pos;
+				ucOpenNew = 0;
+				return NOTIFY_QUEUE_AT(pos)->aValue;
+			}
+		}
+	}
+	if (ucMode == NOTIFY_QUEUE_URGENT) {
+		if (ucCount == NOTIFY_QUEUE_SLOTS)
+			return NULL;
+		while (pos < ucCount && NOTIFY_QUEUE_AT(pos)->ucUrgent)
+			pos++;
+		vNotifyQueueInsert(pos);
+	} else {
+		if (ucCount == NOTIFY_QUEUE_SLOTS)
+			return NULL;
+		pos = ucCount++;
+	}
+	slot = NOTIFY_QUEUE_AT(pos);
+	slot->usChar = usChar;
+	slot->usLength = 0;
+	slot->ucUrgent = (ucMode == NOTIFY_QUEUE_URGENT);
+	ucOpen = pos;
+	ucOpenNew = 1;
+	return slot->aValue;
+}
+
+// length written to the buffer of pNotifyQueueSlot(), 0 leaves the queue as it was
+void vNotifyQueueCommit(uint16_t usLength) {
+	if (ucOpen == 0xFF)
+		return;
+	if (usLength == 0 || usLength > NOTIFY_QUEUE_VALUE_MAX) {
+		if (ucOpenNew)
+			vNotifyQueueRemove(ucOpen);
+		ucOpen = 0xFF;
+		return;
+	}
+	NOTIFY_QUEUE_AT(ucOpen)->usLength = usLength;
+	if (ucOpenNew) {
+		tStats.uiQueued++;
+		if (ucCount > tStats.ucHighWater)
+			tStats.ucHighWater = ucCount;
+	} else {
+		tStats.uiCoalesced++;
+	}
+	ucOpen = 0xFF;
+}
+
+uint8_t ucNotifyQueueFree(void) {
+	return NOTIFY_QUEUE_SLOTS - ucCount;
+}
+
+uint8_t ucNotifyQueueStalled(void) {
+	return ucStalled;
+}
+
+/*
+ * Sends until the queue is empty, the stack runs out of TX buffers or a value
+ * is accepted with BLE_STATUS_PENDING. A pending head stays in its slot, the
+ * sender reads it until it calls vNotifyQueueSent().
+ */
+void vNotifyQueueDrain(void) {
+	NotifyQueueSlot *slot;
+	uint8_t status;
+
+	while (ucCount && !ucStalled && !ucInFlight) {
+		slot = &aSlots[ucHead];
+		status = pfQueueSend(slot->usChar, slot->aValue, slot->usLength);
+		if (status == BLE_STATUS_PENDING) {
+			ucInFlight = 1;
+			break;
+		}
+		if (!ucNotifyQueueResult(status))
+			break;
+	}
+}
+
+// status of the head sent with BLE_STATUS_PENDING, the caller drains again from its task
+void vNotifyQueueSent(uint8_t status) {
+	if (!ucInFlight)
+		return;
+	ucInFlight = 0;
+	ucNotifyQueueResult(status);
+}
+
+// EVT_BLUE_GATT_TX_POOL_AVAILABLE, the caller drains again from its task
+void vNotifyQueueResume(uint16_t usBuffers) {
+	tStats.usPoolBuffers = usBuffers;
+	ucStalled = 0;
+}
+
+// a head in flight keeps its slot until vNotifyQueueSent()
+void vNotifyQueueFlush(void) {
+	ucStalled = 0;
+	if (ucInFlight) {
+		ucCount = 1;
+		ucDiscard = 1;
+		ucOpen = 0xFF;
+		return;
+	}
+	ucHead = 0;
+	ucCount = 0;
+	ucOpen = 0xFF;
+}
+
+/*
+ * Drops the values of usChar only, the others keep their order. Returns 1 when
+ * the head was one of them and had not been handed over, a retry of it is off.
+ */
+uint8_t ucNotifyQueueFlushChar(uint16_t usChar) {
+	uint8_t pos = 0, head = 0;
+
+	ucOpen = 0xFF;
+	if (ucInFlight) {
+		if (ucCount && aSlots[ucHead].usChar == usChar)
+			ucDiscard = 1;
+		pos = 1;
+	}
+	while (pos < ucCount) {
+		if (NOTIFY_QUEUE_AT(pos)->usChar != usChar) {
+			pos++;
+			continue;
+		}
+		if (pos == 0)
+			head = 1;
+		vNotifyQueueRemove(pos);
+	}
+	if (head)
+		ucStalled = 0;
+	return head;
+}
+
+void vNotifyQueueGetStats(NotifyQueueStats *stats) {
+	*stats = tStats;
+	stats->ucDepth = ucCount;
+}
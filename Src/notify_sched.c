@@ -0,0 +1,161 @@
+/*
+ * notify_sched.c
+ *
+ * Earliest deadline pick over the registered characteristics, see
+ * notify_sched.h. Runs in thread mode only, as the queue it fills.
+ */
+
+#include "notify_sched.h"
+#include "notify_queue.h"
+
+typedef struct {
+	uint16_t usChar;
+	uint8_t ucClass;
+	uint8_t ucEnabled;
+	uint8_t ucRaised;    // due now whatever the period
+	uint8_t ucAlarm;     // the next value goes out as ALARM
+	uint32_t uiPeriod;   // ms, 0 when only raised
+	uint32_t uiDeadline;
+	NotifySchedProducer pfProduce;
+} NotifySchedEntry;
+
+static NotifySchedEntry aEntries[NOTIFY_SCHED_MAX];
+static uint8_t ucEntries = 0;
+
+// local function prototypes
+static NotifySchedEntry *pNotifySchedFind(uint16_t usChar);
+static uint8_t ucNotifySchedDue(const NotifySchedEntry *e, uint32_t uiNow);
+static uint8_t ucNotifySchedClass(const NotifySchedEntry *e);
+static NotifySchedEntry *pNotifySchedPick(uint32_t uiNow, uint8_t ucBlocked);
+
+//local functions
+static NotifySchedEntry *pNotifySchedFind(uint16_t usChar) {
+	uint8_t i;
+
+	for (i = 0; i < ucEntries; i++) {
+		if (aEntries[i].usChar == usChar)
+			return &aEntries[i];
+	}
+	return NULL;
+}
+
+static uint8_t ucNotifySchedDue(const NotifySchedEntry *e, uint32_t uiNow) {
+	if (!e->ucEnabled)
+		return 0;
+	if (e->ucRaised)
+		return 1;
+	return e->uiPeriod && (int32_t) (uiNow - e->uiDeadline) >= 0;
+}
+
+static uint8_t ucNotifySchedClass(const NotifySchedEntry *e) {
+	return e->ucAlarm ? NOTIFY_SCHED_ALARM : e->ucClass;
+}
+
+// ucBlocked has bit i set for the entries that found no room in this run
+static NotifySchedEntry *pNotifySchedPick(uint32_t uiNow, uint8_t ucBlocked) {
+	NotifySchedEntry *best = NULL, *e;
+	uint8_t i;
+
+	for (i = 0; i < ucEntries; i++) {
+		e = &aEntries[i];
+		if ((ucBlocked >> i) & 1 || !ucNotifySchedDue(e, uiNow))
+			continue;
+		if (best == NULL || ucNotifySchedClass(e) < ucNotifySchedClass(best)
+				|| (ucNotifySchedClass(e) == ucNotifySchedClass(best)
+						&& (int32_t) (e->uiDeadline - best->uiDeadline) < 0))
+			best = e;
+	}
+	return best;
+}
+
+// Global Function Definitions
+void vNotifySchedInit(void) {
+	ucEntries = 0;
+}
+
+// returns 0 when the table is full
+uint8_t ucNotifySchedRegister(uint16_t usChar, uint32_t uiPeriod,
+		uint8_t ucClass, NotifySchedProducer pfProduce) {
+	NotifySchedEntry *e;
+
+	if (ucEntries == NOTIFY_SCHED_MAX)
+		return 0;
+	e = &aEntries[ucEntries++];
+	e->usChar = usChar;
+	e->ucClass = ucClass;
+	e->ucEnabled = 0;
+	e->ucRaised = 0;
+	e->ucAlarm = 0;
+	e->uiPeriod = uiPeriod;
+	e->uiDeadline = 0;
+	e->pfProduce = pfProduce;
+	return 1;
+}
+
+// subscription of usChar, a periodic value goes out right away
+void vNotifySchedEnable(uint16_t usChar, uint8_t ucEnable, uint32_t uiNow) {
+	NotifySchedEntry *e = pNotifySchedFind(usChar);
+
+	if (e == NULL)
+		return;
+	e->ucEnabled = ucEnable;
+	e->ucRaised = 0;
+	e->ucAlarm = 0;
+	e->uiDeadline = uiNow;
+}
+
+// a value is ready, the deadline of an entry already raised is kept
+void vNotifySchedRaise(uint16_t usChar, uint32_t uiNow) {
+	NotifySchedEntry *e = pNotifySchedFind(usChar);
+
+	if (e == NULL || e->ucRaised)
+		return;
+	e->ucRaised = 1;
+	e->uiDeadline = uiNow;
+}
+
+void vNotifySchedAlarm(uint16_t usChar, uint32_t uiNow) {
+	NotifySchedEntry *e = pNotifySchedFind(usChar);
+
+	if (e == NULL)
+		return;
+	e->ucAlarm = 1;
+	e->ucRaised = 1;
+	e->uiDeadline = uiNow;
+}
+
+// fills the queue with what is due at uiNow, the caller drains it afterwards
+void vNotifySchedRun(uint32_t uiNow) {
+	NotifySchedEntry *e;
+	uint8_t blocked = 0, cls, *value;
+	uint16_t len;
+
+	while ((e = pNotifySchedPick(uiNow, blocked)) != NULL) {
+		cls = ucNotifySchedClass(e);
+		value = NULL;
+		if (cls == NOTIFY_SCHED_ALARM)
+			value = pNotifyQueueSlot(e->usChar, NOTIFY_QUEUE_URGENT);
+		else if (cls == NOTIFY_SCHED_SUMMARY)
+			value = pNotifyQueueSlot(e->usChar, NOTIFY_QUEUE_LATEST);
+		else if (ucNotifyQueueFree() > NOTIFY_SCHED_BULK_RESERVE)
+			value = pNotifyQueueSlot(e->usChar, NOTIFY_QUEUE_APPEND);
+		if (value == NULL) {
+			blocked |= 1 << (e - aEntries);
+			continue;
+		}
+		len = e->pfProduce(value, NOTIFY_QUEUE_VALUE_MAX);
+		vNotifyQueueCommit(len);
+
+		e->ucAlarm = 0;
+		if (e->uiPeriod == 0) {
+			// raised until the producer runs dry
+			if (len == 0)
+				e->ucRaised = 0;
+			continue;
+		}
+		e->ucRaised = 0;
+		e->uiDeadline += e->uiPeriod;
+		if ((int32_t) (uiNow - e->uiDeadline) >= 0)
+			e->uiDeadline = uiNow + e->uiPeriod;
+	}
+}
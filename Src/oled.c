@@ -2,6 +2,7 @@
 #include "oledfont.h"
 #include "main.h"
 #include "ssd1306.h"
+#include "oled_widget.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -9,11 +10,11 @@
 #define SIZE 16
 #define XLevelL 0x02
 #define XLevelH 0x10
-#define Max_Column 128
-#define Max_Row 64
+#define Max_Column SSD1306_WIDTH
+#define Max_Row SSD1306_HEIGHT
 #define Brightness 0xFF
-#define X_WIDTH 128
-#define Y_WIDTH 64
+#define X_WIDTH SSD1306_WIDTH
+#define Y_WIDTH SSD1306_HEIGHT
 
 #define OLED_NUM_A 0x1
 #define OLED_NUM_B 0x2
@@ -25,6 +26,13 @@
 
 #define oledI2c	hi2c3
 
+// scrolling waveform band, same pages as vOledDrawChart
+#define OLED_WAVE_FIRST_PAGE 5
+#define OLED_WAVE_LAST_PAGE 7
+#define OLED_WAVE_PAGES (OLED_WAVE_LAST_PAGE - OLED_WAVE_FIRST_PAGE + 1)
+// one column per display update, DISPLAY_PERIOD in main.c
+#define OLED_WAVE_STEP_MS 50
+
 unsigned short usBpmPoslastX;
 unsigned short usBpmPoslastY;
 unsigned short usBpmPosX;
@@ -36,8 +44,6 @@ uint32_t maxRangeOfGSR = 512;
 
 uint8_t point_x = 0;
 uint8_t point_y = 0;
-uint8_t whatToDo = 0;
-uint8_t oled_cache[8][128];
 uint8_t pos_x_this = 0;
 
 #define LCD_BUFFER_LENGHT 64
@@ -84,56 +90,67 @@ const uint8_t oled_nums[] = { 0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
 		0x7f, 0x6f, 0x00 };
 const uint8_t oled_nums_pos[] = { 24, 36, 47, 86, 98, 109 };
 char pos_y_old = 0;
+
+static uint8_t ucWaveActive = 0;
+static char cWaveMin;
+static char cWaveMax;
+static char cWaveLast;
+static uint32_t uiWaveLastTick;
+static uint8_t ucWaveSame; // columns at the right edge equal to the newest one
+
+// values shown by the retained screens, set by the vOledBle* entry points
+static uint8_t ucScreenHR;
+static uint8_t ucScreenSpO2;
+static uint16_t usScreenDiff;
+static uint8_t ucScreenStars;
+// OLED_STATUS_* handled by the last vOledScreenProcess() and its tick count
+static uint8_t ucScreenStatus = 0xFF;
+static uint8_t ucScreenTicks;
+static const char * const cDataStars[] = { "*", "**", "***" };
 // function prototypes
-static void HAL_I2C_MemTransfer(I2C_HandleTypeDef *hi2c);
 static void OLED_WR_Byte(uint8_t dat, uint8_t cmd);
+static char cOledChartY(float value);
+static void vOledChartColumn(char pos_y, char pos_y_old, uint8_t *dat);
 static char min(char a, char b);
 static char max(char a, char b);
+static uint32_t uiSourceHR(void);
+static uint32_t uiSourceSpO2(void);
+static uint32_t uiSourceDiff(void);
+static uint32_t uiSourceHeart(void);
+static uint32_t uiSourceStars(void);
+
+static OledWidget tMax30102Widgets[] = {
+	{ OLED_WIDGET_LABEL, 0, 0, 30, 8, NULL, "Heart", NULL, 0, 0 },
+	{ OLED_WIDGET_LABEL, 33, 0, 24, 8, NULL, "Rate", NULL, 0, 0 },
+	{ OLED_WIDGET_LABEL, 60, 0, 6, 8, NULL, "&", NULL, 0, 0 },
+	{ OLED_WIDGET_LABEL, 69, 0, 48, 8, NULL, "Oximetry", NULL, 0, 0 },
+	{ OLED_WIDGET_ICON, 1, 16, 21, 24, uiSourceHeart, heart, NULL, 0, 0 },
+	{ OLED_WIDGET_BIG_NUMBER, 24, 16, 33, 24, uiSourceHR, &oled_nums_pos[0], NULL, 3, 0 },
+	{ OLED_WIDGET_ICON, 58, 32, 13, 8, NULL, bpm, NULL, 0, 0 },
+	{ OLED_WIDGET_ICON, 73, 16, 11, 24, NULL, spo2, NULL, 0, 0 },
+	{ OLED_WIDGET_BIG_NUMBER, 86, 16, 33, 24, uiSourceSpO2, &oled_nums_pos[3], NULL, 3, 0 },
+	{ OLED_WIDGET_ICON, 121, 32, 6, 8, NULL, percent, NULL, 0, 0 },
+	{ OLED_WIDGET_SPARKLINE, 0, OLED_WAVE_FIRST_PAGE * 8, SSD1306_WIDTH,
+			OLED_WAVE_PAGES * 8, uiSourceDiff, NULL, NULL, 0, 0 },
+};
+static OledScreen tMax30102Screen = { tMax30102Widgets,
+		sizeof(tMax30102Widgets) / sizeof(tMax30102Widgets[0]) };
 
-//local functions
-static void HAL_I2C_MemTransfer(I2C_HandleTypeDef *hi2c) {
-	static uint8_t y = 0;
-	static uint8_t dat = 0;
-	if (whatToDo == 4) {
-		OLED_WR_Byte(0X8D, OLED_CMD); //SET DCDC??
-		OLED_WR_Byte(0X10, OLED_CMD); //DCDC OFF
-		OLED_WR_Byte(0XAE, OLED_CMD); //DISPLAY OFF
-	} else if (whatToDo == 3) {
-		// OLED_WR_Byte((x & 0x0f), OLED_CMD); //0+?????
-		dat = 0x00;
-		HAL_I2C_Mem_Write(&oledI2c, OLED_ADDR, 0x00, I2C_MEMADD_SIZE_8BIT, &dat,
-				1, 30);
-		whatToDo = 0;
-	} else if (whatToDo == 2) {
-		// OLED_WR_Byte(((x & 0xf0) >> 4) | 0x10, OLED_CMD); //8+?????
-		dat = 0x10;
-		HAL_I2C_Mem_Write(&oledI2c, OLED_ADDR, 0x00, I2C_MEMADD_SIZE_8BIT, &dat,
-				1, 30);
-		whatToDo = 3;
-	} else if (whatToDo == 1) {
-		// OLED_WR_Byte(0xb0 + y, OLED_CMD); //b+???
-		//HAL_I2C_Mem_Write_IT(&hi2c3, OLED_ADDR, 0x00, I2C_MEMADD_SIZE_8BIT, &dat, 1);
-		dat = 0xb0 + y;
-		HAL_I2C_Mem_Write(&oledI2c, OLED_ADDR, 0x00, I2C_MEMADD_SIZE_8BIT, &dat,
-				1, 30);
-		whatToDo = 2;
-	} else if (whatToDo == 0) {
-		HAL_I2C_Mem_Write(&oledI2c, OLED_ADDR, 0x40, I2C_MEMADD_SIZE_8BIT,
-				(uint8_t *) (&oled_cache[y]), 128, 128);
-		y += 1;
-		if (y > 7) {
-			y = 0;
-		}
-		whatToDo = 1;
-	}
-}
+static OledWidget tDataWidgets[] = {
+	{ OLED_WIDGET_LABEL, 0, 0, 84, 10, NULL, "DATA SENDING", &Font_7x10, 0, 0 },
+	{ OLED_WIDGET_LABEL, 40, 14, 33, 18, uiSourceStars, cDataStars, &Font_11x18, 0, 0 },
+};
+static OledScreen tDataScreen = { tDataWidgets,
+		sizeof(tDataWidgets) / sizeof(tDataWidgets[0]) };
 
+//local functions
 static void OLED_WR_Byte(uint8_t dat, uint8_t cmd) {
 	if (cmd == OLED_CMD)
-		HAL_I2C_Mem_Write(&hi2c3, OLED_ADDR, 0x00, I2C_MEMADD_SIZE_8BIT, &dat,
-				1, 50);
+		ssd1306_I2C_Write(SSD1306_I2C_ADDR, 0x00, dat);
 	else {
-		oled_cache[point_y][point_x] = dat;
+		// page based draws go straight into the shared framebuffer
+		if (point_x < SSD1306_WIDTH && point_y < SSD1306_PAGES)
+			SSD1306_GetBuffer()[point_y * SSD1306_WIDTH + point_x] = dat;
 		point_x += 1;
 	}
 }
@@ -144,18 +161,29 @@ static char max(char a, char b) {
 static char min(char a, char b) {
 	return a < b ? a : b;
 }
+
+static uint32_t uiSourceHR(void) {
+	return ucScreenHR;
+}
+static uint32_t uiSourceSpO2(void) {
+	return ucScreenSpO2;
+}
+static uint32_t uiSourceDiff(void) {
+	return usScreenDiff;
+}
+static uint32_t uiSourceHeart(void) {
+	return usScreenDiff <= 50;
+}
+static uint32_t uiSourceStars(void) {
+	return ucScreenStars;
+}
 // Global functions
 void vWriteToScreen(I2C_HandleTypeDef *hi2c) {
-	int i = 0;
-	if( HAL_I2C_GetState(&oledI2c) != HAL_I2C_STATE_BUSY){
-		for (i = 0; i < 32; i++)
-			HAL_I2C_MemTransfer(hi2c);
-	}
+	SSD1306_UpdateScreen();
 }
 
 void vOledDisplayOff(void) {
-	whatToDo = 4;
-	HAL_I2C_MemTransfer(&oledI2c);
+	SSD1306_OFF();
 }
 
 void vOledSetPos(uint8_t x, uint8_t y) {
@@ -164,12 +192,7 @@ void vOledSetPos(uint8_t x, uint8_t y) {
 }
 
 void vOledClear(void) {
-	uint8_t i, n;
-	for (i = 0; i < 8; i++) {
-		vOledSetPos(0, i);
-		for (n = 0; n < 128; n++)
-			OLED_WR_Byte(0x00, OLED_DATA);
-	}
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
 }
 
 void vOledShowString(OledFonts font, uint8_t x, uint8_t y, uint8_t *str) {
@@ -197,34 +220,6 @@ void vOledShowString(OledFonts font, uint8_t x, uint8_t y, uint8_t *str) {
 void vOledInit(void) {
 	HAL_Delay(50);
 	SSD1306_Init();
-	OLED_WR_Byte(0xAE, OLED_CMD); //--display off
-	OLED_WR_Byte(0x00, OLED_CMD); //---????4?
-	OLED_WR_Byte(0x10, OLED_CMD); //---????4?
-	OLED_WR_Byte(0x40, OLED_CMD); //--set start line address
-	OLED_WR_Byte(0xB0, OLED_CMD); //--???
-	OLED_WR_Byte(0x81, OLED_CMD); // contract control
-	OLED_WR_Byte(0xf0, OLED_CMD); //--128
-	OLED_WR_Byte(0xA1, OLED_CMD); //set segment remap
-	OLED_WR_Byte(0xA6, OLED_CMD); //--a6??,a7??
-	OLED_WR_Byte(0xA8, OLED_CMD); //--set multiplex ratio(1 to 64)
-	OLED_WR_Byte(0x3F, OLED_CMD); //--1/32 duty
-	OLED_WR_Byte(0xC8, OLED_CMD); //c0?c8????
-	OLED_WR_Byte(0xD3, OLED_CMD); //-set display offset
-	OLED_WR_Byte(0x00, OLED_CMD); //
-	OLED_WR_Byte(0xD5, OLED_CMD); //set osc division
-	OLED_WR_Byte(0x80, OLED_CMD); //
-	OLED_WR_Byte(0xD9, OLED_CMD); //Set Pre-Charge Period
-	OLED_WR_Byte(0xF1, OLED_CMD); //
-	OLED_WR_Byte(0xDA, OLED_CMD); //set com pin configuartion
-	OLED_WR_Byte(0x12, OLED_CMD); //
-	OLED_WR_Byte(0xDB, OLED_CMD); //set Vcomh
-	OLED_WR_Byte(0x30, OLED_CMD); //
-	OLED_WR_Byte(0x8D, OLED_CMD); //set charge pump enable
-	OLED_WR_Byte(0x14, OLED_CMD); //
-	OLED_WR_Byte(0xAF, OLED_CMD); //--????,af?,ae?
-	//HAL_Delay(50);
-	vOledClear();
-	vWriteToScreen(&oledI2c);
 }
 
 //Sensor Related
@@ -301,10 +296,14 @@ void vOledShowHeart(uint8_t showOrNot) {
 }
 
 void vOledShowNum(uint8_t which, uint8_t num) {
+	vOledShowDigit(oled_nums_pos[which], 2, num);
+}
+
+// seven segment digit 10 columns wide over three pages, num 10 is blank
+void vOledShowDigit(uint8_t start, uint8_t page, uint8_t num) {
 	uint8_t dat = oled_nums[num];
-	uint8_t start = oled_nums_pos[which];
 	uint8_t i, temp;
-	vOledSetPos(start, 2);
+	vOledSetPos(start, page);
 	for (i = 0; i < 10; i++) {
 		temp = 0;
 		if (i <= 1) {
@@ -319,7 +318,7 @@ void vOledShowNum(uint8_t which, uint8_t num) {
 		}
 		OLED_WR_Byte(temp, OLED_DATA);
 	}
-	vOledSetPos(start, 3);
+	vOledSetPos(start, page + 1);
 	for (i = 0; i < 10; i++) {
 		temp = 0;
 		if (i <= 1) {
@@ -338,7 +337,7 @@ void vOledShowNum(uint8_t which, uint8_t num) {
 		}
 		OLED_WR_Byte(temp, OLED_DATA);
 	}
-	vOledSetPos(start, 4);
+	vOledSetPos(start, page + 2);
 	for (i = 0; i < 10; i++) {
 		temp = 0;
 		if (i <= 1) {
@@ -355,25 +354,38 @@ void vOledShowNum(uint8_t which, uint8_t num) {
 	}
 }
 
-void vOledDrawChart(float value) {
-	uint8_t dat[] = { 0xff, 0xff, 0xff };
+static char cOledChartY(float value) {
 	char pos_y = (char) (value * 0.12) + 10;
 	if (pos_y > 23)
 		pos_y = 23;
 	if (pos_y <= 0)
 		pos_y = 0;
-	uint8_t i, ii, blank;
+	return pos_y;
+}
+
+// dat[i] is the byte for page 7 - i of a vertical run between the two points
+static void vOledChartColumn(char pos_y, char pos_y_old, uint8_t *dat) {
+	uint8_t i;
 	uint8_t y_max = max(pos_y, pos_y_old);
 	uint8_t y_min = min(pos_y, pos_y_old);
 
 	if (y_max == y_min)
 		y_max = y_min + 1;
 	for (i = 0; i < 3; i++) {
+		dat[i] = 0xff;
 		if ((y_min - i * 8) >= 0)
 			dat[i] &= (uint8_t) (dat[i] >> (y_min - i * 8));
 		if (((i + 1) * 8 - y_max) >= 0)
 			dat[i] &= (uint8_t) (dat[i] << ((i + 1) * 8 - y_max));
 	}
+}
+
+void vOledDrawChart(float value) {
+	uint8_t dat[3];
+	char pos_y = cOledChartY(value);
+	uint8_t i, ii, blank;
+
+	vOledChartColumn(pos_y, pos_y_old, dat);
 	for (i = 0; i < 3; i++) {
 		vOledSetPos(pos_x_this, 7 - i);
 		OLED_WR_Byte(dat[i], OLED_DATA);
@@ -389,8 +401,73 @@ void vOledDrawChart(float value) {
 		pos_x_this = 0;
 }
 
+// The band is shifted left in the framebuffer and the newest column goes to
+// the right edge. The controller scroll (0x27) is not used: its step comes
+// from the panel oscillator, which cannot be kept in step with HAL_GetTick,
+// and GDDRAM must not be written while it runs. A band that is one column
+// repeated is left alone, a flat trace costs nothing once it fills the band.
+void vOledWaveformStart(void) {
+	uint8_t *fb = SSD1306_GetBuffer();
+
+	memset(&fb[OLED_WAVE_FIRST_PAGE * SSD1306_WIDTH], 0,
+			OLED_WAVE_PAGES * SSD1306_WIDTH);
+	ucWaveSame = SSD1306_WIDTH;
+	cWaveLast = cWaveMin = cWaveMax = cOledChartY(0);
+	uiWaveLastTick = HAL_GetTick();
+	ucWaveActive = 1;
+}
+
+void vOledWaveformStop(void) {
+	ucWaveActive = 0;
+}
+
+uint8_t ucOledWaveformPush(float value) {
+	uint8_t *fb = SSD1306_GetBuffer();
+	uint8_t *row;
+	uint8_t dat[3];
+	uint8_t i, same = 1;
+	uint32_t now;
+	char pos_y;
+
+	if (!ucWaveActive)
+		return 0;
+
+	// keep the envelope of everything pushed between two scroll steps
+	pos_y = cOledChartY(value);
+	cWaveMin = min(cWaveMin, pos_y);
+	cWaveMax = max(cWaveMax, pos_y);
+
+	now = HAL_GetTick();
+	if (now - uiWaveLastTick < OLED_WAVE_STEP_MS)
+		return 0;
+	uiWaveLastTick += OLED_WAVE_STEP_MS;
+	if (now - uiWaveLastTick >= OLED_WAVE_STEP_MS)
+		uiWaveLastTick = now;
+
+	// join the previous column so the trace stays continuous
+	vOledChartColumn(min(cWaveMin, cWaveLast), max(cWaveMax, cWaveLast), dat);
+	cWaveLast = cWaveMin = cWaveMax = pos_y;
+	for (i = 0; i < OLED_WAVE_PAGES; i++) {
+		if (fb[(OLED_WAVE_FIRST_PAGE + i + 1) * SSD1306_WIDTH - 1]
+				!= dat[OLED_WAVE_PAGES - 1 - i])
+			same = 0;
+	}
+	if (!same)
+		ucWaveSame = 0;
+	else if (ucWaveSame >= SSD1306_WIDTH)
+		return 0;
+	ucWaveSame++;
+
+	for (i = 0; i < OLED_WAVE_PAGES; i++) {
+		row = &fb[(OLED_WAVE_FIRST_PAGE + i) * SSD1306_WIDTH];
+		memmove(row, row + 1, SSD1306_WIDTH - 1);
+		row[SSD1306_WIDTH - 1] = dat[OLED_WAVE_PAGES - 1 - i];
+	}
+	return 1;
+}
+
 void floatToUcharArray(float dest, char *pArray) {
-	char tempBufer[2];
+	char tempBufer[12];
 	int iPart;
 	int fPart;
 
@@ -407,30 +484,18 @@ void floatToUcharArray(float dest, char *pArray) {
 int x = 0, y = 10;
 
 void vOledBlePrintData() {
-
-	static int iCharCounter = 0;
-
-	memset(tempLcdBuffer, 0, LCD_BUFFER_LENGHT);
-	SSD1306_Fill(SSD1306_COLOR_BLACK);
-	SSD1306_GotoXY(0, 0);
-	sprintf(tempLcdBuffer, (char *) "DATA SENDING");
-	SSD1306_Puts(tempLcdBuffer, &Font_7x10, SSD1306_COLOR_WHITE);
-	SSD1306_GotoXY(40, 14);
-	if (iCharCounter == 0) {
-		SSD1306_Puts((const char*) "*", &Font_11x18, SSD1306_COLOR_WHITE);
-	} else if (iCharCounter == 1) {
-		SSD1306_Puts((const char*) "**", &Font_11x18, SSD1306_COLOR_WHITE);
-	} else if (iCharCounter == 2) {
-		iCharCounter = -1;
-		SSD1306_Puts((const char*) "***", &Font_11x18, SSD1306_COLOR_WHITE);
-	}
-	SSD1306_UpdateScreen();
-	iCharCounter++;
+	if (pOledScreenCurrent() == &tDataScreen)
+		ucScreenStars = (ucScreenStars + 1) % 3;
+	else
+		ucScreenStars = 0;
+	ucOledScreenUpdate(&tDataScreen);
 }
 
 void vOledBlePrintLux(uint32_t lux) {
 	char tempBufer[10];
 
+	vOledScreenLeave();
+
 	memset(tempLcdBuffer, 0, LCD_BUFFER_LENGHT);
 	sprintf(tempLcdBuffer, (char *) "Lux: ");
 	sprintf(tempBufer, "%d", (int) lux);
@@ -446,6 +511,8 @@ void vOledBlePrintGSR(float gsr) {
 	char tempBufer[10];
 	int iGsr = gsr;
 
+	vOledScreenLeave();
+
 	if (usBpmPosX > 127 || usBpmPosX == 0) {
 		SSD1306_Fill(SSD1306_COLOR_BLACK);
 		SSD1306_UpdateScreen();
@@ -473,41 +540,43 @@ void vOledBlePrintGSR(float gsr) {
 // Max30102
 
 void vOledBleMaxInit30102(void){
-	vOledShowHeart(1);
-	vSetBPM();
-	vSetPercentage();
-	vSetSPO2();
-	vMax30102String();
+	vOledScreenEnter(&tMax30102Screen);
 }
 
 void vOledBleClearScreen(void){
+	vOledScreenLeave();
 	vOledClear();
 	vWriteToScreen(&oledI2c);
 }
 
+// only widgets whose value changed are redrawn and sent
 void vOledBlePrintMax30102(uint8_t hr, uint8_t spo2, uint16_t diff) {
-
-	if (hr % 1000 / 100 > 0)
-		vOledShowNum(0, hr % 1000 / 100);
-	else
-		vOledShowNum(0, 10);
-	vOledShowNum(1, hr % 100 / 10);
-	vOledShowNum(2, hr % 10);
-	// ????
-	if (spo2 % 1000 / 100 > 0)
-		vOledShowNum(3, spo2 % 1000 / 100);
-	else
-		vOledShowNum(3, 10);
-	vOledShowNum(4, spo2 % 100 / 10);
-	vOledShowNum(5, spo2 % 10);
-	// ???
-	//diff = usGetMax30102Diff();
-	vOledDrawChart(diff);
-	if (diff > 50)
-		vOledShowHeart(0);
-	else
-		vOledShowHeart(1);
-	vWriteToScreen(&oledI2c);
+	ucScreenHR = hr;
+	ucScreenSpO2 = spo2;
+	usScreenDiff = diff;
+	ucOledScreenUpdate(&tMax30102Screen);
+}
+// One screen is on the panel for each OLED_STATUS_*, the MAX30102 one while
+// no other is selected. Called every display period, only what changed on
+// the active screen is redrawn.
+void vOledScreenProcess(uint8_t status, uint8_t hr, uint8_t spo2,
+		uint16_t diff) {
+	if (status != ucScreenStatus)
+		ucScreenTicks = 0;
+	if (status == OLED_STATUS_SHUT_DOWN) {
+		if (ucScreenStatus != OLED_STATUS_SHUT_DOWN)
+			vOledBleClearScreen();
+	} else if (status == OLED_STATUS_BLE) {
+		// the stars step once per OLED_COUNTER_TIME_OUT periods
+		if (ucScreenTicks == 0 || ucScreenTicks >= OLED_COUNTER_TIME_OUT) {
+			vOledBlePrintData();
+			ucScreenTicks = 0;
+		}
+	} else {
+		vOledBlePrintMax30102(hr, spo2, diff);
+	}
+	ucScreenStatus = status;
+	ucScreenTicks++;
 }
 // si7021
 
@@ -520,7 +589,7 @@ void vMax30003String(void) {
 	vOledShowString(font, 102, 0, (uint8_t*) "RR ");
 }
 
-void vOledShowHR() {
+void vOledShowHR(void) {
 	uint8_t i;
 	vOledSetPos(1, 2);
 		for (i = 0; i < 21; i++) {
@@ -554,6 +623,7 @@ void vOledShowRR(void) {
 
 
 void vOledBlePrintMax30003(uint32_t ecg, uint32_t hr, uint32_t rr){
+	vOledScreenLeave();
 	vMax30003String();
 	vOledShowHR();
 	vOledShowRR();
@@ -571,6 +641,7 @@ void vOledBlePrintMax30003(uint32_t ecg, uint32_t hr, uint32_t rr){
 }
 
 void vOledBlePrintTemperature(float temperature) {
+	vOledScreenLeave();
 	memset(tempLcdBuffer, 0, LCD_BUFFER_LENGHT);
 	sprintf(tempLcdBuffer, (char *) "Temp: ");
 	floatToUcharArray(temperature, &tempLcdBuffer[6]);
@@ -581,6 +652,7 @@ void vOledBlePrintTemperature(float temperature) {
 }
 
 void vOledBlePrintSi7021(float temperature, float humidity) {
+	vOledScreenLeave();
 	memset(tempLcdBuffer, 0, LCD_BUFFER_LENGHT);
 	SSD1306_Fill(SSD1306_COLOR_BLACK);
 	sprintf(tempLcdBuffer, (char *) "Temp: ");
@@ -598,6 +670,7 @@ void vOledBlePrintSi7021(float temperature, float humidity) {
 }
 
 void vOledBlePrintHumidity(float humidity) {
+	vOledScreenLeave();
 	memset(tempLcdBuffer, 0, LCD_BUFFER_LENGHT);
 	sprintf(&tempLcdBuffer[0], (char *) "Humidity: ");
 	floatToUcharArray(humidity, &tempLcdBuffer[10]);
@@ -0,0 +1,205 @@
+#include "oled_widget.h"
+#include "oled.h"
+#include "ssd1306.h"
+
+#include <stddef.h>
+
+static OledScreen *pCurrentScreen = NULL;
+static uint32_t uiRedraws = 0;
+// invalidated pixel rectangle not yet on the panel, empty while x0 > x1
+static uint8_t ucDirtyX0 = 0xFF;
+static uint8_t ucDirtyX1 = 0;
+static uint8_t ucDirtyY0 = 0xFF;
+static uint8_t ucDirtyY1 = 0;
+
+// function prototypes
+static void vOledWidgetClear(const OledWidget *widget);
+static void vOledWidgetDraw(const OledWidget *widget);
+static void vOledWidgetInvalidate(const OledWidget *widget);
+static void vOledWidgetFlush(void);
+
+//local functions
+// clears exactly the widget rectangle, pixels of neighbours sharing a page stay
+static void vOledWidgetClear(const OledWidget *widget) {
+	uint8_t *fb = SSD1306_GetBuffer();
+	uint8_t y0 = widget->ucY;
+	uint8_t y1 = widget->ucY + widget->ucH - 1;
+	uint8_t x1 = widget->ucX + widget->ucW - 1;
+	uint8_t page, mask, x;
+
+	if (widget->ucW == 0 || widget->ucH == 0)
+		return;
+	if (x1 >= SSD1306_WIDTH)
+		x1 = SSD1306_WIDTH - 1;
+	if (y1 >= SSD1306_HEIGHT)
+		y1 = SSD1306_HEIGHT - 1;
+	for (page = y0 / 8; page <= y1 / 8; page++) {
+		mask = 0xFF;
+		if (page == y0 / 8)
+			mask &= (uint8_t) (0xFF << (y0 % 8));
+		if (page == y1 / 8)
+			mask &= (uint8_t) (0xFF >> (7 - y1 % 8));
+		for (x = widget->ucX; x <= x1; x++)
+			fb[page * SSD1306_WIDTH + x] &= (uint8_t) ~mask;
+	}
+}
+
+static void vOledWidgetDraw(const OledWidget *widget) {
+	uint8_t *fb = SSD1306_GetBuffer();
+	const uint8_t *bytes = (const uint8_t*) widget->pvArg;
+	const char *text;
+	uint32_t value = widget->uiValue;
+	uint32_t fill;
+	uint8_t digits[10];
+	uint8_t i, n, page, pages;
+
+	switch (widget->eType) {
+	case OLED_WIDGET_LABEL:
+		if (value == OLED_WIDGET_STATIC)
+			text = (const char*) widget->pvArg;
+		else
+			text = ((const char* const *) widget->pvArg)[value];
+		if (widget->pFont == NULL) {
+			vOledShowString(font6x8, widget->ucX, widget->ucY / 8,
+					(uint8_t*) text);
+		} else {
+			SSD1306_GotoXY(widget->ucX, widget->ucY);
+			SSD1306_Puts(text, widget->pFont, SSD1306_COLOR_WHITE);
+		}
+		break;
+	case OLED_WIDGET_BIG_NUMBER:
+		n = widget->uiParam;
+		if (n > sizeof(digits))
+			n = sizeof(digits);
+		for (i = n; i > 0; i--) {
+			digits[i - 1] = value % 10;
+			value /= 10;
+		}
+		// leading zeros stay blank, the last digit is always shown
+		for (i = 0; i + 1 < n && digits[i] == 0; i++)
+			digits[i] = 10;
+		for (i = 0; i < n; i++)
+			vOledShowDigit(bytes[i], widget->ucY / 8, digits[i]);
+		break;
+	case OLED_WIDGET_ICON:
+		if (value == 0)
+			break;
+		pages = widget->ucH / 8;
+		for (page = 0; page < pages; page++)
+			for (i = 0; i < widget->ucW; i++)
+				fb[(widget->ucY / 8 + page) * SSD1306_WIDTH + widget->ucX + i] =
+						bytes[page * widget->ucW + i];
+		break;
+	case OLED_WIDGET_BAR:
+		SSD1306_DrawRectangle(widget->ucX, widget->ucY, widget->ucW - 1,
+				widget->ucH - 1, SSD1306_COLOR_WHITE);
+		if (value > widget->uiParam)
+			value = widget->uiParam;
+		fill = widget->uiParam ?
+				(widget->ucW - 2) * value / widget->uiParam : 0;
+		if (fill > 0)
+			SSD1306_DrawFilledRectangle(widget->ucX + 1, widget->ucY + 1,
+					fill - 1, widget->ucH - 3, SSD1306_COLOR_WHITE);
+		break;
+	case OLED_WIDGET_SPARKLINE:
+		vOledWaveformStart();
+		break;
+	}
+}
+
+static void vOledWidgetInvalidate(const OledWidget *widget) {
+	uint8_t x1 = widget->ucX + widget->ucW - 1;
+	uint8_t y1 = widget->ucY + widget->ucH - 1;
+
+	if (widget->ucX < ucDirtyX0)
+		ucDirtyX0 = widget->ucX;
+	if (x1 > ucDirtyX1)
+		ucDirtyX1 = x1;
+	if (widget->ucY < ucDirtyY0)
+		ucDirtyY0 = widget->ucY;
+	if (y1 > ucDirtyY1)
+		ucDirtyY1 = y1;
+}
+
+// a busy bus keeps the rectangle pending for the next update
+static void vOledWidgetFlush(void) {
+	if (ucDirtyX0 > ucDirtyX1)
+		return;
+	if (!SSD1306_UpdateRect(ucDirtyX0, ucDirtyX1, ucDirtyY0 / 8,
+			ucDirtyY1 / 8))
+		return;
+	ucDirtyX0 = 0xFF;
+	ucDirtyX1 = 0;
+	ucDirtyY0 = 0xFF;
+	ucDirtyY1 = 0;
+}
+
+// Global functions
+void vOledScreenEnter(OledScreen *screen) {
+	OledWidget *widget;
+	uint8_t i;
+
+	vOledScreenLeave();
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	for (i = 0; i < screen->ucCount; i++) {
+		widget = &screen->pWidgets[i];
+		widget->uiValue =
+				widget->pfSource ? widget->pfSource() : OLED_WIDGET_STATIC;
+		vOledWidgetDraw(widget);
+		uiRedraws++;
+	}
+	ucDirtyX0 = 0;
+	ucDirtyX1 = SSD1306_WIDTH - 1;
+	ucDirtyY0 = 0;
+	ucDirtyY1 = SSD1306_HEIGHT - 1;
+	vOledWidgetFlush();
+	pCurrentScreen = screen;
+}
+
+uint8_t ucOledScreenUpdate(OledScreen *screen) {
+	OledWidget *widget;
+	uint32_t value;
+	uint8_t i, redrawn = 0;
+
+	if (screen != pCurrentScreen) {
+		vOledScreenEnter(screen);
+		return screen->ucCount;
+	}
+	for (i = 0; i < screen->ucCount; i++) {
+		widget = &screen->pWidgets[i];
+		if (widget->pfSource == NULL)
+			continue;
+		value = widget->pfSource();
+		if (widget->eType == OLED_WIDGET_SPARKLINE) {
+			if (ucOledWaveformPush((float) value)) {
+				vOledWidgetInvalidate(widget);
+				uiRedraws++;
+				redrawn++;
+			}
+			continue;
+		}
+		if (value == widget->uiValue)
+			continue;
+		widget->uiValue = value;
+		vOledWidgetClear(widget);
+		vOledWidgetDraw(widget);
+		vOledWidgetInvalidate(widget);
+		uiRedraws++;
+		redrawn++;
+	}
+	vOledWidgetFlush();
+	return redrawn;
+}
+
+void vOledScreenLeave(void) {
+	vOledWaveformStop();
+	pCurrentScreen = NULL;
+}
+
+OledScreen *pOledScreenCurrent(void) {
+	return pCurrentScreen;
+}
+
+uint32_t uiOledScreenRedraws(void) {
+	return uiRedraws;
+}
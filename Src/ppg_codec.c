@@ -0,0 +1,218 @@
+/*
+ * ppg_codec.c
+ *
+ * Block delta coder for the PPG stream, see ppg_codec.h for the format.
+ * A block of 8 pairs is sized with a handful of shifts and compares per
+ * sample, no division, no tables.
+ */
+
+#include "ppg_codec.h"
+
+#define PPG_CODEC_ESCAPE(w) ((1UL << (w)) - 1)
+
+// local function prototypes
+static uint32_t uiPpgCodecZigzag(uint32_t cur, uint32_t prev);
+static uint8_t ucPpgCodecBitLen(uint32_t value);
+static uint16_t usPpgCodecWidth(const uint32_t *samples, uint8_t n,
+		uint32_t prev, uint8_t *width);
+static uint16_t usPpgCodecPutChannel(uint8_t *buf, uint16_t bit, uint8_t width,
+		uint32_t sample, uint32_t prev);
+static uint8_t ucPpgCodecGetChannel(const uint8_t *buf, uint16_t *bit,
+		uint16_t bits, uint8_t width, uint32_t *sample);
+
+//local functions
+// samples wider than 18 bits are cut to their low 18, the widths stay <= 19
+static uint32_t uiPpgCodecZigzag(uint32_t cur, uint32_t prev) {
+	int32_t delta = (int32_t) (cur & PPG_CODEC_SAMPLE_MASK)
+			- (int32_t) (prev & PPG_CODEC_SAMPLE_MASK);
+
+	return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+static uint8_t ucPpgCodecBitLen(uint32_t value) {
+	return value ? 32 - __builtin_clz(value) : 0;
+}
+
+/*
+ * A code of length l = bitlen(zz + 1) fits a width w >= l, below that it is
+ * an escape. The best width is therefore one of the lengths seen, each one is
+ * tried, returns the bits of the channel at that width.
+ */
+static uint16_t usPpgCodecWidth(const uint32_t *samples, uint8_t n,
+		uint32_t prev, uint8_t *width) {
+	uint8_t len[PPG_CODEC_BLOCK];
+	uint8_t i, j, w, longest = 0;
+	uint16_t bits, best = 0xFFFF;
+
+	for (i = 0; i < n; i++) {
+		len[i] = ucPpgCodecBitLen(uiPpgCodecZigzag(samples[i], prev) + 1);
+		prev = samples[i];
+		if (len[i] > longest)
+			longest = len[i];
+	}
+	// only zero deltas, nothing but the width goes out
+	if (longest == 1) {
+		*width = 0;
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		w = len[i];
+		bits = (uint16_t) n * w;
+		for (j = 0; j < n; j++) {
+			if (len[j] > w)
+				bits += PPG_CODEC_SAMPLE_BITS;
+		}
+		if (bits < best || (bits == best && w > *width)) {
+			best = bits;
+			*width = w;
+		}
+	}
+	return best;
+}
+
+static uint16_t usPpgCodecPutChannel(uint8_t *buf, uint16_t bit, uint8_t width,
+		uint32_t sample, uint32_t prev) {
+	uint32_t zz;
+
+	if (width == 0)
+		return bit;
+	zz = uiPpgCodecZigzag(sample, prev);
+	if (zz >= PPG_CODEC_ESCAPE(width)) {
+		vPpgCodecPut(buf, bit, width, PPG_CODEC_ESCAPE(width));
+		bit += width;
+		vPpgCodecPut(buf, bit, PPG_CODEC_SAMPLE_BITS, sample);
+		return bit + PPG_CODEC_SAMPLE_BITS;
+	}
+	vPpgCodecPut(buf, bit, width, zz);
+	return bit + width;
+}
+
+// *sample holds the previous sample on entry, returns 0 past the end of the body
+static uint8_t ucPpgCodecGetChannel(const uint8_t *buf, uint16_t *bit,
+		uint16_t bits, uint8_t width, uint32_t *sample) {
+	uint32_t zz;
+
+	if (width == 0)
+		return 1;
+	if (*bit + width > bits)
+		return 0;
+	zz = uiPpgCodecGet(buf, *bit, width);
+	*bit += width;
+	if (zz == PPG_CODEC_ESCAPE(width)) {
+		if (*bit + PPG_CODEC_SAMPLE_BITS > bits)
+			return 0;
+		*sample = uiPpgCodecGet(buf, *bit, PPG_CODEC_SAMPLE_BITS);
+		*bit += PPG_CODEC_SAMPLE_BITS;
+		return 1;
+	}
+	*sample += (zz >> 1) ^ (0 - (zz & 1));
+	return 1;
+}
+
+// Global Function Definitions
+// ORs the value in, the buffer has to be zeroed
+void vPpgCodecPut(uint8_t *buf, uint16_t bit, uint8_t width, uint32_t value) {
+	uint8_t room, take;
+
+	while (width) {
+		room = 8 - (bit & 7);
+		take = width < room ? width : room;
+		buf[bit >> 3] |= ((value >> (width - take)) & ((1U << take) - 1))
+				<< (room - take);
+		bit += take;
+		width -= take;
+	}
+}
+
+uint32_t uiPpgCodecGet(const uint8_t *buf, uint16_t bit, uint8_t width) {
+	uint8_t room, take;
+	uint32_t value = 0;
+
+	while (width) {
+		room = 8 - (bit & 7);
+		take = width < room ? width : room;
+		value = (value << take)
+				| ((buf[bit >> 3] >> (room - take)) & ((1U << take) - 1));
+		bit += take;
+		width -= take;
+	}
+	return value;
+}
+
+uint16_t usPpgCodecPutBase(uint8_t *buf, uint16_t bit, uint32_t red,
+		uint32_t ired) {
+	vPpgCodecPut(buf, bit, PPG_CODEC_SAMPLE_BITS, red);
+	vPpgCodecPut(buf, bit + PPG_CODEC_SAMPLE_BITS, PPG_CODEC_SAMPLE_BITS, ired);
+	return bit + PPG_CODEC_BASE_BITS;
+}
+
+// bits a block of n pairs takes, header included, and the widths it will use
+uint16_t usPpgCodecBlockBits(const uint32_t *red, const uint32_t *ired,
+		uint8_t n, uint32_t prevRed, uint32_t prevIred, uint8_t *wRed,
+		uint8_t *wIred) {
+	return PPG_CODEC_BLOCK_HEADER_BITS + usPpgCodecWidth(red, n, prevRed, wRed)
+			+ usPpgCodecWidth(ired, n, prevIred, wIred);
+}
+
+// widths from usPpgCodecBlockBits(), returns the bit after the block
+uint16_t usPpgCodecPutBlock(uint8_t *buf, uint16_t bit, const uint32_t *red,
+		const uint32_t *ired, uint8_t n, uint8_t wRed, uint8_t wIred,
+		uint32_t *prevRed, uint32_t *prevIred) {
+	uint8_t i;
+
+	vPpgCodecPut(buf, bit, PPG_CODEC_LEN_BITS, n - 1);
+	bit += PPG_CODEC_LEN_BITS;
+	vPpgCodecPut(buf, bit, PPG_CODEC_WIDTH_BITS, wRed);
+	bit += PPG_CODEC_WIDTH_BITS;
+	vPpgCodecPut(buf, bit, PPG_CODEC_WIDTH_BITS, wIred);
+	bit += PPG_CODEC_WIDTH_BITS;
+	for (i = 0; i < n; i++) {
+		bit = usPpgCodecPutChannel(buf, bit, wRed, red[i], *prevRed);
+		bit = usPpgCodecPutChannel(buf, bit, wIred, ired[i], *prevIred);
+		*prevRed = red[i];
+		*prevIred = ired[i];
+	}
+	return bit;
+}
+
+// reference decoder, returns count or 0 when the body is short or malformed
+uint8_t ucPpgCodecDecode(const uint8_t *buf, uint16_t bits, uint8_t count,
+		uint32_t *red, uint32_t *ired) {
+	uint16_t bit = 0;
+	uint32_t r, ir;
+	uint8_t pairs, n, wRed, wIred, i;
+
+	if (count == 0)
+		return 0;
+	if (bits < PPG_CODEC_BASE_BITS)
+		return 0;
+	r = uiPpgCodecGet(buf, 0, PPG_CODEC_SAMPLE_BITS);
+	ir = uiPpgCodecGet(buf, PPG_CODEC_SAMPLE_BITS, PPG_CODEC_SAMPLE_BITS);
+	bit = PPG_CODEC_BASE_BITS;
+	red[0] = r;
+	ired[0] = ir;
+	pairs = 1;
+
+	while (pairs < count) {
+		if (bit + PPG_CODEC_BLOCK_HEADER_BITS > bits)
+			return 0;
+		n = uiPpgCodecGet(buf, bit, PPG_CODEC_LEN_BITS) + 1;
+		bit += PPG_CODEC_LEN_BITS;
+		wRed = uiPpgCodecGet(buf, bit, PPG_CODEC_WIDTH_BITS);
+		bit += PPG_CODEC_WIDTH_BITS;
+		wIred = uiPpgCodecGet(buf, bit, PPG_CODEC_WIDTH_BITS);
+		bit += PPG_CODEC_WIDTH_BITS;
+		if (wRed > PPG_CODEC_WIDTH_MAX || wIred > PPG_CODEC_WIDTH_MAX
+				|| pairs + n > count)
+			return 0;
+		for (i = 0; i < n; i++) {
+			if (!ucPpgCodecGetChannel(buf, &bit, bits, wRed, &r)
+					|| !ucPpgCodecGetChannel(buf, &bit, bits, wIred, &ir))
+				return 0;
+			red[pairs] = r;
+			ired[pairs] = ir;
+			pairs++;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,307 @@
+/*
+ * ppg_stream.c
+ *
+ * PPG frames for the DATA characteristic, see ppg_stream.h for the layout.
+ * Samples are pushed from the sensor read in the main loop and frames are
+ * taken by the notification task, both run in thread mode so no locking.
+ */
+
+#include "ppg_stream.h"
+
+#include <string.h>
+
+#define PPG_STREAM_PERIOD_MS (1000 / PPG_STREAM_RATE_HZ)
+// the count field is 7 bits
+#define PPG_STREAM_CODED_PAIRS_MAX PPG_STREAM_COUNT_MASK
+// encode time from DWT->CYCCNT unless the build brings its own clock
+#ifndef PPG_STREAM_CYCLES
+#define PPG_STREAM_CYCLES() (DWT->CYCCNT)
+#define PPG_STREAM_CYCLES_START() do { \
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+	} while (0)
+#endif
+
+static uint8_t aFrames[PPG_STREAM_FRAMES][PPG_STREAM_FRAME_MAX];
+static uint16_t ausFrameLen[PPG_STREAM_FRAMES];
+static uint8_t ucRead = 0;     // oldest closed frame
+static uint8_t ucReady = 0;    // closed frames waiting to be sent
+static uint8_t ucActive = 0;
+static uint16_t usFrameSize;
+static uint8_t ucFramePairs;   // raw pairs that fit in usFrameSize
+static uint8_t ucPairs;        // pairs in the frame being filled
+static uint16_t usBit;         // write position in the frame being filled
+static uint16_t usSeq;
+static uint32_t uiFirstTick;
+static void (*pfFrameReady)(void);
+static PpgStreamStats tStats;
+#if (PPG_STREAM_DELTA_CODED != 0)
+// pairs waiting to be coded as one block, and the pair the next delta is taken from
+static uint32_t auiBlockRed[PPG_CODEC_BLOCK];
+static uint32_t auiBlockIred[PPG_CODEC_BLOCK];
+static uint8_t ucBlockLen;
+static uint8_t ucBlockMax;     // small frames take small blocks, one block never spills over many frames
+static uint32_t uiBlockTick;
+static uint32_t uiPrevRed;
+static uint32_t uiPrevIred;
+#endif
+
+// local function prototypes
+static uint8_t *pPpgStreamFill(void);
+static void vPpgStreamOpen(void);
+static void vPpgStreamClose(void);
+static uint8_t ucPpgStreamPending(void);
+static uint32_t uiPpgStreamAge(void);
+static void vPpgStreamFlush(void);
+#if (PPG_STREAM_DELTA_CODED != 0)
+static void vPpgStreamEncode(void);
+#endif
+
+//local functions
+static uint8_t *pPpgStreamFill(void) {
+	return aFrames[(ucRead + ucReady) % PPG_STREAM_FRAMES];
+}
+
+static void vPpgStreamOpen(void) {
+	memset(pPpgStreamFill(), 0, usFrameSize);
+	ucPairs = 0;
+	usBit = PPG_STREAM_HEADER_SIZE * 8;
+}
+
+static void vPpgStreamClose(void) {
+	uint8_t *frame = pPpgStreamFill();
+
+	frame[0] = usSeq >> 8;
+	frame[1] = usSeq;
+	frame[2] = uiFirstTick >> 24;
+	frame[3] = uiFirstTick >> 16;
+	frame[4] = uiFirstTick >> 8;
+	frame[5] = uiFirstTick;
+#if (PPG_STREAM_DELTA_CODED != 0)
+	frame[6] = ucPairs | PPG_STREAM_CODED;
+#else
+	frame[6] = ucPairs;
+#endif
+	frame[7] = PPG_STREAM_RATE_HZ;
+	ausFrameLen[(ucRead + ucReady) % PPG_STREAM_FRAMES] = (usBit + 7) / 8;
+	usSeq++;
+	tStats.uiFrames++;
+	tStats.uiBodyBits += usBit - PPG_STREAM_HEADER_SIZE * 8;
+
+	// all slots taken, the oldest frame goes and its sequence number is the gap
+	if (++ucReady == PPG_STREAM_FRAMES) {
+		ucRead = (ucRead + 1) % PPG_STREAM_FRAMES;
+		ucReady--;
+		tStats.uiDropped++;
+	}
+	vPpgStreamOpen();
+	if (pfFrameReady)
+		pfFrameReady();
+}
+
+// samples pushed but not in a closed frame yet
+static uint8_t ucPpgStreamPending(void) {
+#if (PPG_STREAM_DELTA_CODED != 0)
+	return ucPairs + ucBlockLen;
+#else
+	return ucPairs;
+#endif
+}
+
+// age of the oldest pending sample
+static uint32_t uiPpgStreamAge(void) {
+#if (PPG_STREAM_DELTA_CODED != 0)
+	if (ucPairs == 0)
+		return HAL_GetTick() - uiBlockTick;
+#endif
+	return HAL_GetTick() - uiFirstTick;
+}
+
+// everything pending goes out, in as many frames as it takes
+static void vPpgStreamFlush(void) {
+#if (PPG_STREAM_DELTA_CODED != 0)
+	vPpgStreamEncode();
+#endif
+	if (ucPairs)
+		vPpgStreamClose();
+}
+
+#if (PPG_STREAM_DELTA_CODED != 0)
+/*
+ * Codes the pending block into the frame being filled. A frame starts with a
+ * raw base pair, a block that does not fit is cut to what does and the rest
+ * opens the next frame. The tick of a pair that opens a frame out of the
+ * middle of a block is taken from the sample rate.
+ */
+static void vPpgStreamEncode(void) {
+	uint8_t *frame = pPpgStreamFill();
+	uint32_t start = PPG_STREAM_CYCLES();
+	uint16_t room;
+	uint8_t k = 0, n, wRed = 0, wIred = 0;
+
+	while (k < ucBlockLen) {
+		if (ucPairs == 0) {
+			uiFirstTick = uiBlockTick + k * PPG_STREAM_PERIOD_MS;
+			usBit = usPpgCodecPutBase(frame, usBit, auiBlockRed[k],
+					auiBlockIred[k]);
+			uiPrevRed = auiBlockRed[k];
+			uiPrevIred = auiBlockIred[k];
+			ucPairs = 1;
+			k++;
+			continue;
+		}
+		n = ucBlockLen - k;
+		if (n > PPG_STREAM_CODED_PAIRS_MAX - ucPairs)
+			n = PPG_STREAM_CODED_PAIRS_MAX - ucPairs;
+		room = usFrameSize * 8 - usBit;
+		while (n && usPpgCodecBlockBits(&auiBlockRed[k], &auiBlockIred[k], n,
+				uiPrevRed, uiPrevIred, &wRed, &wIred) > room)
+			n--;
+		if (n == 0) {
+			vPpgStreamClose();
+			frame = pPpgStreamFill();
+			continue;
+		}
+		usBit = usPpgCodecPutBlock(frame, usBit, &auiBlockRed[k],
+				&auiBlockIred[k], n, wRed, wIred, &uiPrevRed, &uiPrevIred);
+		ucPairs += n;
+		k += n;
+		if (ucPairs == PPG_STREAM_CODED_PAIRS_MAX) {
+			vPpgStreamClose();
+			frame = pPpgStreamFill();
+		}
+	}
+	ucBlockLen = 0;
+	tStats.uiEncodeCycles += PPG_STREAM_CYCLES() - start;
+}
+#endif
+
+// Global Function Definitions
+void vPpgStreamStart(uint16_t frameSize, void (*pfReady)(void)) {
+	if (frameSize > PPG_STREAM_FRAME_MAX)
+		frameSize = PPG_STREAM_FRAME_MAX;
+	if (frameSize < PPG_STREAM_FRAME_MIN)
+		frameSize = PPG_STREAM_FRAME_MIN;
+	usFrameSize = frameSize;
+	ucFramePairs = PPG_STREAM_PAIRS(frameSize);
+#if (PPG_STREAM_DELTA_CODED != 0)
+	ucBlockMax = ucFramePairs < PPG_CODEC_BLOCK ? ucFramePairs : PPG_CODEC_BLOCK;
+#endif
+	pfFrameReady = pfReady;
+	ucRead = 0;
+	ucReady = 0;
+	usSeq = 0;
+	memset(&tStats, 0, sizeof(tStats));
+#if (PPG_STREAM_DELTA_CODED != 0)
+	ucBlockLen = 0;
+	// start the cycle counter if the debugger did not
+	PPG_STREAM_CYCLES_START();
+#endif
+	vPpgStreamOpen();
+	ucActive = 1;
+}
+
+// a partial frame goes out at the old size, the sequence numbers carry on
+void vPpgStreamResize(uint16_t frameSize) {
+	if (frameSize > PPG_STREAM_FRAME_MAX)
+		frameSize = PPG_STREAM_FRAME_MAX;
+	if (frameSize < PPG_STREAM_FRAME_MIN)
+		frameSize = PPG_STREAM_FRAME_MIN;
+	if (frameSize == usFrameSize)
+		return;
+	if (ucActive)
+		vPpgStreamFlush();
+	usFrameSize = frameSize;
+	ucFramePairs = PPG_STREAM_PAIRS(frameSize);
+#if (PPG_STREAM_DELTA_CODED != 0)
+	ucBlockMax = ucFramePairs < PPG_CODEC_BLOCK ? ucFramePairs : PPG_CODEC_BLOCK;
+#endif
+	if (ucActive)
+		vPpgStreamOpen();
+}
+
+void vPpgStreamStop(void) {
+	ucActive = 0;
+	ucReady = 0;
+}
+
+void vPpgStreamPush(uint32_t red, uint32_t ired) {
+	if (!ucActive)
+		return;
+	tStats.uiSamples++;
+#if (PPG_STREAM_DELTA_CODED != 0)
+	if (ucBlockLen == 0)
+		uiBlockTick = HAL_GetTick();
+	auiBlockRed[ucBlockLen] = red;
+	auiBlockIred[ucBlockLen] = ired;
+	if (++ucBlockLen >= ucBlockMax)
+		vPpgStreamEncode();
+#else
+	if (ucPairs == 0)
+		uiFirstTick = HAL_GetTick();
+	vPpgCodecPut(pPpgStreamFill(), usBit, PPG_STREAM_SAMPLE_BITS, red);
+	vPpgCodecPut(pPpgStreamFill(), usBit + PPG_STREAM_SAMPLE_BITS,
+			PPG_STREAM_SAMPLE_BITS, ired);
+	usBit += PPG_STREAM_PAIR_BITS;
+	ucPairs++;
+	if (ucPairs >= ucFramePairs)
+		vPpgStreamClose();
+#endif
+
+	if (ucPpgStreamPending() && uiPpgStreamAge() >= PPG_STREAM_DEADLINE_MS)
+		vPpgStreamFlush();
+}
+
+// sends a partial frame once it is past its deadline, for when samples stop
+void vPpgStreamPoll(void) {
+	if (ucActive && ucPpgStreamPending()
+			&& uiPpgStreamAge() >= PPG_STREAM_DEADLINE_MS)
+		vPpgStreamFlush();
+}
+
+uint8_t *pPpgStreamPeek(uint16_t *len) {
+	if (!ucActive || ucReady == 0)
+		return NULL;
+	*len = ausFrameLen[ucRead];
+	return aFrames[ucRead];
+}
+
+void vPpgStreamRelease(void) {
+	if (ucReady == 0)
+		return;
+	ucRead = (ucRead + 1) % PPG_STREAM_FRAMES;
+	ucReady--;
+}
+
+void vPpgStreamGetStats(PpgStreamStats *stats) {
+	*stats = tStats;
+}
+
+// reference decoder for the central side, returns the number of pairs read
+uint8_t ucPpgStreamDecode(const uint8_t *frame, uint16_t len,
+		PpgStreamHeader *header, uint32_t *red, uint32_t *ired) {
+	uint16_t bit = PPG_STREAM_HEADER_SIZE * 8;
+	uint8_t i;
+
+	if (len < PPG_STREAM_HEADER_SIZE)
+		return 0;
+	header->usSeq = ((uint16_t) frame[0] << 8) | frame[1];
+	header->uiTimestamp = ((uint32_t) frame[2] << 24)
+			| ((uint32_t) frame[3] << 16) | ((uint32_t) frame[4] << 8)
+			| frame[5];
+	header->ucCount = frame[6] & PPG_STREAM_COUNT_MASK;
+	header->ucCoded = (frame[6] & PPG_STREAM_CODED) != 0;
+	header->ucRate = frame[7];
+	if (header->ucCoded)
+		return ucPpgCodecDecode(frame + PPG_STREAM_HEADER_SIZE,
+				(len - PPG_STREAM_HEADER_SIZE) * 8, header->ucCount, red, ired);
+	if (header->ucCount > PPG_STREAM_PAIRS(len))
+		return 0;
+	for (i = 0; i < header->ucCount; i++) {
+		red[i] = uiPpgCodecGet(frame, bit, PPG_STREAM_SAMPLE_BITS);
+		ired[i] = uiPpgCodecGet(frame, bit + PPG_STREAM_SAMPLE_BITS,
+				PPG_STREAM_SAMPLE_BITS);
+		bit += PPG_STREAM_PAIR_BITS;
+	}
+	return header->ucCount;
+}
@@ -0,0 +1,172 @@
+/*
+ * sch_periodic.c
+ *
+ * Release times, earliest deadline pick and miss counting, see
+ * sch_periodic.h. Thread mode only, the timer callback just posts the task
+ * that calls uiSchPeriodicRelease().
+ */
+
+#include "sch_periodic.h"
+#include <stddef.h>
+
+typedef struct {
+	uint8_t ucTask;
+	uint8_t ucEnabled;
+	uint8_t ucPending;   // released, not run to the end yet
+	uint32_t uiPeriod;
+	uint32_t uiDeadline; // relative to the release
+	uint32_t uiRelease;  // of the pending job
+	uint32_t uiNext;     // next release
+	SchPeriodicStats tStats;
+} SchPeriodicEntry;
+
+static SchPeriodicEntry aEntries[SCH_PERIODIC_MAX];
+static uint8_t ucEntries = 0;
+static uint32_t uiMask = 0;          // bit ucTask set for each entry
+
+// local function prototypes
+static SchPeriodicEntry *pSchPeriodicFind(uint8_t ucTask);
+
+//local functions
+static SchPeriodicEntry *pSchPeriodicFind(uint8_t ucTask) {
+	uint8_t i;
+
+	if (ucTask > 31 || !((uiMask >> ucTask) & 1))
+		return NULL;
+	for (i = 0; i < ucEntries; i++) {
+		if (aEntries[i].ucTask == ucTask)
+			return &aEntries[i];
+	}
+	return NULL;
+}
+
+// Global Function Definitions
+void vSchPeriodicInit(void) {
+	ucEntries = 0;
+	uiMask = 0;
+}
+
+// returns 0 when the table is full, the task starts disabled
+uint8_t ucSchPeriodicRegister(uint8_t ucTask, uint32_t uiPeriod, uint32_t uiDeadline) {
+	SchPeriodicEntry *e;
+
+	if (ucEntries == SCH_PERIODIC_MAX || ucTask > 31 || uiPeriod == 0
+			|| pSchPeriodicFind(ucTask) != NULL)
+		return 0;
+	e = &aEntries[ucEntries++];
+	e->ucTask = ucTask;
+	e->ucEnabled = 0;
+	e->ucPending = 0;
+	e->uiPeriod = uiPeriod;
+	e->uiDeadline = uiDeadline;
+	e->uiRelease = 0;
+	e->uiNext = 0;
+	e->tStats.uiReleases = 0;
+	e->tStats.uiMisses = 0;
+	e->tStats.uiLatencyMax = 0;
+	e->tStats.uiResponseMax = 0;
+	uiMask |= 1UL << ucTask;
+	return 1;
+}
+
+// the first release is one period after enabling, an enabled task keeps its phase
+void vSchPeriodicEnable(uint8_t ucTask, uint8_t ucEnable, uint32_t uiNow) {
+	SchPeriodicEntry *e = pSchPeriodicFind(ucTask);
+
+	if (e == NULL || e->ucEnabled == ucEnable)
+		return;
+	e->ucEnabled = ucEnable;
+	e->ucPending = 0;
+	e->uiNext = uiNow + e->uiPeriod;
+}
+
+// returns the task bits released at uiNow
+uint32_t uiSchPeriodicRelease(uint32_t uiNow) {
+	SchPeriodicEntry *e;
+	uint32_t bits = 0;
+	uint8_t i;
+
+	for (i = 0; i < ucEntries; i++) {
+		e = &aEntries[i];
+		if (!e->ucEnabled || (int32_t) (uiNow - e->uiNext) < 0)
+			continue;
+		if (e->ucPending)
+			e->tStats.uiMisses++;
+		e->ucPending = 1;
+		e->uiRelease = e->uiNext;
+		e->tStats.uiReleases++;
+		e->uiNext += e->uiPeriod;
+		while ((int32_t) (uiNow - e->uiNext) >= 0) {
+			e->tStats.uiMisses++;
+			e->uiNext += e->uiPeriod;
+		}
+		bits |= 1UL << e->ucTask;
+	}
+	return bits;
+}
+
+// ms from uiNow to the next release, 0 when one is due
+uint32_t uiSchPeriodicNext(uint32_t uiNow) {
+	uint32_t next = SCH_PERIODIC_IDLE, left;
+	uint8_t i;
+
+	for (i = 0; i < ucEntries; i++) {
+		if (!aEntries[i].ucEnabled)
+			continue;
+		if ((int32_t) (aEntries[i].uiNext - uiNow) <= 0)
+			return 0;
+		left = aEntries[i].uiNext - uiNow;
+		if (left < next)
+			next = left;
+	}
+	return next;
+}
+
+// task to run among uiReady, SCH_PERIODIC_NONE leaves the choice to the round robin
+uint8_t ucSchPeriodicPick(uint32_t uiReady) {
+	SchPeriodicEntry *best = NULL, *e;
+	uint8_t i;
+
+	if (uiReady & ~uiMask)
+		return SCH_PERIODIC_NONE;
+	for (i = 0; i < ucEntries; i++) {
+		e = &aEntries[i];
+		if (!((uiReady >> e->ucTask) & 1) || !e->ucPending)
+			continue;
+		if (best == NULL || (int32_t) ((e->uiRelease + e->uiDeadline)
+				- (best->uiRelease + best->uiDeadline)) < 0)
+			best = e;
+	}
+	return best != NULL ? best->ucTask : SCH_PERIODIC_NONE;
+}
+
+void vSchPeriodicStart(uint8_t ucTask, uint32_t uiNow) {
+	SchPeriodicEntry *e = pSchPeriodicFind(ucTask);
+
+	if (e == NULL || !e->ucPending)
+		return;
+	if (uiNow - e->uiRelease > e->tStats.uiLatencyMax)
+		e->tStats.uiLatencyMax = uiNow - e->uiRelease;
+}
+
+void vSchPeriodicDone(uint8_t ucTask, uint32_t uiNow) {
+	SchPeriodicEntry *e = pSchPeriodicFind(ucTask);
+
+	if (e == NULL || !e->ucPending)
+		return;
+	e->ucPending = 0;
+	if (uiNow - e->uiRelease > e->tStats.uiResponseMax)
+		e->tStats.uiResponseMax = uiNow - e->uiRelease;
+	if (uiNow - e->uiRelease > e->uiDeadline)
+		e->tStats.uiMisses++;
+}
+
+// returns 0 for a task not registered here
+uint8_t ucSchPeriodicGetStats(uint8_t ucTask, SchPeriodicStats *pStats) {
+	SchPeriodicEntry *e = pSchPeriodicFind(ucTask);
+
+	if (e == NULL)
+		return 0;
+	*pStats = e->tStats;
+	return 1;
+}
@@ -10,6 +10,13 @@
 #include "main.h"
 #include "max30102.h"
 #include "oled.h"
+#include "ppg_stream.h"
+#include "app_ble.h"
+#include "app_entry.h"
+#include "notify_queue.h"
+#include "notify_sched.h"
+#include "history.h"
+#include "cycle_prof.h"
 /* Private typedef -----------------------------------------------------------*/
 typedef union {
 	uint8_t uc[4];
@@ -62,7 +69,9 @@ typedef struct {
 } SMART_WATCH_VCNL4010CharValue_t;
 
 typedef struct {
-	uint8_t ucNotificationStatus;
+	uint16_t usNotificationMask; /* bit SWITCH_x set while any central subscribes to it */
+	uint8_t ucNotifyPending;    /* link slots the queue head has still to reach */
+	uint8_t ucNotifyRetry;      /* the queue head was refused, resend to ucNotifyPending only */
 	uint16_t usParameter;
 	SMART_WATCH_MotionCharValue_t tMotion;
 	SMART_WATCH_FlashCharValue_t tFlash;
@@ -77,7 +86,8 @@ typedef struct {
 	uint8_t ucUpdate_GSR_Id;
 	uint8_t ucUpdate_HR_Id;
 	//uint8_t ucUpdate_SPO2_Id;
-	uint8_t ucUpdate_Data_Id;
+	uint8_t ucHrAlarm;          /* HR above MAX_BPM_THRESHOLD at the last tick */
+	uint16_t usDataPayloadMax;
 } SMART_WATCH_App_Context_t;
 
 #define EGR_CHANGE_PERIOD        (0.1*1000*1000/CFG_TS_TICK_VAL) /*100ms*/
@@ -88,6 +98,10 @@ typedef struct {
 #define HR_CHANGE_PERIOD (0.1*1000*1000/CFG_TS_TICK_VAL) /*100ms*/
 #define SPO2_CHANGE_PERIOD (0.1*1000*1000/CFG_TS_TICK_VAL) /*100ms*/
 #define DATA_CHANGE_PERIOD (0.1*1000*1000/CFG_TS_TICK_VAL)*2 /*100ms*/
+/* One tick drives every notification, periods below are in ms */
+#define NOTIFY_TICK_PERIOD 100 /*ms, also the deadline*/
+#define DATA_PERIOD_MS 200
+#define HR_PERIOD_MS 1000
 
 #define BLE_SWITCH_THRESHOLD 4
 #define OFFSET_DATA_HUMIDTY 0
@@ -111,6 +125,20 @@ typedef struct {
 #define OFFSET_CUM_PULSE OFFSET_SPO2+4
 #define OFFSET_PULSE_COUNTER OFFSET_CUM_PULSE+4
 
+#if (SMART_WATCH_DATA_STREAM_PPG != 0) && (PPG_STREAM_FRAME_MAX > SMART_WATCH_DATA_CHAR_SIZE)
+#error "PPG frames do not fit the DATA characteristic"
+#endif
+#if (SMART_WATCH_DATA_STREAM_PPG != 0) && (PPG_STREAM_FRAME_MAX > NOTIFY_QUEUE_VALUE_MAX)
+#error "PPG frames do not fit a notification queue slot"
+#endif
+
+#if (SMART_WATCH_HISTORY_CHARS != 0) && (SMART_WATCH_HISTORY_CHAR_SIZE > NOTIFY_QUEUE_VALUE_MAX)
+#error "History frames do not fit a notification queue slot"
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0) && (HISTORY_STATUS_SIZE > SMART_WATCH_HISTORY_CP_CHAR_SIZE)
+#error "The history status does not fit SMART_WATCH_HISTORY_CP_CHAR_SIZE"
+#endif
+
 #define OFFSET_EGR_ECG 0
 #define OFFSET_EGR_RR OFFSET_EGR_ECG+4
 /**
@@ -134,19 +162,30 @@ static void SMART_WATCH_Send_Notification_Task(void);
 //static void SMART_WATCH_GSR_Timer_Callback(void);
 //static void SMART_WATCH_HR_Timer_Callback(void);
 //static void SMART_WATCH_SPO2_Timer_Callback(void);
-static void SMART_WATCH_DATA_Timer_Callback(void);
+static void SMART_WATCH_Subscribe(uint16_t usChar, uint8_t ucEnable);
+static uint16_t SMART_WATCH_Produce_Data(uint8_t *pValue, uint16_t usMax);
+#if (SMART_WATCH_HR_CHAR != 0)
+static uint16_t SMART_WATCH_Produce_HR(uint8_t *pValue, uint16_t usMax);
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+static uint16_t SMART_WATCH_Produce_History(uint8_t *pValue, uint16_t usMax);
+#endif
+static uint8_t SMART_WATCH_Notify_Send(uint16_t usChar, uint8_t *pData, uint16_t usLength);
+static void SMART_WATCH_Notify_Done(tBleStatus status);
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+static void SMART_WATCH_PPG_Frame_Ready(void);
+#endif
+#if (SMART_WATCH_DIAG_CHAR != 0) && (CFG_CYCLE_PROF != 0)
+static void SMART_WATCH_Prof_Print(uint8_t ucId, const char *pName, const CycleProfEntry *pEntry);
+#endif
 /* Public functions ----------------------------------------------------------*/
 void SMART_WATCH_STM_App_Notification_EGR(SMART_WATCH_STM_App_Notification_evt_t *pNotification) {
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_EGR_Id,EGR_CHANGE_PERIOD );//TEMPERATURE_CHANGE_PERIOD
+		SMART_WATCH_Subscribe(SWITCH_EGR, 1);
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_EGR_Id);
+		SMART_WATCH_Subscribe(SWITCH_EGR, 0);
 		break; /* NOTIFY_DISABLED_EVT */
 	case SMART_WATCH_STM_WRITE_EVT:
 		if (pNotification->DataTransfered.pPayload[0] == 0x00) {
@@ -161,14 +200,10 @@ void SMART_WATCH_STM_App_Notification_EGR(SMART_WATCH_STM_App_Notification_evt_t
 void SMART_WATCH_STM_App_Notification_TEMPERATURE(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_Temparature_Id,TEMPERATURE_CHANGE_PERIOD );//TEMPERATURE_CHANGE_PERIOD
+		SMART_WATCH_Subscribe(SWITCH_TEMP, 1);
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_Temparature_Id);
+		SMART_WATCH_Subscribe(SWITCH_TEMP, 0);
 		break; /* NOTIFY_DISABLED_EVT */
 	default:
 		break; /* DEFAULT */
@@ -179,14 +214,10 @@ void SMART_WATCH_STM_App_Notification_TEMPERATURE(SMART_WATCH_STM_App_Notificati
 void SMART_WATCH_STM_App_Notification_HUMIDITY(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_Humidity_Id,HUMIDITY_CHANGE_PERIOD );//HUMIDITY_CHANGE_PERIOD
+		SMART_WATCH_Subscribe(SWITCH_HUM, 1);
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_Humidity_Id);
+		SMART_WATCH_Subscribe(SWITCH_HUM, 0);
 		break; /* NOTIFY_DISABLED_EVT */
 	default:
 		break; /* DEFAULT */
@@ -198,12 +229,12 @@ void SMART_WATCH_STM_App_Notification_HUMIDITY(SMART_WATCH_STM_App_Notification_
 void SMART_WATCH_STM_App_Notification_LUX(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
+		SMART_WATCH_App_Context.usNotificationMask |= (1 << SWITCH_LUX);
 
 		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_LUX_Id,LUX_CHANGE_PERIOD );//LUX_CHANGE_PERIOD
 		break;
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
+ 		SMART_WATCH_App_Context.usNotificationMask &= ~(1 << SWITCH_LUX);
 
 		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_LUX_Id);
 		break;
@@ -216,14 +247,10 @@ void SMART_WATCH_STM_App_Notification_LUX(SMART_WATCH_STM_App_Notification_evt_t
 void SMART_WATCH_STM_App_Notification_HR(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_HR_Id, HR_CHANGE_PERIOD);//LUX_CHANGE_PERIOD
+		SMART_WATCH_Subscribe(SWITCH_HR, 1);
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_HR_Id);
+		SMART_WATCH_Subscribe(SWITCH_HR, 0);
 		break; /* NOTIFY_DISABLED_EVT */
 	default:
 		break; /* DEFAULT */
@@ -234,12 +261,12 @@ void SMART_WATCH_STM_App_Notification_HR(SMART_WATCH_STM_App_Notification_evt_t
 void SMART_WATCH_STM_App_Notification_SPO2(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
+		SMART_WATCH_App_Context.usNotificationMask |= (1 << SWITCH_SPO2);
 
 		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_SPO2_Id, SPO2_CHANGE_PERIOD);//SPO2_CHANGE_PERIOD
 		break;
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
+ 		SMART_WATCH_App_Context.usNotificationMask &= ~(1 << SWITCH_SPO2);
 
 		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_SPO2_Id);
 		break;
@@ -252,14 +279,10 @@ void SMART_WATCH_STM_App_Notification_SPO2(SMART_WATCH_STM_App_Notification_evt_
 void SMART_WATCH_STM_App_Notification_GSR(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_GSR_Id, GSR_CHANGE_PERIOD);//LUX_CHANGE_PERIOD
+		SMART_WATCH_Subscribe(SWITCH_GSR, 1);
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_GSR_Id);
+		SMART_WATCH_Subscribe(SWITCH_GSR, 0);
 		break; /* NOTIFY_DISABLED_EVT */
 	default:
 		break; /* DEFAULT */
@@ -270,21 +293,181 @@ void SMART_WATCH_STM_App_Notification_GSR(SMART_WATCH_STM_App_Notification_evt_t
 void SMART_WATCH_STM_App_Notification_Data(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
 	switch (pNotification->SMART_WATCH_Evt_Opcode) {
 	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
-		SMART_WATCH_App_Context.ucNotificationStatus = 1;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Start(SMART_WATCH_App_Context.ucUpdate_Data_Id, DATA_CHANGE_PERIOD);//LUX_CHANGE_PERIOD
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+		vPpgStreamStart(SMART_WATCH_App_Context.usDataPayloadMax, SMART_WATCH_PPG_Frame_Ready);
+#endif
+		SMART_WATCH_Subscribe(SWITCH_DATA, 1);
+		break; /* NOTIFY_ENABLED_EVT */
+	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
+		SMART_WATCH_Subscribe(SWITCH_DATA, 0);
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+		vPpgStreamStop();
+#endif
+		/* history frames already moved its cursor, they stay queued */
+		if (ucNotifyQueueFlushChar(SWITCH_DATA))
+			SMART_WATCH_App_Context.ucNotifyRetry = 0;
+		break; /* NOTIFY_DISABLED_EVT */
+	case SMART_WATCH_STM_WRITE_EVT:
+		if (pNotification->DataTransfered.Length == 0)
+			break;
+		ucOledStatusFlag = pNotification->DataTransfered.pPayload[0] & 0x0F;// first 4 bit contains the number of screen
+		setActiveSensor(pNotification->DataTransfered.pPayload[0]); // last 4 bit for the active sensor value
+		vOledBleClearScreen();
+		break; /* WRITE_EVT */
+	default:
+		break; /* DEFAULT */
+	}
+	return;
+}
+
+/*
+ * The service calls these, not SMART_WATCH_STM_Disconnected(), so a dropped
+ * link leaves the screen as it is
+ */
+void SMART_WATCH_STM_App_Screen_Sensor(uint8_t Enabled){
+	vOledBleClearScreen();
+	if (!Enabled)
+		LCD_Print("SELECT", "CHARACTER");
+}
+
+void SMART_WATCH_STM_App_Screen_HR(uint8_t Enabled){
+	if (Enabled) {
+		vOledBleMaxInit30102();
+		return;
+	}
+	vOledBleClearScreen();
+	LCD_Print("SELECT", "CHARACTER");
+}
+
+void SMART_WATCH_STM_App_Screen_Data(uint8_t Enabled){
+	vOledBleClearScreen();
+	ucOledStatusFlag = Enabled ? OLED_STATUS_BLE : OLED_STATUS_DEF;
+}
+
+#if (SMART_WATCH_DIAG_CHAR != 0)
+void SMART_WATCH_STM_App_Notification_Diag(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
+	switch (pNotification->SMART_WATCH_Evt_Opcode) {
+	case SMART_WATCH_STM_WRITE_EVT:
+#if (CFG_BLE_TL_DIAG != 0)
+		if (pNotification->DataTransfered.Length != 0
+				&& pNotification->DataTransfered.pPayload[0] == SMART_WATCH_DIAG_RESET)
+			APP_BLE_Tl_Stats_Reset();
+#endif
+#if (CFG_CYCLE_PROF != 0)
+		if (pNotification->DataTransfered.Length != 0
+				&& pNotification->DataTransfered.pPayload[0] == SMART_WATCH_DIAG_PROFILE) {
+			vCycleProfDump(SMART_WATCH_Prof_Print);
+			vCycleProfReset();
+		}
+#endif
+		break; /* WRITE_EVT */
+	default:
+		break; /* DEFAULT */
+	}
+	return;
+}
+
+#if (CFG_BLE_TL_DIAG != 0) && (APP_BLE_TL_STATS_SIZE > SMART_WATCH_DIAG_CHAR_SIZE)
+#error "The transport layer record does not fit SMART_WATCH_DIAG_CHAR_SIZE"
+#endif
+
+/* Value of DIAG, read on each client read */
+uint16_t SMART_WATCH_STM_App_Read_Diag(uint8_t *pValue, uint16_t Max){
+#if (CFG_BLE_TL_DIAG != 0)
+	return APP_BLE_Tl_Stats_Encode(pValue);
+#else
+	return 0;
+#endif
+}
+#endif
+
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+/*
+ * HISTORY and its control point. A transfer started while nobody listens
+ * waits for the subscription, one cut by the link going resumes from the
+ * last acknowledged record once a central subscribes again.
+ */
+void SMART_WATCH_STM_App_Notification_History(SMART_WATCH_STM_App_Notification_evt_t *pNotification){
+	switch (pNotification->SMART_WATCH_Evt_Opcode) {
+	case SMART_WATCH_STM_NOTIFY_ENABLED_EVT:
+		SMART_WATCH_Subscribe(SWITCH_HISTORY, 1);
+		ucHistorySyncResume();
+		if (ucHistorySyncState() == HISTORY_SYNC_SENDING)
+			vNotifySchedRaise(SWITCH_HISTORY, HAL_GetTick());
 		break; /* NOTIFY_ENABLED_EVT */
 	case SMART_WATCH_STM_NOTIFY_DISABLED_EVT:
- 		SMART_WATCH_App_Context.ucNotificationStatus = 0;
-		/* Start the timer used to update the characteristic */
-		HW_TS_Stop(SMART_WATCH_App_Context.ucUpdate_Data_Id);
+		SMART_WATCH_Subscribe(SWITCH_HISTORY, 0);
+		vHistorySyncPause();
 		break; /* NOTIFY_DISABLED_EVT */
+	case SMART_WATCH_STM_WRITE_EVT:
+		if (ucHistoryControl(pNotification->DataTransfered.pPayload,
+				pNotification->DataTransfered.Length)) {
+			vNotifySchedRaise(SWITCH_HISTORY, HAL_GetTick());
+			SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
+		}
+		break; /* WRITE_EVT */
 	default:
 		break; /* DEFAULT */
 	}
 	return;
 }
 
+/* Value of the control point, read on each client read */
+uint16_t SMART_WATCH_STM_App_Read_History(uint8_t *pValue, uint16_t Max){
+	return usHistoryStatus(pValue);
+}
+#endif
+
+/* Runs in the HCI event task after an update was refused for lack of TX buffers */
+void SMART_WATCH_STM_App_Tx_Pool_Available(uint16_t ConnectionHandle, uint16_t AvailableBuffers) {
+	vNotifyQueueResume(AvailableBuffers);
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
+	return;
+}
+
+/*
+ * Called after SMART_WATCH_STM_Disconnected(), the slot of the link is free
+ * again. With nobody left the pool event never comes, queued values go, else
+ * the other link keeps them and only a retry aimed at the old slot is dropped.
+ */
+void SMART_WATCH_APP_Disconnected(void) {
+	SMART_WATCH_App_Context.ucNotifyRetry = 0;
+	if (SMART_WATCH_App_Context.usNotificationMask == 0)
+		vNotifyQueueFlush();
+	return;
+}
+
+/* Called by app_ble.c whenever the MTU or the data length of the link changes */
+void SMART_WATCH_APP_Link_Update(uint16_t usPayloadMax) {
+	SMART_WATCH_App_Context.usDataPayloadMax = usPayloadMax;
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+	if (SMART_WATCH_App_Context.usNotificationMask & (1 << SWITCH_DATA))
+		vPpgStreamResize(usPayloadMax);
+#endif
+	return;
+}
+
+/* What the subscriptions ask of the link, the payload size is filled in by app_ble.c */
+void SMART_WATCH_APP_Get_Conn_Demand(ConnGovInput *pDemand) {
+	NotifyQueueStats stats;
+
+	vNotifyQueueGetStats(&stats);
+	pDemand->ucDepth = stats.ucDepth;
+	if (SMART_WATCH_App_Context.usNotificationMask & (1 << SWITCH_DATA))
+		pDemand->ucDemand = SMART_WATCH_DATA_STREAM_PPG ?
+				CONN_GOV_DEMAND_WAVEFORM : CONN_GOV_DEMAND_SUMMARY;
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+	else if ((SMART_WATCH_App_Context.usNotificationMask & (1 << SWITCH_HISTORY))
+			&& ucHistorySyncState() == HISTORY_SYNC_SENDING)
+		pDemand->ucDemand = CONN_GOV_DEMAND_WAVEFORM;
+#endif
+	else if (SMART_WATCH_App_Context.usNotificationMask)
+		pDemand->ucDemand = CONN_GOV_DEMAND_SUMMARY;
+	else
+		pDemand->ucDemand = CONN_GOV_DEMAND_NONE;
+	return;
+}
+
 void SMART_WATCH_APP_Init(void) {
 	/* Register task used to update the characteristic (send the notification) */
 	//SCH_RegTask(CFG_MY_TASK_NOTIFY_EGR,SMART_WATCH_Send_Notification_Task);
@@ -292,9 +475,10 @@ void SMART_WATCH_APP_Init(void) {
 	//SCH_RegTask(CFG_MY_TASK_NOTIFY_HUMIDITY,SMART_WATCH_Send_Notification_Task);
 	//SCH_RegTask(CFG_MY_TASK_NOTIFY_LUX,SMART_WATCH_Send_Notification_Task);
 	//SCH_RegTask(CFG_MY_TASK_NOTIFY_GSR,SMART_WATCH_Send_Notification_Task);
-	SCH_RegTask(CFG_MY_TASK_NOTIFY_HR,SMART_WATCH_Send_Notification_Task);
+	//SCH_RegTask(CFG_MY_TASK_NOTIFY_HR,SMART_WATCH_Send_Notification_Task);
 	//SCH_RegTask(CFG_MY_TASK_NOTIFY_SPO2,SMART_WATCH_Send_Notification_Task);
 	SCH_RegTask(CFG_MY_TASK_NOTIFY_DATA,SMART_WATCH_Send_Notification_Task);
+	vNotifyQueueInit(SMART_WATCH_Notify_Send);
 	/* Create timer to change the Temperature and update charecteristic */
 	//initilizing ble timers
 	APP_DBG_MSG("Initializing BLE timers \n");
@@ -343,15 +527,24 @@ void SMART_WATCH_APP_Init(void) {
 		  SMART_WATCH_SPO2_Timer_Callback);
 	APP_DBG_MSG("HRt BLE timer created \n");
 */
-	HW_TS_Create(CFG_TIM_PROC_ID_ISR,
-	      &(SMART_WATCH_App_Context.ucUpdate_Data_Id),
-	      hw_ts_Repeated,
-		  SMART_WATCH_DATA_Timer_Callback);
-	APP_DBG_MSG("Data soft BLE timer created \n");
+	APPE_Periodic_Register(CFG_MY_TASK_NOTIFY_DATA, NOTIFY_TICK_PERIOD, NOTIFY_TICK_PERIOD);
+	APP_DBG_MSG("Notification tick registered \n");
+	vNotifySchedInit();
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+	ucNotifySchedRegister(SWITCH_DATA, 0, NOTIFY_SCHED_BULK, SMART_WATCH_Produce_Data);
+#else
+	ucNotifySchedRegister(SWITCH_DATA, DATA_PERIOD_MS, NOTIFY_SCHED_SUMMARY, SMART_WATCH_Produce_Data);
+#endif
+#if (SMART_WATCH_HR_CHAR != 0)
+	ucNotifySchedRegister(SWITCH_HR, HR_PERIOD_MS, NOTIFY_SCHED_SUMMARY, SMART_WATCH_Produce_HR);
+#endif
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+	ucNotifySchedRegister(SWITCH_HISTORY, 0, NOTIFY_SCHED_BULK, SMART_WATCH_Produce_History);
+#endif
 	/**
 	 * Initialize Template application context
 	 */
-	SMART_WATCH_App_Context.ucNotificationStatus = 0;
+	SMART_WATCH_App_Context.usNotificationMask = 0;
 	SMART_WATCH_context_Init();
 	return;
 }
@@ -360,7 +553,7 @@ static void SMART_WATCH_HR_Timer_Callback(void){
 	static unsigned char value[16];
 	unionTypeDef tmpVal;
 	int i =0;
-	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_HR, CFG_SCH_PRIO_0);
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
 	static uint8_t sucPrintCounter=0;
 
 	if(sucPrintCounter>=2){
@@ -487,7 +680,7 @@ static void SMART_WATCH_HR_Timer_Callback(void){
 	static unsigned char value[16];
 	unionTypeDef tmpVal;
 	int i =0;
-	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_HR, CFG_SCH_PRIO_0);
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
 	static uint8_t sucPrintCounter=0;
 
 	if(sucPrintCounter>=2){
@@ -535,33 +728,115 @@ static void SMART_WATCH_SPO2_Timer_Callback(void){
 }
 */
 
-static void SMART_WATCH_DATA_Timer_Callback(void){
-	static unsigned char value[512];
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+/* Runs from the sensor read in thread mode, the task sends the frame */
+static void SMART_WATCH_PPG_Frame_Ready(void){
+	vNotifySchedRaise(SWITCH_DATA, HAL_GetTick());
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
+}
+
+/* Frames are moved into the queue only while it has room, past that the stream drops its oldest */
+static uint16_t SMART_WATCH_Produce_Data(uint8_t *pValue, uint16_t usMax){
+	uint8_t *frame;
+	uint16_t len;
+
+	frame = pPpgStreamPeek(&len);
+	if (frame == NULL || len > usMax)
+		return 0;
+	memcpy(pValue, frame, len);
+	vPpgStreamRelease();
+	return len;
+}
+#else
+static uint16_t SMART_WATCH_Produce_Data(uint8_t *pValue, uint16_t usMax){
 	unionTypeDef tmpVal;
 	int i =0;
-	static unsigned char ucPrintCounter=0;
-
-	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
 
 	//get max30102 HR data
 	tmpVal.ui = ucGetMax30102HR()%0xFF;
 	for(i=0;i<1;i++)
-		value[OFFSET_DATA_HR-i] = tmpVal.uc[i];
+		pValue[OFFSET_DATA_HR-i] = tmpVal.uc[i];
 	//get max30102 SPO2 data
 	tmpVal.ui = ucGetMax30102SPO2()%0xFF;
 	for(i=0;i<1;i++)
-		value[OFFSET_DATA_SPO2-i] = tmpVal.uc[i];
+		pValue[OFFSET_DATA_SPO2-i] = tmpVal.uc[i];
 
 	//get max30102 IRed data
 	tmpVal.ui = uiGetMax30102IRed();
 	for(i=0;i<4;i++)
-		value[OFFSET_DATA_IRED+3-i] = tmpVal.uc[i];
+		pValue[OFFSET_DATA_IRED+3-i] = tmpVal.uc[i];
 
 	//get max30102 Red data
 	tmpVal.ui = uiGetMax30102Red();
 	for(i=0;i<4;i++)
-		value[OFFSET_DATA_RED+3-i] = tmpVal.uc[i];
-	SMART_WATCH_STM_App_Update_Char(SWITCH_DATA, (uint8_t *) &value);
+		pValue[OFFSET_DATA_RED+3-i] = tmpVal.uc[i];
+	return OFFSET_DATA_RED+4;
+}
+#endif
+
+#if (SMART_WATCH_HR_CHAR != 0)
+static uint16_t SMART_WATCH_Produce_HR(uint8_t *pValue, uint16_t usMax){
+	unionTypeDef tmpVal;
+	int i =0;
+
+	tmpVal.ui=ucGetMax30102HR();
+	for(i=0;i<4;i++)
+		pValue[OFFSET_HR + 3-i] = tmpVal.uc[i];
+	tmpVal.ui=ucGetMax30102SPO2();
+	for(i=0;i<4;i++)
+		pValue[OFFSET_SPO2 + 3-i] = tmpVal.uc[i];
+	tmpVal.ui=usGetMax30102Diff();
+	for(i=0;i<4;i++)
+		pValue[OFFSET_CUM_PULSE + 3-i] = tmpVal.uc[i];
+	tmpVal.ui=uiGetMax30102PulseCounter();
+	for(i=0;i<4;i++)
+		pValue[OFFSET_PULSE_COUNTER + 3-i] = tmpVal.uc[i];
+	return SMART_WATCH_HR_CHAR_SIZE;
+}
+#endif
+
+#if (SMART_WATCH_HISTORY_CHARS != 0)
+/* One frame per queue slot, as many records as the link payload takes */
+static uint16_t SMART_WATCH_Produce_History(uint8_t *pValue, uint16_t usMax){
+	if (usMax > SMART_WATCH_App_Context.usDataPayloadMax)
+		usMax = SMART_WATCH_App_Context.usDataPayloadMax;
+	if (usMax > SMART_WATCH_HISTORY_CHAR_SIZE)
+		usMax = SMART_WATCH_HISTORY_CHAR_SIZE;
+	return usHistoryFrame(pValue, usMax);
+}
+#endif
+
+#if (SMART_WATCH_DIAG_CHAR != 0) && (CFG_CYCLE_PROF != 0)
+/* One line per entry: runs, average and longest in cycles, then the histogram */
+static void SMART_WATCH_Prof_Print(uint8_t ucId, const char *pName, const CycleProfEntry *pEntry){
+	uint8_t b;
+
+	if (pName != NULL)
+		APP_DBG_MSG("%-9s", pName);
+	else
+		APP_DBG_MSG("task %-4u", ucId);
+	APP_DBG_MSG(" %8lu %8lu %8lu |", (unsigned long) pEntry->uiCount,
+			(unsigned long) (pEntry->ulTotal / pEntry->uiCount), (unsigned long) pEntry->uiMax);
+	for (b = 0; b < CYCLE_PROF_HIST_BUCKETS; b++)
+		APP_DBG_MSG(" %lu", (unsigned long) pEntry->auiHist[b]);
+	APP_DBG_MSG("\n");
+}
+#endif
+
+/* The tick only runs while a central subscribes to something */
+static void SMART_WATCH_Subscribe(uint16_t usChar, uint8_t ucEnable){
+	uint16_t mask = SMART_WATCH_App_Context.usNotificationMask;
+
+	if (ucEnable)
+		SMART_WATCH_App_Context.usNotificationMask |= (1 << usChar);
+	else
+		SMART_WATCH_App_Context.usNotificationMask &= ~(1 << usChar);
+	vNotifySchedEnable(usChar, ucEnable, HAL_GetTick());
+	if (mask == 0 && SMART_WATCH_App_Context.usNotificationMask != 0)
+		APPE_Periodic_Enable(CFG_MY_TASK_NOTIFY_DATA, 1);
+	else if (mask != 0 && SMART_WATCH_App_Context.usNotificationMask == 0)
+		APPE_Periodic_Enable(CFG_MY_TASK_NOTIFY_DATA, 0);
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
 }
 
 static void SMART_WATCH_context_Init(void) {
@@ -579,7 +854,9 @@ static void SMART_WATCH_context_Init(void) {
 	SMART_WATCH_App_Context.tHumidity.usHumidity = 0;
 	SMART_WATCH_App_Context.tHumidity.usTemperature = 0;
 	//
-	SMART_WATCH_App_Context.ucNotificationStatus = 0;
+	SMART_WATCH_App_Context.usNotificationMask = 0;
+	SMART_WATCH_App_Context.ucNotifyRetry = 0;
+	SMART_WATCH_App_Context.ucHrAlarm = 0;
 	//TODO update this
 /*
 	SMART_WATCH_App_Context.ucUpdate_Data_Id = 7;
@@ -593,8 +870,52 @@ static void SMART_WATCH_context_Init(void) {
 */
 	SMART_WATCH_App_Context.usParameter = 0;
 	SMART_WATCH_App_Context.usParameter = 0;
+	SMART_WATCH_App_Context.usDataPayloadMax = APP_BLE_DEFAULT_ATT_MTU - 3;
 }
+/*
+ * The queue hands the same head value back after a refusal, the links that
+ * already took it are not notified a second time. The update does not wait
+ * for CPU2, sampling goes on while it is in flight and the queue hears about
+ * it in SMART_WATCH_Notify_Done().
+ */
+static uint8_t SMART_WATCH_Notify_Send(uint16_t usChar, uint8_t *pData, uint16_t usLength) {
+	uint8_t status;
+
+	if (!SMART_WATCH_App_Context.ucNotifyRetry)
+		SMART_WATCH_App_Context.ucNotifyPending = 0xFF;
+	SMART_WATCH_App_Context.ucNotifyPending &= SMART_WATCH_STM_Subscribers(usChar);
+	status = SMART_WATCH_STM_App_Update_Value_Async(usChar, pData, usLength,
+			&SMART_WATCH_App_Context.ucNotifyPending, SMART_WATCH_Notify_Done);
+	if (status != BLE_STATUS_PENDING)
+		SMART_WATCH_App_Context.ucNotifyRetry = (status == BLE_STATUS_INSUFFICIENT_RESOURCES);
+	return status;
+}
+
+static void SMART_WATCH_Notify_Done(tBleStatus status) {
+	SMART_WATCH_App_Context.ucNotifyRetry = (status == BLE_STATUS_INSUFFICIENT_RESOURCES);
+	vNotifyQueueSent(status);
+	SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
+}
+
+/* Runs on the tick, on a new frame and after each completion */
 static void SMART_WATCH_Send_Notification_Task(void) {
+	uint32_t now = HAL_GetTick();
+#if (SMART_WATCH_HR_CHAR != 0)
+	uint8_t high;
+#endif
+
+#if (SMART_WATCH_DATA_STREAM_PPG != 0)
+	vPpgStreamPoll();
+#endif
+#if (SMART_WATCH_HR_CHAR != 0)
+	/* the rise above the threshold goes out ahead of any waveform frame */
+	high = ucGetMax30102HR() > MAX_BPM_THRESHOLD;
+	if (high && !SMART_WATCH_App_Context.ucHrAlarm)
+		vNotifySchedAlarm(SWITCH_HR, now);
+	SMART_WATCH_App_Context.ucHrAlarm = high;
+#endif
+	vNotifySchedRun(now);
+	vNotifyQueueDrain();
 /*
 	SMART_WATCH_App_Context.tHumidity.usTemperature +=
 			SMART_WATCH_App_Context.usChangeStep;
@@ -606,7 +927,7 @@ static void SMART_WATCH_Send_Notification_Task(void) {
 		counter=0;
 		value++;
 	}
-	if (SMART_WATCH_App_Context.ucNotificationStatus) {
+	if (SMART_WATCH_App_Context.usNotificationMask) {
 	} else {
 	}*/
 	return;
@@ -33,10 +33,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /* Absolute value */
 #define ABS(x)   ((x) > 0 ? (x) : -(x))
 
-extern I2C_HandleTypeDef hi2c3;
+extern I2C_HandleTypeDef SSD1306_I2C_PORT;
 
-/* SSD1306 data buffer */
-static uint8_t SSD1306_Buffer[(SSD1306_WIDTH * SSD1306_HEIGHT) / 8];
+/* SSD1306 data buffer, shared by every screen of the watch */
+static uint8_t SSD1306_Buffer[SSD1306_BUFFER_SIZE];
 
 /* Private SSD1306 structure */
 typedef struct {
@@ -44,11 +44,24 @@ typedef struct {
   uint16_t CurrentY;
   uint8_t Inverted;
   uint8_t Initialized;
+  uint8_t Window[4];        /* Column/page window last sent to the controller, start/end column then start/end page */
 } SSD1306_t;
 
+static void SSD1306_SetWindow(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1);
+static void SSD1306_FlushRect(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last);
+
 /* Private variable */
 static SSD1306_t SSD1306;
 
+#if (SSD1306_FRAME_STATS != 0)
+static SSD1306_Stats_t SSD1306_Stats;
+static uint32_t SSD1306_StatsStartCycle;
+
+#define SSD1306_STATS_ADD(bytes)  do { SSD1306_Stats.Bytes += (bytes); SSD1306_Stats.Transactions++; } while (0)
+#else
+#define SSD1306_STATS_ADD(bytes)
+#endif
+
 uint8_t SSD1306_Init(void) {
   /* Init I2C */
   //ssd1306_I2C_Init();
@@ -61,7 +74,7 @@ uint8_t SSD1306_Init(void) {
   HAL_Delay(100);
 
   /* Check if LCD connected to I2C */
-  if (HAL_I2C_IsDeviceReady(&hi2c3, SSD1306_I2C_ADDR, 1, 20000) != HAL_OK) {
+  if (HAL_I2C_IsDeviceReady(&SSD1306_I2C_PORT, SSD1306_I2C_ADDR, 1, 20000) != HAL_OK) {
     /* Return false */
     return 0;
   }
@@ -72,38 +85,51 @@ uint8_t SSD1306_Init(void) {
   /* Init LCD */
   SSD1306_WRITECOMMAND(0xAE); //display off
   SSD1306_WRITECOMMAND(0xA8); //--set multiplex ratio(1 to 64)
-  SSD1306_WRITECOMMAND(0x1F); //
+  SSD1306_WRITECOMMAND(SSD1306_HEIGHT - 1); //
   SSD1306_WRITECOMMAND(0xD3); //-set display offset
   SSD1306_WRITECOMMAND(0x00); //
   SSD1306_WRITECOMMAND(0x40); //--set start line address
   SSD1306_WRITECOMMAND(0x20); //Set Memory Addressing Mode
-  SSD1306_WRITECOMMAND(0x02); //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
+  SSD1306_WRITECOMMAND(0x00); //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
+#ifdef SSD1306_MIRROR_HORIZ
+  SSD1306_WRITECOMMAND(0xA0); //--mirror horizontally
+#else
   SSD1306_WRITECOMMAND(0xA1); //--set segment re-map 0 to 127
+#endif
+#ifdef SSD1306_MIRROR_VERT
+  SSD1306_WRITECOMMAND(0xC0); //--mirror vertically
+#else
   SSD1306_WRITECOMMAND(0xC8); //Set COM Output Scan Direction
+#endif
   SSD1306_WRITECOMMAND(0xDA); //--set com pins hardware configuration
-  SSD1306_WRITECOMMAND(0x02); //
+#if (SSD1306_HEIGHT == 32)
+  SSD1306_WRITECOMMAND(0x02); //sequential COM pins
+#elif (SSD1306_HEIGHT == 64)
+  SSD1306_WRITECOMMAND(0x12); //alternative COM pins
+#else
+#error "Only 32 or 64 lines of height are supported!"
+#endif
   SSD1306_WRITECOMMAND(0x81); //--set contrast control register
-  SSD1306_WRITECOMMAND(0x1F); //
+  SSD1306_WRITECOMMAND(0xFF); //
   SSD1306_WRITECOMMAND(0xA4); //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
+#ifdef SSD1306_INVERSE_COLOR
+  SSD1306_WRITECOMMAND(0xA7); //--set inverse display mode
+#else
   SSD1306_WRITECOMMAND(0xA6); //--set normal display mode
+#endif
   SSD1306_WRITECOMMAND(0xD5); //--set display clock divide ratio/oscillator frequency
-  SSD1306_WRITECOMMAND(0x80); //--set divide ratio
-  SSD1306_WRITECOMMAND(0x8D); //--set DC-DC enable
-  SSD1306_WRITECOMMAND(0x14); //
-  SSD1306_WRITECOMMAND(0x2E); //Disable Scroll
-  SSD1306_WRITECOMMAND(0xAF); //--turn on SSD1306 panel
-
-  /*SSD1306_WRITECOMMAND(0xB0); //Set Page Start Address for Page Addressing Mode,0-7
-  SSD1306_WRITECOMMAND(0x00); //---set low column address
-  SSD1306_WRITECOMMAND(0x10); //---set high column address
+  SSD1306_WRITECOMMAND(0xF0); //--set divide ratio
   SSD1306_WRITECOMMAND(0xD9); //--set pre-charge period
   SSD1306_WRITECOMMAND(0x22); //
   SSD1306_WRITECOMMAND(0xDB); //--set vcomh
   SSD1306_WRITECOMMAND(0x20); //0x20,0.77xVcc
+  SSD1306_WRITECOMMAND(0x8D); //--set DC-DC enable
+  SSD1306_WRITECOMMAND(0x14); //
   SSD1306_WRITECOMMAND(0x2E); //Disable Scroll
-  SSD1306_WRITECOMMAND(0x2F); //Disable Scroll*/
+  SSD1306_WRITECOMMAND(0xAF); //--turn on SSD1306 panel
 
-  //SSD1306_WRITECOMMAND(0xA5); //--turn on SSD1306 panel
+  /* Window is unknown after init, force it out on the first flush */
+  memset(SSD1306.Window, 0xFF, sizeof(SSD1306.Window));
 
   /* Clear screen */
   SSD1306_Fill(SSD1306_COLOR_BLACK);
@@ -122,17 +148,69 @@ uint8_t SSD1306_Init(void) {
   return 1;
 }
 
+static void SSD1306_SetWindow(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1) {
+  uint8_t window[] = { 0x21, x0, x1, 0x22, page0, page1 };
+
+  /* Horizontal addressing wraps inside the window, so an unchanged window needs no commands */
+  if (SSD1306.Window[0] == x0 && SSD1306.Window[1] == x1 &&
+      SSD1306.Window[2] == page0 && SSD1306.Window[3] == page1) {
+    return;
+  }
+
+  ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x00, window, sizeof(window));
+  SSD1306.Window[0] = x0;
+  SSD1306.Window[1] = x1;
+  SSD1306.Window[2] = page0;
+  SSD1306.Window[3] = page1;
+}
+
+static void SSD1306_FlushRect(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last) {
+  uint8_t page;
+
+  SSD1306_SetWindow(x0, x1, first, last);
+
+  /* Full width pages are contiguous in RAM, a narrower window needs one transfer per page */
+  if (x0 == 0 && x1 == SSD1306_WIDTH - 1) {
+    ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x40, &SSD1306_Buffer[SSD1306_WIDTH * first],
+                           SSD1306_WIDTH * (last - first + 1));
+    return;
+  }
+  for (page = first; page <= last; page++) {
+    ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x40, &SSD1306_Buffer[SSD1306_WIDTH * page + x0],
+                           x1 - x0 + 1);
+  }
+}
+
 void SSD1306_UpdateScreen(void) {
-  uint8_t m;
+  SSD1306_UpdatePages(0, SSD1306_PAGES - 1);
+}
 
-  for (m = 0; m < 4; m++) {
-    SSD1306_WRITECOMMAND(0xB0+m);
-    SSD1306_WRITECOMMAND(0x00);
-    SSD1306_WRITECOMMAND(0x10);
+void SSD1306_UpdatePages(uint8_t first, uint8_t last) {
+  (void)SSD1306_UpdateRect(0, SSD1306_WIDTH - 1, first, last);
+}
 
-    /* Write multi data */
-    ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x40, &SSD1306_Buffer[SSD1306_WIDTH * m], SSD1306_WIDTH);
+uint8_t SSD1306_UpdateRect(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last) {
+  if (x1 >= SSD1306_WIDTH) {
+    x1 = SSD1306_WIDTH - 1;
+  }
+  if (last >= SSD1306_PAGES) {
+    last = SSD1306_PAGES - 1;
   }
+  if (x0 > x1 || first > last) {
+    return 1;
+  }
+
+  /* The bus is shared with the MAX30102, skip this frame if a transfer is running */
+  if (HAL_I2C_GetState(&SSD1306_I2C_PORT) == HAL_I2C_STATE_BUSY) {
+    return 0;
+  }
+
+  SSD1306_FlushRect(x0, x1, first, last);
+  return 1;
+}
+
+uint8_t* SSD1306_GetBuffer(void) {
+  return SSD1306_Buffer;
 }
 
 void SSD1306_ToggleInvert(void) {
@@ -496,6 +574,81 @@ void SSD1306_DrawFilledCircle(int16_t x0, int16_t y0, int16_t r, SSD1306_COLOR_t
   }
 }
 
+void SSD1306_DrawRle(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t* rle) {
+  uint8_t* row = &SSD1306_Buffer[SSD1306_WIDTH * page + x];
+  uint16_t left = (uint16_t)w * pages;
+  uint8_t col = 0;
+  uint8_t n, chunk, run;
+
+  /* Check input parameters */
+  if (x + w > SSD1306_WIDTH || page + pages > SSD1306_PAGES) {
+    return;
+  }
+
+  while (left) {
+    /* 0x00..0x7F: n + 1 literal bytes, 0x80..0xFF: next byte repeated n - 0x80 + 2 times */
+    n = *rle++;
+    run = n & 0x80;
+    n = run ? n - 0x80 + 2 : n + 1;
+    if (n > left) {
+      n = left;
+    }
+    left -= n;
+
+    /* Split at the right edge of the bitmap, each piece is a plain memset / memcpy */
+    while (n) {
+      chunk = w - col;
+      if (chunk > n) {
+        chunk = n;
+      }
+      if (run) {
+        memset(&row[col], *rle, chunk);
+      } else {
+        memcpy(&row[col], rle, chunk);
+        rle += chunk;
+      }
+      n -= chunk;
+      col += chunk;
+      if (col == w) {
+        col = 0;
+        row += SSD1306_WIDTH;
+      }
+    }
+    if (run) {
+      rle++;
+    }
+  }
+}
+
+void SSD1306_DrawBitmap(uint16_t x, uint16_t y, const unsigned char* bitmap, uint16_t w, uint16_t h, SSD1306_COLOR_t c) {
+  uint16_t byteWidth = (w + 7) / 8;
+  uint16_t i, j;
+  uint8_t b = 0;
+
+  /* Check input parameters */
+  if (
+      x >= SSD1306_WIDTH ||
+        y >= SSD1306_HEIGHT
+          ) {
+            /* Return error */
+            return;
+          }
+
+  for (j = 0; j < h; j++) {
+    for (i = 0; i < w; i++) {
+      if (i & 7) {
+        b <<= 1;
+      } else {
+        b = bitmap[j * byteWidth + i / 8];
+      }
+
+      if (b & 0x80) {
+        SSD1306_DrawPixel(x + i, y + j, c);
+      }
+    }
+  }
+}
+
 void SSD1306_ON(void) {
   SSD1306_WRITECOMMAND(0x8D);
   SSD1306_WRITECOMMAND(0x14);
@@ -507,21 +660,37 @@ void SSD1306_OFF(void) {
   SSD1306_WRITECOMMAND(0xAE);
 }
 
-uint8_t dt[sizeof(SSD1306_Buffer)+1];
+void SSD1306_StatsReset(void) {
+#if (SSD1306_FRAME_STATS != 0)
+  /* Start the cycle counter if the debugger did not */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  memset(&SSD1306_Stats, 0, sizeof(SSD1306_Stats));
+  SSD1306_StatsStartCycle = DWT->CYCCNT;
+#endif
+}
+
+void SSD1306_StatsGet(SSD1306_Stats_t* stats) {
+#if (SSD1306_FRAME_STATS != 0)
+  *stats = SSD1306_Stats;
+  stats->Cycles = DWT->CYCCNT - SSD1306_StatsStartCycle;
+#else
+  memset(stats, 0, sizeof(*stats));
+#endif
+}
 
 void ssd1306_I2C_WriteMulti(uint8_t address, uint8_t reg, uint8_t* data, uint16_t count) {
-  //uint8_t dt[count + 1];
-  dt[0] = reg;
-  uint8_t i;
-  for(i = 1; i <= count; i++)
-    dt[i] = data[i-1];
-  HAL_I2C_Master_Transmit(&hi2c3, address, dt, count+1, 100);
+  /* The control byte goes out as the memory address, no staging copy of the payload */
+  HAL_I2C_Mem_Write(&SSD1306_I2C_PORT, address, reg, I2C_MEMADD_SIZE_8BIT, data, count, 100);
+  SSD1306_STATS_ADD(count + 2);
 }
 
 void ssd1306_I2C_Write(uint8_t address, uint8_t reg, uint8_t data) {
   uint8_t dt[2];
   dt[0] = reg;
   dt[1] = data;
-  HAL_I2C_Master_Transmit(&hi2c3, address, dt, 2, 100);
+  HAL_I2C_Master_Transmit(&SSD1306_I2C_PORT, address, dt, 2, 100);
+  SSD1306_STATS_ADD(3);
 }
 /* USER CODE END */
@@ -25,6 +25,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "app_common.h"
+#include "cycle_prof.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -203,17 +204,31 @@ void SysTick_Handler(void)
 /* please refer to the startup file (startup_stm32wbxx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles EXTI line0 interrupt.
+  */
+void EXTI0_IRQHandler(void)
+{
+  /* USER CODE BEGIN EXTI0_IRQn 0 */
+  CYCLE_PROF_BEGIN();
+  /* USER CODE END EXTI0_IRQn 0 */
+  HAL_GPIO_EXTI_IRQHandler(MAX30102_INT_Pin);
+  /* USER CODE BEGIN EXTI0_IRQn 1 */
+  CYCLE_PROF_END(CYCLE_PROF_ISR_EXTI0);
+  /* USER CODE END EXTI0_IRQn 1 */
+}
+
 /**
   * @brief This function handles EXTI line4 interrupt.
   */
 void EXTI4_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI4_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END EXTI4_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
   /* USER CODE BEGIN EXTI4_IRQn 1 */
-
+  CYCLE_PROF_END(CYCLE_PROF_ISR_EXTI4);
   /* USER CODE END EXTI4_IRQn 1 */
 }
 
@@ -223,11 +238,11 @@ void EXTI4_IRQHandler(void)
 void EXTI2_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI2_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END EXTI2_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_2);
   /* USER CODE BEGIN EXTI2_IRQn 1 */
-
+  CYCLE_PROF_END(CYCLE_PROF_ISR_EXTI2);
   /* USER CODE END EXTI2_IRQn 1 */
 }
 
@@ -237,11 +252,12 @@ void EXTI2_IRQHandler(void)
 void DMA1_Channel1_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel1_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END DMA1_Channel1_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart1_tx);
   /* USER CODE BEGIN DMA1_Channel1_IRQn 1 */
   HAL_DMA_IRQHandler(&hdma_adc1);
+  CYCLE_PROF_END(CYCLE_PROF_ISR_DMA1_CH1);
   /* USER CODE END DMA1_Channel1_IRQn 1 */
 }
 
@@ -251,11 +267,11 @@ void DMA1_Channel1_IRQHandler(void)
 void ADC1_IRQHandler(void)
 {
   /* USER CODE BEGIN ADC1_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END ADC1_IRQn 0 */
   HAL_ADC_IRQHandler(&hadc1);
   /* USER CODE BEGIN ADC1_IRQn 1 */
-
+  CYCLE_PROF_END(CYCLE_PROF_ISR_ADC1);
   /* USER CODE END ADC1_IRQn 1 */
 }
 
@@ -265,11 +281,11 @@ void ADC1_IRQHandler(void)
 void TIM1_UP_TIM16_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END TIM1_UP_TIM16_IRQn 0 */
   HAL_TIM_IRQHandler(&htim16);
   /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 1 */
-
+  CYCLE_PROF_END(CYCLE_PROF_ISR_TIM16);
   /* USER CODE END TIM1_UP_TIM16_IRQn 1 */
 }
 
@@ -279,11 +295,11 @@ void TIM1_UP_TIM16_IRQHandler(void)
 void USART1_IRQHandler(void)
 {
   /* USER CODE BEGIN USART1_IRQn 0 */
-
+  CYCLE_PROF_BEGIN();
   /* USER CODE END USART1_IRQn 0 */
   HAL_UART_IRQHandler(&huart1);
   /* USER CODE BEGIN USART1_IRQn 1 */
-
+  CYCLE_PROF_END(CYCLE_PROF_ISR_USART1);
   /* USER CODE END USART1_IRQn 1 */
 }
 
@@ -294,7 +310,7 @@ void USART1_IRQHandler(void)
   */
 void RTC_WKUP_IRQHandler(void)
 {
-  HW_TS_RTC_Wakeup_Handler();
+  CYCLE_PROF_CALL(CYCLE_PROF_ISR_RTC_WKUP, HW_TS_RTC_Wakeup_Handler());
 }
 
 /**
@@ -302,7 +318,7 @@ void RTC_WKUP_IRQHandler(void)
   */
 void IPCC_C1_RX_IRQHandler(void)
 {
-  HW_IPCC_Rx_Handler();
+  CYCLE_PROF_CALL(CYCLE_PROF_ISR_IPCC_RX, HW_IPCC_Rx_Handler());
 }
 
 /**
@@ -310,7 +326,7 @@ void IPCC_C1_RX_IRQHandler(void)
   */
 void IPCC_C1_TX_IRQHandler(void)
 {
-  HW_IPCC_Tx_Handler();
+  CYCLE_PROF_CALL(CYCLE_PROF_ISR_IPCC_TX, HW_IPCC_Tx_Handler());
 }
 
 /* USER CODE END 1 */
@@ -0,0 +1,133 @@
+/*
+ * tx_power.c
+ *
+ * RSSI driven TX power steps, see tx_power.h. Fed from thread mode only.
+ */
+
+#include "tx_power.h"
+
+typedef struct {
+	uint8_t ucLevel; // aci_hal_set_tx_power_level() PA_Level
+	int16_t sPower;  // 0.1 dBm at the IC pin
+} TxPowerStep;
+
+static const TxPowerStep aSteps[TX_POWER_STEPS] = {
+	{ 0x01, -209 }, { 0x04, -176 }, { 0x07, -141 }, { 0x0A, -109 },
+	{ 0x0D, -78 }, { 0x10, -50 }, { 0x13, -25 }, { 0x16, -9 },
+	{ 0x18, -2 }, { 0x1A, 10 }, { 0x1C, 30 }, { 0x1F, 60 },
+};
+
+static uint8_t ucCeiling = 0;  // highest step allowed
+static uint8_t ucStep = 0;
+static int16_t sAverage = 0;   // RSSI, 0.1 dBm
+static int16_t sWorst = 0;     // sAverage down at once, up over TX_POWER_RELEASE samples
+static uint8_t ucAveraged = 0; // sAverage holds a value
+static uint8_t ucHold = 0;     // samples before the next step down
+static uint32_t uiSince = 0;
+static TxPowerStats tStats;
+
+// local function prototypes
+static void vTxPowerAccount(uint32_t uiNow);
+static uint8_t ucTxPowerGo(uint8_t step, uint32_t uiNow);
+static int16_t sTxPowerAtCentral(uint8_t step, int16_t rssi);
+
+//local functions
+static void vTxPowerAccount(uint32_t uiNow) {
+	tStats.uiTimeAt[ucStep] += uiNow - uiSince;
+	uiSince = uiNow;
+}
+
+// returns 1 when the PA level changes
+static uint8_t ucTxPowerGo(uint8_t step, uint32_t uiNow) {
+	vTxPowerAccount(uiNow);
+	if (step == ucStep)
+		return 0;
+	ucStep = step;
+	tStats.uiChanges++;
+	return 1;
+}
+
+// estimate of our signal at the central for an RSSI, 0.1 dBm
+static int16_t sTxPowerAtCentral(uint8_t step, int16_t rssi) {
+	return aSteps[step].sPower + rssi - TX_POWER_CENTRAL_DBM * 10;
+}
+
+// Global Function Definitions
+// ucMaxLevel is the highest PA level allowed, the controller starts there
+void vTxPowerInit(uint8_t ucMaxLevel, uint32_t uiNow) {
+	uint8_t i;
+
+	ucCeiling = 0;
+	for (i = 0; i < TX_POWER_STEPS; i++) {
+		if (aSteps[i].ucLevel <= ucMaxLevel)
+			ucCeiling = i;
+	}
+	for (i = 0; i < TX_POWER_STEPS; i++)
+		tStats.uiTimeAt[i] = 0;
+	tStats.uiChanges = 0;
+	tStats.uiLosses = 0;
+	ucStep = ucCeiling;
+	ucAveraged = 0;
+	ucHold = 0;
+	uiSince = uiNow;
+}
+
+// weakest RSSI over the open links in dBm, returns 1 when the level changes
+uint8_t ucTxPowerSample(int8_t cRssi, uint32_t uiNow) {
+	if (cRssi == TX_POWER_RSSI_NONE)
+		return ucTxPowerLoss(uiNow);
+	if (!ucAveraged) {
+		sAverage = cRssi * 10;
+		sWorst = sAverage;
+		ucAveraged = 1;
+	} else {
+		sAverage += (cRssi * 10 - sAverage) / 4;
+	}
+	if (sAverage < sWorst)
+		sWorst = sAverage;
+	else
+		sWorst += (sAverage - sWorst) / TX_POWER_RELEASE;
+	if (ucHold)
+		ucHold--;
+
+	if (sTxPowerAtCentral(ucStep, sAverage) < TX_POWER_TARGET_DBM * 10) {
+		if (ucStep == ucCeiling)
+			return ucTxPowerGo(ucStep, uiNow);
+		ucHold = TX_POWER_HOLD;
+		return ucTxPowerGo(ucStep + 1, uiNow);
+	}
+	// a fade seen at this level keeps it, the level would only come back up
+	if (ucStep > 0 && !ucHold
+			&& sTxPowerAtCentral(ucStep - 1, sWorst)
+					>= (TX_POWER_TARGET_DBM + TX_POWER_HYSTERESIS_DB) * 10) {
+		ucHold = TX_POWER_HOLD;
+		return ucTxPowerGo(ucStep - 1, uiNow);
+	}
+	return ucTxPowerGo(ucStep, uiNow);
+}
+
+// the link is struggling, full power at once
+uint8_t ucTxPowerLoss(uint32_t uiNow) {
+	tStats.uiLosses++;
+	ucHold = TX_POWER_LOSS_HOLD;
+	return ucTxPowerGo(ucCeiling, uiNow);
+}
+
+// no link left, advertising goes out at the ceiling and the average restarts
+uint8_t ucTxPowerReset(uint32_t uiNow) {
+	ucAveraged = 0;
+	ucHold = 0;
+	return ucTxPowerGo(ucCeiling, uiNow);
+}
+
+uint8_t ucTxPowerLevel(void) {
+	return aSteps[ucStep].ucLevel;
+}
+
+void vTxPowerGetStats(TxPowerStats *stats, uint32_t uiNow) {
+	vTxPowerAccount(uiNow);
+	*stats = tStats;
+	stats->ucLevel = aSteps[ucStep].ucLevel;
+	stats->sPower = aSteps[ucStep].sPower;
+	stats->sRssi = sAverage;
+}
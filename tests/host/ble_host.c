@@ -0,0 +1,382 @@
+/*
+ * ble_host.c
+ *
+ * See ble_host.h. app_entry.c itself drags in the RTC, the system channel
+ * and the clock tree, the part of it the BLE application depends on is
+ * mirrored here: the mailbox and memory manager set up the same way, the
+ * periodic tasks on one timer and the idle hooks of the scheduler. The page
+ * with the device UID reads erased, so app_ble.c takes its static address.
+ */
+
+#include "ble_host.h"
+#include "hal_host.h"
+#include "app_common.h"
+#include "app_entry.h"
+#include "app_ble.h"
+#include "ble.h"
+#include "tl.h"
+#include "hw.h"
+#include "shci.h"
+#include "lpm.h"
+#include "otp.h"
+#include "scheduler.h"
+#include "sch_periodic.h"
+#include "history.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+
+#define BLE_HOST_TIMERS 8
+#define BLE_HOST_UID_PAGE 0x1FFF7000UL
+#define BLE_HOST_POOL_SIZE (CFG_TLBLE_EVT_QUEUE_LENGTH * 4U \
+		* DIVC((sizeof(TL_PacketHeader_t) + TL_BLE_EVENT_FRAME_SIZE), 4U))
+
+typedef struct {
+	HW_TS_pTimerCb_t pfCallback;
+	HW_TS_Mode_t eMode;
+	uint8_t ucCreated;
+	uint8_t ucRunning;
+	uint32_t uiTicks;
+	uint64_t ulDue;
+} Timer;
+
+uint32_t uiHostPrimask;
+uint32_t SystemCoreClock = 64000000;
+// main.c
+uint8_t ucOledStatusFlag = 7;
+
+static uint8_t aEvtPool[BLE_HOST_POOL_SIZE] __attribute__((aligned(4)));
+static uint8_t aBleSpare[sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + 255] __attribute__((aligned(4)));
+static uint8_t aSysSpare[sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + 255] __attribute__((aligned(4)));
+static Timer aTimers[BLE_HOST_TIMERS];
+static uint8_t ucPeriodicTimer;
+static uint64_t ulRunEnd;
+static uint8_t ucWaitDepth;
+static BleHostStats tStats;
+static void (*pfIrqHandler)(void);
+static uint32_t uiIrqPeriodUs;
+static uint64_t ulIrqDue;
+static uint64_t ulWokeUs;
+
+// local function prototypes
+static void vUidPage(void);
+static uint64_t ulTimerNextDue(void);
+static uint8_t ucFireDue(void);
+static void vPeriodicRelease(void);
+static void vPeriodicArm(void);
+static void vPeriodicTimer(void);
+
+//local functions
+// erased UID page at the address LL_FLASH_GetUDN() reads
+static void vUidPage(void) {
+	static uint8_t mapped;
+	void *page;
+
+	if (mapped)
+		return;
+	page = mmap((void *) BLE_HOST_UID_PAGE, 4096, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (page != (void *) BLE_HOST_UID_PAGE) {
+		printf("ble_host: cannot map the UID page\n");
+		abort();
+	}
+	memset(page, 0xFF, 4096);
+	mapped = 1;
+}
+
+static uint64_t ulTimerNextDue(void) {
+	uint64_t due = UINT64_MAX;
+	uint8_t i;
+
+	for (i = 0; i < BLE_HOST_TIMERS; i++) {
+		if (aTimers[i].ucRunning && aTimers[i].ulDue < due)
+			due = aTimers[i].ulDue;
+	}
+	if (uiIrqPeriodUs && ulIrqDue < due)
+		due = ulIrqDue;
+	return due;
+}
+
+// the RTC and IPCC interrupts of what is due, 1 if any came
+static uint8_t ucFireDue(void) {
+	uint8_t i, fired = 0;
+
+	for (i = 0; i < BLE_HOST_TIMERS; i++) {
+		if (!aTimers[i].ucRunning || aTimers[i].ulDue > ulHostUs())
+			continue;
+		if (aTimers[i].eMode == hw_ts_Repeated)
+			aTimers[i].ulDue += (uint64_t) aTimers[i].uiTicks * CFG_TS_TICK_VAL;
+		else
+			aTimers[i].ucRunning = 0;
+		aTimers[i].pfCallback();
+		fired = 1;
+	}
+	if (uiIrqPeriodUs && ulIrqDue <= ulHostUs()) {
+		ulIrqDue += uiIrqPeriodUs;
+		pfIrqHandler();
+		fired = 1;
+	}
+	if (ulCpu2HostNextDue() <= ulHostUs()) {
+		vCpu2HostRun();
+		fired = 1;
+	}
+	return fired;
+}
+
+// as Periodic_Release(), Periodic_Arm() and Periodic_Timer() of app_entry.c
+static void vPeriodicRelease(void) {
+	uint32_t released = uiSchPeriodicRelease(HAL_GetTick());
+
+	if (released)
+		SCH_SetTask(released, CFG_SCH_PRIO_0);
+	vPeriodicArm();
+}
+
+static void vPeriodicArm(void) {
+	uint32_t next = uiSchPeriodicNext(HAL_GetTick());
+	uint32_t ticks = (next * 1000 + CFG_TS_TICK_VAL - 1) / CFG_TS_TICK_VAL;
+
+	if (next == SCH_PERIODIC_IDLE)
+		HW_TS_Stop(ucPeriodicTimer);
+	else if (next == 0)
+		SCH_SetTask(1 << CFG_TASK_SCH_PERIODIC_ID, CFG_SCH_PRIO_0);
+	else
+		HW_TS_Start(ucPeriodicTimer, ticks);
+}
+
+static void vPeriodicTimer(void) {
+	SCH_SetTask(1 << CFG_TASK_SCH_PERIODIC_ID, CFG_SCH_PRIO_0);
+}
+
+// Global Function Definitions
+void vBleHostInit(void) {
+	TL_MM_Config_t mm;
+
+	vHostReset();
+	vCpu2HostReset();
+	vUidPage();
+	memset(aTimers, 0, sizeof(aTimers));
+	memset(&tStats, 0, sizeof(tStats));
+	ucWaitDepth = 0;
+	ulRunEnd = 0;
+	uiIrqPeriodUs = 0;
+	ulWokeUs = 0;
+
+	TL_Init();
+	mm.p_BleSpareEvtBuffer = aBleSpare;
+	mm.p_SystemSpareEvtBuffer = aSysSpare;
+	mm.p_AsynchEvtPool = aEvtPool;
+	mm.AsynchEvtPoolSize = BLE_HOST_POOL_SIZE;
+	TL_MM_Init(&mm);
+	TL_Enable();
+
+	vSchPeriodicInit();
+	SCH_RegTask(CFG_TASK_SCH_PERIODIC_ID, vPeriodicRelease);
+	HW_TS_Create(CFG_TIM_PROC_ID_ISR, &ucPeriodicTimer, hw_ts_SingleShot, vPeriodicTimer);
+	// as main() does before the BLE stack comes up
+	vHistoryInit();
+
+	APP_BLE_Init();
+	vBleHostRun(10);
+}
+
+void vBleHostIrq(uint32_t uiPeriodUs, void (*pfHandler)(void)) {
+	pfIrqHandler = pfHandler;
+	uiIrqPeriodUs = uiPeriodUs;
+	ulIrqDue = ulHostUs() + uiPeriodUs;
+}
+
+void vBleHostRun(uint32_t uiMs) {
+	vBleHostRunUs(uiMs * 1000);
+}
+
+void vBleHostRunUs(uint32_t uiUs) {
+	ulRunEnd = ulHostUs() + uiUs;
+	while (ulHostUs() < ulRunEnd)
+		SCH_Run(~0);
+	// what became due at the end is taken too
+	ucFireDue();
+	SCH_Run(~0);
+}
+
+void vBleHostBusyUs(uint32_t uiUs) {
+	uint64_t end = ulHostUs() + uiUs;
+	uint64_t next;
+
+	for (;;) {
+		ucFireDue();
+		next = ulTimerNextDue();
+		if (ulCpu2HostNextDue() < next)
+			next = ulCpu2HostNextDue();
+		if (next > end)
+			break;
+		if (next > ulHostUs())
+			vHostAdvanceUs((uint32_t) (next - ulHostUs()));
+	}
+	vHostAdvanceUs((uint32_t) (end - ulHostUs()));
+}
+
+uint16_t usBleHostChar(uint8_t ucUuidLast) {
+	uint8_t uuid[16] = BLE_HOST_UUID(ucUuidLast);
+
+	return usCpu2HostFindChar(uuid);
+}
+
+uint16_t usBleHostConnect(const Cpu2HostCentral *pCentral) {
+	uint16_t conn = usCpu2HostConnect(pCentral);
+
+	vBleHostRun(BLE_HOST_LINK_SETUP_MS);
+	return conn;
+}
+
+void vBleHostGetStats(BleHostStats *pStats) {
+	*pStats = tStats;
+}
+
+void vBleHostClearStats(void) {
+	memset(&tStats, 0, sizeof(tStats));
+	ulWokeUs = ulHostUs();
+}
+
+uint32_t uiBleHostCycles(void) {
+	return (uint32_t) (ulHostUs() * (SystemCoreClock / 1000000));
+}
+
+/*
+ * Scheduler idle hooks, SCH_Idle() runs with the interrupts off like the
+ * WFI of the firmware
+ */
+void SCH_Idle(void) {
+	uint64_t now = ulHostUs();
+	uint64_t next = ulTimerNextDue();
+	uint64_t cpu2 = ulCpu2HostNextDue();
+
+	if (cpu2 < next)
+		next = cpu2;
+	if (ucWaitDepth == 0 && next > ulRunEnd)
+		next = ulRunEnd;
+	if (next == UINT64_MAX) {
+		printf("ble_host: CPU2 never answered\n");
+		abort();
+	}
+	if (next > now) {
+		vHostAdvanceUs((uint32_t) (next - now));
+		if (ucWaitDepth) {
+			tStats.ulStallUs += next - now;
+			if (next - now > tStats.uiStallMaxUs)
+				tStats.uiStallMaxUs = (uint32_t) (next - now);
+		} else {
+			tStats.ulSleepUs += next - now;
+			if (now - ulWokeUs > tStats.uiAwakeMaxUs)
+				tStats.uiAwakeMaxUs = (uint32_t) (now - ulWokeUs);
+			ulWokeUs = next;
+		}
+	}
+	if (ucFireDue() && next > now && ucWaitDepth == 0)
+		tStats.uiWakeups++;
+}
+
+void SCH_EvtIdle(uint32_t evt_waited_bm) {
+	(void) evt_waited_bm;
+	if (ucWaitDepth++ == 0)
+		tStats.uiStalls++;
+	SCH_Run(~0);
+	ucWaitDepth--;
+}
+
+/*
+ * Timer server on the virtual clock
+ */
+HW_TS_ReturnStatus_t HW_TS_Create(uint32_t TimerProcessID, uint8_t *pTimerId, HW_TS_Mode_t TimerMode,
+		HW_TS_pTimerCb_t pTimerCallBack) {
+	uint8_t i;
+
+	(void) TimerProcessID;
+	for (i = 0; i < BLE_HOST_TIMERS; i++) {
+		if (aTimers[i].ucCreated)
+			continue;
+		memset(&aTimers[i], 0, sizeof(aTimers[i]));
+		aTimers[i].ucCreated = 1;
+		aTimers[i].eMode = TimerMode;
+		aTimers[i].pfCallback = pTimerCallBack;
+		*pTimerId = i;
+		return hw_ts_Successful;
+	}
+	return hw_ts_Failed;
+}
+
+void HW_TS_Start(uint8_t TimerID, uint32_t timeout_ticks) {
+	aTimers[TimerID].uiTicks = timeout_ticks;
+	aTimers[TimerID].ulDue = ulHostUs() + (uint64_t) timeout_ticks * CFG_TS_TICK_VAL;
+	aTimers[TimerID].ucRunning = 1;
+}
+
+void HW_TS_Stop(uint8_t TimerID) {
+	aTimers[TimerID].ucRunning = 0;
+}
+
+void HW_TS_Delete(uint8_t TimerID) {
+	aTimers[TimerID].ucCreated = 0;
+	aTimers[TimerID].ucRunning = 0;
+}
+
+/*
+ * What app_entry.c gives the application
+ */
+uint8_t APPE_Periodic_Register(uint8_t task_id, uint32_t period_ms, uint32_t deadline_ms) {
+	return ucSchPeriodicRegister(task_id, period_ms, deadline_ms);
+}
+
+void APPE_Periodic_Enable(uint8_t task_id, uint8_t enable) {
+	vSchPeriodicEnable(task_id, enable, HAL_GetTick());
+	vPeriodicArm();
+}
+
+// the sensor stays as it is, main.c powers it
+void setActiveSensor(uint8_t data) {
+	(void) data;
+}
+
+/*
+ * System channel, low power manager and OTP: CPU2 takes the BLE
+ * configuration, the OTP holds nothing
+ */
+SHCI_CmdStatus_t SHCI_C2_BLE_Init(SHCI_C2_Ble_Init_Cmd_Packet_t *pCmdPacket) {
+	(void) pCmdPacket;
+	return SHCI_Success;
+}
+
+void LPM_SetOffMode(uint32_t id, LPM_OffModeSel_t mode) {
+	(void) id;
+	(void) mode;
+}
+
+void LPM_SetStopMode(uint32_t id, LPM_StopModeSel_t mode) {
+	(void) id;
+	(void) mode;
+}
+
+uint8_t *OTP_Read(uint8_t id) {
+	(void) id;
+	return NULL;
+}
+
+// the traces of the stack only with BLE_HOST_TRACE set
+int iHostTrace(const char *pFormat, ...) {
+	va_list args;
+	int n;
+
+	if (getenv("BLE_HOST_TRACE") == NULL)
+		return 0;
+	va_start(args, pFormat);
+	n = vprintf(pFormat, args);
+	va_end(args);
+	return n;
+}
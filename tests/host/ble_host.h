@@ -0,0 +1,54 @@
+/*
+ * ble_host.h
+ *
+ * The BLE application as app_entry.c runs it, on a virtual microsecond clock:
+ * the scheduler sleeps in SCH_Idle() until the next timer server expiry or
+ * the next answer or event of cpu2_host.c, and time spent waiting in
+ * SCH_EvtIdle() for a command answer is accounted as a main loop stall.
+ */
+
+#ifndef BLE_HOST_H_
+#define BLE_HOST_H_
+#include "cpu2_host.h"
+
+// 128 bit UUIDs of the smart watch characteristics, LSB first as the GATT
+// database holds them, they differ in the last octet
+#define BLE_HOST_UUID(last) { 0xe4, 0xcc, 0xdb, 0xe2, 0x2a, 0x2a, 0xa9, 0x98, \
+		0xe9, 0x11, 0x71, 0xdd, 0xee, 0x8a, 0x53, (last) }
+#define BLE_HOST_HR 0x54
+#define BLE_HOST_DATA 0x24
+#define BLE_HOST_DIAG 0x44
+#define BLE_HOST_HISTORY 0x04
+#define BLE_HOST_HISTORY_CP 0x05
+// link setup of app_ble.c, MTU, data length, PHY and parameters, takes less
+#define BLE_HOST_LINK_SETUP_MS 2000
+
+typedef struct {
+	uint64_t ulSleepUs;        // idle with nothing to wait for
+	uint32_t uiWakeups;        // sleeps ended by a timer or a CPU2 event
+	uint32_t uiAwakeMaxUs;     // longest the main loop ran between two sleeps
+	uint64_t ulStallUs;        // waited for a command answer
+	uint32_t uiStallMaxUs;     // longest single wait
+	uint32_t uiStalls;
+} BleHostStats;
+
+// host clock, CPU2 and the transport reset, the application up to advertising
+void vBleHostInit(void);
+// an EXTI line going off every uiPeriodUs from now, as the MAX30102 INT does,
+// pfHandler runs as its interrupt handler; a period of 0 stops it
+void vBleHostIrq(uint32_t uiPeriodUs, void (*pfHandler)(void));
+void vBleHostRun(uint32_t uiMs);
+void vBleHostRunUs(uint32_t uiUs);
+// the main loop stuck in a task: timers and CPU2 interrupt it, their tasks
+// and the events CPU2 sends wait until it is done
+void vBleHostBusyUs(uint32_t uiUs);
+// value handle of a smart watch characteristic, 0 if the build has none
+uint16_t usBleHostChar(uint8_t ucUuidLast);
+// a virtual central connects and the link setup runs to its end
+uint16_t usBleHostConnect(const Cpu2HostCentral *pCentral);
+void vBleHostGetStats(BleHostStats *pStats);
+void vBleHostClearStats(void);
+// the cycle counter hci_tl.c reads, at SystemCoreClock on the virtual clock
+uint32_t uiBleHostCycles(void);
+
+#endif /* BLE_HOST_H_ */
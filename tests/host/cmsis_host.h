@@ -0,0 +1,98 @@
+/*
+ * cmsis_host.h
+ *
+ * Forced into the BLE stack sources in place of cmsis_gcc.h, whose intrinsics
+ * are Cortex-M instructions. There is one thread and no interrupt on the
+ * host, PRIMASK is a variable and the barriers and sleep hints do nothing.
+ */
+
+#ifndef CMSIS_HOST_H_
+#define CMSIS_HOST_H_
+#define __CMSIS_GCC_H
+#include <stdint.h>
+
+#ifndef __ASM
+#define __ASM __asm
+#endif
+#ifndef __INLINE
+#define __INLINE inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE static inline
+#endif
+#ifndef __NO_RETURN
+#define __NO_RETURN __attribute__((__noreturn__))
+#endif
+#ifndef __USED
+#define __USED __attribute__((used))
+#endif
+#ifndef __WEAK
+#define __WEAK __attribute__((weak))
+#endif
+#ifndef __PACKED
+#define __PACKED __attribute__((packed, aligned(1)))
+#endif
+#ifndef __PACKED_STRUCT
+#define __PACKED_STRUCT struct __attribute__((packed, aligned(1)))
+#endif
+#ifndef __PACKED_UNION
+#define __PACKED_UNION union __attribute__((packed, aligned(1)))
+#endif
+#ifndef __ALIGNED
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#endif
+#ifndef __RESTRICT
+#define __RESTRICT __restrict
+#endif
+
+extern uint32_t uiHostPrimask;
+
+__STATIC_INLINE uint32_t __get_PRIMASK(void) {
+	return uiHostPrimask;
+}
+
+__STATIC_INLINE void __set_PRIMASK(uint32_t priMask) {
+	uiHostPrimask = priMask;
+}
+
+__STATIC_INLINE void __disable_irq(void) {
+	uiHostPrimask = 1;
+}
+
+__STATIC_INLINE void __enable_irq(void) {
+	uiHostPrimask = 0;
+}
+
+__STATIC_INLINE uint32_t __get_IPSR(void) {
+	return 0;
+}
+
+__STATIC_INLINE uint32_t __CLZ(uint32_t value) {
+	return value ? (uint32_t) __builtin_clz(value) : 32;
+}
+
+__STATIC_INLINE uint32_t __REV(uint32_t value) {
+	return __builtin_bswap32(value);
+}
+
+__STATIC_INLINE uint32_t __RBIT(uint32_t value) {
+	uint32_t result = 0;
+	uint8_t i;
+
+	for (i = 0; i < 32; i++, value >>= 1)
+		result = (result << 1) | (value & 1);
+	return result;
+}
+
+#define __NOP()
+#define __WFI()
+#define __WFE()
+#define __SEV()
+#define __ISB()
+#define __DSB()
+#define __DMB()
+
+#endif /* CMSIS_HOST_H_ */
@@ -0,0 +1,1103 @@
+/*
+ * cpu2_host.c
+ *
+ * See cpu2_host.h. The mailbox tables are found through the MAPPING_TABLE
+ * section TL_Init() fills, like CPU2 finds them at the start of SRAM2. Every
+ * event takes the room its header and parameters need, rounded to a word,
+ * from the pool given to TL_MM_Init(), first fit, and waits while no gap is
+ * large enough. The buffers CPU1 puts in the free buffer queue go back to the
+ * pool when it signals them.
+ */
+
+#include "cpu2_host.h"
+#include "hal_host.h"
+#include "app_common.h"
+#include "app_ble.h"
+#include "ble.h"
+#include "tl.h"
+#include "mbox_def.h"
+#include "stm_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+#ifndef EVT_LE_DATA_LENGTH_CHANGE
+#define EVT_LE_DATA_LENGTH_CHANGE 0x07
+#endif
+
+#define CPU2_HOST_ATTRS 96
+#define CPU2_HOST_PENDING 256
+#define CPU2_HOST_OPCODES 24
+#define CPU2_HOST_NO_LINK 0xFF
+#define CPU2_HOST_CONN_FIRST 0x0801
+// ATT procedure timeout of the stack
+#define CPU2_HOST_ATT_TIMEOUT_US 30000000
+#define CPU2_HOST_BUFFER_SIZE (DIVC(sizeof(TL_PacketHeader_t) + TL_BLE_EVENT_FRAME_SIZE, 4) * 4)
+// event buffers CPU1 may hold at once
+#define CPU2_HOST_HELD 128
+
+enum {
+	ATTR_FREE, ATTR_SERVICE, ATTR_CHAR, ATTR_VALUE, ATTR_CCCD
+};
+
+enum {
+	PENDING_EVENT, PENDING_CC, PENDING_CS
+};
+
+typedef struct {
+	uint8_t ucKind;
+	uint16_t usService;        // service declaration of the attribute
+	uint16_t usEnd;            // service declaration: last handle it may use
+	uint8_t aUuid[16];
+	uint8_t ucProps;
+	uint8_t ucEvtMask;
+	uint16_t usSize;
+	uint16_t usLen;
+	uint8_t ucCccd;            // CCCD: bit per link slot
+	uint8_t aValue[CPU2_HOST_VALUE_MAX];
+} Attr;
+
+typedef struct {
+	uint16_t usConn;           // 0 for a free slot
+	Cpu2HostCentral tCentral;
+	uint16_t usMtu;
+	uint16_t usOctets;
+	uint8_t ucPhy;
+	uint16_t usInterval;
+	uint16_t usLatency;
+	uint16_t usTimeout;
+	uint16_t usReadHandle;     // read waiting for aci_gatt_allow_read()
+} Link;
+
+typedef struct {
+	uint64_t ulDue;
+	uint32_t uiSeq;
+	uint8_t ucBlocked;         // found no room in the pool, waits for a buffer to come back
+	uint8_t ucDelayed;         // counted in uiEventsDelayed
+	uint8_t ucKind;
+	uint8_t ucLen;             // parameters
+	uint8_t aData[2 + 255];    // evtcode, plen, parameters
+} Pending;
+
+// pool bytes an event buffer CPU1 holds takes
+typedef struct {
+	uint16_t usOffset;
+	uint16_t usSize;
+} Held;
+
+typedef struct {
+	uint16_t usOpcode;
+	uint8_t ucStatus;
+	uint32_t uiCount;
+	uint8_t ucLen;
+	uint8_t aParams[255];
+} Opcode;
+
+// the command status answers, everything else gets a command complete
+static const uint16_t ausStatusOpcodes[] = {
+	CPU2_HOST_GATT_EXCHANGE_CONFIG, CPU2_HOST_LE_SET_PHY,
+	CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ, CPU2_HOST_OPCODE(0x3F, 0x093),
+	CPU2_HOST_OPCODE(0x01, 0x006)
+};
+
+static Attr aAttrs[CPU2_HOST_ATTRS];
+static uint16_t usNextHandle;
+static Link aLinks[CPU2_HOST_CENTRALS];
+static Pending aPending[CPU2_HOST_PENDING];
+static uint16_t usPending;
+static uint32_t uiSeq;
+static Opcode aOpcodes[CPU2_HOST_OPCODES];
+static uint8_t ucOpcodes;
+static Cpu2HostNotify aNotify[CPU2_HOST_NOTIFY_LOG];
+static uint16_t usNotify;
+static Cpu2HostUpdate aUpdates[CPU2_HOST_UPDATE_LOG];
+static uint16_t usUpdates;
+static Cpu2HostStats tStats;
+static uint32_t uiLatencyUs;
+static uint8_t ucRefuseN, ucRefuseM;
+static uint32_t uiRefuseCount;
+static uint32_t uiPoolUs;
+static uint8_t aAdvData[31];
+static uint8_t ucAdvLen;
+static uint8_t ucAdvertising;
+static uint8_t ucTxPower;
+static Held aHeld[CPU2_HOST_HELD];
+static uint8_t ucHeld;
+static uint16_t usPoolUsed;
+static uint16_t usPoolLimit;
+
+// MB_RefTable_t of tl_mbox.c, the linker marks where its section starts
+extern MB_RefTable_t __start_MAPPING_TABLE[];
+
+// local function prototypes
+static Opcode *pOpcode(uint16_t usOpcode, uint8_t ucCreate);
+static Link *pLink(uint16_t usConn);
+static uint8_t ucLinkSlot(uint16_t usConn);
+static void vSchedule(uint8_t ucKind, const uint8_t *pEvt, uint8_t ucLen, uint64_t ulDue);
+static void vEvent(uint8_t ucEvtCode, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs);
+static void vVendorEvent(uint16_t usCode, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs);
+static void vMetaEvent(uint8_t ucSub, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs);
+static uint8_t ucDeliver(Pending *pPending);
+static void vReply(uint16_t usOpcode, uint8_t ucStatus, const uint8_t *pRet, uint8_t ucRetLen);
+static uint16_t usAlloc(uint8_t ucKind, uint16_t usService);
+static void vNotify(uint16_t usValue, uint16_t usConn, uint16_t usLen);
+static uint8_t ucNotifyTargets(uint16_t usValue, uint16_t usConn);
+static uint8_t ucRefused(uint16_t usConn);
+static void vAdvMerge(const uint8_t *pData, uint8_t ucLen);
+static void vCommand(uint16_t usOpcode, const uint8_t *pParams, uint8_t ucLen);
+static void vPoolInit(void);
+static uint8_t *pPoolAlloc(uint16_t usSize);
+static void vPoolRelease(const uint8_t *pBuffer);
+
+//local functions
+static uint16_t usGet16(const uint8_t *p) {
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void vPut16(uint8_t *p, uint16_t usValue) {
+	p[0] = (uint8_t) usValue;
+	p[1] = (uint8_t) (usValue >> 8);
+}
+
+static Opcode *pOpcode(uint16_t usOpcode, uint8_t ucCreate) {
+	uint8_t i;
+
+	for (i = 0; i < ucOpcodes; i++) {
+		if (aOpcodes[i].usOpcode == usOpcode)
+			return &aOpcodes[i];
+	}
+	if (!ucCreate || ucOpcodes == CPU2_HOST_OPCODES)
+		return NULL;
+	memset(&aOpcodes[ucOpcodes], 0, sizeof(aOpcodes[0]));
+	aOpcodes[ucOpcodes].usOpcode = usOpcode;
+	return &aOpcodes[ucOpcodes++];
+}
+
+static uint8_t ucLinkSlot(uint16_t usConn) {
+	uint8_t i;
+
+	for (i = 0; i < CPU2_HOST_CENTRALS; i++) {
+		if (aLinks[i].usConn != 0 && aLinks[i].usConn == usConn)
+			return i;
+	}
+	return CPU2_HOST_NO_LINK;
+}
+
+static Link *pLink(uint16_t usConn) {
+	uint8_t slot = ucLinkSlot(usConn);
+
+	return slot == CPU2_HOST_NO_LINK ? NULL : &aLinks[slot];
+}
+
+static void vSchedule(uint8_t ucKind, const uint8_t *pEvt, uint8_t ucLen, uint64_t ulDue) {
+	Pending *pending;
+
+	if (usPending == CPU2_HOST_PENDING) {
+		printf("cpu2_host: more than %u events pending\n", CPU2_HOST_PENDING);
+		abort();
+	}
+	pending = &aPending[usPending++];
+	pending->ulDue = ulDue;
+	pending->ucBlocked = 0;
+	pending->ucDelayed = 0;
+	pending->uiSeq = uiSeq++;
+	pending->ucKind = ucKind;
+	pending->ucLen = ucLen;
+	memcpy(pending->aData, pEvt, 2 + ucLen);
+}
+
+static void vEvent(uint8_t ucEvtCode, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs) {
+	uint8_t evt[2 + 255];
+
+	evt[0] = ucEvtCode;
+	evt[1] = ucLen;
+	memcpy(&evt[2], pParams, ucLen);
+	vSchedule(PENDING_EVENT, evt, ucLen, ulHostUs() + uiLatencyUs + uiDelayUs);
+}
+
+static void vVendorEvent(uint16_t usCode, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs) {
+	uint8_t params[255];
+
+	vPut16(params, usCode);
+	memcpy(&params[2], pParams, ucLen);
+	vEvent(EVT_VENDOR, params, ucLen + 2, uiDelayUs);
+}
+
+static void vMetaEvent(uint8_t ucSub, const void *pParams, uint8_t ucLen, uint32_t uiDelayUs) {
+	uint8_t params[255];
+
+	params[0] = ucSub;
+	memcpy(&params[1], pParams, ucLen);
+	vEvent(EVT_LE_META_EVENT, params, ucLen + 1, uiDelayUs);
+}
+
+// into the mailbox, 0 while the pool has no room for it
+static uint8_t ucDeliver(Pending *pPending) {
+	MB_RefTable_t *ref = __start_MAPPING_TABLE;
+	tListNode *buffer;
+	TL_EvtPacket_t *packet;
+	uint64_t wait;
+	uint16_t free;
+
+	if (pPending->ucKind == PENDING_EVENT) {
+		buffer = (tListNode *) pPoolAlloc((uint16_t) (DIVC(sizeof(TL_PacketHeader_t)
+				+ TL_EVT_HDR_SIZE + pPending->ucLen, 4) * 4));
+		if (buffer == NULL)
+			return 0;
+		free = (uint16_t) ((usPoolLimit - usPoolUsed) / CPU2_HOST_BUFFER_SIZE);
+		if (free < tStats.usPoolFreeMin)
+			tStats.usPoolFreeMin = free;
+		if (usPoolUsed > tStats.usPoolUsedMax)
+			tStats.usPoolUsedMax = usPoolUsed;
+		if (ucHeld > tStats.usHeldMax)
+			tStats.usHeldMax = ucHeld;
+		wait = ulHostUs() - pPending->ulDue;
+		if (wait > tStats.ulPoolWaitUs)
+			tStats.ulPoolWaitUs = wait;
+		tStats.uiEvents++;
+	} else if (pPending->ucKind == PENDING_CC) {
+		buffer = (tListNode *) ref->p_ble_table->pcmd_buffer;
+	} else {
+		buffer = (tListNode *) ref->p_ble_table->pcs_buffer;
+	}
+	packet = (TL_EvtPacket_t *) buffer;
+	packet->evtserial.type = TL_BLEEVT_PKT_TYPE;
+	memcpy(&packet->evtserial.evt, pPending->aData, 2 + pPending->ucLen);
+	LST_insert_tail((tListNode *) ref->p_ble_table->pevt_queue, buffer);
+	HW_IPCC_BLE_RxEvtNot();
+	return 1;
+}
+
+static void vReply(uint16_t usOpcode, uint8_t ucStatus, const uint8_t *pRet, uint8_t ucRetLen) {
+	uint8_t evt[2 + 255];
+	uint8_t i, status = 0;
+
+	for (i = 0; i < sizeof(ausStatusOpcodes) / sizeof(ausStatusOpcodes[0]); i++) {
+		if (ausStatusOpcodes[i] == usOpcode)
+			status = 1;
+	}
+	if (status) {
+		evt[0] = TL_BLEEVT_CS_OPCODE;
+		evt[1] = 4;
+		evt[2] = ucStatus;
+		evt[3] = 1;
+		vPut16(&evt[4], usOpcode);
+		vSchedule(PENDING_CS, evt, 4, ulHostUs() + uiLatencyUs);
+		return;
+	}
+	evt[0] = TL_BLEEVT_CC_OPCODE;
+	evt[1] = (uint8_t) (3 + 1 + ucRetLen);
+	evt[2] = 1;
+	vPut16(&evt[3], usOpcode);
+	evt[5] = ucStatus;
+	memcpy(&evt[6], pRet, ucRetLen);
+	vSchedule(PENDING_CC, evt, evt[1], ulHostUs() + uiLatencyUs);
+}
+
+static uint16_t usAlloc(uint8_t ucKind, uint16_t usService) {
+	uint16_t handle;
+
+	if (usService != 0) {
+		// inside the range the service declared
+		handle = usService + 1;
+		while (handle <= aAttrs[usService].usEnd && aAttrs[handle].ucKind != ATTR_FREE)
+			handle++;
+		if (handle > aAttrs[usService].usEnd)
+			return 0;
+	} else {
+		handle = usNextHandle;
+	}
+	if (handle >= CPU2_HOST_ATTRS)
+		return 0;
+	memset(&aAttrs[handle], 0, sizeof(aAttrs[handle]));
+	aAttrs[handle].ucKind = ucKind;
+	aAttrs[handle].usService = usService ? usService : handle;
+	if (usService == 0)
+		usNextHandle = handle + 1;
+	return handle;
+}
+
+static uint8_t ucNotifyTargets(uint16_t usValue, uint16_t usConn) {
+	uint8_t slot;
+	uint8_t cccd;
+
+	if (!(aAttrs[usValue].ucProps & (CHAR_PROP_NOTIFY | CHAR_PROP_INDICATE))
+			|| aAttrs[usValue + 1].ucKind != ATTR_CCCD)
+		return 0;
+	cccd = aAttrs[usValue + 1].ucCccd;
+	if (usConn == 0)
+		return cccd;
+	slot = ucLinkSlot(usConn);
+	return slot == CPU2_HOST_NO_LINK ? 0 : cccd & (1 << slot);
+}
+
+static void vNotify(uint16_t usValue, uint16_t usConn, uint16_t usLen) {
+	Cpu2HostNotify *notify;
+	Link *link = pLink(usConn);
+	uint16_t len = usLen;
+
+	if (link != NULL && len > link->usMtu - 3)
+		len = link->usMtu - 3;
+	tStats.uiNotifications++;
+	tStats.uiNotifyBytes += len;
+	if (usNotify == CPU2_HOST_NOTIFY_LOG)
+		return;
+	notify = &aNotify[usNotify++];
+	notify->ulUs = ulHostUs();
+	notify->usConn = usConn;
+	notify->usHandle = usValue;
+	notify->usLen = len;
+	memcpy(notify->aData, aAttrs[usValue].aValue, len);
+}
+
+// the TX pool is short for this update, the event telling it is free follows
+static uint8_t ucRefused(uint16_t usConn) {
+	aci_gatt_tx_pool_available_event_rp0 pool;
+	uint8_t slot;
+
+	if (ucRefuseM == 0 || (uiRefuseCount++ % ucRefuseM) >= ucRefuseN)
+		return 0;
+	tStats.uiRefused++;
+	if (usConn == 0) {
+		for (slot = 0; slot < CPU2_HOST_CENTRALS && aLinks[slot].usConn == 0; slot++)
+			;
+		usConn = slot < CPU2_HOST_CENTRALS ? aLinks[slot].usConn : 0;
+	}
+	pool.Connection_Handle = usConn;
+	pool.Available_Buffers = 1;
+	vVendorEvent(EVT_BLUE_GATT_TX_POOL_AVAILABLE, &pool, sizeof(pool), uiPoolUs);
+	return 1;
+}
+
+// AD structures replace the one of the same type or are appended
+static void vAdvMerge(const uint8_t *pData, uint8_t ucLen) {
+	uint8_t merged[31 + 31];
+	uint8_t i = 0, j, k, len, found;
+
+	memcpy(merged, aAdvData, ucAdvLen);
+	len = ucAdvLen;
+	while (i + 1 < ucLen && pData[i] != 0) {
+		found = 0;
+		for (j = 0; j + 1 < len; j += merged[j] + 1) {
+			if (merged[j + 1] != pData[i + 1])
+				continue;
+			// drop the old one, the new one goes at the end
+			k = merged[j] + 1;
+			memmove(&merged[j], &merged[j + k], len - j - k);
+			len -= k;
+			found = 1;
+			break;
+		}
+		(void) found;
+		memcpy(&merged[len], &pData[i], pData[i] + 1);
+		len += pData[i] + 1;
+		i += pData[i] + 1;
+	}
+	ucAdvLen = len > sizeof(aAdvData) ? sizeof(aAdvData) : len;
+	memcpy(aAdvData, merged, ucAdvLen);
+}
+
+static void vCommand(uint16_t usOpcode, const uint8_t *pParams, uint8_t ucLen) {
+	Opcode *opcode = pOpcode(usOpcode, 1);
+	uint8_t ret[16];
+	uint8_t status = 0;
+	uint16_t handle, service, value, conn, len, offset;
+	Link *link;
+
+	tStats.uiCommands++;
+	if (opcode != NULL) {
+		opcode->uiCount++;
+		opcode->ucLen = ucLen;
+		memcpy(opcode->aParams, pParams, ucLen);
+		status = opcode->ucStatus;
+	}
+	if (status != 0) {
+		vReply(usOpcode, status, NULL, 0);
+		return;
+	}
+	memset(ret, 0, sizeof(ret));
+
+	switch (usOpcode) {
+	case CPU2_HOST_OPCODE(0x3F, 0x101): // aci_gatt_init, GATT service and service changed
+		service = usAlloc(ATTR_SERVICE, 0);
+		aAttrs[service].usEnd = service + 3;
+		usNextHandle = service + 4;
+		usAlloc(ATTR_CHAR, service);
+		usAlloc(ATTR_VALUE, service);
+		usAlloc(ATTR_CCCD, service);
+		break;
+
+	case CPU2_HOST_OPCODE(0x3F, 0x08A): // aci_gap_init
+		service = usAlloc(ATTR_SERVICE, 0);
+		aAttrs[service].usEnd = service + 6;
+		usNextHandle = service + 7;
+		vPut16(&ret[0], service);
+		usAlloc(ATTR_CHAR, service);
+		vPut16(&ret[2], usAlloc(ATTR_CHAR, service) - 1);
+		usAlloc(ATTR_VALUE, service);
+		vPut16(&ret[4], usAlloc(ATTR_CHAR, service));
+		usAlloc(ATTR_VALUE, service);
+		vReply(usOpcode, 0, ret, 6);
+		return;
+
+	case CPU2_HOST_OPCODE(0x3F, 0x102): // aci_gatt_add_service
+		len = pParams[0] == 1 ? 2 : 16;
+		service = usAlloc(ATTR_SERVICE, 0);
+		if (service == 0) {
+			vReply(usOpcode, CPU2_HOST_INSUFFICIENT_RESOURCES, ret, 2);
+			return;
+		}
+		memcpy(aAttrs[service].aUuid, &pParams[1], len);
+		aAttrs[service].usEnd = service + pParams[1 + len + 1] - 1;
+		usNextHandle = aAttrs[service].usEnd + 1;
+		vPut16(ret, service);
+		vReply(usOpcode, 0, ret, 2);
+		return;
+
+	case CPU2_HOST_OPCODE(0x3F, 0x104): // aci_gatt_add_char
+		service = usGet16(pParams);
+		len = pParams[2] == 1 ? 2 : 16;
+		handle = usAlloc(ATTR_CHAR, service);
+		value = handle ? usAlloc(ATTR_VALUE, service) : 0;
+		if (value == 0) {
+			vReply(usOpcode, CPU2_HOST_INSUFFICIENT_RESOURCES, ret, 2);
+			return;
+		}
+		memcpy(aAttrs[value].aUuid, &pParams[3], len);
+		aAttrs[value].usSize = usGet16(&pParams[3 + len]);
+		aAttrs[value].ucProps = pParams[3 + len + 2];
+		aAttrs[value].ucEvtMask = pParams[3 + len + 4];
+		if (aAttrs[value].ucProps & (CHAR_PROP_NOTIFY | CHAR_PROP_INDICATE)) {
+			if (usAlloc(ATTR_CCCD, service) == 0) {
+				vReply(usOpcode, CPU2_HOST_INSUFFICIENT_RESOURCES, ret, 2);
+				return;
+			}
+		}
+		vPut16(ret, handle);
+		vReply(usOpcode, 0, ret, 2);
+		return;
+
+	case CPU2_HOST_GATT_UPDATE_CHAR_VALUE:
+		value = usGet16(&pParams[2]) + 1;
+		offset = pParams[4];
+		len = pParams[5];
+		if (value >= CPU2_HOST_ATTRS || aAttrs[value].ucKind != ATTR_VALUE
+				|| offset + len > aAttrs[value].usSize) {
+			status = BLE_STATUS_INVALID_PARAMS;
+			break;
+		}
+		if (ucNotifyTargets(value, 0) && ucRefused(0)) {
+			status = CPU2_HOST_INSUFFICIENT_RESOURCES;
+			break;
+		}
+		memcpy(&aAttrs[value].aValue[offset], &pParams[6], len);
+		aAttrs[value].usLen = offset + len;
+		for (conn = 0; conn < CPU2_HOST_CENTRALS; conn++) {
+			if (ucNotifyTargets(value, 0) & (1 << conn))
+				vNotify(value, aLinks[conn].usConn, aAttrs[value].usLen);
+		}
+		break;
+
+	case CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT:
+		conn = usGet16(pParams);
+		value = usGet16(&pParams[4]) + 1;
+		len = usGet16(&pParams[7]);
+		offset = usGet16(&pParams[9]);
+		if (value >= CPU2_HOST_ATTRS || aAttrs[value].ucKind != ATTR_VALUE
+				|| len > aAttrs[value].usSize || offset + pParams[11] > len) {
+			status = BLE_STATUS_INVALID_PARAMS;
+			break;
+		}
+		if (pParams[6] != 0 && ucNotifyTargets(value, conn) && ucRefused(conn)) {
+			status = CPU2_HOST_INSUFFICIENT_RESOURCES;
+			break;
+		}
+		memcpy(&aAttrs[value].aValue[offset], &pParams[12], pParams[11]);
+		aAttrs[value].usLen = len;
+		if (usUpdates < CPU2_HOST_UPDATE_LOG) {
+			aUpdates[usUpdates].ulUs = ulHostUs();
+			aUpdates[usUpdates].usConn = conn;
+			aUpdates[usUpdates].usHandle = value;
+			aUpdates[usUpdates].ucType = pParams[6];
+			aUpdates[usUpdates].usCharLen = len;
+			aUpdates[usUpdates].usOffset = offset;
+			aUpdates[usUpdates++].ucLen = pParams[11];
+		}
+		if (pParams[6] == 0)
+			break;
+		for (handle = 0; handle < CPU2_HOST_CENTRALS; handle++) {
+			if (ucNotifyTargets(value, conn) & (1 << handle))
+				vNotify(value, aLinks[handle].usConn, len);
+		}
+		break;
+
+	case CPU2_HOST_GATT_ALLOW_READ:
+		link = pLink(usGet16(pParams));
+		if (link != NULL)
+			link->usReadHandle = 0;
+		break;
+
+	case CPU2_HOST_GATT_EXCHANGE_CONFIG:
+		link = pLink(usGet16(pParams));
+		vReply(usOpcode, link ? 0 : BLE_STATUS_INVALID_PARAMS, NULL, 0);
+		if (link == NULL)
+			return;
+		if (link->tCentral.usMtu == 0) {
+			vVendorEvent(EVT_BLUE_GATT_PROCEDURE_TIMEOUT, pParams, 2, CPU2_HOST_ATT_TIMEOUT_US);
+			return;
+		}
+		link->usMtu = MIN(link->tCentral.usMtu, CFG_BLE_MAX_ATT_MTU);
+		{
+			aci_att_exchange_mtu_resp_event_rp0 mtu = { link->usConn, link->usMtu };
+			aci_gatt_proc_complete_event_rp0 done = { link->usConn, 0 };
+
+			vVendorEvent(EVT_BLUE_ATT_EXCHANGE_MTU_RESP, &mtu, sizeof(mtu), link->usInterval * 1250);
+			vVendorEvent(EVT_BLUE_GATT_PROCEDURE_COMPLETE, &done, sizeof(done), link->usInterval * 1250);
+		}
+		return;
+
+	case CPU2_HOST_LE_SET_DATA_LENGTH:
+		link = pLink(usGet16(pParams));
+		vPut16(ret, usGet16(pParams));
+		vReply(usOpcode, link ? 0 : BLE_STATUS_INVALID_PARAMS, ret, 2);
+		if (link == NULL || link->tCentral.usMaxOctets <= APP_BLE_DEFAULT_TX_OCTETS)
+			return;
+		link->usOctets = MIN(usGet16(&pParams[2]), link->tCentral.usMaxOctets);
+		{
+			hci_le_data_length_change_event_rp0 dle = { link->usConn, link->usOctets,
+					(uint16_t) ((link->usOctets + 14) * 8), link->usOctets,
+					(uint16_t) ((link->usOctets + 14) * 8) };
+
+			vMetaEvent(EVT_LE_DATA_LENGTH_CHANGE, &dle, sizeof(dle), link->usInterval * 1250);
+		}
+		return;
+
+	case CPU2_HOST_LE_SET_PHY:
+		link = pLink(usGet16(pParams));
+		vReply(usOpcode, link ? 0 : BLE_STATUS_INVALID_PARAMS, NULL, 0);
+		if (link == NULL)
+			return;
+		{
+			hci_le_phy_update_complete_event_rp0 phy = { 0, link->usConn, 1, 1 };
+
+			if (link->tCentral.uc2M && (pParams[3] & 2)) {
+				link->ucPhy = 2;
+				phy.TX_PHY = 2;
+				phy.RX_PHY = 2;
+			} else if (!link->tCentral.uc2M) {
+				phy.Status = CPU2_HOST_UNSUPPORTED_REMOTE_FEATURE;
+			}
+			vMetaEvent(EVT_LE_PHY_UPDATE_COMPLETE, &phy, sizeof(phy), 2 * link->usInterval * 1250);
+		}
+		return;
+
+	case CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ:
+		link = pLink(usGet16(pParams));
+		vReply(usOpcode, link ? 0 : BLE_STATUS_INVALID_PARAMS, NULL, 0);
+		if (link == NULL)
+			return;
+		{
+			aci_l2cap_connection_update_resp_event_rp0 resp = { link->usConn, 0 };
+			hci_le_connection_update_complete_event_rp0 update;
+
+			link->usInterval = usGet16(&pParams[4]);
+			link->usLatency = usGet16(&pParams[6]);
+			link->usTimeout = usGet16(&pParams[8]);
+			update.Status = 0;
+			update.Connection_Handle = link->usConn;
+			update.Conn_Interval = link->usInterval;
+			update.Conn_Latency = link->usLatency;
+			update.Supervision_Timeout = link->usTimeout;
+			vVendorEvent(EVT_BLUE_L2CAP_CONNECTION_UPDATE_RESP, &resp, sizeof(resp), 1250);
+			vMetaEvent(EVT_LE_CONN_UPDATE_COMPLETE, &update, sizeof(update), 6 * link->usInterval * 1250);
+		}
+		return;
+
+	case CPU2_HOST_READ_RSSI:
+		link = pLink(usGet16(pParams));
+		vPut16(ret, usGet16(pParams));
+		ret[2] = link ? (uint8_t) link->tCentral.cRssi : 127;
+		vReply(usOpcode, link ? 0 : BLE_STATUS_INVALID_PARAMS, ret, 3);
+		return;
+
+	case CPU2_HOST_OPCODE(0x3F, 0x083): // aci_gap_set_discoverable
+		ucAdvertising = 1;
+		ucAdvLen = 0;
+		{
+			uint8_t ad[31];
+			uint8_t name = pParams[7], uuids = pParams[8 + name];
+
+			ad[0] = 2;
+			ad[1] = AD_TYPE_FLAGS;
+			ad[2] = FLAG_BIT_LE_GENERAL_DISCOVERABLE_MODE | FLAG_BIT_BR_EDR_NOT_SUPPORTED;
+			vAdvMerge(ad, 3);
+			if (name) {
+				ad[0] = name;
+				memcpy(&ad[1], &pParams[8], name);
+				vAdvMerge(ad, name + 1);
+			}
+			if (uuids) {
+				ad[0] = uuids;
+				memcpy(&ad[1], &pParams[9 + name], uuids);
+				vAdvMerge(ad, uuids + 1);
+			}
+		}
+		break;
+
+	case CPU2_HOST_OPCODE(0x3F, 0x081): // aci_gap_set_non_discoverable
+		ucAdvertising = 0;
+		break;
+
+	case CPU2_HOST_GAP_UPDATE_ADV_DATA:
+		vAdvMerge(&pParams[1], pParams[0]);
+		break;
+
+	case CPU2_HOST_HAL_SET_TX_POWER_LEVEL:
+		ucTxPower = pParams[1];
+		break;
+
+	default:
+		break;
+	}
+	vReply(usOpcode, status, ret, 0);
+}
+
+// what CPU2 does with the pool when it starts
+static void vPoolInit(void) {
+	MB_MemManagerTable_t *mm = __start_MAPPING_TABLE->p_mem_manager_table;
+
+	LST_init_head((tListNode *) mm->pevt_free_buffer_queue);
+	ucHeld = 0;
+	usPoolUsed = 0;
+	usPoolLimit = (uint16_t) mm->blepoolsize;
+	tStats.usPoolBuffers = (uint16_t) (mm->blepoolsize / CPU2_HOST_BUFFER_SIZE);
+	tStats.usPoolFreeMin = tStats.usPoolBuffers;
+}
+
+// first fit below usPoolLimit, NULL if no gap is large enough
+static uint8_t *pPoolAlloc(uint16_t usSize) {
+	MB_MemManagerTable_t *mm = __start_MAPPING_TABLE->p_mem_manager_table;
+	uint16_t offset, best = 0xFFFF;
+	uint8_t i, k;
+
+	if (ucHeld == CPU2_HOST_HELD)
+		return NULL;
+	// a gap starts at the pool or right after a held buffer
+	for (i = 0; i <= ucHeld; i++) {
+		offset = i == ucHeld ? 0 : (uint16_t) (aHeld[i].usOffset + aHeld[i].usSize);
+		if (offset + usSize > usPoolLimit || offset >= best)
+			continue;
+		for (k = 0; k < ucHeld; k++) {
+			if (offset < aHeld[k].usOffset + aHeld[k].usSize
+					&& aHeld[k].usOffset < offset + usSize)
+				break;
+		}
+		if (k == ucHeld)
+			best = offset;
+	}
+	if (best == 0xFFFF)
+		return NULL;
+	aHeld[ucHeld].usOffset = best;
+	aHeld[ucHeld].usSize = usSize;
+	ucHeld++;
+	usPoolUsed += usSize;
+	return mm->blepool + best;
+}
+
+static void vPoolRelease(const uint8_t *pBuffer) {
+	MB_MemManagerTable_t *mm = __start_MAPPING_TABLE->p_mem_manager_table;
+	uint8_t i;
+
+	for (i = 0; i < ucHeld; i++) {
+		if (mm->blepool + aHeld[i].usOffset != pBuffer)
+			continue;
+		usPoolUsed -= aHeld[i].usSize;
+		aHeld[i] = aHeld[--ucHeld];
+		return;
+	}
+	printf("cpu2_host: buffer %p freed twice or not from the pool\n", (const void *) pBuffer);
+	abort();
+}
+
+// Global Function Definitions
+void vCpu2HostReset(void) {
+	memset(aAttrs, 0, sizeof(aAttrs));
+	usNextHandle = 1;
+	memset(aLinks, 0, sizeof(aLinks));
+	usPending = 0;
+	uiSeq = 0;
+	ucOpcodes = 0;
+	usNotify = 0;
+	usUpdates = 0;
+	memset(&tStats, 0, sizeof(tStats));
+	uiLatencyUs = 0;
+	ucRefuseN = 0;
+	ucRefuseM = 0;
+	uiRefuseCount = 0;
+	uiPoolUs = 0;
+	ucAdvLen = 0;
+	ucAdvertising = 0;
+	ucTxPower = 0;
+}
+
+void vCpu2HostSetLatency(uint32_t uiUs) {
+	uiLatencyUs = uiUs;
+}
+
+void vCpu2HostSetStatus(uint16_t usOpcode, uint8_t ucStatus) {
+	Opcode *opcode = pOpcode(usOpcode, 1);
+
+	if (opcode != NULL)
+		opcode->ucStatus = ucStatus;
+}
+
+void vCpu2HostRefuse(uint8_t ucN, uint8_t ucM, uint32_t uiUs) {
+	ucRefuseN = ucN;
+	ucRefuseM = ucM;
+	uiRefuseCount = 0;
+	uiPoolUs = uiUs;
+}
+
+uint64_t ulCpu2HostNextDue(void) {
+	uint64_t due = UINT64_MAX;
+	uint16_t i;
+
+	for (i = 0; i < usPending; i++) {
+		if (!aPending[i].ucBlocked && aPending[i].ulDue < due)
+			due = aPending[i].ulDue;
+	}
+	return due;
+}
+
+void vCpu2HostRun(void) {
+	uint16_t i, next;
+	uint8_t blocked = 0;
+
+	for (;;) {
+		// everything due in the order it was scheduled, command answers do
+		// not need a pool buffer and pass events that wait for one
+		next = usPending;
+		for (i = 0; i < usPending; i++) {
+			if (aPending[i].ulDue > ulHostUs() || (blocked && aPending[i].ucKind == PENDING_EVENT))
+				continue;
+			if (next == usPending || aPending[i].uiSeq < aPending[next].uiSeq)
+				next = i;
+		}
+		if (next == usPending)
+			return;
+		if (!ucDeliver(&aPending[next])) {
+			// the events due behind it keep their order and wait too
+			for (i = 0; i < usPending; i++) {
+				if (aPending[i].ucKind != PENDING_EVENT || aPending[i].ulDue > ulHostUs()
+						|| aPending[i].ucBlocked)
+					continue;
+				aPending[i].ucBlocked = 1;
+				if (!aPending[i].ucDelayed)
+					tStats.uiEventsDelayed++;
+				aPending[i].ucDelayed = 1;
+			}
+			blocked = 1;
+			continue;
+		}
+		memmove(&aPending[next], &aPending[next + 1], (usPending - next - 1) * sizeof(Pending));
+		usPending--;
+	}
+}
+
+uint32_t uiCpu2HostCount(uint16_t usOpcode) {
+	Opcode *opcode = pOpcode(usOpcode, 0);
+
+	return opcode ? opcode->uiCount : 0;
+}
+
+const uint8_t *pCpu2HostLastParams(uint16_t usOpcode, uint8_t *pLen) {
+	Opcode *opcode = pOpcode(usOpcode, 0);
+
+	if (opcode == NULL || opcode->uiCount == 0)
+		return NULL;
+	*pLen = opcode->ucLen;
+	return opcode->aParams;
+}
+
+void vCpu2HostPoolLimit(uint16_t usBytes) {
+	MB_MemManagerTable_t *mm = __start_MAPPING_TABLE->p_mem_manager_table;
+	uint16_t i;
+
+	usPoolLimit = (usBytes == 0 || usBytes > mm->blepoolsize) ? (uint16_t) mm->blepoolsize : usBytes;
+	for (i = 0; i < usPending; i++)
+		aPending[i].ucBlocked = 0;
+}
+
+void vCpu2HostGetStats(Cpu2HostStats *pStats) {
+	*pStats = tStats;
+}
+
+void vCpu2HostClearStats(void) {
+	uint16_t buffers = tStats.usPoolBuffers;
+
+	memset(&tStats, 0, sizeof(tStats));
+	tStats.usPoolBuffers = buffers;
+	tStats.usPoolFreeMin = (uint16_t) ((usPoolLimit - usPoolUsed) / CPU2_HOST_BUFFER_SIZE);
+}
+
+uint16_t usCpu2HostFindChar(const uint8_t *pUuid128) {
+	uint16_t handle;
+
+	for (handle = 1; handle < CPU2_HOST_ATTRS; handle++) {
+		if (aAttrs[handle].ucKind == ATTR_VALUE && memcmp(aAttrs[handle].aUuid, pUuid128, 16) == 0)
+			return handle;
+	}
+	return 0;
+}
+
+uint8_t ucCpu2HostCharProps(uint16_t usValueHandle) {
+	return aAttrs[usValueHandle].ucProps;
+}
+
+uint16_t usCpu2HostCharSize(uint16_t usValueHandle) {
+	return aAttrs[usValueHandle].usSize;
+}
+
+const uint8_t *pCpu2HostValue(uint16_t usValueHandle, uint16_t *pLen) {
+	*pLen = aAttrs[usValueHandle].usLen;
+	return aAttrs[usValueHandle].aValue;
+}
+
+uint16_t usCpu2HostAttributes(void) {
+	uint16_t handle, count = 0;
+
+	for (handle = 1; handle < CPU2_HOST_ATTRS; handle++) {
+		if (aAttrs[handle].ucKind != ATTR_FREE)
+			count++;
+	}
+	return count;
+}
+
+uint16_t usCpu2HostServiceEnd(uint16_t usServiceHandle) {
+	return aAttrs[usServiceHandle].usEnd;
+}
+
+uint16_t usCpu2HostServiceOf(uint16_t usValueHandle) {
+	return aAttrs[usValueHandle].usService;
+}
+
+const uint8_t *pCpu2HostAdvData(uint8_t *pLen) {
+	*pLen = ucAdvLen;
+	return aAdvData;
+}
+
+uint8_t ucCpu2HostAdvertising(void) {
+	return ucAdvertising;
+}
+
+uint8_t ucCpu2HostTxPower(void) {
+	return ucTxPower;
+}
+
+uint16_t usCpu2HostNotifications(void) {
+	return usNotify;
+}
+
+const Cpu2HostNotify *pCpu2HostNotification(uint16_t usIndex) {
+	return &aNotify[usIndex];
+}
+
+uint16_t usCpu2HostUpdates(void) {
+	return usUpdates;
+}
+
+const Cpu2HostUpdate *pCpu2HostUpdate(uint16_t usIndex) {
+	return &aUpdates[usIndex];
+}
+
+void vCpu2HostClearNotifications(void) {
+	usNotify = 0;
+	usUpdates = 0;
+}
+
+uint16_t usCpu2HostConnect(const Cpu2HostCentral *pCentral) {
+	hci_le_connection_complete_event_rp0 complete;
+	uint8_t slot;
+	Link *link;
+
+	for (slot = 0; slot < CPU2_HOST_CENTRALS && aLinks[slot].usConn != 0; slot++)
+		;
+	if (slot == CPU2_HOST_CENTRALS)
+		return 0;
+	link = &aLinks[slot];
+	memset(link, 0, sizeof(*link));
+	link->usConn = CPU2_HOST_CONN_FIRST + slot;
+	link->tCentral = *pCentral;
+	link->usMtu = APP_BLE_DEFAULT_ATT_MTU;
+	link->usOctets = APP_BLE_DEFAULT_TX_OCTETS;
+	link->ucPhy = 1;
+	link->usInterval = pCentral->usInterval ? pCentral->usInterval : 24;
+	link->usTimeout = 400;
+	ucAdvertising = 0;
+
+	memset(&complete, 0, sizeof(complete));
+	complete.Connection_Handle = link->usConn;
+	complete.Role = 1;
+	complete.Peer_Address[0] = slot + 1;
+	complete.Conn_Interval = link->usInterval;
+	complete.Supervision_Timeout = link->usTimeout;
+	vMetaEvent(EVT_LE_CONN_COMPLETE, &complete, sizeof(complete), 0);
+	return link->usConn;
+}
+
+void vCpu2HostDisconnect(uint16_t usConn, uint8_t ucReason) {
+	hci_disconnection_complete_event_rp0 complete = { 0, usConn, ucReason };
+	uint8_t slot = ucLinkSlot(usConn);
+	uint16_t handle;
+
+	if (slot == CPU2_HOST_NO_LINK)
+		return;
+	for (handle = 1; handle < CPU2_HOST_ATTRS; handle++)
+		aAttrs[handle].ucCccd &= ~(1 << slot);
+	aLinks[slot].usConn = 0;
+	vEvent(EVT_DISCONN_COMPLETE, &complete, sizeof(complete), 0);
+}
+
+void vCpu2HostSubscribe(uint16_t usConn, uint16_t usValueHandle, uint8_t ucEnable) {
+	uint8_t slot = ucLinkSlot(usConn);
+	uint8_t cccd[2] = { ucEnable ? 0x01 : 0x00, 0x00 };
+
+	if (slot == CPU2_HOST_NO_LINK || aAttrs[usValueHandle + 1].ucKind != ATTR_CCCD)
+		return;
+	if (ucEnable)
+		aAttrs[usValueHandle + 1].ucCccd |= 1 << slot;
+	else
+		aAttrs[usValueHandle + 1].ucCccd &= ~(1 << slot);
+	vCpu2HostWriteAttr(usConn, usValueHandle + 1, cccd, sizeof(cccd));
+}
+
+void vCpu2HostWrite(uint16_t usConn, uint16_t usValueHandle, const uint8_t *pData, uint16_t usLen) {
+	Attr *attr = &aAttrs[usValueHandle];
+
+	if (attr->ucKind != ATTR_VALUE || usLen > attr->usSize)
+		return;
+	memcpy(attr->aValue, pData, usLen);
+	attr->usLen = usLen;
+	vCpu2HostWriteAttr(usConn, usValueHandle, pData, usLen);
+}
+
+void vCpu2HostWriteAttr(uint16_t usConn, uint16_t usHandle, const uint8_t *pData, uint16_t usLen) {
+	uint8_t params[255];
+
+	vPut16(&params[0], usConn);
+	vPut16(&params[2], usHandle);
+	vPut16(&params[4], 0);
+	vPut16(&params[6], usLen);
+	memcpy(&params[8], pData, usLen);
+	vVendorEvent(EVT_BLUE_GATT_ATTRIBUTE_MODIFIED, params, (uint8_t) (8 + usLen), 0);
+}
+
+uint8_t ucCpu2HostReadRequest(uint16_t usConn, uint16_t usValueHandle) {
+	aci_gatt_read_permit_req_event_rp0 permit = { usConn, usValueHandle, 0 };
+	Link *link = pLink(usConn);
+
+	if (link == NULL || aAttrs[usValueHandle].ucKind != ATTR_VALUE)
+		return 0;
+	if (!(aAttrs[usValueHandle].ucEvtMask & GATT_NOTIFY_READ_REQ_AND_WAIT_FOR_APPL_RESP))
+		return 1;
+	link->usReadHandle = usValueHandle;
+	vVendorEvent(EVT_BLUE_GATT_READ_PERMIT_REQ, &permit, sizeof(permit), 0);
+	return 1;
+}
+
+uint8_t ucCpu2HostReadPending(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link != NULL && link->usReadHandle != 0;
+}
+
+void vCpu2HostSetRssi(uint16_t usConn, int8_t cRssi) {
+	Link *link = pLink(usConn);
+
+	if (link != NULL)
+		link->tCentral.cRssi = cRssi;
+}
+
+uint16_t usCpu2HostLinkMtu(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link ? link->usMtu : 0;
+}
+
+uint16_t usCpu2HostLinkOctets(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link ? link->usOctets : 0;
+}
+
+uint8_t ucCpu2HostLinkPhy(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link ? link->ucPhy : 0;
+}
+
+uint16_t usCpu2HostLinkInterval(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link ? link->usInterval : 0;
+}
+
+uint16_t usCpu2HostLinkLatency(uint16_t usConn) {
+	Link *link = pLink(usConn);
+
+	return link ? link->usLatency : 0;
+}
+
+void vCpu2HostEvent(uint8_t ucEvtCode, const uint8_t *pParams, uint8_t ucLen, uint32_t uiDelayUs) {
+	vEvent(ucEvtCode, pParams, ucLen, uiDelayUs);
+}
+
+/*
+ * The IPCC side of tl_mbox.c
+ */
+void HW_IPCC_Enable(void) {
+}
+
+void HW_IPCC_Init(void) {
+}
+
+void HW_IPCC_BLE_Init(void) {
+	vPoolInit();
+}
+
+void HW_IPCC_BLE_SendCmd(void) {
+	TL_CmdPacket_t *cmd = (TL_CmdPacket_t *) __start_MAPPING_TABLE->p_ble_table->pcmd_buffer;
+
+	vCommand(cmd->cmdserial.cmd.cmdcode, cmd->cmdserial.cmd.payload, cmd->cmdserial.cmd.plen);
+}
+
+void HW_IPCC_MM_SendFreeBuf(void (*cb)(void)) {
+	MB_MemManagerTable_t *mm = __start_MAPPING_TABLE->p_mem_manager_table;
+	tListNode *node;
+	uint16_t i;
+
+	cb();
+	// CPU2 takes back what came
+	while (!LST_is_empty((tListNode *) mm->pevt_free_buffer_queue)) {
+		LST_remove_head((tListNode *) mm->pevt_free_buffer_queue, &node);
+		vPoolRelease((const uint8_t *) node);
+	}
+	for (i = 0; i < usPending; i++)
+		aPending[i].ucBlocked = 0;
+}
+
+void HW_IPCC_BLE_SendAclData(void) {
+}
+
+void HW_IPCC_SYS_Init(void) {
+}
+
+void HW_IPCC_SYS_SendCmd(void) {
+}
+
+void HW_IPCC_TRACES_Init(void) {
+}
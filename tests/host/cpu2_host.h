@@ -0,0 +1,147 @@
+/*
+ * cpu2_host.h
+ *
+ * CPU2 behind the mailbox of tl_mbox.c: the commands CPU1 writes to the BLE
+ * command buffer are decoded and answered with a command complete or status
+ * event after a configurable latency, the GATT database they build is kept
+ * with its values, and the notifications the updates send are logged per
+ * connection. Centrals are virtual, they connect, write CCCDs and values,
+ * answer the link negotiation and report RSSI through the events CPU2 would
+ * send, each in a buffer taken from the event pool CPU1 gives back.
+ */
+
+#ifndef CPU2_HOST_H_
+#define CPU2_HOST_H_
+#include <stdint.h>
+
+#define CPU2_HOST_VALUE_MAX 512
+#define CPU2_HOST_NOTIFY_LOG 1024
+#define CPU2_HOST_UPDATE_LOG 1024
+#define CPU2_HOST_CENTRALS 4
+// Bluetooth status codes the scripts use
+#define CPU2_HOST_INSUFFICIENT_RESOURCES 0x64
+#define CPU2_HOST_UNSUPPORTED_REMOTE_FEATURE 0x1A
+#define CPU2_HOST_UNKNOWN_COMMAND 0x01
+
+// opcode of an ACI/HCI command, as hci_send_req() builds it
+#define CPU2_HOST_OPCODE(ogf, ocf) ((uint16_t) (((ogf) << 10) | ((ocf) & 0x3FF)))
+#define CPU2_HOST_GATT_EXCHANGE_CONFIG CPU2_HOST_OPCODE(0x3F, 0x10B)
+#define CPU2_HOST_GATT_UPDATE_CHAR_VALUE CPU2_HOST_OPCODE(0x3F, 0x106)
+#define CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT CPU2_HOST_OPCODE(0x3F, 0x12C)
+#define CPU2_HOST_GATT_ALLOW_READ CPU2_HOST_OPCODE(0x3F, 0x127)
+#define CPU2_HOST_GAP_UPDATE_ADV_DATA CPU2_HOST_OPCODE(0x3F, 0x08E)
+#define CPU2_HOST_HAL_SET_TX_POWER_LEVEL CPU2_HOST_OPCODE(0x3F, 0x00F)
+#define CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ CPU2_HOST_OPCODE(0x3F, 0x181)
+#define CPU2_HOST_LE_SET_DATA_LENGTH CPU2_HOST_OPCODE(0x08, 0x022)
+#define CPU2_HOST_LE_SET_PHY CPU2_HOST_OPCODE(0x08, 0x032)
+#define CPU2_HOST_READ_RSSI CPU2_HOST_OPCODE(0x05, 0x005)
+
+typedef struct {
+	uint64_t ulUs;             // host time it went out
+	uint16_t usConn;
+	uint16_t usHandle;         // value handle
+	uint16_t usLen;
+	uint8_t aData[CPU2_HOST_VALUE_MAX];
+} Cpu2HostNotify;
+
+// one aci_gatt_update_char_value_ext() the stack took
+typedef struct {
+	uint64_t ulUs;
+	uint16_t usConn;           // Conn_Handle_To_Notify
+	uint16_t usHandle;         // value handle
+	uint8_t ucType;            // Update_Type
+	uint16_t usCharLen;
+	uint16_t usOffset;
+	uint8_t ucLen;
+} Cpu2HostUpdate;
+
+// what a virtual central answers the link negotiation with
+typedef struct {
+	uint16_t usMtu;            // ATT MTU of its exchange response, 0: no response
+	uint16_t usMaxOctets;      // LL payload it takes, 27 without data length extension
+	uint8_t uc2M;              // supports the 2M PHY
+	uint16_t usInterval;       // connection interval, 1.25 ms units
+	int8_t cRssi;
+} Cpu2HostCentral;
+
+typedef struct {
+	uint32_t uiCommands;       // commands of any kind
+	uint32_t uiRefused;        // update commands refused for lack of TX buffers
+	uint32_t uiEvents;         // events put in pool buffers
+	uint32_t uiEventsDelayed;  // events that had to wait for room in the pool
+	uint16_t usPoolBuffers;    // full size events the pool holds
+	uint16_t usPoolFreeMin;    // fewest full size events there was room left for
+	uint16_t usPoolUsedMax;    // most pool bytes CPU1 held at once
+	uint16_t usHeldMax;        // most event buffers CPU1 held at once
+	uint64_t ulPoolWaitUs;     // longest wait of an event for room
+	uint32_t uiNotifications;  // notifications sent, one per subscribed link
+	uint32_t uiNotifyBytes;    // their ATT payload
+} Cpu2HostStats;
+
+void vCpu2HostReset(void);
+// command complete or status this long after the command is sent
+void vCpu2HostSetLatency(uint32_t uiUs);
+// every following command with this opcode fails with ucStatus, 0 clears it
+void vCpu2HostSetStatus(uint16_t usOpcode, uint8_t ucStatus);
+// out of every ucM notifying updates the first ucN are refused with
+// CPU2_HOST_INSUFFICIENT_RESOURCES, the TX pool available event follows each
+// refusal after uiPoolUs
+void vCpu2HostRefuse(uint8_t ucN, uint8_t ucM, uint32_t uiPoolUs);
+// events only take the first usBytes of the pool, 0 for all of it
+void vCpu2HostPoolLimit(uint16_t usBytes);
+
+// host time of the next answer or event waiting, UINT64_MAX if none
+uint64_t ulCpu2HostNextDue(void);
+// delivers what is due at the host time
+void vCpu2HostRun(void);
+uint32_t uiCpu2HostCount(uint16_t usOpcode);
+// parameters of the last command with this opcode, NULL if none was sent
+const uint8_t *pCpu2HostLastParams(uint16_t usOpcode, uint8_t *pLen);
+void vCpu2HostGetStats(Cpu2HostStats *pStats);
+// counts and high water marks from now on
+void vCpu2HostClearStats(void);
+
+// GATT database
+uint16_t usCpu2HostFindChar(const uint8_t *pUuid128);  // value handle, 0 if absent
+uint8_t ucCpu2HostCharProps(uint16_t usValueHandle);
+uint16_t usCpu2HostCharSize(uint16_t usValueHandle);
+const uint8_t *pCpu2HostValue(uint16_t usValueHandle, uint16_t *pLen);
+uint16_t usCpu2HostAttributes(void);                   // handles in use
+// attributes of one service: declarations, values and CCCDs
+uint16_t usCpu2HostServiceEnd(uint16_t usServiceHandle);
+uint16_t usCpu2HostServiceOf(uint16_t usValueHandle);
+// last advertising data set, and whether advertising runs
+const uint8_t *pCpu2HostAdvData(uint8_t *pLen);
+uint8_t ucCpu2HostAdvertising(void);
+// PA level of the last aci_hal_set_tx_power_level()
+uint8_t ucCpu2HostTxPower(void);
+
+// notification and update logs, cleared together
+uint16_t usCpu2HostNotifications(void);
+const Cpu2HostNotify *pCpu2HostNotification(uint16_t usIndex);
+uint16_t usCpu2HostUpdates(void);
+const Cpu2HostUpdate *pCpu2HostUpdate(uint16_t usIndex);
+void vCpu2HostClearNotifications(void);
+
+// virtual centrals, handles start at 0x0801
+uint16_t usCpu2HostConnect(const Cpu2HostCentral *pCentral);
+void vCpu2HostDisconnect(uint16_t usConn, uint8_t ucReason);
+void vCpu2HostSubscribe(uint16_t usConn, uint16_t usValueHandle, uint8_t ucEnable);
+void vCpu2HostWrite(uint16_t usConn, uint16_t usValueHandle, const uint8_t *pData, uint16_t usLen);
+// ATTRIBUTE_MODIFIED for any handle, a CCCD as well as a value
+void vCpu2HostWriteAttr(uint16_t usConn, uint16_t usHandle, const uint8_t *pData, uint16_t usLen);
+// read of a value, with a read permit it waits for aci_gatt_allow_read(),
+// 0 if there is no such link or value
+uint8_t ucCpu2HostReadRequest(uint16_t usConn, uint16_t usValueHandle);
+uint8_t ucCpu2HostReadPending(uint16_t usConn);
+void vCpu2HostSetRssi(uint16_t usConn, int8_t cRssi);
+// ATT MTU, LL payload and TX PHY the link ended up with
+uint16_t usCpu2HostLinkMtu(uint16_t usConn);
+uint16_t usCpu2HostLinkOctets(uint16_t usConn);
+uint8_t ucCpu2HostLinkPhy(uint16_t usConn);
+uint16_t usCpu2HostLinkInterval(uint16_t usConn);
+uint16_t usCpu2HostLinkLatency(uint16_t usConn);
+// any HCI event, evtcode and parameters, sent at the host time plus uiDelayUs
+void vCpu2HostEvent(uint8_t ucEvtCode, const uint8_t *pParams, uint8_t ucLen, uint32_t uiDelayUs);
+
+#endif /* CPU2_HOST_H_ */
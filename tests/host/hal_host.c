@@ -0,0 +1,212 @@
+/*
+ * hal_host.c
+ *
+ * Host side of the HAL calls, see hal_host.h. Time only moves in
+ * vHostAdvance() and vHostAdvanceUs(), HAL_Delay() included, so every run is
+ * deterministic.
+ */
+
+#include "hal_host.h"
+#include <string.h>
+#include <time.h>
+
+#define HOST_I2C_DEVICES 4
+#define HOST_I2C_MAX_TRANSFER 1200
+
+I2C_HandleTypeDef hi2c3;
+
+static uint64_t ulUs;
+static uint8_t ucI2cBusy;
+static GPIO_PinState ePinState = GPIO_PIN_SET;
+static const HostI2cDevice *aDevices[HOST_I2C_DEVICES];
+static uint8_t ucDevices;
+static uint8_t aTransfer[HOST_I2C_MAX_TRANSFER];
+static uint32_t uiI2cBitNs;
+static uint32_t uiI2cNs;       // bus time short of a whole us
+
+// local function prototypes
+static const HostI2cDevice *pHostI2cFind(uint16_t usAddr);
+static void vHostI2cBus(uint16_t usBytes);
+
+//local functions
+static const HostI2cDevice *pHostI2cFind(uint16_t usAddr) {
+	uint8_t i;
+
+	for (i = 0; i < ucDevices; i++) {
+		if ((aDevices[i]->usAddr & 0xFE) == (usAddr & 0xFE))
+			return aDevices[i];
+	}
+	return NULL;
+}
+
+// address byte and data on the bus
+static void vHostI2cBus(uint16_t usBytes) {
+	uiI2cNs += (usBytes + 1U) * 9U * uiI2cBitNs;
+	if (uiI2cNs >= 1000) {
+		vHostAdvanceUs(uiI2cNs / 1000);
+		uiI2cNs %= 1000;
+	}
+}
+
+// Global Function Definitions
+void vHostReset(void) {
+	ulUs = 0;
+	ucI2cBusy = 0;
+	ePinState = GPIO_PIN_SET;
+	ucDevices = 0;
+	uiI2cBitNs = 0;
+	uiI2cNs = 0;
+}
+
+void vHostAdvance(uint32_t uiMs) {
+	vHostAdvanceUs(uiMs * 1000);
+}
+
+void vHostAdvanceUs(uint32_t uiUs) {
+	uint8_t i;
+
+	ulUs += uiUs;
+	for (i = 0; i < ucDevices; i++) {
+		if (aDevices[i]->pfRun != NULL)
+			aDevices[i]->pfRun(uiUs);
+	}
+}
+
+uint64_t ulHostUs(void) {
+	return ulUs;
+}
+
+void vHostI2cAttach(const HostI2cDevice *pDevice) {
+	if (ucDevices < HOST_I2C_DEVICES && pHostI2cFind(pDevice->usAddr) == NULL)
+		aDevices[ucDevices++] = pDevice;
+}
+
+void vHostI2cSetBusy(uint8_t ucBusy) {
+	ucI2cBusy = ucBusy;
+}
+
+void vHostI2cSetBitNs(uint32_t uiNs) {
+	uiI2cBitNs = uiNs;
+}
+
+void vHostSetPin(GPIO_PinState ePin) {
+	ePinState = ePin;
+}
+
+uint32_t uiHostNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+uint32_t HAL_GetTick(void) {
+	return (uint32_t) (ulUs / 1000);
+}
+
+void HAL_Delay(uint32_t Delay) {
+	vHostAdvance(Delay);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	(void) GPIOx;
+	(void) GPIO_Pin;
+	(void) PinState;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+	(void) GPIOx;
+	(void) GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+	(void) GPIOx;
+	(void) GPIO_Pin;
+	return ePinState;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c) {
+	(void) hi2c;
+	return ucI2cBusy ? HAL_I2C_STATE_BUSY : HAL_I2C_STATE_READY;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+	(void) hi2c;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+	(void) hi2c;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint32_t Trials, uint32_t Timeout) {
+	(void) hi2c;
+	(void) Trials;
+	(void) Timeout;
+	return pHostI2cFind(DevAddress) != NULL ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	const HostI2cDevice *dev = pHostI2cFind(DevAddress);
+
+	(void) hi2c;
+	(void) Timeout;
+	if (dev == NULL || dev->pfWrite == NULL)
+		return HAL_ERROR;
+	dev->pfWrite(pData, Size);
+	vHostI2cBus(Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	const HostI2cDevice *dev = pHostI2cFind(DevAddress);
+
+	(void) hi2c;
+	(void) Timeout;
+	if (dev == NULL || dev->pfRead == NULL)
+		return HAL_ERROR;
+	dev->pfRead(pData, Size);
+	vHostI2cBus(Size);
+	return HAL_OK;
+}
+
+// the memory address goes out as the first byte of one write
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size,
+		uint32_t Timeout) {
+	const HostI2cDevice *dev = pHostI2cFind(DevAddress);
+
+	(void) hi2c;
+	(void) MemAddSize;
+	(void) Timeout;
+	if (dev == NULL || dev->pfWrite == NULL || Size >= HOST_I2C_MAX_TRANSFER)
+		return HAL_ERROR;
+	aTransfer[0] = (uint8_t) MemAddress;
+	memcpy(&aTransfer[1], pData, Size);
+	dev->pfWrite(aTransfer, Size + 1);
+	vHostI2cBus(Size + 1);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+		uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size,
+		uint32_t Timeout) {
+	const HostI2cDevice *dev = pHostI2cFind(DevAddress);
+	uint8_t reg = (uint8_t) MemAddress;
+
+	(void) hi2c;
+	(void) MemAddSize;
+	(void) Timeout;
+	if (dev == NULL || dev->pfWrite == NULL || dev->pfRead == NULL)
+		return HAL_ERROR;
+	dev->pfWrite(&reg, 1);
+	dev->pfRead(pData, Size);
+	// the register, then the data after a repeated start
+	vHostI2cBus(1);
+	vHostI2cBus(Size);
+	return HAL_OK;
+}
@@ -0,0 +1,35 @@
+/*
+ * hal_host.h
+ *
+ * The few HAL calls the firmware modules under test make, backed by a
+ * virtual microsecond clock HAL_GetTick() reads in ms and an I2C bus that
+ * hands transfers to emulated devices.
+ */
+
+#ifndef HAL_HOST_H_
+#define HAL_HOST_H_
+#include "stm32wbxx_hal.h"
+
+typedef struct {
+	uint16_t usAddr;                                  // HAL 8 bit address, R/W bit ignored
+	void (*pfWrite)(const uint8_t *pData, uint16_t usLen); // bytes after the address byte
+	void (*pfRead)(uint8_t *pData, uint16_t usLen);
+	void (*pfRun)(uint32_t uiUs);                     // device clock, may be NULL
+} HostI2cDevice;
+
+extern I2C_HandleTypeDef hi2c3;
+
+void vHostReset(void);
+void vHostAdvance(uint32_t uiMs);
+void vHostAdvanceUs(uint32_t uiUs);
+uint64_t ulHostUs(void);
+void vHostI2cAttach(const HostI2cDevice *pDevice);
+void vHostI2cSetBusy(uint8_t ucBusy);
+// transfers block for their time on the bus, 9 bits a byte with the address
+// byte, at uiNs a bit; 0, the default, keeps them instant
+void vHostI2cSetBitNs(uint32_t uiNs);
+void vHostSetPin(GPIO_PinState ePin);
+// wall clock of the host, stands in for DWT->CYCCNT in the modules that read it
+uint32_t uiHostNs(void);
+
+#endif /* HAL_HOST_H_ */
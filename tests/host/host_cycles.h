@@ -0,0 +1,21 @@
+/*
+ * host_cycles.h
+ *
+ * Forced into the modules that time themselves with DWT->CYCCNT, the host
+ * wall clock in ns takes its place and starting the counter is a no-op.
+ */
+
+#ifndef HOST_CYCLES_H_
+#define HOST_CYCLES_H_
+#include <stdint.h>
+
+uint32_t uiHostNs(void);
+// the BLE transport times events on the virtual clock, see ble_host.h
+uint32_t uiBleHostCycles(void);
+
+#define PPG_STREAM_CYCLES() uiHostNs()
+#define PPG_STREAM_CYCLES_START()
+#define HCI_TL_CYCLES() uiBleHostCycles()
+#define HCI_TL_CYCLES_START()
+
+#endif /* HOST_CYCLES_H_ */
@@ -0,0 +1,110 @@
+/*
+ * max30102_emu.c
+ *
+ * See max30102_emu.h. Register addresses and the FIFO behaviour follow the
+ * datasheet: the pointer does not move on FIFO data reads, every 6 bytes
+ * read there advance the read pointer, a full FIFO drops its oldest sample.
+ */
+
+#include "max30102_emu.h"
+#include "hal_host.h"
+#include "max30102.h"
+
+#include <string.h>
+
+static uint8_t aRegs[256];
+static uint32_t auiRed[MAX30102_EMU_FIFO];
+static uint32_t auiIred[MAX30102_EMU_FIFO];
+static uint8_t ucPointer;
+static uint8_t ucByte;         // byte of the sample at the read pointer
+static uint32_t uiFifoBytes;
+
+// local function prototypes
+static void vMax30102EmuWrite(const uint8_t *pData, uint16_t usLen);
+static void vMax30102EmuRead(uint8_t *pData, uint16_t usLen);
+static void vMax30102EmuInt(void);
+
+static const HostI2cDevice tDevice = { MAX30102_ADDR_WRITE, vMax30102EmuWrite,
+		vMax30102EmuRead, NULL };
+
+//local functions
+static void vMax30102EmuInt(void) {
+	vHostSetPin(ucMax30102EmuUnread() ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+static void vMax30102EmuWrite(const uint8_t *pData, uint16_t usLen) {
+	uint16_t i;
+
+	if (usLen == 0)
+		return;
+	ucPointer = pData[0];
+	for (i = 1; i < usLen; i++)
+		aRegs[ucPointer++] = pData[i];
+	vMax30102EmuInt();
+}
+
+static void vMax30102EmuRead(uint8_t *pData, uint16_t usLen) {
+	uint8_t rd;
+	uint32_t value;
+	uint16_t i;
+
+	for (i = 0; i < usLen; i++) {
+		if (ucPointer != RES_FIFO_DATA_REGISTER) {
+			pData[i] = aRegs[ucPointer++];
+			continue;
+		}
+		// reading an empty FIFO repeats the last sample, the pointer stays
+		rd = aRegs[RES_FIFO_READ_POINTER] % MAX30102_EMU_FIFO;
+		value = ucByte < 3 ? auiRed[rd] : auiIred[rd];
+		pData[i] = (uint8_t) (value >> (8 * (2 - ucByte % 3)));
+		uiFifoBytes++;
+		if (++ucByte == 6) {
+			ucByte = 0;
+			if (ucMax30102EmuUnread()) {
+				aRegs[RES_FIFO_READ_POINTER] = (rd + 1) % MAX30102_EMU_FIFO;
+				aRegs[RES_OVERFLOW_COUNTER] = 0;
+			}
+		}
+	}
+	vMax30102EmuInt();
+}
+
+// Global Function Definitions
+void vMax30102EmuInit(void) {
+	memset(aRegs, 0, sizeof(aRegs));
+	aRegs[RES_PART_ID] = 0x15;
+	ucPointer = 0;
+	ucByte = 0;
+	uiFifoBytes = 0;
+	vHostI2cAttach(&tDevice);
+	vMax30102EmuInt();
+}
+
+void vMax30102EmuPush(uint32_t uiRed, uint32_t uiIred) {
+	uint8_t wr = aRegs[RES_FIFO_WRITE_POINTER] % MAX30102_EMU_FIFO;
+
+	if (ucMax30102EmuUnread() == MAX30102_EMU_FIFO - 1) {
+		// full, the oldest sample goes
+		aRegs[RES_FIFO_READ_POINTER] = (aRegs[RES_FIFO_READ_POINTER] + 1)
+				% MAX30102_EMU_FIFO;
+		if (aRegs[RES_OVERFLOW_COUNTER] < 0x1F)
+			aRegs[RES_OVERFLOW_COUNTER]++;
+	}
+	auiRed[wr] = uiRed & 0x3FFFF;
+	auiIred[wr] = uiIred & 0x3FFFF;
+	aRegs[RES_FIFO_WRITE_POINTER] = (wr + 1) % MAX30102_EMU_FIFO;
+	vMax30102EmuInt();
+}
+
+uint8_t ucMax30102EmuUnread(void) {
+	return (aRegs[RES_FIFO_WRITE_POINTER] - aRegs[RES_FIFO_READ_POINTER]
+			+ MAX30102_EMU_FIFO) % MAX30102_EMU_FIFO;
+}
+
+uint8_t ucMax30102EmuOverflow(void) {
+	return aRegs[RES_OVERFLOW_COUNTER];
+}
+
+uint32_t uiMax30102EmuFifoBytes(void) {
+	return uiFifoBytes;
+}
@@ -0,0 +1,24 @@
+/*
+ * max30102_emu.h
+ *
+ * MAX30102 on the host I2C bus: the register pointer, the 32 sample FIFO
+ * with its write and read pointers and overflow counter, and the FIFO data
+ * register handing out 6 bytes per red / IR sample. INT is low while
+ * samples are unread.
+ */
+
+#ifndef MAX30102_EMU_H_
+#define MAX30102_EMU_H_
+#include <stdint.h>
+
+#define MAX30102_EMU_FIFO 32
+
+void vMax30102EmuInit(void);
+// a new sample in the FIFO, the oldest one is lost when it is full
+void vMax30102EmuPush(uint32_t uiRed, uint32_t uiIred);
+uint8_t ucMax30102EmuUnread(void);
+uint8_t ucMax30102EmuOverflow(void);
+// bytes read from the FIFO data register
+uint32_t uiMax30102EmuFifoBytes(void);
+
+#endif /* MAX30102_EMU_H_ */
@@ -0,0 +1,117 @@
+/*
+ * app_common.h
+ *
+ * Stands in for Inc/app_common.h and hw.h when hw_timerserver.c builds on
+ * the host. The RTC registers the timer server reads and writes are plain
+ * fields of an RtcHost, SSR counts down with the tick rtc_host.c is set to,
+ * and the wakeup timer raises WUTF and its interrupt on the tick it counts
+ * to. RTC_HOST_INSTANCE picks the RtcHost a build of the timer server uses,
+ * so that two of them run side by side on their own wakeup timers.
+ */
+
+#ifndef APP_COMMON_H
+#define APP_COMMON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cmsis_host.h"
+
+typedef struct {
+	volatile uint32_t CR;
+	volatile uint32_t SSR;
+	volatile uint32_t WUTR;
+	volatile uint32_t PRER;
+	uint64_t ulFireAt;         // tick the wakeup timer sets WUTF on
+	uint8_t ucWutf;
+	uint8_t ucPending;         // NVIC pending bit of RTC_WKUP
+	uint8_t ucIrqEnabled;
+} RtcHost;
+
+typedef struct {
+	RtcHost *Instance;
+} RTC_HandleTypeDef;
+
+extern RtcHost tRtcHost;
+extern RtcHost tRtcList;
+
+void vRtcHostInit(RtcHost *pRtc);
+void vRtcHostSetTick(uint64_t ulTick);
+void vRtcHostEnable(RtcHost *pRtc);
+uint8_t ucRtcHostWutwf(const RtcHost *pRtc);
+
+#ifndef RTC_HOST_INSTANCE
+#define RTC_HOST_INSTANCE tRtcHost
+#endif
+#define RTC (&RTC_HOST_INSTANCE)
+
+#define SET 1
+#define RESET 0
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) ((REG) = (((REG) & ~(CLEARMASK)) | (SETMASK)))
+#define POSITION_VAL(VAL) (__builtin_ctz(VAL))
+
+#define RTC_SSR_SS 0xFFFFu
+#define RTC_CR_WUCKSEL 0x7u
+#define RTC_CR_BYPSHAD (1u << 5)
+#define RTC_CR_WUTE (1u << 10)
+#define RTC_PRER_PREDIV_A (0x7Fu << 16)
+#define RTC_PRER_PREDIV_S 0x7FFFu
+#define RTC_WUTR_WUT 0xFFFFu
+#define RTC_FLAG_WUTWF 1
+#define RTC_FLAG_WUTF 2
+#define RTC_IT_WUT 0
+#define RTC_EXTI_LINE_WAKEUPTIMER_EVENT 0
+#define RTC_WKUP_IRQn 3
+
+#define __HAL_RTC_WAKEUPTIMER_GET_FLAG(h, f) \
+	((f) == RTC_FLAG_WUTWF ? ucRtcHostWutwf((h)->Instance) : (h)->Instance->ucWutf)
+#define __HAL_RTC_WAKEUPTIMER_CLEAR_FLAG(h, f) ((h)->Instance->ucWutf = 0)
+#define __HAL_RTC_WAKEUPTIMER_ENABLE(h) vRtcHostEnable((h)->Instance)
+#define __HAL_RTC_WAKEUPTIMER_DISABLE(h) ((h)->Instance->CR &= ~RTC_CR_WUTE)
+#define __HAL_RTC_WAKEUPTIMER_ENABLE_IT(h, i) ((void) 0)
+#define __HAL_RTC_WAKEUPTIMER_EXTI_CLEAR_FLAG() ((void) 0)
+#define __HAL_RTC_WRITEPROTECTION_DISABLE(h) ((void) 0)
+#define __HAL_RTC_WRITEPROTECTION_ENABLE(h) ((void) 0)
+#define HAL_NVIC_SetPendingIRQ(i) (RTC->ucPending = 1)
+#define HAL_NVIC_ClearPendingIRQ(i) (RTC->ucPending = 0)
+#define HAL_NVIC_EnableIRQ(i) (RTC->ucIrqEnabled = 1)
+#define HAL_NVIC_DisableIRQ(i) (RTC->ucIrqEnabled = 0)
+#define HAL_NVIC_SetPriority(i, p, s) ((void) 0)
+#define LL_EXTI_EnableIT_0_31(l) ((void) 0)
+#define LL_EXTI_EnableRisingTrig_0_31(l) ((void) 0)
+
+#define PLACE_IN_SECTION(x)
+#define __weak __attribute__((weak))
+#define LSI_VALUE 32000
+
+// hw.h
+typedef enum {
+	hw_ts_InitMode_Full,
+	hw_ts_InitMode_Limited,
+} HW_TS_InitMode_t;
+
+typedef enum {
+	hw_ts_SingleShot,
+	hw_ts_Repeated
+} HW_TS_Mode_t;
+
+typedef enum {
+	hw_ts_Successful,
+	hw_ts_Failed,
+} HW_TS_ReturnStatus_t;
+
+typedef void (*HW_TS_pTimerCb_t)(void);
+
+void HW_TS_Init(HW_TS_InitMode_t TimerInitMode, RTC_HandleTypeDef *hrtc);
+HW_TS_ReturnStatus_t HW_TS_Create(uint32_t TimerProcessID, uint8_t *pTimerId, HW_TS_Mode_t TimerMode,
+		HW_TS_pTimerCb_t pTimerCallBack);
+void HW_TS_Stop(uint8_t TimerID);
+void HW_TS_Start(uint8_t TimerID, uint32_t timeout_ticks);
+void HW_TS_Delete(uint8_t TimerID);
+void HW_TS_RTC_Wakeup_Handler(void);
+uint16_t HW_TS_RTC_ReadLeftTicksToCount(void);
+void HW_TS_RTC_Int_AppNot(uint32_t TimerProcessID, uint8_t TimerID, HW_TS_pTimerCb_t pTimerCallBack);
+void HW_TS_RTC_CountUpdated_AppNot(void);
+
+#endif /* APP_COMMON_H */
@@ -0,0 +1,20 @@
+/*
+ * hw_conf.h
+ *
+ * The timer server settings of Inc/hw_conf.h. The number of timers can be
+ * set per build to measure the timer server with more or fewer of them.
+ */
+
+#ifndef HW_CONF_H
+#define HW_CONF_H
+
+#ifndef CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER
+#define CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER 16
+#endif
+#define CFG_HW_TS_NVIC_RTC_WAKEUP_IT_PREEMPTPRIO 3
+#define CFG_HW_TS_NVIC_RTC_WAKEUP_IT_SUBPRIO 0
+#define CFG_HW_TS_USE_PRIMASK_AS_CRITICAL_SECTION 1
+#define CFG_HW_TS_RTC_HANDLER_MAX_DELAY (10 * (LSI_VALUE / 1000))
+#define CFG_HW_TS_RTC_WAKEUP_HANDLER_ID RTC_WKUP_IRQn
+
+#endif /* HW_CONF_H */
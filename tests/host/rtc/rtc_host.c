@@ -0,0 +1,56 @@
+/*
+ * rtc_host.c
+ *
+ * The RTC the timer server runs on, see app_common.h. One tick is one count
+ * of the wakeup timer and of SSR, as with the RTCCLK / 16 clock and the
+ * asynchronous prescaler of 16 the firmware sets up.
+ */
+
+#include "app_common.h"
+
+RtcHost tRtcHost;
+RtcHost tRtcList;
+uint32_t uiHostPrimask;
+
+static RtcHost *const apRtc[] = { &tRtcHost, &tRtcList };
+static uint64_t ulTick;
+
+// Global Function Definitions
+void vRtcHostInit(RtcHost *pRtc) {
+	pRtc->CR = 0;
+	pRtc->WUTR = RTC_WUTR_WUT;
+	pRtc->PRER = (15u << 16) | RTC_PRER_PREDIV_S;
+	pRtc->SSR = RTC_PRER_PREDIV_S - (uint32_t) (ulTick % (RTC_PRER_PREDIV_S + 1));
+	pRtc->ulFireAt = 0;
+	pRtc->ucWutf = 0;
+	pRtc->ucPending = 0;
+	pRtc->ucIrqEnabled = 1;
+}
+
+// SSR counts down, the wakeup timers that reach their count set WUTF and reload
+void vRtcHostSetTick(uint64_t ulNow) {
+	RtcHost *rtc;
+	uint8_t i;
+
+	ulTick = ulNow;
+	for (i = 0; i < sizeof(apRtc) / sizeof(apRtc[0]); i++) {
+		rtc = apRtc[i];
+		rtc->SSR = RTC_PRER_PREDIV_S - (uint32_t) (ulTick % (RTC_PRER_PREDIV_S + 1));
+		while ((rtc->CR & RTC_CR_WUTE) && rtc->ulFireAt <= ulTick) {
+			rtc->ucWutf = 1;
+			rtc->ucPending = 1;
+			rtc->ulFireAt += (rtc->WUTR & RTC_WUTR_WUT) + 1;
+		}
+	}
+}
+
+// counts WUTR + 1 ticks from now
+void vRtcHostEnable(RtcHost *pRtc) {
+	pRtc->CR |= RTC_CR_WUTE;
+	pRtc->ulFireAt = ulTick + (pRtc->WUTR & RTC_WUTR_WUT) + 1;
+}
+
+// WUTR may be written once the timer is disabled
+uint8_t ucRtcHostWutwf(const RtcHost *pRtc) {
+	return (pRtc->CR & RTC_CR_WUTE) ? RESET : SET;
+}
@@ -0,0 +1,369 @@
+/*
+ * ssd1306_emu.c
+ *
+ * SSD1306 command interpreter and panel model, see ssd1306_emu.h.
+ */
+
+#include "ssd1306_emu.h"
+#include "ssd1306_conf.h"
+#include "hal_host.h"
+#include <stdio.h>
+#include <string.h>
+
+#define EMU_MODE_HORIZONTAL 0
+#define EMU_MODE_VERTICAL 1
+#define EMU_MODE_PAGE 2
+
+typedef struct {
+	uint8_t aRam[SSD1306_EMU_PAGES][SSD1306_EMU_WIDTH];
+	uint8_t ucMode;
+	uint8_t ucColStart, ucColEnd, ucPageStart, ucPageEnd;
+	uint8_t ucCol, ucPage;
+	uint8_t ucPageModeCol;    // column start of page addressing
+	uint8_t ucStartLine;
+	uint8_t ucOffset;
+	uint8_t ucMux;            // multiplex ratio - 1
+	uint8_t ucSegRemap;
+	uint8_t ucComRemap;
+	uint8_t ucInverse;
+	uint8_t ucEntireOn;
+	uint8_t ucDisplayOn;
+	uint8_t ucClock;          // 0xD5 argument
+	uint8_t ucPrecharge;      // 0xD9 argument
+	uint8_t ucScrollLeft;
+	uint8_t ucScrollFirst, ucScrollLast;
+	uint8_t ucScrollFrames;
+	uint8_t ucScrollSetup;
+	uint8_t ucScrollActive;
+	uint32_t uiScrollCount;
+	uint8_t aCmd[8];          // command being collected
+	uint8_t ucCmdLen, ucCmdNeed;
+	uint32_t uiUsLeft;        // toward the next frame
+	uint32_t uiOscHz;
+	Ssd1306EmuStats tStats;
+} Ssd1306Emu;
+
+static Ssd1306Emu tEmu;
+
+// frames per scroll step for the interval codes 0..7
+static const uint16_t aScrollFrames[8] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+// local function prototypes
+static void vEmuWrite(const uint8_t *pData, uint16_t usLen);
+static void vEmuRunDevice(uint32_t uiUs);
+static uint8_t ucEmuArgs(uint8_t ucCmd);
+static void vEmuCommand(void);
+static void vEmuByte(uint8_t ucByte, uint8_t ucData);
+static void vEmuData(uint8_t ucByte);
+static void vEmuScrollStep(void);
+
+static const HostI2cDevice tEmuDevice = { SSD1306_I2C_ADDR, vEmuWrite, NULL, vEmuRunDevice };
+
+//local functions
+static uint8_t ucEmuArgs(uint8_t ucCmd) {
+	switch (ucCmd) {
+	case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5:
+	case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+	case 0x21: case 0x22: case 0xA3:
+		return 2;
+	case 0x29: case 0x2A:
+		return 5;
+	case 0x26: case 0x27:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+static void vEmuCommand(void) {
+	uint8_t *c = tEmu.aCmd;
+
+	switch (c[0]) {
+	case 0x20:
+		tEmu.ucMode = c[1] & 0x03;
+		break;
+	case 0x21:
+		// column and page windows only apply to horizontal and vertical addressing
+		if (tEmu.ucMode == EMU_MODE_PAGE)
+			break;
+		tEmu.ucColStart = tEmu.ucCol = c[1] & 0x7F;
+		tEmu.ucColEnd = c[2] & 0x7F;
+		break;
+	case 0x22:
+		if (tEmu.ucMode == EMU_MODE_PAGE)
+			break;
+		tEmu.ucPageStart = tEmu.ucPage = c[1] & 0x07;
+		tEmu.ucPageEnd = c[2] & 0x07;
+		break;
+	case 0x26:
+	case 0x27:
+	case 0x29:
+	case 0x2A:
+	case 0xA3:
+		if (tEmu.ucScrollActive)
+			tEmu.tStats.uiViolations++;
+		if (c[0] == 0x26 || c[0] == 0x27) {
+			tEmu.ucScrollLeft = c[0] == 0x27;
+			tEmu.ucScrollFirst = c[2] & 0x07;
+			tEmu.ucScrollFrames = c[3] & 0x07;
+			tEmu.ucScrollLast = c[4] & 0x07;
+			tEmu.ucScrollSetup = 1;
+		}
+		break;
+	case 0x2E:
+		tEmu.ucScrollActive = 0;
+		break;
+	case 0x2F:
+		if (tEmu.ucScrollSetup && tEmu.ucScrollFirst <= tEmu.ucScrollLast) {
+			tEmu.ucScrollActive = 1;
+			tEmu.uiScrollCount = 0;
+		}
+		break;
+	case 0x81: case 0x8D: case 0xDA: case 0xDB:
+		// contrast, charge pump, COM pins and VCOMH do not change the image
+		break;
+	case 0xA0: case 0xA1:
+		tEmu.ucSegRemap = c[0] & 1;
+		break;
+	case 0xA4: case 0xA5:
+		tEmu.ucEntireOn = c[0] & 1;
+		break;
+	case 0xA6: case 0xA7:
+		tEmu.ucInverse = c[0] & 1;
+		break;
+	case 0xA8:
+		if ((c[1] & 0x3F) >= 15)
+			tEmu.ucMux = c[1] & 0x3F;
+		break;
+	case 0xAE: case 0xAF:
+		tEmu.ucDisplayOn = c[0] & 1;
+		break;
+	case 0xC0: case 0xC8:
+		tEmu.ucComRemap = c[0] == 0xC8;
+		break;
+	case 0xD3:
+		tEmu.ucOffset = c[1] & 0x3F;
+		break;
+	case 0xD5:
+		tEmu.ucClock = c[1];
+		break;
+	case 0xD9:
+		tEmu.ucPrecharge = c[1];
+		break;
+	default:
+		if (c[0] >= 0x40 && c[0] <= 0x7F) {
+			tEmu.ucStartLine = c[0] & 0x3F;
+		} else if (tEmu.ucMode == EMU_MODE_PAGE && c[0] <= 0x0F) {
+			tEmu.ucPageModeCol = tEmu.ucCol = (tEmu.ucCol & 0xF0) | c[0];
+		} else if (tEmu.ucMode == EMU_MODE_PAGE && c[0] <= 0x1F) {
+			tEmu.ucPageModeCol = tEmu.ucCol = ((c[0] & 0x07) << 4) | (tEmu.ucCol & 0x0F);
+		} else if (tEmu.ucMode == EMU_MODE_PAGE && c[0] >= 0xB0 && c[0] <= 0xB7) {
+			tEmu.ucPage = c[0] & 0x07;
+		}
+		break;
+	}
+}
+
+static void vEmuData(uint8_t ucByte) {
+	if (tEmu.ucScrollActive)
+		tEmu.tStats.uiViolations++;
+	tEmu.tStats.uiDataBytes++;
+	tEmu.aRam[tEmu.ucPage][tEmu.ucCol] = ucByte;
+
+	switch (tEmu.ucMode) {
+	case EMU_MODE_HORIZONTAL:
+		if (tEmu.ucCol++ < tEmu.ucColEnd)
+			break;
+		tEmu.ucCol = tEmu.ucColStart;
+		if (tEmu.ucPage++ >= tEmu.ucPageEnd)
+			tEmu.ucPage = tEmu.ucPageStart;
+		break;
+	case EMU_MODE_VERTICAL:
+		if (tEmu.ucPage++ < tEmu.ucPageEnd)
+			break;
+		tEmu.ucPage = tEmu.ucPageStart;
+		if (tEmu.ucCol++ >= tEmu.ucColEnd)
+			tEmu.ucCol = tEmu.ucColStart;
+		break;
+	default:
+		if (tEmu.ucCol++ >= SSD1306_EMU_WIDTH - 1)
+			tEmu.ucCol = tEmu.ucPageModeCol;
+		break;
+	}
+}
+
+static void vEmuByte(uint8_t ucByte, uint8_t ucData) {
+	if (ucData) {
+		vEmuData(ucByte);
+		return;
+	}
+	if (tEmu.ucCmdNeed == 0) {
+		tEmu.aCmd[0] = ucByte;
+		tEmu.ucCmdLen = 1;
+		tEmu.ucCmdNeed = ucEmuArgs(ucByte) + 1;
+	} else {
+		tEmu.aCmd[tEmu.ucCmdLen++] = ucByte;
+	}
+	if (tEmu.ucCmdLen == tEmu.ucCmdNeed) {
+		vEmuCommand();
+		tEmu.ucCmdNeed = 0;
+	}
+}
+
+// a control byte with Co set covers one byte, without it the rest of the transfer
+static void vEmuWrite(const uint8_t *pData, uint16_t usLen) {
+	uint16_t i = 0;
+	uint8_t ctrl;
+
+	tEmu.tStats.uiTransactions++;
+	tEmu.tStats.uiBytes += usLen + 1;
+	while (i < usLen) {
+		ctrl = pData[i++];
+		if (ctrl & 0x80) {
+			if (i < usLen)
+				vEmuByte(pData[i++], ctrl & 0x40);
+			continue;
+		}
+		while (i < usLen)
+			vEmuByte(pData[i++], ctrl & 0x40);
+	}
+}
+
+// one column per step, the band wraps around
+static void vEmuScrollStep(void) {
+	uint8_t page, edge;
+
+	for (page = tEmu.ucScrollFirst; page <= tEmu.ucScrollLast; page++) {
+		if (tEmu.ucScrollLeft) {
+			edge = tEmu.aRam[page][0];
+			memmove(&tEmu.aRam[page][0], &tEmu.aRam[page][1], SSD1306_EMU_WIDTH - 1);
+			tEmu.aRam[page][SSD1306_EMU_WIDTH - 1] = edge;
+		} else {
+			edge = tEmu.aRam[page][SSD1306_EMU_WIDTH - 1];
+			memmove(&tEmu.aRam[page][1], &tEmu.aRam[page][0], SSD1306_EMU_WIDTH - 1);
+			tEmu.aRam[page][0] = edge;
+		}
+	}
+	tEmu.tStats.uiScrollSteps++;
+}
+
+static void vEmuRunDevice(uint32_t uiUs) {
+	vSsd1306EmuRun(uiUs);
+}
+
+// Global Function Definitions
+// power on reset state, attached to the host I2C bus
+void vSsd1306EmuInit(void) {
+	memset(&tEmu, 0, sizeof(tEmu));
+	tEmu.ucMode = EMU_MODE_PAGE;
+	tEmu.ucColEnd = SSD1306_EMU_WIDTH - 1;
+	tEmu.ucPageEnd = SSD1306_EMU_PAGES - 1;
+	tEmu.ucMux = SSD1306_EMU_HEIGHT - 1;
+	tEmu.ucClock = 0x80;
+	tEmu.ucPrecharge = 0x22;
+	tEmu.uiOscHz = SSD1306_EMU_OSC_HZ;
+	vHostI2cAttach(&tEmuDevice);
+}
+
+// real parts spread around the typical oscillator frequency
+void vSsd1306EmuSetOsc(uint32_t uiHz) {
+	tEmu.uiOscHz = uiHz;
+}
+
+// frame period = divide ratio * (phase 1 + phase 2 + 50) * mux / Fosc
+uint32_t uiSsd1306EmuFrameUs(void) {
+	uint32_t clocks = ((tEmu.ucClock & 0x0F) + 1)
+			* ((tEmu.ucPrecharge & 0x0F) + (tEmu.ucPrecharge >> 4) + 50)
+			* (tEmu.ucMux + 1);
+
+	return (uint32_t) ((uint64_t) clocks * 1000000 / tEmu.uiOscHz);
+}
+
+void vSsd1306EmuRun(uint32_t uiUs) {
+	uint32_t frame = uiSsd1306EmuFrameUs();
+	uint32_t frames = aScrollFrames[tEmu.ucScrollFrames];
+
+	tEmu.uiUsLeft += uiUs;
+	while (tEmu.uiUsLeft >= frame) {
+		tEmu.uiUsLeft -= frame;
+		if (tEmu.ucScrollActive && ++tEmu.uiScrollCount >= frames) {
+			tEmu.uiScrollCount = 0;
+			vEmuScrollStep();
+		}
+	}
+}
+
+// 1 for a lit pixel at x, y of the panel
+uint8_t ucSsd1306EmuPixel(uint8_t x, uint8_t y) {
+	uint8_t col, com, row, line, lit;
+
+	if (x >= SSD1306_EMU_WIDTH || y >= SSD1306_EMU_HEIGHT || !tEmu.ucDisplayOn)
+		return 0;
+	col = tEmu.ucSegRemap ? x : SSD1306_EMU_WIDTH - 1 - x;
+	com = tEmu.ucComRemap ? y : SSD1306_EMU_HEIGHT - 1 - y;
+	row = (com - tEmu.ucOffset) & 0x3F;
+	if (row > tEmu.ucMux)
+		return 0;
+	line = (tEmu.ucStartLine + row) & 0x3F;
+	lit = tEmu.ucEntireOn || ((tEmu.aRam[line / 8][col] >> (line % 8)) & 1);
+	return lit ^ tEmu.ucInverse;
+}
+
+uint8_t ucSsd1306EmuRam(uint8_t ucPage, uint8_t ucCol) {
+	return tEmu.aRam[ucPage & 0x07][ucCol & 0x7F];
+}
+
+uint8_t ucSsd1306EmuScrolling(void) {
+	return tEmu.ucScrollActive;
+}
+
+void vSsd1306EmuStats(Ssd1306EmuStats *pStats) {
+	*pStats = tEmu.tStats;
+}
+
+void vSsd1306EmuStatsReset(void) {
+	memset(&tEmu.tStats, 0, sizeof(tEmu.tStats));
+}
+
+// plain PBM, unlit pixels are written black so the file looks like the panel
+uint8_t ucSsd1306EmuWritePbm(const char *pPath) {
+	FILE *f = fopen(pPath, "w");
+	uint8_t x, y;
+
+	if (f == NULL)
+		return 0;
+	fprintf(f, "P1\n%d %d\n", SSD1306_EMU_WIDTH, SSD1306_EMU_HEIGHT);
+	for (y = 0; y < SSD1306_EMU_HEIGHT; y++) {
+		for (x = 0; x < SSD1306_EMU_WIDTH; x++)
+			fputc(ucSsd1306EmuPixel(x, y) ? '0' : '1', f);
+		fputc('\n', f);
+	}
+	fclose(f);
+	return 1;
+}
+
+// number of pixels that differ from the image in pPath, -1 without a readable image
+int32_t iSsd1306EmuComparePbm(const char *pPath) {
+	FILE *f = fopen(pPath, "r");
+	int32_t diff = 0;
+	int w, h, ch;
+	uint16_t n = 0;
+
+	if (f == NULL)
+		return -1;
+	if (fscanf(f, "P1 %d %d", &w, &h) != 2 || w != SSD1306_EMU_WIDTH
+			|| h != SSD1306_EMU_HEIGHT) {
+		fclose(f);
+		return -1;
+	}
+	while (n < SSD1306_EMU_WIDTH * SSD1306_EMU_HEIGHT && (ch = fgetc(f)) != EOF) {
+		if (ch != '0' && ch != '1')
+			continue;
+		if ((ch == '0') != ucSsd1306EmuPixel(n % SSD1306_EMU_WIDTH, n / SSD1306_EMU_WIDTH))
+			diff++;
+		n++;
+	}
+	fclose(f);
+	return n == SSD1306_EMU_WIDTH * SSD1306_EMU_HEIGHT ? diff : -1;
+}
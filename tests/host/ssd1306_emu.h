@@ -0,0 +1,46 @@
+/*
+ * ssd1306_emu.h
+ *
+ * SSD1306 controller on the host I2C bus. The command stream is interpreted
+ * like the datasheet describes it: page, horizontal and vertical addressing
+ * with their column and page pointers, multiplex ratio, start line, display
+ * offset, segment and COM remap, inverse and entire display on, and the
+ * continuous horizontal scroll stepping with the frame clock.
+ *
+ * The panel image is what a 128x64 module wired for segment remap 0xA1 and
+ * COM scan 0xC8 shows, the orientation SSD1306_Init() sets up. Writing
+ * GDDRAM or setting up a scroll while the scroll runs is counted as a
+ * violation, the datasheet does not allow either.
+ */
+
+#ifndef SSD1306_EMU_H_
+#define SSD1306_EMU_H_
+#include <stdint.h>
+
+#define SSD1306_EMU_WIDTH 128
+#define SSD1306_EMU_HEIGHT 64
+#define SSD1306_EMU_PAGES 8
+// oscillator frequency the frame clock runs from unless set otherwise
+#define SSD1306_EMU_OSC_HZ 370000
+
+typedef struct {
+	uint32_t uiBytes;         // address and control bytes included
+	uint32_t uiTransactions;
+	uint32_t uiDataBytes;     // GDDRAM writes
+	uint32_t uiViolations;
+	uint32_t uiScrollSteps;
+} Ssd1306EmuStats;
+
+void vSsd1306EmuInit(void);
+void vSsd1306EmuSetOsc(uint32_t uiHz);
+void vSsd1306EmuRun(uint32_t uiUs);
+uint32_t uiSsd1306EmuFrameUs(void);
+uint8_t ucSsd1306EmuPixel(uint8_t x, uint8_t y);
+uint8_t ucSsd1306EmuRam(uint8_t ucPage, uint8_t ucCol);
+uint8_t ucSsd1306EmuScrolling(void);
+void vSsd1306EmuStats(Ssd1306EmuStats *pStats);
+void vSsd1306EmuStatsReset(void);
+uint8_t ucSsd1306EmuWritePbm(const char *pPath);
+int32_t iSsd1306EmuComparePbm(const char *pPath);
+
+#endif /* SSD1306_EMU_H_ */
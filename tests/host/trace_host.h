@@ -0,0 +1,17 @@
+/*
+ * trace_host.h
+ *
+ * Forced into the BLE build: the APP_DBG_MSG traces go through
+ * iHostTrace(), silent unless BLE_HOST_TRACE is set in the environment, so
+ * only the test results reach stdout.
+ */
+
+#ifndef TRACE_HOST_H_
+#define TRACE_HOST_H_
+#include <stdio.h>
+
+int iHostTrace(const char *pFormat, ...) __attribute__((format(printf, 1, 2)));
+
+#define printf iHostTrace
+
+#endif /* TRACE_HOST_H_ */
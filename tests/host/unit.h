@@ -0,0 +1,43 @@
+/*
+ * unit.h
+ *
+ * Checks for the host tests. One test program per translation unit, a failed
+ * check prints where and keeps going, main() returns UNIT_END().
+ */
+
+#ifndef UNIT_H_
+#define UNIT_H_
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t uiUnitChecks;
+static uint32_t uiUnitFailures;
+
+#define CHECK(cond) do { \
+	uiUnitChecks++; \
+	if (!(cond)) { \
+		printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		uiUnitFailures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+	long long llA = (long long) (a), llB = (long long) (b); \
+	uiUnitChecks++; \
+	if (llA != llB) { \
+		printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", \
+				__FILE__, __LINE__, #a, #b, llA, llB); \
+		uiUnitFailures++; \
+	} \
+} while (0)
+
+#define UNIT_RUN(test) do { \
+	uint32_t uiBefore = uiUnitFailures; \
+	test(); \
+	printf("%-40s %s\n", #test, uiUnitFailures == uiBefore ? "ok" : "FAILED"); \
+} while (0)
+
+#define UNIT_END() (printf("%u checks, %u failed\n", (unsigned) uiUnitChecks, \
+		(unsigned) uiUnitFailures), uiUnitFailures ? 1 : 0)
+
+#endif /* UNIT_H_ */
@@ -0,0 +1,139 @@
+/*
+ * test_bitmap_rle.c
+ *
+ * The RLE assets decoded by SSD1306_DrawRle() against the bitmaps they were
+ * generated from in tools/bitmaps, pixel by pixel, with the flash each
+ * stream saves and the decode time next to the pixel drawing it replaced.
+ */
+
+#include "unit.h"
+#include "ssd1306.h"
+#include "bluetooth_logo.h"
+
+#include <string.h>
+#include <time.h>
+
+// tools/bitmaps/logo.h and Inc/logo.h share the LOGO guard
+#include "../tools/bitmaps/logo.h"
+#undef LOGO
+#include "logo.h"
+
+#define BENCH_RUNS 2000
+
+// tools/bitmaps/bluetooth_logo.c, one row per word, leftmost pixel in bit 23
+extern const long int bluetooth_logo[];
+#define BLUETOOTH_LOGO_BITS 24
+
+// local function prototypes
+static uint16_t usRleLength(const uint8_t *rle, uint16_t bytes);
+static uint64_t ulNowNs(void);
+static uint8_t ucFbPixel(uint8_t x, uint8_t y);
+
+//local functions
+// stream bytes that decode to the given number of page bytes
+static uint16_t usRleLength(const uint8_t *rle, uint16_t bytes) {
+	const uint8_t *p = rle;
+	uint16_t n;
+
+	while (bytes) {
+		n = *p & 0x80 ? *p - 0x80 + 2 : *p + 1;
+		p += *p & 0x80 ? 2 : n + 1;
+		bytes -= n < bytes ? n : bytes;
+	}
+	return (uint16_t) (p - rle);
+}
+
+static uint64_t ulNowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint8_t ucFbPixel(uint8_t x, uint8_t y) {
+	return (SSD1306_GetBuffer()[(y / 8) * SSD1306_WIDTH + x] >> (y % 8)) & 1;
+}
+
+// the boot logo against the LCD Assistant rows drawn the old way
+static void test_logo_pixels(void) {
+	static uint8_t ref[SSD1306_BUFFER_SIZE];
+
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	SSD1306_DrawBitmap(0, 0, logo, LOGO_WIDTH, LOGO_PAGES * 8,
+			SSD1306_COLOR_WHITE);
+	memcpy(ref, SSD1306_GetBuffer(), sizeof(ref));
+
+	// leftovers of a previous screen must not show through
+	SSD1306_Fill(SSD1306_COLOR_WHITE);
+	SSD1306_DrawRle(0, 0, LOGO_WIDTH, LOGO_PAGES, logo_rle);
+	CHECK(memcmp(ref, SSD1306_GetBuffer(), sizeof(ref)) == 0);
+}
+
+// the Bluetooth logo at its hal_lcd position, everything around it untouched
+static void test_bluetooth_logo_pixels(void) {
+	uint8_t x, y, want;
+	uint16_t errors = 0;
+
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	SSD1306_DrawPixel(0, 0, SSD1306_COLOR_WHITE);
+	SSD1306_DrawPixel(1 + BLUETOOTH_LOGO_WIDTH, 0, SSD1306_COLOR_WHITE);
+	SSD1306_DrawPixel(1, BLUETOOTH_LOGO_HEIGHT, SSD1306_COLOR_WHITE);
+	SSD1306_DrawRle(1, 0, BLUETOOTH_LOGO_WIDTH, BLUETOOTH_LOGO_PAGES,
+			bluetooth_logo_rle);
+	for (y = 0; y < BLUETOOTH_LOGO_HEIGHT; y++) {
+		for (x = 0; x < BLUETOOTH_LOGO_WIDTH; x++) {
+			want = (bluetooth_logo[y] >> (BLUETOOTH_LOGO_BITS - 1 - x)) & 1;
+			if (ucFbPixel(1 + x, y) != want)
+				errors++;
+		}
+	}
+	CHECK_EQ(errors, 0);
+	CHECK_EQ(ucFbPixel(0, 0), 1);
+	CHECK_EQ(ucFbPixel(1 + BLUETOOTH_LOGO_WIDTH, 0), 1);
+	CHECK_EQ(ucFbPixel(1, BLUETOOTH_LOGO_HEIGHT), 1);
+}
+
+// page bytes of the plain bitmap in flash against the RLE stream, and the
+// time to put each asset into the framebuffer
+static void test_flash_and_decode_time(void) {
+	uint16_t logoRaw = sizeof(logo);
+	uint16_t logoRle = usRleLength(logo_rle, LOGO_WIDTH * LOGO_PAGES);
+	uint16_t btRaw = BLUETOOTH_LOGO_WIDTH * BLUETOOTH_LOGO_PAGES;
+	uint16_t btRle = usRleLength(bluetooth_logo_rle, btRaw);
+	uint64_t start;
+	uint32_t rleNs, bitmapNs;
+	uint16_t run;
+
+	CHECK_EQ(logoRle, sizeof(logo_rle));
+	CHECK(logoRle < logoRaw);
+	CHECK(btRle < btRaw);
+
+	start = ulNowNs();
+	for (run = 0; run < BENCH_RUNS; run++)
+		SSD1306_DrawRle(0, 0, LOGO_WIDTH, LOGO_PAGES, logo_rle);
+	rleNs = (uint32_t) ((ulNowNs() - start) / BENCH_RUNS);
+	start = ulNowNs();
+	for (run = 0; run < BENCH_RUNS; run++)
+		SSD1306_DrawBitmap(0, 0, logo, LOGO_WIDTH, LOGO_PAGES * 8,
+				SSD1306_COLOR_WHITE);
+	bitmapNs = (uint32_t) ((ulNowNs() - start) / BENCH_RUNS);
+	printf("%-16s %6s %6s %8s %10s\n", "asset", "raw", "rle", "rle ns",
+			"bitmap ns");
+	printf("%-16s %6u %6u %8u %10u\n", "logo", logoRaw, logoRle,
+			(unsigned) rleNs, (unsigned) bitmapNs);
+
+	start = ulNowNs();
+	for (run = 0; run < BENCH_RUNS; run++)
+		SSD1306_DrawRle(1, 0, BLUETOOTH_LOGO_WIDTH, BLUETOOTH_LOGO_PAGES,
+				bluetooth_logo_rle);
+	rleNs = (uint32_t) ((ulNowNs() - start) / BENCH_RUNS);
+	printf("%-16s %6u %6u %8u %10s\n", "bluetooth_logo", btRaw, btRle,
+			(unsigned) rleNs, "-");
+}
+
+int main(void) {
+	UNIT_RUN(test_logo_pixels);
+	UNIT_RUN(test_bluetooth_logo_pixels);
+	UNIT_RUN(test_flash_and_decode_time);
+	return UNIT_END();
+}
@@ -0,0 +1,228 @@
+/*
+ * test_cmd_in_place.c
+ *
+ * Notification commands serialised in place by hci_async_reserve() and
+ * hci_async_commit(), against the same command built the way the generated
+ * ACI wrappers do it, in a cmd_buffer[BLE_CMD_MAX_PARAM_LEN] on the stack and
+ * copied by hci_send_req_async(). With the link to CPU2 idle the reserved
+ * area has to be the mailbox command buffer itself, behind a command in
+ * flight a ring slot. The benchmark reports the stack each way takes, painted
+ * and scanned below the caller, the bytes memcpy() moves, counted through
+ * the linker's --wrap, and the host ns per command where the target would
+ * count DWT cycles; both commands reach CPU2 the same.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "tl.h"
+#include "mbox_def.h"
+#include "hci_tl.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+
+// Value_Length of one aci_gatt_update_char_value_ext()
+#define UPDATE_HDR 12
+#define UPDATE_CHUNK_MAX (BLE_CMD_MAX_PARAM_LEN - UPDATE_HDR)
+#define STACK_PROBE 4096
+#define STACK_MARGIN 256
+#define STACK_PAINT 0xA5
+#define BENCH_COMMANDS 2000
+
+extern MB_RefTable_t __start_MAPPING_TABLE[];
+
+static const Cpu2HostCentral tCentral = { 512, 251, 1, 24, -60 };
+static uint8_t aValue[UPDATE_CHUNK_MAX];
+static uint16_t usData;
+static uint32_t uiDone;
+static uint32_t uiCopied;
+static uint8_t ucCounting;
+
+void *__real_memcpy(void *pDst, const void *pSrc, size_t n);
+void *__wrap_memcpy(void *pDst, const void *pSrc, size_t n);
+
+// local function prototypes
+static void vDone(uint16_t usOpcode, uint8_t ucStatus, uint32_t uiContext);
+static void vHeader(aci_gatt_update_char_value_ext_cp0 *pCp0);
+static void vCopied(void);
+static void vInPlace(void);
+static uint32_t uiStackUsed(void (*pfSend)(void));
+static uint32_t uiNsPerCommand(void (*pfSend)(void));
+static void vConnected(void);
+static uint32_t uiBytesCopied(void (*pfSend)(void));
+
+//local functions
+// every memcpy() of the test and of the library, see CMakeLists.txt
+void *__wrap_memcpy(void *pDst, const void *pSrc, size_t n) {
+	if (ucCounting)
+		uiCopied += n;
+	return __real_memcpy(pDst, pSrc, n);
+}
+
+static void vDone(uint16_t usOpcode, uint8_t ucStatus, uint32_t uiContext) {
+	(void) usOpcode;
+	(void) uiContext;
+	CHECK_EQ(ucStatus, BLE_STATUS_SUCCESS);
+	uiDone++;
+}
+
+// one chunk of DATA, notified to the first link
+static void vHeader(aci_gatt_update_char_value_ext_cp0 *pCp0) {
+	pCp0->Conn_Handle_To_Notify = 0;
+	pCp0->Service_Handle = usCpu2HostServiceOf(usData);
+	pCp0->Char_Handle = usData - 1;
+	pCp0->Update_Type = 0;
+	pCp0->Char_Length = UPDATE_CHUNK_MAX;
+	pCp0->Value_Offset = 0;
+	pCp0->Value_Length = UPDATE_CHUNK_MAX;
+}
+
+// as the generated wrappers build it, copied again by hci_send_req_async()
+static void vCopied(void) {
+	uint8_t cmd_buffer[BLE_CMD_MAX_PARAM_LEN];
+	aci_gatt_update_char_value_ext_cp0 *cp0 = (aci_gatt_update_char_value_ext_cp0 *) cmd_buffer;
+
+	vHeader(cp0);
+	memcpy(cp0->Value, aValue, UPDATE_CHUNK_MAX);
+	CHECK_EQ(hci_send_req_async(CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT, UPDATE_HDR + UPDATE_CHUNK_MAX,
+			cmd_buffer, vDone, 0), 0);
+}
+
+// as SmartWatch_Async_Next() builds it
+static void vInPlace(void) {
+	aci_gatt_update_char_value_ext_cp0 *cp0;
+
+	cp0 = (aci_gatt_update_char_value_ext_cp0 *) hci_async_reserve();
+	CHECK(cp0 != NULL);
+	if (cp0 == NULL)
+		return;
+	vHeader(cp0);
+	memcpy(cp0->Value, aValue, UPDATE_CHUNK_MAX);
+	CHECK_EQ(hci_async_commit(CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT, UPDATE_HDR + UPDATE_CHUNK_MAX,
+			vDone, 0), 0);
+}
+
+/*
+ * Paints STACK_PROBE bytes below this frame, with STACK_MARGIN left for the
+ * frame itself, and returns how deep pfSend wrote into them. Only the
+ * difference between two senders means anything, the margin is in both.
+ */
+static __attribute__((noinline)) uint32_t uiStackUsed(void (*pfSend)(void)) {
+	volatile uint8_t *top = (volatile uint8_t *) __builtin_frame_address(0) - STACK_MARGIN;
+	uint32_t i;
+
+	for (i = 1; i <= STACK_PROBE; i++)
+		top[-(int32_t) i] = STACK_PAINT;
+	pfSend();
+	for (i = STACK_PROBE; i > 0; i--)
+		if (top[-(int32_t) i] != STACK_PAINT)
+			break;
+	return i;
+}
+
+// CPU2 answers between the commands, only the send is timed
+static uint32_t uiNsPerCommand(void (*pfSend)(void)) {
+	uint64_t ns = 0;
+	uint32_t start;
+	uint16_t i;
+
+	for (i = 0; i < BENCH_COMMANDS; i++) {
+		start = uiHostNs();
+		pfSend();
+		ns += (uint32_t) (uiHostNs() - start);
+		vBleHostRun(1);
+	}
+	return (uint32_t) (ns / BENCH_COMMANDS);
+}
+
+// bytes memcpy() moves for one command on an idle link
+static uint32_t uiBytesCopied(void (*pfSend)(void)) {
+	uiCopied = 0;
+	ucCounting = 1;
+	pfSend();
+	ucCounting = 0;
+	vBleHostRun(1);
+	return uiCopied;
+}
+
+static void vConnected(void) {
+	uint16_t i;
+
+	vBleHostInit();
+	usBleHostConnect(&tCentral);
+	usData = usBleHostChar(BLE_HOST_DATA);
+	for (i = 0; i < UPDATE_CHUNK_MAX; i++)
+		aValue[i] = (uint8_t) (i * 7);
+	vCpu2HostClearNotifications();
+	uiDone = 0;
+}
+
+// idle link: the mailbox, a command in flight: a ring slot
+static void test_reserve(void) {
+	TL_CmdPacket_t *mailbox;
+	const uint8_t *stored;
+	uint16_t len;
+
+	vConnected();
+	mailbox = (TL_CmdPacket_t *) __start_MAPPING_TABLE->p_ble_table->pcmd_buffer;
+	vCpu2HostSetLatency(500);
+	CHECK(hci_async_reserve() == mailbox->cmdserial.cmd.payload);
+	vInPlace();
+	CHECK(hci_async_reserve() != mailbox->cmdserial.cmd.payload);
+	vInPlace();
+	vBleHostRun(5);
+	CHECK_EQ(uiDone, 2);
+	CHECK_EQ(usCpu2HostUpdates(), 2);
+	stored = pCpu2HostValue(usData, &len);
+	CHECK_EQ(len, UPDATE_CHUNK_MAX);
+	CHECK(memcmp(stored, aValue, UPDATE_CHUNK_MAX) == 0);
+	CHECK(hci_async_reserve() == mailbox->cmdserial.cmd.payload);
+}
+
+// stack and time of each way, both land in CPU2 the same
+static void test_benchmark(void) {
+	uint32_t copiedStack, inPlaceStack, copiedNs, inPlaceNs, copiedBytes, inPlaceBytes;
+	const uint8_t *stored;
+	uint16_t len;
+
+	vConnected();
+	copiedStack = uiStackUsed(vCopied);
+	vBleHostRun(1);
+	stored = pCpu2HostValue(usData, &len);
+	CHECK(len == UPDATE_CHUNK_MAX && memcmp(stored, aValue, len) == 0);
+	inPlaceStack = uiStackUsed(vInPlace);
+	vBleHostRun(1);
+	CHECK_EQ(uiDone, 2);
+	CHECK_EQ(usCpu2HostUpdates(), 2);
+	// the cmd_buffer less the few locals the in place path keeps
+	CHECK(copiedStack >= inPlaceStack + BLE_CMD_MAX_PARAM_LEN - 32);
+
+	// the whole command once more, the host CPU2 copies what it takes in both
+	copiedBytes = uiBytesCopied(vCopied);
+	inPlaceBytes = uiBytesCopied(vInPlace);
+	CHECK_EQ(copiedBytes - inPlaceBytes, UPDATE_HDR + UPDATE_CHUNK_MAX);
+
+	copiedNs = uiNsPerCommand(vCopied);
+	inPlaceNs = uiNsPerCommand(vInPlace);
+	CHECK_EQ(uiDone, 4 + 2 * BENCH_COMMANDS);
+	printf("%u octet update: stack %u bytes copied, %u in place, %u saved\n",
+			UPDATE_CHUNK_MAX, (unsigned) copiedStack, (unsigned) inPlaceStack,
+			(unsigned) (copiedStack - inPlaceStack));
+	printf("%u octet update: memcpy %u bytes saved\n",
+			UPDATE_CHUNK_MAX, (unsigned) (copiedBytes - inPlaceBytes));
+	printf("%u octet update: %u ns copied, %u ns in place per command\n",
+			UPDATE_CHUNK_MAX, (unsigned) copiedNs, (unsigned) inPlaceNs);
+}
+
+int main(void) {
+	UNIT_RUN(test_reserve);
+	UNIT_RUN(test_benchmark);
+	return UNIT_END();
+}
@@ -0,0 +1,278 @@
+/*
+ * test_conn_governor.c
+ *
+ * Connection parameter governor of conn_governor.c on scripted subscription
+ * scenarios. A link model plays the connection: events at the interval the
+ * last accepted request set, skipped up to the peripheral latency while the
+ * queue is empty, at most LINK_PACKETS_PER_EVENT notifications per event, an
+ * update taking effect LINK_UPDATE_EVENTS events after it was asked for. The
+ * producer fills a NOTIFY_QUEUE_SLOTS queue at the rate of the scenario and
+ * the governor runs every LINK_TICK_MS like Link_Tick() does. Each scenario
+ * reports the requests sent, queue depth, drops and the radio duty cycle,
+ * air time from a 1M PHY packet model. The last test runs app_ble.c itself
+ * against the host CPU2 and follows the interval it ends up with.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "conn_governor.h"
+#include "notify_queue.h"
+
+#include <string.h>
+
+#define LINK_TICK_MS 500
+#define LINK_PACKETS_PER_EVENT 6
+#define LINK_UPDATE_EVENTS 6
+// interval the central connects with, 30 ms
+#define LINK_CONNECT_INTERVAL 24
+// preamble, access address, LL header, L2CAP and ATT headers, CRC
+#define AIR_OVERHEAD 17
+#define AIR_IFS_US 150
+// empty packet both ways and the wake up around each event
+#define EVENT_US 500
+#define PHASES_MAX 8
+// PPG at 100 Hz in 18 bit pairs, coded to about two thirds
+#define WAVEFORM_BYTES_PER_S 300
+#define SUMMARY_VALUES_PER_S 1
+
+typedef struct {
+	uint32_t uiMs;
+	uint8_t ucDemand;          // ConnGovDemand
+	uint16_t usPayload;        // notification payload of the link
+} Phase;
+
+typedef struct {
+	const char *pName;
+	Phase aPhases[PHASES_MAX];
+} Scenario;
+
+typedef struct {
+	uint32_t uiRequests;
+	uint32_t uiGapMin;         // ms between two requests
+	uint8_t ucDepthMax;
+	uint32_t uiDepthSum;       // per ms, for the mean
+	uint32_t uiDrops;
+	uint32_t uiDropsSettled;   // in the last half of each phase
+	uint64_t ulOnUs;
+	uint32_t uiMs;
+	uint8_t ucProfile;         // at the end
+} Result;
+
+// the phone subscribes DATA at 10 s, the link is set up
+static const Scenario aScenarios[] = {
+	{ "idle", { { 60000, CONN_GOV_DEMAND_NONE, 244 } } },
+	{ "summary only", { { 10000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 60000, CONN_GOV_DEMAND_SUMMARY, 244 } } },
+	{ "waveform, 244 octets", { { 10000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 60000, CONN_GOV_DEMAND_WAVEFORM, 244 } } },
+	{ "waveform, 20 octets", { { 10000, CONN_GOV_DEMAND_NONE, 20 },
+			{ 60000, CONN_GOV_DEMAND_WAVEFORM, 20 } } },
+	{ "waveform, 3 s pause", { { 10000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 30000, CONN_GOV_DEMAND_WAVEFORM, 244 }, { 3000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 27000, CONN_GOV_DEMAND_WAVEFORM, 244 } } },
+	{ "waveform, then summary", { { 10000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 30000, CONN_GOV_DEMAND_WAVEFORM, 244 }, { 30000, CONN_GOV_DEMAND_SUMMARY, 244 } } },
+	{ "subscribe churn 1 s", { { 10000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 1000, CONN_GOV_DEMAND_WAVEFORM, 244 }, { 1000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 1000, CONN_GOV_DEMAND_WAVEFORM, 244 }, { 1000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 1000, CONN_GOV_DEMAND_WAVEFORM, 244 }, { 1000, CONN_GOV_DEMAND_NONE, 244 },
+			{ 30000, CONN_GOV_DEMAND_NONE, 244 } } },
+};
+
+enum { IDLE, SUMMARY, WAVEFORM, WAVEFORM_SHORT, PAUSE, STEP_DOWN, CHURN };
+
+static Result atResults[sizeof(aScenarios) / sizeof(aScenarios[0])];
+
+// local function prototypes
+static uint32_t uiAirUs(uint16_t usPayload);
+static void vSimulate(const Scenario *pScenario, Result *pResult);
+
+//local functions
+// one notification and the empty packet acknowledging it
+static uint32_t uiAirUs(uint16_t usPayload) {
+	return (usPayload + AIR_OVERHEAD) * 8 + AIR_IFS_US + 80 + AIR_IFS_US;
+}
+
+static void vSimulate(const Scenario *pScenario, Result *pResult) {
+	const ConnGovParams *params;
+	const Phase *phase;
+	ConnGovInput in;
+	uint32_t now = 0, phaseEnd = 0, nextEvent = 0, produced = 0, lastRequest = 0;
+	uint32_t updateAt = 0, intervalUs = LINK_CONNECT_INTERVAL * 1250, perSecond = 0;
+	uint16_t latency = 0, skipped = 0, pending = CONN_GOV_NONE, profile = CONN_GOV_NONE;
+	uint8_t depth = 0, i = 0, sent, target;
+	uint32_t phaseStart = 0;
+
+	memset(pResult, 0, sizeof(*pResult));
+	pResult->uiGapMin = 0xFFFFFFFFUL;
+	vConnGovInit();
+	phase = &pScenario->aPhases[0];
+	phaseEnd = phase->uiMs;
+	for (now = 0; phase->uiMs != 0; now++) {
+		if (now == phaseEnd) {
+			if (++i == PHASES_MAX || pScenario->aPhases[i].uiMs == 0)
+				break;
+			phase = &pScenario->aPhases[i];
+			phaseStart = now;
+			phaseEnd = now + phase->uiMs;
+		}
+		// producer, whole values only
+		if (phase->ucDemand == CONN_GOV_DEMAND_WAVEFORM)
+			perSecond = WAVEFORM_BYTES_PER_S;
+		else if (phase->ucDemand == CONN_GOV_DEMAND_SUMMARY)
+			perSecond = SUMMARY_VALUES_PER_S * phase->usPayload;
+		else
+			perSecond = 0;
+		produced += perSecond;
+		while (produced >= 1000U * phase->usPayload) {
+			produced -= 1000U * phase->usPayload;
+			if (depth < NOTIFY_QUEUE_SLOTS) {
+				depth++;
+			} else {
+				pResult->uiDrops++;
+				if (now - phaseStart >= phase->uiMs / 2)
+					pResult->uiDropsSettled++;
+			}
+		}
+
+		// connection events due in this ms
+		while ((uint64_t) nextEvent <= (uint64_t) now * 1000) {
+			if (depth != 0 || skipped >= latency) {
+				sent = depth < LINK_PACKETS_PER_EVENT ? depth : LINK_PACKETS_PER_EVENT;
+				depth -= sent;
+				pResult->ulOnUs += EVENT_US + sent * uiAirUs(phase->usPayload);
+				skipped = 0;
+				if (updateAt && --updateAt == 0) {
+					params = pConnGovParams((uint8_t) pending);
+					intervalUs = params->usIntervalMax * 1250;
+					latency = params->usLatency;
+					profile = pending;
+					vConnGovAnswered();
+				}
+			} else {
+				skipped++;
+			}
+			nextEvent += intervalUs;
+		}
+
+		if (now % LINK_TICK_MS == 0) {
+			in.ucDemand = phase->ucDemand;
+			in.ucDepth = depth;
+			in.usPayloadMax = phase->usPayload;
+			target = ucConnGovEvaluate(&in, now);
+			if (ucConnGovMayRequest(now) && target != profile && updateAt == 0) {
+				vConnGovRequested(now);
+				if (pResult->uiRequests && now - lastRequest < pResult->uiGapMin)
+					pResult->uiGapMin = now - lastRequest;
+				lastRequest = now;
+				pResult->uiRequests++;
+				pending = target;
+				updateAt = LINK_UPDATE_EVENTS;
+			}
+		}
+		if (depth > pResult->ucDepthMax)
+			pResult->ucDepthMax = depth;
+		pResult->uiDepthSum += depth;
+	}
+	pResult->uiMs = now;
+	pResult->ucProfile = (uint8_t) profile;
+}
+
+// each profile is a request the central may accept, the timeout strictly
+// above two of the longest gaps latency allows between events
+static void test_profiles(void) {
+	const ConnGovParams *p;
+	uint8_t i;
+
+	for (i = 0; i < CONN_GOV_PROFILES; i++) {
+		p = pConnGovParams(i);
+		CHECK(p->usIntervalMin >= 6 && p->usIntervalMin <= p->usIntervalMax);
+		CHECK(p->usIntervalMax <= 3200 && p->usLatency <= 499);
+		CHECK(p->usTimeout >= 10 && p->usTimeout <= 3200);
+		// 10 ms against 1.25 ms units: timeout * 10 > (1 + latency) * max * 1.25 * 2
+		CHECK(4u * p->usTimeout > (1u + p->usLatency) * p->usIntervalMax);
+	}
+}
+
+// every scenario, the table the governor was tuned on
+static void test_scenarios(void) {
+	static const char *apProfile[] = { "idle", "summary", "stream", "burst", "none" };
+	const Result *r;
+	uint8_t i;
+
+	printf("%-24s %8s %6s %6s %6s %8s  %s\n", "scenario", "requests", "depth", "mean",
+			"drops", "duty", "profile");
+	for (i = 0; i < sizeof(aScenarios) / sizeof(aScenarios[0]); i++) {
+		vSimulate(&aScenarios[i], &atResults[i]);
+		r = &atResults[i];
+		printf("%-24s %8u %6u %6.2f %6u %7.2f%%  %s\n", aScenarios[i].pName,
+				(unsigned) r->uiRequests, r->ucDepthMax, (double) r->uiDepthSum / r->uiMs,
+				(unsigned) r->uiDrops, 100.0 * r->ulOnUs / ((double) r->uiMs * 1000),
+				apProfile[r->ucProfile]);
+		CHECK(r->uiRequests < 2 || r->uiGapMin >= CONN_GOV_REQUEST_GAP_MS);
+		CHECK_EQ(r->uiDropsSettled, 0);
+	}
+
+	CHECK_EQ(atResults[IDLE].ucProfile, CONN_GOV_IDLE);
+	CHECK_EQ(atResults[IDLE].uiRequests, 1);
+	CHECK_EQ(atResults[SUMMARY].ucProfile, CONN_GOV_SUMMARY);
+	CHECK_EQ(atResults[WAVEFORM].ucProfile, CONN_GOV_STREAM);
+	CHECK_EQ(atResults[WAVEFORM_SHORT].ucProfile, CONN_GOV_BURST);
+	CHECK_EQ(atResults[STEP_DOWN].ucProfile, CONN_GOV_SUMMARY);
+	CHECK_EQ(atResults[CHURN].ucProfile, CONN_GOV_IDLE);
+	// the pause is shorter than the hold, it costs no request
+	CHECK_EQ(atResults[PAUSE].uiRequests, atResults[WAVEFORM].uiRequests);
+	// streaming on and off every second asks for the fast profile once
+	CHECK(atResults[CHURN].uiRequests <= 3);
+	// idle costs a fraction of streaming
+	CHECK(atResults[IDLE].ulOnUs * 10 < atResults[WAVEFORM].ulOnUs);
+	CHECK(atResults[SUMMARY].ulOnUs < atResults[WAVEFORM].ulOnUs);
+	CHECK(atResults[WAVEFORM].ulOnUs < atResults[WAVEFORM_SHORT].ulOnUs);
+}
+
+// app_ble.c against the host CPU2, the interval follows the subscription
+static void test_stack(void) {
+	static const Cpu2HostCentral central = { 512, 251, 1, LINK_CONNECT_INTERVAL, -60 };
+	const ConnGovParams *stream = pConnGovParams(CONN_GOV_STREAM);
+	const ConnGovParams *idle = pConnGovParams(CONN_GOV_IDLE);
+	uint16_t conn, data, interval;
+	uint32_t requests;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&central);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vBleHostRun(5000);
+	interval = usCpu2HostLinkInterval(conn);
+	CHECK(interval >= idle->usIntervalMin && interval <= idle->usIntervalMax);
+	CHECK_EQ(usCpu2HostLinkLatency(conn), idle->usLatency);
+
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10000);
+	interval = usCpu2HostLinkInterval(conn);
+	CHECK(interval >= stream->usIntervalMin && interval <= stream->usIntervalMax);
+	CHECK_EQ(usCpu2HostLinkLatency(conn), 0);
+
+	// a pause shorter than the hold keeps the stream profile
+	requests = uiCpu2HostCount(CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ);
+	vCpu2HostSubscribe(conn, data, 0);
+	vBleHostRun(3000);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10000);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ), requests);
+
+	vCpu2HostSubscribe(conn, data, 0);
+	vBleHostRun(CONN_GOV_HOLD_MS + 5000);
+	interval = usCpu2HostLinkInterval(conn);
+	CHECK(interval >= idle->usIntervalMin && interval <= idle->usIntervalMax);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_L2CAP_CONN_PARAM_UPDATE_REQ), requests + 1);
+}
+
+int main(void) {
+	UNIT_RUN(test_profiles);
+	UNIT_RUN(test_scenarios);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
@@ -0,0 +1,219 @@
+/*
+ * test_cycle_prof.c
+ *
+ * cycle_prof.c on a virtual cycle counter that stands in for DWT->CYCCNT and
+ * only moves when the test says so. The bucket of a run is checked at each
+ * power of two edge and at both ends, the counter wrapping mid run has to be
+ * measured right, and an interrupt taken inside a task counts in both
+ * entries as cycle_prof.h says. A random main loop of tasks and interrupts
+ * has to give, entry by entry, the counts, totals, longest runs and
+ * histograms a reference model kept on the side gives, the dump has to
+ * report exactly the entries that ran with their names, and a reset has to
+ * leave nothing.
+ */
+
+#include "unit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the firmware reads DWT->CYCCNT, the test its own counter
+#define CFG_CYCLE_PROF 1
+#define CYCLE_PROF_NOW() (uiCycles)
+static uint32_t uiCycles;
+#include "cycle_prof.h"
+
+#undef NULL
+#define NULL ((void *) 0)
+
+#define LOOP_RUNS 20000
+#define LOOP_TASKS 6
+// interrupts taken per LOOP_IRQ_EVERY runs, each inside the task
+#define LOOP_IRQ_EVERY 4
+
+static CycleProfEntry aModel[CYCLE_PROF_ENTRIES];
+static uint8_t aucDumped[CYCLE_PROF_ENTRIES];
+static uint8_t ucDumpBad;
+static uint32_t uiIrqCycles;
+
+// local function prototypes
+static uint8_t ucBucket(uint32_t uiRun);
+static void vModel(uint8_t ucId, uint32_t uiRun);
+static void vSpend(uint32_t uiRun);
+static void vIrq(void);
+static void vNested(void);
+static void vPrint(uint8_t ucId, const char *pName, const CycleProfEntry *pEntry);
+
+//local functions
+// the bucket as cycle_prof.h describes it, by counting
+static uint8_t ucBucket(uint32_t uiRun) {
+	uint8_t b;
+
+	for (b = 0; b < CYCLE_PROF_HIST_BUCKETS - 1; b++) {
+		if (uiRun < (2UL << (b + CYCLE_PROF_HIST_SHIFT)))
+			return b;
+	}
+	return CYCLE_PROF_HIST_BUCKETS - 1;
+}
+
+static void vModel(uint8_t ucId, uint32_t uiRun) {
+	aModel[ucId].uiCount++;
+	aModel[ucId].ulTotal += uiRun;
+	if (uiRun > aModel[ucId].uiMax)
+		aModel[ucId].uiMax = uiRun;
+	aModel[ucId].auiHist[ucBucket(uiRun)]++;
+}
+
+static void vSpend(uint32_t uiRun) {
+	uiCycles += uiRun;
+}
+
+// a handler measured with BEGIN and END, as in stm32wbxx_it.c
+static void vIrq(void) {
+	CYCLE_PROF_BEGIN();
+	vSpend(uiIrqCycles);
+	CYCLE_PROF_END(CYCLE_PROF_ISR_EXTI0);
+}
+
+// a task of its own within the one running
+static void vNested(void) {
+	vSpend(100);
+	CYCLE_PROF_CALL(6, vSpend(50));
+	vSpend(100);
+}
+
+static void vPrint(uint8_t ucId, const char *pName, const CycleProfEntry *pEntry) {
+	aucDumped[ucId]++;
+	if (pEntry != pCycleProfGet(ucId) || pEntry->uiCount == 0)
+		ucDumpBad = 1;
+	if ((ucId < CYCLE_PROF_TASKS) != (pName == NULL))
+		ucDumpBad = 1;
+}
+
+// each run lands in the bucket of its length, at every edge
+static void test_buckets(void) {
+	const CycleProfEntry *e;
+	uint32_t runs[3 * 32 + 2], n = 0, i;
+	uint64_t total = 0;
+	uint8_t bit, id = 0;
+
+	vCycleProfReset();
+	for (bit = 0; bit < 32; bit++) {
+		runs[n++] = (1UL << bit) - 1;
+		runs[n++] = 1UL << bit;
+		runs[n++] = (1UL << bit) + 1;
+	}
+	runs[n++] = 0;
+	runs[n++] = 0xFFFFFFFFUL;
+	for (i = 0; i < n; i++) {
+		vCycleProfRecord(id, runs[i]);
+		total += runs[i];
+		e = pCycleProfGet(id);
+		CHECK_EQ(e->auiHist[ucBucket(runs[i])], 1);
+		CHECK_EQ(e->uiCount, 1);
+		vCycleProfReset();
+	}
+	for (i = 0; i < n; i++)
+		vCycleProfRecord(id, runs[i]);
+	e = pCycleProfGet(id);
+	CHECK_EQ(e->uiCount, n);
+	CHECK(e->ulTotal == total);
+	CHECK_EQ(e->uiMax, 0xFFFFFFFFUL);
+	CHECK_EQ(ucBucket(31), 0);
+	CHECK_EQ(ucBucket(32), 1);
+	// ids past the table are dropped
+	vCycleProfRecord(CYCLE_PROF_ENTRIES, 10);
+	CHECK(pCycleProfGet(CYCLE_PROF_ENTRIES) == NULL);
+}
+
+// the counter wrapping, a nested interrupt counted twice, the macros off the clock
+static void test_clock(void) {
+	const CycleProfEntry *task, *irq;
+
+	vCycleProfReset();
+	uiCycles = 0xFFFFFF00UL;
+	CYCLE_PROF_CALL(3, vSpend(0x400));
+	task = pCycleProfGet(3);
+	CHECK_EQ(task->uiCount, 1);
+	CHECK_EQ(task->uiMax, 0x400);
+	CHECK_EQ(uiCycles, 0x300);
+
+	// an interrupt of 500 inside a task of 1000
+	uiIrqCycles = 500;
+	CYCLE_PROF_CALL(4, (vSpend(400), vIrq(), vSpend(600)));
+	task = pCycleProfGet(4);
+	irq = pCycleProfGet(CYCLE_PROF_ISR_EXTI0);
+	CHECK_EQ(task->uiMax, 1500);
+	CHECK_EQ(irq->uiMax, 500);
+	CHECK_EQ(irq->uiCount, 1);
+
+	// a nested task, as SCH_Run() from within a task runs one
+	CYCLE_PROF_CALL(5, vNested());
+	CHECK_EQ(pCycleProfGet(5)->uiMax, 250);
+	CHECK_EQ(pCycleProfGet(6)->uiMax, 50);
+	CHECK(strcmp(pCycleProfName(CYCLE_PROF_ISR_EXTI0), "EXTI0") == 0);
+	CHECK(pCycleProfName(5) == NULL);
+}
+
+// a random main loop against the reference model, then dump and reset
+static void test_loop(void) {
+	const CycleProfEntry *e;
+	uint32_t i, run, before;
+	uint8_t id, k, ran = 0;
+
+	vCycleProfReset();
+	memset(aModel, 0, sizeof(aModel));
+	srand(5);
+	uiCycles = 0xFFF00000UL;
+	for (i = 0; i < LOOP_RUNS; i++) {
+		id = (uint8_t) (rand() % LOOP_TASKS);
+		// mostly short, now and then a task of a few ms at 64 MHz
+		run = rand() % 8 ? (uint32_t) (rand() % 2000) : (uint32_t) (rand() % 400000);
+		before = uiCycles;
+		if (i % LOOP_IRQ_EVERY == 0) {
+			uiIrqCycles = (uint32_t) (20 + rand() % 300);
+			CYCLE_PROF_CALL(id, (vSpend(run / 2), vIrq(), vSpend(run - run / 2)));
+			vModel(CYCLE_PROF_ISR_EXTI0, uiIrqCycles);
+		} else {
+			CYCLE_PROF_CALL(id, vSpend(run));
+		}
+		vModel(id, uiCycles - before);
+		// the main loop between tasks
+		vSpend(30);
+	}
+
+	for (id = 0; id < CYCLE_PROF_ENTRIES; id++) {
+		e = pCycleProfGet(id);
+		CHECK_EQ(e->uiCount, aModel[id].uiCount);
+		CHECK(e->ulTotal == aModel[id].ulTotal);
+		CHECK_EQ(e->uiMax, aModel[id].uiMax);
+		for (k = 0; k < CYCLE_PROF_HIST_BUCKETS; k++)
+			CHECK_EQ(e->auiHist[k], aModel[id].auiHist[k]);
+		if (e->uiCount) {
+			ran++;
+			printf("%-9s %6u %8u %8u\n", pCycleProfName(id) ? pCycleProfName(id) : "task",
+					(unsigned) e->uiCount, (unsigned) (e->ulTotal / e->uiCount), (unsigned) e->uiMax);
+		}
+	}
+	CHECK_EQ(ran, LOOP_TASKS + 1);
+
+	memset(aucDumped, 0, sizeof(aucDumped));
+	ucDumpBad = 0;
+	vCycleProfDump(vPrint);
+	CHECK_EQ(ucDumpBad, 0);
+	for (id = 0; id < CYCLE_PROF_ENTRIES; id++)
+		CHECK_EQ(aucDumped[id], aModel[id].uiCount ? 1 : 0);
+
+	vCycleProfReset();
+	memset(aucDumped, 0, sizeof(aucDumped));
+	vCycleProfDump(vPrint);
+	for (id = 0; id < CYCLE_PROF_ENTRIES; id++)
+		CHECK_EQ(aucDumped[id] + pCycleProfGet(id)->uiMax, 0);
+}
+
+int main(void) {
+	UNIT_RUN(test_buckets);
+	UNIT_RUN(test_clock);
+	UNIT_RUN(test_loop);
+	return UNIT_END();
+}
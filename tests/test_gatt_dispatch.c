@@ -0,0 +1,152 @@
+/*
+ * test_gatt_dispatch.c
+ *
+ * Attribute map of smart_watch_stm.c fed with synthetic
+ * EVT_BLUE_GATT_ATTRIBUTE_MODIFIED events from the host CPU2. A CCCD write
+ * subscribes exactly that characteristic on exactly that link, a value write
+ * reaches the write handler of its row and nothing else. Every other handle,
+ * those of the GAP and GATT services before ours, the declarations and the
+ * read only values inside it, past its end and the handles the old if/else
+ * chain compared against for characteristics never added, has to be ignored.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "main.h"
+#include "history.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+static const Cpu2HostCentral tCentral = { 247, 251, 1, 24, -60 };
+// enables notifications on a CCCD, starts a sync on the control point,
+// selects screen 1 on DATA
+static const uint8_t aWrite[9] = { 0x01 };
+
+// local function prototypes
+static uint16_t usSubscribed(void);
+static uint8_t ucHistoryState(void);
+
+//local functions
+// one bit per SWITCH_x that any link listens to
+static uint16_t usSubscribed(void) {
+	uint16_t mask = 0;
+	uint8_t id;
+
+	for (id = 0; id <= SMART_WATCH_SWITCH_MAX; id++)
+		if (SMART_WATCH_STM_Subscribers(id))
+			mask |= 1 << id;
+	return mask;
+}
+
+static uint8_t ucHistoryState(void) {
+	uint8_t status[HISTORY_STATUS_SIZE];
+
+	usHistoryStatus(status);
+	return status[12];
+}
+
+// each CCCD switches its own characteristic, on its own link
+static void test_cccd(void) {
+	static const Cpu2HostCentral second = { 185, 27, 0, 40, -70 };
+	const uint8_t off[2] = { 0x00, 0x00 }, indicate[2] = { 0x02, 0x00 };
+	uint16_t conn, other, data, history;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	other = usBleHostConnect(&second);
+	data = usBleHostChar(BLE_HOST_DATA);
+	history = usBleHostChar(BLE_HOST_HISTORY);
+	CHECK(data != 0 && history != 0);
+
+	vCpu2HostWriteAttr(conn, data + 1, aWrite, 2);
+	vBleHostRun(10);
+	CHECK_EQ(usSubscribed(), 1 << SWITCH_DATA);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 1 << 0);
+
+	vCpu2HostWriteAttr(other, history + 1, aWrite, 2);
+	vBleHostRun(10);
+	CHECK_EQ(usSubscribed(), (1 << SWITCH_DATA) | (1 << SWITCH_HISTORY));
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HISTORY), 1 << 1);
+
+	// indications are not offered, asking for them subscribes to notifications
+	vCpu2HostWriteAttr(conn, history + 1, indicate, 2);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HISTORY), (1 << 0) | (1 << 1));
+	vCpu2HostWriteAttr(conn, history + 1, off, 2);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HISTORY), 1 << 1);
+
+	vCpu2HostWriteAttr(conn, usBleHostChar(BLE_HOST_HR) + 1, aWrite, 2);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HR), 1 << 0);
+	vCpu2HostWriteAttr(conn, usBleHostChar(BLE_HOST_HR) + 1, off, 2);
+	vCpu2HostWriteAttr(conn, data + 1, off, 2);
+	vBleHostRun(10);
+	CHECK_EQ(usSubscribed(), 1 << SWITCH_HISTORY);
+	vCpu2HostWriteAttr(other, history + 1, off, 2);
+	vBleHostRun(10);
+	CHECK_EQ(usSubscribed(), 0);
+}
+
+// value writes reach the handler of their row
+static void test_value_write(void) {
+	const uint8_t screen[1] = { OLED_STATUS_BLE };
+	uint16_t conn;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	CHECK_EQ(ucHistoryState(), HISTORY_SYNC_IDLE);
+	vCpu2HostWriteAttr(conn, usBleHostChar(BLE_HOST_HISTORY_CP), aWrite, sizeof(aWrite));
+	vBleHostRun(10);
+	CHECK_EQ(ucHistoryState(), HISTORY_SYNC_SENDING);
+
+	vCpu2HostWriteAttr(conn, usBleHostChar(BLE_HOST_DATA), screen, sizeof(screen));
+	vBleHostRun(10);
+	CHECK_EQ(ucOledStatusFlag, OLED_STATUS_BLE);
+	CHECK_EQ(usSubscribed(), 0);
+}
+
+// every handle without a row, from 0 to past the last attribute
+static void test_foreign_handles(void) {
+	uint16_t conn, handle, last, ignored = 0;
+	uint16_t data, cp, diag;
+	uint8_t flag;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	data = usBleHostChar(BLE_HOST_DATA);
+	cp = usBleHostChar(BLE_HOST_HISTORY_CP);
+	diag = usBleHostChar(BLE_HOST_DIAG);
+	last = usCpu2HostAttributes() + 8;
+	flag = ucOledStatusFlag;
+
+	for (handle = 0; handle <= last; handle++) {
+		if (handle == data || handle == data + 1 || handle == cp || handle == diag
+				|| handle == usBleHostChar(BLE_HOST_HISTORY) + 1
+				|| handle == usBleHostChar(BLE_HOST_HR) + 1)
+			continue;
+		vCpu2HostWriteAttr(conn, handle, aWrite, sizeof(aWrite));
+		vBleHostRun(1);
+		ignored++;
+		CHECK_EQ(usSubscribed(), 0);
+		CHECK_EQ(ucOledStatusFlag, flag);
+		CHECK_EQ(ucHistoryState(), HISTORY_SYNC_IDLE);
+		if (usSubscribed() != 0 || ucOledStatusFlag != flag)
+			printf("  handle 0x%04X dispatched\n", handle);
+	}
+	vCpu2HostWriteAttr(conn, 0xFFFF, aWrite, sizeof(aWrite));
+	vBleHostRun(1);
+	CHECK_EQ(usSubscribed(), 0);
+	printf("%u of %u handles ignored\n", ignored, last + 1);
+}
+
+int main(void) {
+	UNIT_RUN(test_cccd);
+	UNIT_RUN(test_value_write);
+	UNIT_RUN(test_foreign_handles);
+	return UNIT_END();
+}
@@ -0,0 +1,239 @@
+/*
+ * test_gatt_service.c
+ *
+ * The smart watch service as a central sees it over the host CPU2 the
+ * application builds it on. Layout: one service holding the characteristics
+ * of this build in table order, each with its UUID, properties and declared
+ * size, a working CCCD on those that notify, and none of the characteristics
+ * left out of the build. Rates: HR once a second, DATA at the PPG sample rate
+ * in frames as long as the link allows, nothing once a central unsubscribes.
+ * Payloads: the HR fields big endian as the algorithm reports them, the PPG
+ * samples bit exact and in the order the sensor gave them. The DATA and HR
+ * notification and byte rates are printed for the link used.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "max30102.h"
+#include "max30102_emu.h"
+#include "ppg_stream.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+#define SAMPLE_MS (1000 / PPG_STREAM_RATE_HZ)
+#define HR_PERIOD_MS 1000
+// NOTIFY_TICK_PERIOD of smart_watch_app.c, the deadline of a value
+#define NOTIFY_TICK_MS 100
+// the HR algorithm settles within this, see test_notify_sched.c
+#define SETTLE_MS 10000
+#define MEASURE_MS 10000
+#define SAMPLES_MAX ((SETTLE_MS + MEASURE_MS) / SAMPLE_MS)
+// a beat every 40 samples, 75 bpm
+#define BEAT_SAMPLES 40
+
+typedef struct {
+	uint8_t ucUuidLast;
+	uint8_t ucProps;
+	uint16_t usSize;
+	uint16_t usSwitch;         // SWITCH_x of a notifying one
+} CharDef;
+
+static const Cpu2HostCentral tPhone = { 247, 251, 1, 24, -60 };
+// this build, in the order smart_watch_stm.c adds them
+static const CharDef aChars[] = {
+	{ BLE_HOST_HR, CHAR_PROP_NOTIFY, SMART_WATCH_HR_CHAR_SIZE, SWITCH_HR },
+	{ BLE_HOST_DATA, CHAR_PROP_NOTIFY | CHAR_PROP_WRITE, SMART_WATCH_DATA_CHAR_SIZE, SWITCH_DATA },
+	{ BLE_HOST_DIAG, CHAR_PROP_READ | CHAR_PROP_WRITE, SMART_WATCH_DIAG_CHAR_SIZE, 0 },
+	{ BLE_HOST_HISTORY, CHAR_PROP_NOTIFY, SMART_WATCH_HISTORY_CHAR_SIZE, SWITCH_HISTORY },
+	{ BLE_HOST_HISTORY_CP, CHAR_PROP_READ | CHAR_PROP_WRITE, SMART_WATCH_HISTORY_CP_CHAR_SIZE, 0 },
+};
+// LUX, SPO2, GSR and humidity share the UUID pattern, none is in this build
+static const uint8_t aucAbsent[] = { 0x64, 0x34, 0x14, 0x74 };
+static uint32_t auiRed[SAMPLES_MAX];
+static uint32_t auiIRed[SAMPLES_MAX];
+static uint32_t uiSamples;
+
+// local function prototypes
+static uint32_t uiGetBE32(const uint8_t *p);
+static uint16_t usConnected(void);
+static void vSensor(uint32_t uiMs);
+
+//local functions
+static uint32_t uiGetBE32(const uint8_t *p) {
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint16_t usConnected(void) {
+	vBleHostInit();
+	vMax30102EmuInit();
+	uiSamples = 0;
+	return usBleHostConnect(&tPhone);
+}
+
+// the sensor sampled at its rate while the application runs
+static void vSensor(uint32_t uiMs) {
+	uint32_t ms;
+
+	for (ms = 0; ms < uiMs; ms += SAMPLE_MS) {
+		if (uiSamples < SAMPLES_MAX) {
+			auiRed[uiSamples] = 90000 + (uiSamples % BEAT_SAMPLES) * 100;
+			auiIRed[uiSamples] = 100000 + (uiSamples % BEAT_SAMPLES) * 200;
+			vMax30102EmuPush(auiRed[uiSamples], auiIRed[uiSamples]);
+			uiSamples++;
+		}
+		vMax30102ReadData();
+		vBleHostRun(SAMPLE_MS);
+	}
+}
+
+// one service, table order, UUID, properties, size and CCCD of each
+static void test_layout(void) {
+	uint16_t conn, handle, service, last = 0, i;
+
+	conn = usConnected();
+	service = usCpu2HostServiceOf(usBleHostChar(aChars[0].ucUuidLast));
+	CHECK(service != 0);
+	for (i = 0; i < sizeof(aChars) / sizeof(aChars[0]); i++) {
+		handle = usBleHostChar(aChars[i].ucUuidLast);
+		CHECK(handle > last);
+		if (handle == 0) {
+			printf("  characteristic 0x%02X missing\n", aChars[i].ucUuidLast);
+			continue;
+		}
+		CHECK_EQ(usCpu2HostServiceOf(handle), service);
+		CHECK_EQ(ucCpu2HostCharProps(handle), aChars[i].ucProps);
+		CHECK_EQ(usCpu2HostCharSize(handle), aChars[i].usSize);
+		last = handle;
+		if (!(aChars[i].ucProps & CHAR_PROP_NOTIFY))
+			continue;
+		// the CCCD right after the value reaches the application
+		vCpu2HostSubscribe(conn, handle, 1);
+		vBleHostRun(10);
+		CHECK(SMART_WATCH_STM_Subscribers(aChars[i].usSwitch) != 0);
+		vCpu2HostSubscribe(conn, handle, 0);
+		vBleHostRun(10);
+		CHECK_EQ(SMART_WATCH_STM_Subscribers(aChars[i].usSwitch), 0);
+	}
+	CHECK(service < usBleHostChar(aChars[0].ucUuidLast));
+	CHECK(usCpu2HostServiceEnd(service) >= last);
+	for (i = 0; i < sizeof(aucAbsent); i++)
+		CHECK_EQ(usBleHostChar(aucAbsent[i]), 0);
+	printf("service 0x%04X..0x%04X, %u characteristics, %u handles in the database\n", service,
+			usCpu2HostServiceEnd(service), (unsigned) (sizeof(aChars) / sizeof(aChars[0])),
+			usCpu2HostAttributes());
+}
+
+// HR once a second with the algorithm's values, big endian
+static void test_hr(void) {
+	const Cpu2HostNotify *notify;
+	uint64_t from, last = 0;
+	uint32_t count = 0, pulses = 0, bytes = 0, gap, gapMin = 0xFFFFFFFFUL, gapMax = 0;
+	uint16_t conn, hr, i;
+
+	conn = usConnected();
+	hr = usBleHostChar(BLE_HOST_HR);
+	vCpu2HostSubscribe(conn, hr, 1);
+	vSensor(SETTLE_MS);
+	vCpu2HostClearNotifications();
+	from = ulHostUs();
+	vSensor(MEASURE_MS);
+
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		notify = pCpu2HostNotification(i);
+		CHECK_EQ(notify->usHandle, hr);
+		CHECK_EQ(notify->usLen, SMART_WATCH_HR_CHAR_SIZE);
+		CHECK(notify->ulUs >= from);
+		// 75 bpm settled, the pulse counter never goes back
+		CHECK(uiGetBE32(&notify->aData[0]) >= 70 && uiGetBE32(&notify->aData[0]) <= 80);
+		CHECK(uiGetBE32(&notify->aData[12]) >= pulses);
+		pulses = uiGetBE32(&notify->aData[12]);
+		if (count) {
+			gap = (uint32_t) ((notify->ulUs - last) / 1000);
+			gapMin = gap < gapMin ? gap : gapMin;
+			gapMax = gap > gapMax ? gap : gapMax;
+		}
+		last = notify->ulUs;
+		bytes += notify->usLen;
+		count++;
+	}
+	CHECK(count >= MEASURE_MS / HR_PERIOD_MS - 1 && count <= MEASURE_MS / HR_PERIOD_MS + 1);
+	CHECK(gapMin + NOTIFY_TICK_MS >= HR_PERIOD_MS && gapMax <= HR_PERIOD_MS + NOTIFY_TICK_MS);
+	if (count) {
+		notify = pCpu2HostNotification((uint16_t) (count - 1));
+		CHECK_EQ(uiGetBE32(&notify->aData[0]), ucGetMax30102HR());
+		CHECK_EQ(uiGetBE32(&notify->aData[4]), ucGetMax30102SPO2());
+	}
+	printf("HR: %u notifications in %u s, %u to %u ms apart, %u B/s\n", (unsigned) count,
+			MEASURE_MS / 1000, (unsigned) gapMin, (unsigned) gapMax,
+			(unsigned) (bytes * 1000 / MEASURE_MS));
+
+	// nothing after the central unsubscribes
+	vCpu2HostSubscribe(conn, hr, 0);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	vSensor(3 * HR_PERIOD_MS);
+	CHECK_EQ(usCpu2HostNotifications(), 0);
+}
+
+// DATA carries every sample the sensor gave, in order, at its rate
+static void test_data(void) {
+	const Cpu2HostNotify *notify;
+	PpgStreamHeader header;
+	PpgStreamStats stats;
+	uint32_t red[PPG_STREAM_COUNT_MASK + 1], ired[PPG_STREAM_COUNT_MASK + 1];
+	uint32_t first, next, bad = 0, bytes = 0;
+	uint16_t conn, data, i, frames = 0, lenMax = 0;
+	int32_t seq = -1;
+	uint8_t n, k;
+
+	conn = usConnected();
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	first = uiSamples;
+	vSensor(MEASURE_MS);
+
+	next = first;
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		notify = pCpu2HostNotification(i);
+		if (notify->usHandle != data)
+			continue;
+		n = ucPpgStreamDecode(notify->aData, notify->usLen, &header, red, ired);
+		CHECK_EQ(n, header.ucCount);
+		CHECK_EQ(header.ucRate, PPG_STREAM_RATE_HZ);
+		if (seq >= 0)
+			CHECK_EQ(header.usSeq, (uint16_t) (seq + 1));
+		seq = header.usSeq;
+		for (k = 0; k < n; k++, next++) {
+			if (next >= uiSamples || red[k] != auiRed[next] || ired[k] != auiIRed[next])
+				bad++;
+		}
+		lenMax = notify->usLen > lenMax ? notify->usLen : lenMax;
+		bytes += notify->usLen;
+		frames++;
+	}
+	vPpgStreamGetStats(&stats);
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(stats.uiDropped, 0);
+	// all but the frame still filling
+	CHECK(uiSamples - next <= PPG_STREAM_COUNT_MASK + 1);
+	CHECK(next - first >= MEASURE_MS / SAMPLE_MS - (PPG_STREAM_COUNT_MASK + 1));
+	// frames as long as the 247 octet MTU lets them be
+	CHECK(lenMax <= tPhone.usMtu - 3);
+	CHECK(frames > 0);
+	printf("DATA: %u samples/s in %u frames/s of up to %u bytes, %u B/s\n",
+			(unsigned) ((next - first) * 1000 / MEASURE_MS),
+			(unsigned) (frames * 1000 / MEASURE_MS), lenMax, (unsigned) (bytes * 1000 / MEASURE_MS));
+}
+
+int main(void) {
+	UNIT_RUN(test_layout);
+	UNIT_RUN(test_hr);
+	UNIT_RUN(test_data);
+	return UNIT_END();
+}
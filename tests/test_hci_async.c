@@ -0,0 +1,206 @@
+/*
+ * test_hci_async.c
+ *
+ * Asynchronous commands of hci_tl.c against the host CPU2 answering each
+ * command after a set latency. The same characteristic updates go through
+ * hci_send_req() and through hci_send_req_async(): the first stalls the main
+ * loop for every round trip, the second has to leave it free at any latency
+ * and still get every value out. Queued commands go out in order one at a
+ * time as the numcmd credit comes back, a synchronous command behind them
+ * goes last, and a full ring refuses instead of overwriting.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "hci_tl.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+#define UPDATES 20
+#define PIECE 10
+
+static const Cpu2HostCentral tCentral = { 512, 251, 1, 24, -60 };
+static uint8_t aValue[SMART_WATCH_DATA_CHAR_SIZE];
+static uint8_t ucDone;
+static tBleStatus eDoneStatus;
+static uint32_t auiContext[HCI_TL_ASYNC_QUEUE_SIZE + 2];
+static uint8_t aucStatus[HCI_TL_ASYNC_QUEUE_SIZE + 2];
+static uint8_t ucCompleted;
+
+// local function prototypes
+static uint16_t usSubscribed(uint32_t uiLatencyUs);
+static void vValueDone(tBleStatus Status);
+static void vCmdDone(uint16_t usOpcode, uint8_t ucStatus, uint32_t uiContext);
+static int iQueuePiece(uint16_t usData, uint8_t ucIndex);
+static uint32_t uiSyncStall(uint32_t uiLatencyUs);
+static uint32_t uiAsyncStall(uint32_t uiLatencyUs);
+
+//local functions
+static uint16_t usSubscribed(uint32_t uiLatencyUs) {
+	uint16_t conn, data;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	vCpu2HostSetLatency(uiLatencyUs);
+	vBleHostClearStats();
+	return data;
+}
+
+static void vValueDone(tBleStatus Status) {
+	ucDone++;
+	eDoneStatus = Status;
+}
+
+static void vCmdDone(uint16_t usOpcode, uint8_t ucStatus, uint32_t uiContext) {
+	CHECK_EQ(usOpcode, CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT);
+	auiContext[ucCompleted] = uiContext;
+	aucStatus[ucCompleted++] = ucStatus;
+}
+
+// PIECE octets of DATA at ucIndex * PIECE, stored without notifying
+static int iQueuePiece(uint16_t usData, uint8_t ucIndex) {
+	uint8_t params[12 + PIECE];
+
+	params[0] = 0;
+	params[1] = 0;
+	params[2] = (uint8_t) usCpu2HostServiceOf(usData);
+	params[3] = (uint8_t) (usCpu2HostServiceOf(usData) >> 8);
+	params[4] = (uint8_t) (usData - 1);
+	params[5] = (uint8_t) ((usData - 1) >> 8);
+	params[6] = 0;
+	params[7] = SMART_WATCH_DATA_CHAR_SIZE & 0xFF;
+	params[8] = SMART_WATCH_DATA_CHAR_SIZE >> 8;
+	params[9] = ucIndex * PIECE;
+	params[10] = 0;
+	params[11] = PIECE;
+	memset(&params[12], ucIndex, PIECE);
+	return hci_send_req_async(CPU2_HOST_GATT_UPDATE_CHAR_VALUE_EXT, sizeof(params), params,
+			vCmdDone, ucIndex);
+}
+
+// UPDATES full values through hci_send_req(), main loop stall in us
+static uint32_t uiSyncStall(uint32_t uiLatencyUs) {
+	BleHostStats stats;
+	uint8_t pending, i;
+
+	usSubscribed(uiLatencyUs);
+	for (i = 0; i < UPDATES; i++) {
+		memset(aValue, i, sizeof(aValue));
+		pending = SMART_WATCH_STM_Subscribers(SWITCH_DATA);
+		CHECK_EQ(SMART_WATCH_STM_App_Update_Value(SWITCH_DATA, aValue, sizeof(aValue), &pending),
+				BLE_STATUS_SUCCESS);
+		vBleHostRun(10);
+	}
+	CHECK_EQ(usCpu2HostNotifications(), UPDATES);
+	vBleHostGetStats(&stats);
+	return (uint32_t) stats.ulStallUs;
+}
+
+// the same through hci_send_req_async(), each update waited for in 1 ms steps
+static uint32_t uiAsyncStall(uint32_t uiLatencyUs) {
+	BleHostStats stats;
+	uint8_t pending, i;
+	uint16_t ms;
+
+	usSubscribed(uiLatencyUs);
+	ucDone = 0;
+	for (i = 0; i < UPDATES; i++) {
+		memset(aValue, i, sizeof(aValue));
+		pending = SMART_WATCH_STM_Subscribers(SWITCH_DATA);
+		CHECK_EQ(SMART_WATCH_STM_App_Update_Value_Async(SWITCH_DATA, aValue, sizeof(aValue),
+				&pending, vValueDone), BLE_STATUS_PENDING);
+		for (ms = 0; ms < 100 && ucDone == i; ms++)
+			vBleHostRun(1);
+		CHECK_EQ(ucDone, i + 1);
+		CHECK_EQ(eDoneStatus, BLE_STATUS_SUCCESS);
+		CHECK_EQ(pending, 0);
+		vBleHostRun(10 - (ms < 10 ? ms : 10));
+	}
+	CHECK_EQ(usCpu2HostNotifications(), UPDATES);
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		CHECK_EQ(pCpu2HostNotification(i)->usLen, sizeof(aValue));
+		CHECK_EQ(pCpu2HostNotification(i)->aData[sizeof(aValue) - 1], i);
+	}
+	vBleHostGetStats(&stats);
+	CHECK_EQ(stats.uiStalls, 0);
+	return (uint32_t) stats.ulStallUs;
+}
+
+// stall against CPU2 latency, two commands per value
+static void test_latency(void) {
+	static const uint32_t auiLatency[] = { 50, 300, 1000, 3000 };
+	uint32_t sync, async;
+	uint8_t i;
+
+	for (i = 0; i < sizeof(auiLatency) / sizeof(auiLatency[0]); i++) {
+		sync = uiSyncStall(auiLatency[i]);
+		async = uiAsyncStall(auiLatency[i]);
+		CHECK(sync >= UPDATES * 2 * auiLatency[i]);
+		CHECK_EQ(async, 0);
+		printf("CPU2 latency %4u us: %u updates stall the main loop %6u us synchronous, %u us asynchronous\n",
+				(unsigned) auiLatency[i], UPDATES, (unsigned) sync, (unsigned) async);
+	}
+}
+
+// queued commands in order, one in flight, the synchronous one last
+static void test_order(void) {
+	uint8_t piece[PIECE];
+	uint16_t data;
+	uint8_t i;
+
+	data = usSubscribed(500);
+	vCpu2HostClearNotifications();
+	ucCompleted = 0;
+	for (i = 0; i < 3; i++)
+		CHECK_EQ(iQueuePiece(data, i), 0);
+	CHECK_EQ(ucCompleted, 0);
+	memset(piece, 3, sizeof(piece));
+	CHECK_EQ(aci_gatt_update_char_value_ext(0, usCpu2HostServiceOf(data), data - 1, 0,
+			SMART_WATCH_DATA_CHAR_SIZE, 3 * PIECE, PIECE, piece), BLE_STATUS_SUCCESS);
+	// the synchronous call returned only after the queue ahead of it completed
+	CHECK_EQ(ucCompleted, 3);
+	CHECK_EQ(usCpu2HostUpdates(), 4);
+	for (i = 0; i < 4; i++) {
+		CHECK_EQ(pCpu2HostUpdate(i)->usOffset, i * PIECE);
+		if (i < 3) {
+			CHECK_EQ(auiContext[i], i);
+			CHECK_EQ(aucStatus[i], BLE_STATUS_SUCCESS);
+		}
+		// numcmd is 1, the next one waits for the answer to this one
+		if (i > 0)
+			CHECK(pCpu2HostUpdate(i)->ulUs - pCpu2HostUpdate(i - 1)->ulUs >= 500);
+	}
+}
+
+// the ring refuses when full, everything queued still completes
+static void test_full(void) {
+	uint16_t data;
+	uint8_t queued = 0;
+
+	data = usSubscribed(1000);
+	ucCompleted = 0;
+	while (queued < HCI_TL_ASYNC_QUEUE_SIZE + 2 && iQueuePiece(data, queued) == 0)
+		queued++;
+	CHECK(queued >= HCI_TL_ASYNC_QUEUE_SIZE && queued < HCI_TL_ASYNC_QUEUE_SIZE + 2);
+	CHECK_EQ(hci_async_free(), 0);
+	CHECK(hci_async_reserve() == (void *) 0);
+	vBleHostRun(20);
+	CHECK_EQ(ucCompleted, queued);
+	CHECK_EQ(hci_async_free(), HCI_TL_ASYNC_QUEUE_SIZE);
+	CHECK_EQ(usCpu2HostUpdates(), queued);
+}
+
+int main(void) {
+	UNIT_RUN(test_latency);
+	UNIT_RUN(test_order);
+	UNIT_RUN(test_full);
+	return UNIT_END();
+}
@@ -0,0 +1,435 @@
+/*
+ * test_history_sync.c
+ *
+ * Bulk sync of history.c cut by disconnects at every point of a transfer. A
+ * virtual central keeps the records of each frame in order, drops the
+ * sequences it already holds and acknowledges every few frames; a link
+ * going loses the frames in flight and an acknowledgement not yet taken.
+ * Whatever the cut, every record of the range has to be kept exactly once
+ * and with the content it was stored with, nothing below an acknowledged
+ * sequence may be sent again, and the transfer has to end idle with the
+ * whole range acknowledged. Only records the ring overwrote during a pause
+ * may be missing, and then as a gap the central sees. The same runs through
+ * smart_watch_app.c and the host CPU2, with real disconnects and a new
+ * connection subscribing again, and a table reports what the cuts resend.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// records of a full MTU of 247, as the stack sends them
+#define PAYLOAD 244
+#define RECORDS 600
+#define RANGE_MAX (HISTORY_RECORDS * 3)
+#define INFLIGHT_MAX 4
+#define STEPS_MAX 10000
+#define SEEDS 300
+// stack runs, time the central takes per look at the notifications
+#define CENTRAL_MS 5
+#define STACK_MS_MAX 60000
+#define STACK_ACK_EVERY 4
+// notifications CPU2 takes per connection event, see uiStackRun()
+#define STACK_TX_BUFFERS 3
+#define FRAME_RECORDS ((PAYLOAD - HISTORY_FRAME_HEADER) / HISTORY_RECORD_SIZE)
+
+typedef struct {
+	uint32_t uiFirst;          // range asked for
+	uint32_t uiEnd;
+	uint32_t uiClosedAt;       // sequence of the closing frame
+	uint32_t uiNext;           // next sequence it keeps
+	uint32_t uiDuplicates;     // records dropped as already kept
+	uint32_t uiSkipped;        // records the ring lost before they were sent
+	uint32_t uiBadContent;
+	uint32_t uiFrames;         // since the last acknowledgement
+	uint8_t ucAckEvery;
+	uint8_t ucClosed;          // closing frame seen
+	uint8_t ucAckDue;
+	uint8_t aCount[RANGE_MAX]; // times each sequence was kept
+} Central;
+
+// a run of the module harness
+typedef struct {
+	uint8_t ucInflight;        // frames handed out but not delivered, at most
+	uint8_t ucAckEvery;
+	uint16_t usCut;            // step of a single cut, 0xFFFF for none
+	uint8_t ucCutOdds;         // random cuts, one step in ucCutOdds, 0 for none
+	uint32_t uiPauseS;         // records stored while the link is down
+} Harness;
+
+static const Cpu2HostCentral tPhone = { 247, 251, 1, 24, -60 };
+static Central tCentral;
+static uint32_t uiClock;       // ms of the records fed to history.c
+static uint32_t uiResentBelowAck;
+
+// local function prototypes
+static uint8_t ucHR(uint32_t uiSeq);
+static void vFeed(uint32_t uiSeconds);
+static uint32_t uiGet32(const uint8_t *p);
+static void vPut32(uint8_t *p, uint32_t v);
+static void vCentralStart(uint8_t *pCmd, uint32_t uiFirst, uint32_t uiCount, uint8_t ucAckEvery);
+static void vCentralFrame(const uint8_t *pFrame, uint16_t usLen);
+static uint16_t usCentralAck(uint8_t *pCmd);
+static void vCentralCheck(void);
+static uint32_t uiAcked(void);
+static uint32_t uiRun(const Harness *pHarness);
+static uint32_t uiStackRun(uint16_t usCutAfter, uint8_t ucAckEvery, uint8_t ucData);
+
+//local functions
+static uint8_t ucHR(uint32_t uiSeq) {
+	return (uint8_t) (60 + uiSeq % 100);
+}
+
+// one reading per second, record n holds reading n, stored with the next one
+static void vFeed(uint32_t uiSeconds) {
+	uint32_t i, seq;
+
+	for (i = 0; i < uiSeconds; i++) {
+		seq = uiClock / HISTORY_PERIOD_MS;
+		vHistorySample(ucHR(seq), 97, HISTORY_TEMP_NONE, uiClock);
+		uiClock += HISTORY_PERIOD_MS;
+	}
+}
+
+static uint32_t uiGet32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void vPut32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+static void vCentralStart(uint8_t *pCmd, uint32_t uiFirst, uint32_t uiCount, uint8_t ucAckEvery) {
+	memset(&tCentral, 0, sizeof(tCentral));
+	tCentral.uiFirst = uiFirst;
+	tCentral.uiNext = uiFirst;
+	tCentral.uiEnd = uiCount ? uiFirst + uiCount : uiHistoryNext();
+	tCentral.ucAckEvery = ucAckEvery;
+	pCmd[0] = HISTORY_CP_START;
+	vPut32(&pCmd[1], uiFirst);
+	vPut32(&pCmd[5], uiCount);
+}
+
+// in order or not at all, what it holds already is dropped
+static void vCentralFrame(const uint8_t *pFrame, uint16_t usLen) {
+	uint32_t seq = uiGet32(pFrame), n = (usLen - HISTORY_FRAME_HEADER) / HISTORY_RECORD_SIZE, i;
+	const uint8_t *r;
+
+	CHECK(usLen >= HISTORY_FRAME_HEADER);
+	if (n == 0) {
+		// past the end when the ring overwrote all that was left of it
+		CHECK(seq == tCentral.uiEnd || (seq > tCentral.uiEnd && seq <= uiHistoryOldest()));
+		if (tCentral.uiNext < tCentral.uiEnd && !tCentral.ucClosed) {
+			CHECK(tCentral.uiEnd <= uiHistoryOldest());
+			tCentral.uiSkipped += tCentral.uiEnd - tCentral.uiNext;
+			tCentral.uiNext = tCentral.uiEnd;
+		}
+		tCentral.uiClosedAt = seq;
+		tCentral.ucClosed = 1;
+		tCentral.ucAckDue = 1;
+		return;
+	}
+	for (i = 0; i < n; i++, seq++) {
+		r = pFrame + HISTORY_FRAME_HEADER + i * HISTORY_RECORD_SIZE;
+		if (seq < tCentral.uiNext) {
+			tCentral.uiDuplicates++;
+			continue;
+		}
+		if (seq > tCentral.uiNext) {
+			// only what the ring has overwritten may be missing
+			CHECK(seq <= uiHistoryOldest());
+			tCentral.uiSkipped += seq - tCentral.uiNext;
+		}
+		if (seq >= RANGE_MAX || seq >= tCentral.uiEnd) {
+			CHECK(seq < tCentral.uiEnd);
+			return;
+		}
+		tCentral.aCount[seq]++;
+		if (uiGet32(r) != seq + 1 || r[4] != ucHR(seq) || r[5] != 97
+				|| (int8_t) r[7] != HISTORY_TEMP_NONE)
+			tCentral.uiBadContent++;
+		tCentral.uiNext = seq + 1;
+	}
+	if (++tCentral.uiFrames >= tCentral.ucAckEvery)
+		tCentral.ucAckDue = 1;
+}
+
+// 0 when no acknowledgement is due
+static uint16_t usCentralAck(uint8_t *pCmd) {
+	if (!tCentral.ucAckDue)
+		return 0;
+	tCentral.ucAckDue = 0;
+	tCentral.uiFrames = 0;
+	pCmd[0] = HISTORY_CP_ACK;
+	vPut32(&pCmd[1], tCentral.ucClosed ? tCentral.uiClosedAt : tCentral.uiNext);
+	return 5;
+}
+
+// every record of the range kept once, but those the ring lost first
+static void vCentralCheck(void) {
+	uint32_t seq, missing = 0, twice = 0;
+
+	CHECK(tCentral.ucClosed);
+	CHECK_EQ(tCentral.uiBadContent, 0);
+	for (seq = tCentral.uiFirst; seq < tCentral.uiEnd && seq < RANGE_MAX; seq++) {
+		if (tCentral.aCount[seq] == 0)
+			missing++;
+		else if (tCentral.aCount[seq] > 1)
+			twice++;
+	}
+	CHECK_EQ(missing, tCentral.uiSkipped);
+	CHECK_EQ(twice, 0);
+	CHECK_EQ(ucHistorySyncState(), HISTORY_SYNC_IDLE);
+	CHECK_EQ(uiAcked(), tCentral.uiClosedAt);
+}
+
+static uint32_t uiAcked(void) {
+	uint8_t status[HISTORY_STATUS_SIZE];
+
+	usHistoryStatus(status);
+	return uiGet32(&status[8]);
+}
+
+/*
+ * history.c alone: frames handed out up to ucInflight ahead of the central,
+ * one action per step, a cut drops the frames in flight and an
+ * acknowledgement not yet taken. Returns the steps the transfer took.
+ */
+static uint32_t uiRun(const Harness *pHarness) {
+	static uint8_t inflight[INFLIGHT_MAX][PAYLOAD];
+	uint16_t lens[INFLIGHT_MAX], ackLen = 0, len;
+	uint8_t cmd[9], ack[5], head = 0, count = 0, down = 0;
+	uint32_t step;
+
+	vHistoryInit();
+	uiClock = 0;
+	vFeed(RECORDS + 1);
+	vCentralStart(cmd, 0, 0, pHarness->ucAckEvery);
+	CHECK_EQ(ucHistoryControl(cmd, 9), 1);
+
+	for (step = 0; step < STEPS_MAX && ucHistorySyncState() != HISTORY_SYNC_IDLE; step++) {
+		if (step == pHarness->usCut || (pHarness->ucCutOdds && rand() % pHarness->ucCutOdds == 0)) {
+			// link down, the last listener gone
+			count = 0;
+			ackLen = 0;
+			vHistorySyncPause();
+			down = 1;
+			continue;
+		}
+		if (down) {
+			// a new link subscribes again, the phone remembers where it stood
+			vFeed(pHarness->uiPauseS);
+			ucHistorySyncResume();
+			down = 0;
+			continue;
+		}
+		switch (step % 3) {
+		case 0:
+			if (count == pHarness->ucInflight)
+				break;
+			len = usHistoryFrame(inflight[(head + count) % INFLIGHT_MAX], PAYLOAD);
+			if (len == 0)
+				break;
+			// nothing the central acknowledged goes again
+			if (len > HISTORY_FRAME_HEADER
+					&& uiGet32(inflight[(head + count) % INFLIGHT_MAX]) < uiAcked())
+				uiResentBelowAck++;
+			lens[(head + count) % INFLIGHT_MAX] = len;
+			count++;
+			break;
+		case 1:
+			if (count == 0)
+				break;
+			vCentralFrame(inflight[head], lens[head]);
+			head = (uint8_t) ((head + 1) % INFLIGHT_MAX);
+			count--;
+			if (ackLen == 0)
+				ackLen = usCentralAck(ack);
+			break;
+		default:
+			if (ackLen)
+				ucHistoryControl(ack, ackLen);
+			ackLen = 0;
+			break;
+		}
+	}
+	CHECK(step < STEPS_MAX);
+	return step;
+}
+
+// a single cut at every step of the transfer, frames in flight one to four
+static void test_every_cut(void) {
+	Harness harness = { 1, 1, 0xFFFF, 0, 0 };
+	uint32_t steps, duplicates;
+	uint16_t cut;
+
+	printf("%8s %5s %6s %10s\n", "inflight", "ack", "cuts", "resent max");
+	for (harness.ucInflight = 1; harness.ucInflight <= INFLIGHT_MAX; harness.ucInflight++) {
+		for (harness.ucAckEvery = 1; harness.ucAckEvery <= 8; harness.ucAckEvery *= 2) {
+			harness.usCut = 0xFFFF;
+			steps = uiRun(&harness);
+			vCentralCheck();
+			CHECK_EQ(tCentral.uiDuplicates, 0);
+			duplicates = 0;
+			for (cut = 0; cut <= steps; cut++) {
+				harness.usCut = cut;
+				uiRun(&harness);
+				vCentralCheck();
+				if (tCentral.uiDuplicates > duplicates)
+					duplicates = tCentral.uiDuplicates;
+				// at most what was sent since the last acknowledgement, and the frames in flight
+				CHECK(tCentral.uiDuplicates
+						<= (uint32_t) (harness.ucAckEvery + harness.ucInflight) * FRAME_RECORDS);
+			}
+			printf("%8u %5u %6u %10u\n", harness.ucInflight, harness.ucAckEvery,
+					(unsigned) steps + 1, (unsigned) duplicates);
+		}
+	}
+	CHECK_EQ(uiResentBelowAck, 0);
+}
+
+// many cuts at random points, some pauses long enough for the ring to wrap
+static void test_random_cuts(void) {
+	Harness harness;
+	uint32_t skipped = 0, runs = 0;
+	uint16_t seed;
+
+	for (seed = 1; seed <= SEEDS; seed++) {
+		srand(seed);
+		harness.ucInflight = (uint8_t) (1 + rand() % INFLIGHT_MAX);
+		harness.ucAckEvery = (uint8_t) (1 + rand() % 6);
+		harness.usCut = 0xFFFF;
+		harness.ucCutOdds = (uint8_t) (8 + rand() % 40);
+		harness.uiPauseS = seed % 50 == 0 ? HISTORY_RECORDS / 4 : (uint32_t) (rand() % 3);
+		uiRun(&harness);
+		vCentralCheck();
+		skipped += tCentral.uiSkipped;
+		runs++;
+	}
+	CHECK_EQ(uiResentBelowAck, 0);
+	// the long pauses did wrap the ring over the range
+	CHECK(skipped > 0);
+	printf("%u runs with random cuts, %u records lost to the ring during long pauses\n",
+			(unsigned) runs, (unsigned) skipped);
+}
+
+/*
+ * Through the stack: the phone subscribes, starts the range and reads the
+ * notifications every CENTRAL_MS, the link drops after ucCutAfter frames.
+ * With ucData it also listens to DATA and only unsubscribes from it there,
+ * the link stays. Returns the frames notified.
+ */
+static uint32_t uiStackRun(uint16_t usCutAfter, uint8_t ucAckEvery, uint8_t ucData) {
+	const Cpu2HostNotify *notify;
+	uint8_t cmd[9], ack[5];
+	uint16_t conn, history, data, cp, i, seen = 0, len;
+	uint32_t frames = 0, ms;
+	uint8_t cut = usCutAfter != 0xFFFF;
+
+	vBleHostInit();
+	uiClock = 0;
+	vFeed(RECORDS + 1);
+	conn = usBleHostConnect(&tPhone);
+	history = usBleHostChar(BLE_HOST_HISTORY);
+	cp = usBleHostChar(BLE_HOST_HISTORY_CP);
+	data = usBleHostChar(BLE_HOST_DATA);
+	// TX buffers for STACK_TX_BUFFERS notifications per connection event of 30 ms
+	vCpu2HostRefuse(1, STACK_TX_BUFFERS + 1, 30000);
+	vCpu2HostSubscribe(conn, history, 1);
+	if (ucData)
+		vCpu2HostSubscribe(conn, data, 1);
+	vCentralStart(cmd, 0, 0, ucAckEvery);
+	vCpu2HostWrite(conn, cp, cmd, 9);
+	vCpu2HostClearNotifications();
+
+	for (ms = 0; ms < STACK_MS_MAX && !(tCentral.ucClosed && ucHistorySyncState() == HISTORY_SYNC_IDLE);
+			ms += CENTRAL_MS) {
+		vBleHostRun(CENTRAL_MS);
+		for (i = seen; i < usCpu2HostNotifications(); i++) {
+			notify = pCpu2HostNotification(i);
+			if (notify->usHandle != history)
+				continue;
+			if (cut && frames == usCutAfter)
+				break;
+			vCentralFrame(notify->aData, notify->usLen);
+			frames++;
+		}
+		if (cut && frames == usCutAfter && ucData) {
+			// history frames queued behind DATA values have to stay
+			vCpu2HostSubscribe(conn, data, 0);
+			cut = 0;
+		} else if (cut && frames == usCutAfter) {
+			// the link drops before the rest arrives, the phone comes back
+			vCpu2HostDisconnect(conn, 0x08);
+			vBleHostRun(100);
+			vCpu2HostClearNotifications();
+			seen = 0;
+			tCentral.ucAckDue = 0;
+			conn = usBleHostConnect(&tPhone);
+			vCpu2HostSubscribe(conn, history, 1);
+			cut = 0;
+			continue;
+		}
+		seen = i;
+		len = usCentralAck(ack);
+		if (len)
+			vCpu2HostWrite(conn, cp, ack, len);
+	}
+	CHECK(ms < STACK_MS_MAX);
+	return frames;
+}
+
+// disconnects after every frame of a transfer through smart_watch_app.c
+static void test_stack(void) {
+	uint32_t frames, duplicates = 0;
+	uint16_t cut;
+
+	frames = uiStackRun(0xFFFF, STACK_ACK_EVERY, 0);
+	vCentralCheck();
+	CHECK_EQ(tCentral.uiDuplicates, 0);
+	CHECK_EQ(tCentral.uiEnd, RECORDS);
+	for (cut = 0; cut < frames; cut++) {
+		uiStackRun(cut, STACK_ACK_EVERY, 0);
+		vCentralCheck();
+		// what came since the last acknowledgement, and what was on its way
+		CHECK(tCentral.uiDuplicates <= (STACK_ACK_EVERY + STACK_TX_BUFFERS) * FRAME_RECORDS);
+		if (tCentral.uiDuplicates > duplicates)
+			duplicates = tCentral.uiDuplicates;
+	}
+	printf("%u records in %u frames through the stack, a cut after any of them resends %u at most\n",
+			RECORDS, (unsigned) frames, (unsigned) duplicates);
+}
+
+// DATA unsubscribed after every frame, the history goes on without a gap
+static void test_stack_data_off(void) {
+	uint32_t frames;
+	uint16_t cut;
+
+	frames = uiStackRun(0xFFFF, STACK_ACK_EVERY, 1);
+	vCentralCheck();
+	for (cut = 0; cut < frames; cut++) {
+		uiStackRun(cut, STACK_ACK_EVERY, 1);
+		vCentralCheck();
+		CHECK_EQ(tCentral.uiSkipped, 0);
+		CHECK_EQ(tCentral.uiDuplicates, 0);
+	}
+	printf("DATA unsubscribed after any of %u frames, no record lost or resent\n",
+			(unsigned) frames);
+}
+
+int main(void) {
+	UNIT_RUN(test_every_cut);
+	UNIT_RUN(test_random_cuts);
+	UNIT_RUN(test_stack);
+	UNIT_RUN(test_stack_data_off);
+	return UNIT_END();
+}
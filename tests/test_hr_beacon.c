@@ -0,0 +1,227 @@
+/*
+ * test_hr_beacon.c
+ *
+ * Advertised heart rate record of hr_beacon.c: the first reading and any
+ * reading past a deadband, or a finger put on or taken off, is due, the
+ * rest is not; confidence follows the share of steady readings and the
+ * sequence moves once per record. However fast the readings change, no more
+ * than one record goes out per advertising interval and the last value is
+ * not lost behind the throttle. Through app_ble.c the record lands at the end
+ * of the manufacturer data CPU2 advertises, while the watch advertises, also
+ * next to a connected central, and not once every slot is taken.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "app_ble.h"
+#include "hr_beacon.h"
+
+#include <stdlib.h>
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+
+#define INTERVAL_MS 100
+// 0xa0 of CFG_FAST_CONN_ADV_INTERVAL_MAX in ms
+#define FAST_ADV_MS ((CFG_FAST_CONN_ADV_INTERVAL_MAX * 5) / 8)
+#define AD_TYPE_MANUFACTURER 0xFF
+
+// local function prototypes
+static void vRecord(uint8_t *pHR, uint8_t *pSPO2, uint8_t *pConfidence, uint8_t *pSeq);
+static const uint8_t *pAdvRecord(void);
+
+//local functions
+static void vRecord(uint8_t *pHR, uint8_t *pSPO2, uint8_t *pConfidence, uint8_t *pSeq) {
+	uint8_t record[HR_BEACON_RECORD_SIZE];
+
+	vHrBeaconEncode(record);
+	*pHR = record[0];
+	*pSPO2 = record[1];
+	*pConfidence = record[2];
+	*pSeq = record[3];
+}
+
+// last HR_BEACON_RECORD_SIZE bytes of the manufacturer AD structure on air
+static const uint8_t *pAdvRecord(void) {
+	const uint8_t *adv;
+	uint8_t len, i;
+
+	adv = pCpu2HostAdvData(&len);
+	for (i = 0; i + 1 < len && adv[i] != 0; i += adv[i] + 1) {
+		if (adv[i + 1] == AD_TYPE_MANUFACTURER && i + adv[i] + 1 <= len)
+			return &adv[i + adv[i] + 1 - HR_BEACON_RECORD_SIZE];
+	}
+	return NULL;
+}
+
+// record layout, confidence and sequence
+static void test_encode(void) {
+	uint8_t hr, spo2, confidence, seq, i;
+
+	vHrBeaconInit();
+	CHECK_EQ(ucHrBeaconSample(70, 98, 0, INTERVAL_MS), 1);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(hr, 70);
+	CHECK_EQ(spo2, 98);
+	CHECK_EQ(confidence, 0);
+	CHECK_EQ(seq, 1);
+
+	// half the window steady, then all of it
+	for (i = 1; i <= 4; i++)
+		CHECK_EQ(ucHrBeaconSample(70, 98, i * INTERVAL_MS, INTERVAL_MS), 0);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(confidence, 50);
+	for (i = 5; i <= 8; i++)
+		CHECK_EQ(ucHrBeaconSample(71, 98, i * INTERVAL_MS, INTERVAL_MS), 0);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(confidence, 100);
+	CHECK_EQ(seq, 1);
+	CHECK_EQ(hr, 70);
+
+	// an unsteady reading leaves the window one short
+	CHECK_EQ(ucHrBeaconSample(90, 98, 9 * INTERVAL_MS, INTERVAL_MS), 1);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(hr, 90);
+	CHECK_EQ(confidence, 87);
+	CHECK_EQ(seq, 2);
+
+	// no finger is never steady
+	for (i = 10; i < 20; i++)
+		ucHrBeaconSample(0, 0, i * INTERVAL_MS, INTERVAL_MS);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(hr, 0);
+	CHECK_EQ(spo2, 0);
+	CHECK_EQ(confidence, 0);
+}
+
+// due past the deadbands and on a finger coming or going
+static void test_deadband(void) {
+	static const struct {
+		uint8_t ucHR, ucSPO2, ucDue;
+	} aSteps[] = {
+		{ 70, 98, 1 },
+		{ 72, 98, 0 }, { 68, 98, 0 }, { 73, 98, 1 },
+		{ 73, 97, 0 }, { 73, 96, 1 }, { 71, 97, 0 },
+		{ 0, 0, 1 }, { 0, 0, 0 }, { 71, 97, 1 },
+		{ 0, 97, 1 }, { 71, 97, 1 },
+	};
+	uint8_t i;
+
+	vHrBeaconInit();
+	for (i = 0; i < sizeof(aSteps) / sizeof(aSteps[0]); i++) {
+		CHECK_EQ(ucHrBeaconSample(aSteps[i].ucHR, aSteps[i].ucSPO2, i * INTERVAL_MS, INTERVAL_MS),
+				aSteps[i].ucDue);
+		if (ucHrBeaconSample(aSteps[i].ucHR, aSteps[i].ucSPO2, i * INTERVAL_MS, INTERVAL_MS))
+			printf("  repeated reading %u due twice\n", i);
+	}
+}
+
+// a reading every 10 ms moving each time, at most one record per interval
+static void test_throttle(void) {
+	uint32_t now, last = 0, records = 0, gapMin = 0xFFFFFFFFUL;
+	uint8_t hr = 70, sent, spo2, confidence, seq;
+
+	vHrBeaconInit();
+	srand(3);
+	for (now = 0; now < 10000; now += 10) {
+		hr = (uint8_t) (hr + (rand() % 2 ? 4 : -4));
+		if (hr < 40 || hr > 180)
+			hr = 70;
+		if (!ucHrBeaconSample(hr, 98, now, INTERVAL_MS))
+			continue;
+		if (records && now - last < gapMin)
+			gapMin = now - last;
+		last = now;
+		records++;
+	}
+	CHECK(gapMin >= INTERVAL_MS);
+	CHECK(records <= 10000 / INTERVAL_MS + 1);
+	CHECK(records >= 10000 / INTERVAL_MS / 2);
+
+	// a change held back by the throttle goes out with the first reading after it
+	now = last + INTERVAL_MS;
+	CHECK_EQ(ucHrBeaconSample(150, 98, now, INTERVAL_MS), 1);
+	CHECK_EQ(ucHrBeaconSample(120, 98, now + 10, INTERVAL_MS), 0);
+	CHECK_EQ(ucHrBeaconSample(120, 98, now + INTERVAL_MS, INTERVAL_MS), 1);
+	vRecord(&sent, &spo2, &confidence, &seq);
+	CHECK_EQ(sent, 120);
+	printf("10 s of readings every 10 ms: %u records, %u ms apart at least\n",
+			(unsigned) records, (unsigned) gapMin);
+}
+
+// the sequence wraps, a receiver compares it for change only
+static void test_sequence(void) {
+	uint8_t hr, spo2, confidence, seq;
+	uint16_t i;
+
+	vHrBeaconInit();
+	for (i = 0; i < 258; i++)
+		ucHrBeaconSample((i & 1) ? 60 : 80, 98, i * INTERVAL_MS, INTERVAL_MS);
+	vRecord(&hr, &spo2, &confidence, &seq);
+	CHECK_EQ(seq, 2);
+}
+
+// through app_ble.c and CPU2, throttled to the fast advertising interval
+static void test_stack(void) {
+	static const Cpu2HostCentral central = { 247, 251, 1, 24, -60 };
+	const uint8_t *record;
+	uint32_t updates, ms;
+	uint8_t len, hr = 70;
+
+	vBleHostInit();
+	CHECK(ucCpu2HostAdvertising());
+	updates = uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA);
+	APP_BLE_Broadcast_Update(70, 98);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA), updates + 1);
+	record = pAdvRecord();
+	CHECK(record != NULL);
+	if (record == NULL)
+		return;
+	CHECK_EQ(record[0], 70);
+	CHECK_EQ(record[1], 98);
+	CHECK_EQ(record[3], 1);
+	pCpu2HostAdvData(&len);
+	CHECK(len <= 31);
+
+	// readings every 10 ms that always move
+	updates = uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA);
+	for (ms = 0; ms < 2000; ms += 10) {
+		hr = (uint8_t) (hr == 70 ? 80 : 70);
+		APP_BLE_Broadcast_Update(hr, 98);
+		vBleHostRun(10);
+	}
+	updates = uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA) - updates;
+	CHECK(updates <= 2000 / FAST_ADV_MS + 1);
+	// half the readings equal the record on air, one may slip a step
+	CHECK(updates >= 2000 / (FAST_ADV_MS + 10));
+	printf("2 s of readings every 10 ms: %u advertising data updates at %u ms\n",
+			(unsigned) updates, FAST_ADV_MS);
+
+	// one central, the other slot still advertises and carries the record
+	usBleHostConnect(&central);
+	CHECK(ucCpu2HostAdvertising());
+	vBleHostRun(3000);
+	APP_BLE_Broadcast_Update(120, 95);
+	record = pAdvRecord();
+	CHECK(record != NULL && record[0] == 120 && record[1] == 95);
+
+	// every slot taken, nobody scans for it
+	usBleHostConnect(&central);
+	vBleHostRun(3000);
+	updates = uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA);
+	APP_BLE_Broadcast_Update(60, 90);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GAP_UPDATE_ADV_DATA), updates);
+}
+
+int main(void) {
+	UNIT_RUN(test_encode);
+	UNIT_RUN(test_deadband);
+	UNIT_RUN(test_throttle);
+	UNIT_RUN(test_sequence);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
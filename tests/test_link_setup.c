@@ -0,0 +1,212 @@
+/*
+ * test_link_setup.c
+ *
+ * Link negotiation of app_ble.c against scripted CPU2 answers: the MTU
+ * exchange, data length and 2M PHY each succeed, are refused by the stack,
+ * are not taken by the central or, for the MTU, never answered or answered
+ * with an error. Every path has to end with the defaults for what failed,
+ * the negotiated values for the rest, one command per step, and the
+ * notification payload sized to what the link ended up with.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "app_ble.h"
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+
+// ATT MTU 512 of CFG_BLE_MAX_ATT_MTU, 251 octets less the L2CAP and ATT headers
+#define FULL_PAYLOAD (APP_BLE_MAX_TX_OCTETS - APP_BLE_NOTIFY_OVERHEAD)
+#define ATT_TIMEOUT_MS 30000
+
+typedef struct {
+	const char *pName;
+	Cpu2HostCentral tCentral;
+	uint16_t usRefuse;         // opcode the stack refuses, 0 for none
+	uint16_t usMtu;
+	uint16_t usOctets;
+	uint8_t ucPhy;
+	uint16_t usPayload;
+} Scenario;
+
+static const Scenario aScenarios[] = {
+	{ "all negotiated", { 512, 251, 1, 24, -60 }, 0, 512, 251, 2, FULL_PAYLOAD },
+	{ "central MTU 185", { 185, 251, 1, 24, -60 }, 0, 185, 251, 2, 182 },
+	{ "central MTU above ours", { 1024, 251, 1, 24, -60 }, 0, CFG_BLE_MAX_ATT_MTU, 251, 2, FULL_PAYLOAD },
+	{ "MTU exchange refused", { 512, 251, 1, 24, -60 }, CPU2_HOST_GATT_EXCHANGE_CONFIG,
+			APP_BLE_DEFAULT_ATT_MTU, 251, 2, APP_BLE_DEFAULT_ATT_MTU - 3 },
+	{ "data length refused", { 512, 251, 1, 24, -60 }, CPU2_HOST_LE_SET_DATA_LENGTH,
+			512, APP_BLE_DEFAULT_TX_OCTETS, 2, 509 },
+	{ "central without DLE", { 512, 27, 1, 24, -60 }, 0, 512, APP_BLE_DEFAULT_TX_OCTETS, 2, 509 },
+	{ "central LL payload 100", { 512, 100, 1, 24, -60 }, 0, 512, 100, 2, 100 - APP_BLE_NOTIFY_OVERHEAD },
+	{ "PHY refused", { 512, 251, 1, 24, -60 }, CPU2_HOST_LE_SET_PHY, 512, 251, 1, FULL_PAYLOAD },
+	{ "central without 2M", { 512, 251, 0, 24, -60 }, 0, 512, 251, 1, FULL_PAYLOAD },
+	{ "nothing negotiated", { 23, 27, 0, 24, -60 }, 0, APP_BLE_DEFAULT_ATT_MTU,
+			APP_BLE_DEFAULT_TX_OCTETS, 1, APP_BLE_DEFAULT_ATT_MTU - 3 },
+};
+
+// local function prototypes
+static void vCheckCommandsOnce(void);
+static void vProcComplete(uint16_t usConn, uint8_t ucError, uint32_t uiDelayUs);
+
+//local functions
+static void vCheckCommandsOnce(void) {
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GATT_EXCHANGE_CONFIG), 1);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_DATA_LENGTH), 1);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_PHY), 1);
+}
+
+// EVT_BLUE_GATT_PROCEDURE_COMPLETE as CPU2 frames it, vendor code first
+static void vProcComplete(uint16_t usConn, uint8_t ucError, uint32_t uiDelayUs) {
+	uint8_t evt[5];
+
+	evt[0] = (uint8_t) EVT_BLUE_GATT_PROCEDURE_COMPLETE;
+	evt[1] = (uint8_t) (EVT_BLUE_GATT_PROCEDURE_COMPLETE >> 8);
+	evt[2] = (uint8_t) usConn;
+	evt[3] = (uint8_t) (usConn >> 8);
+	evt[4] = ucError;
+	vCpu2HostEvent(EVT_VENDOR, evt, sizeof(evt), uiDelayUs);
+}
+
+// every scenario of the table from the connection to the end of the setup
+static void test_scenarios(void) {
+	const APP_BLE_LinkParams_t *link;
+	const Scenario *s;
+	const uint8_t *params;
+	uint32_t failures;
+	uint16_t conn;
+	uint8_t i, len;
+
+	for (i = 0; i < sizeof(aScenarios) / sizeof(aScenarios[0]); i++) {
+		s = &aScenarios[i];
+		failures = uiUnitFailures;
+		vBleHostInit();
+		if (s->usRefuse)
+			vCpu2HostSetStatus(s->usRefuse, CPU2_HOST_UNKNOWN_COMMAND);
+		conn = usBleHostConnect(&s->tCentral);
+		link = APP_BLE_Get_Link_Params(conn);
+		CHECK(link != NULL);
+		if (link == NULL)
+			continue;
+
+		CHECK_EQ(link->Step, APP_BLE_LINK_DONE);
+		vCheckCommandsOnce();
+		CHECK_EQ(link->Att_Mtu, s->usMtu);
+		CHECK_EQ(link->Max_Tx_Octets, s->usOctets);
+		CHECK_EQ(link->Tx_Phy, s->ucPhy);
+		CHECK_EQ(link->Rx_Phy, s->ucPhy);
+		CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), s->usPayload);
+		CHECK_EQ(link->Mtu_Status, s->usRefuse == CPU2_HOST_GATT_EXCHANGE_CONFIG
+				? CPU2_HOST_UNKNOWN_COMMAND : BLE_STATUS_SUCCESS);
+		CHECK_EQ(link->Data_Length_Status, s->usRefuse == CPU2_HOST_LE_SET_DATA_LENGTH
+				? CPU2_HOST_UNKNOWN_COMMAND : BLE_STATUS_SUCCESS);
+		CHECK_EQ(link->Phy_Status, s->usRefuse == CPU2_HOST_LE_SET_PHY
+				? CPU2_HOST_UNKNOWN_COMMAND : BLE_STATUS_SUCCESS);
+
+		// the requests themselves: this link, 251 octets, 2M both ways
+		params = pCpu2HostLastParams(CPU2_HOST_LE_SET_DATA_LENGTH, &len);
+		CHECK(params != NULL && len == 6);
+		CHECK_EQ(params[0] | (params[1] << 8), conn);
+		CHECK_EQ(params[2] | (params[3] << 8), APP_BLE_MAX_TX_OCTETS);
+		CHECK_EQ(params[4] | (params[5] << 8), APP_BLE_MAX_TX_TIME);
+		params = pCpu2HostLastParams(CPU2_HOST_LE_SET_PHY, &len);
+		CHECK(params != NULL && len == 7);
+		CHECK_EQ(params[3], 2);
+		CHECK_EQ(params[4], 2);
+		CHECK_EQ(usCpu2HostLinkMtu(conn), s->usRefuse == CPU2_HOST_GATT_EXCHANGE_CONFIG
+				? APP_BLE_DEFAULT_ATT_MTU : s->usMtu);
+		if (uiUnitFailures != failures)
+			printf("  in scenario \"%s\"\n", s->pName);
+	}
+}
+
+// the central never answers the exchange: data length and PHY wait for the
+// ATT timeout, then go out with the default MTU kept
+static void test_mtu_timeout(void) {
+	static const Cpu2HostCentral central = { 0, 251, 1, 24, -60 };
+	const APP_BLE_LinkParams_t *link;
+
+	vBleHostInit();
+	link = APP_BLE_Get_Link_Params(usBleHostConnect(&central));
+	CHECK(link != NULL);
+	if (link == NULL)
+		return;
+	CHECK_EQ(link->Step, APP_BLE_LINK_MTU_WAIT);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_DATA_LENGTH), 0);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_PHY), 0);
+
+	vBleHostRun(ATT_TIMEOUT_MS);
+	CHECK_EQ(link->Step, APP_BLE_LINK_DONE);
+	vCheckCommandsOnce();
+	CHECK_EQ(link->Mtu_Status, BLE_STATUS_TIMEOUT);
+	CHECK_EQ(link->Att_Mtu, APP_BLE_DEFAULT_ATT_MTU);
+	CHECK_EQ(link->Max_Tx_Octets, 251);
+	CHECK_EQ(link->Tx_Phy, 2);
+	CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), APP_BLE_DEFAULT_ATT_MTU - 3);
+}
+
+// the procedure ends with an ATT error instead of a response
+static void test_mtu_error(void) {
+	static const Cpu2HostCentral central = { 0, 251, 1, 24, -60 };
+	const APP_BLE_LinkParams_t *link;
+	uint16_t conn;
+
+	vBleHostInit();
+	conn = usCpu2HostConnect(&central);
+	vProcComplete(conn, 0x06, 200000);
+	vBleHostRun(BLE_HOST_LINK_SETUP_MS);
+	link = APP_BLE_Get_Link_Params(conn);
+	CHECK(link != NULL);
+	if (link == NULL)
+		return;
+	CHECK_EQ(link->Step, APP_BLE_LINK_DONE);
+	vCheckCommandsOnce();
+	CHECK_EQ(link->Mtu_Status, 0x06);
+	CHECK_EQ(link->Att_Mtu, APP_BLE_DEFAULT_ATT_MTU);
+	CHECK_EQ(link->Tx_Phy, 2);
+
+	// the late timeout of that exchange changes nothing
+	vBleHostRun(ATT_TIMEOUT_MS);
+	CHECK_EQ(link->Mtu_Status, 0x06);
+	vCheckCommandsOnce();
+}
+
+// a disconnect frees the parameters, the next central negotiates anew
+static void test_reconnect(void) {
+	static const Cpu2HostCentral first = { 512, 251, 1, 24, -60 };
+	static const Cpu2HostCentral second = { 247, 27, 0, 24, -60 };
+	const APP_BLE_LinkParams_t *link;
+	uint16_t conn;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&first);
+	CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), FULL_PAYLOAD);
+	vCpu2HostDisconnect(conn, 0x13);
+	vBleHostRun(100);
+	CHECK(APP_BLE_Get_Link_Params(conn) == NULL);
+
+	conn = usBleHostConnect(&second);
+	link = APP_BLE_Get_Link_Params(conn);
+	CHECK(link != NULL);
+	if (link == NULL)
+		return;
+	CHECK_EQ(link->Step, APP_BLE_LINK_DONE);
+	CHECK_EQ(link->Att_Mtu, 247);
+	CHECK_EQ(link->Max_Tx_Octets, APP_BLE_DEFAULT_TX_OCTETS);
+	CHECK_EQ(link->Tx_Phy, 1);
+	CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), 244);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GATT_EXCHANGE_CONFIG), 2);
+}
+
+int main(void) {
+	UNIT_RUN(test_scenarios);
+	UNIT_RUN(test_mtu_timeout);
+	UNIT_RUN(test_mtu_error);
+	UNIT_RUN(test_reconnect);
+	return UNIT_END();
+}
@@ -0,0 +1,187 @@
+/*
+ * test_lpm_timeline.c
+ *
+ * The event timeline of main.c on the host stack, with the time the CPU
+ * spends in each task. The MAX30102 INT raises EXTI0 at the sample rate and
+ * posts the drain task, the display task runs every DISPLAY_PERIOD, and
+ * the BLE application runs its own timers and CPU2 events. The I2C transfers
+ * of the drain and the display block for their time on the bus. In between,
+ * SCH_Idle() sleeps, in Stop2 when CFG_LPM_SUPPORTED holds, which the
+ * shipped CFG_LOW_POWER configuration has to give. For each scenario the
+ * table prints the fraction of time asleep, the wakeups per second and the
+ * longest the CPU stays awake. No sample may be lost, every wakeup has to
+ * come from a source of the timeline, and the CPU has to sleep most of the
+ * time however a central uses the link.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "scheduler.h"
+#include "app_entry.h"
+#include "main.h"
+#include "app_ble.h"
+#include "history.h"
+#include "max30102.h"
+#include "max30102_emu.h"
+#include "ppg_stream.h"
+#include "ssd1306_emu.h"
+#include "ssd1306.h"
+#include "oled.h"
+
+#include <string.h>
+
+// main.c
+#define DISPLAY_PERIOD 50
+#define SAMPLE_US (1000000 / PPG_STREAM_RATE_HZ)
+// NOTIFY_TICK_PERIOD of smart_watch_app.c
+#define NOTIFY_TICK_MS 100
+// Timing 0x0040040C of MX_I2C3_Init on the 32 MHz PCLK1, about 1.4 MHz
+#define I2C_BIT_NS 700
+#define RUN_MS 10000
+#define BEAT_SAMPLES 40
+
+typedef enum {
+	SCENARIO_ADVERTISING,
+	SCENARIO_CONNECTED,
+	SCENARIO_HR,
+	SCENARIO_DATA,
+	SCENARIO_DISPLAY_OFF,
+	SCENARIO_COUNT,
+} Scenario;
+
+typedef struct {
+	uint32_t uiSleepPermille;
+	uint32_t uiWakeupsPerS;
+	uint32_t uiAwakeMaxUs;
+	uint32_t uiSamples;
+	uint32_t uiDrained;        // samples the drain task read
+} Timeline;
+
+static const char *const apcScenarioName[SCENARIO_COUNT] = {
+	"advertising", "connected", "HR", "DATA", "display off",
+};
+static const Cpu2HostCentral tPhone = { 247, 251, 1, 24, -60 };
+static uint32_t uiSamples;
+static uint32_t uiDrained;
+
+// local function prototypes
+static void vSensorIrq(void);
+static void vReadSensorData(void);
+static void vDisplayTask(void);
+static void vTimeline(Scenario eScenario, Timeline *pTimeline);
+
+//local functions
+// EXTI0, a new sample behind the MAX30102 INT
+static void vSensorIrq(void) {
+	vMax30102EmuPush(90000 + (uiSamples % BEAT_SAMPLES) * 100,
+			100000 + (uiSamples % BEAT_SAMPLES) * 200);
+	uiSamples++;
+	SCH_SetTask(1 << CFG_TASK_SENSOR_DRAIN_ID, CFG_SCH_PRIO_0);
+}
+
+// the drain task of main.c, the LED left out
+static void vReadSensorData(void) {
+	uint8_t heartRate, unread = ucMax30102EmuUnread();
+
+	vMax30102ReadData();
+	uiDrained += unread - ucMax30102EmuUnread();
+	heartRate = ucGetMax30102HR();
+	vHistorySample(heartRate, ucGetMax30102SPO2(), HISTORY_TEMP_NONE, HAL_GetTick());
+#if (CFG_BLE_HR_BROADCAST != 0)
+	APP_BLE_Broadcast_Update(heartRate, ucGetMax30102SPO2());
+#endif
+}
+
+static void vDisplayTask(void) {
+	vOledScreenProcess(ucOledStatusFlag, ucGetMax30102HR(), ucGetMax30102SPO2(),
+			usGetMax30102Diff());
+	if (HAL_GPIO_ReadPin(MAX30102_INT_GPIO_Port, MAX30102_INT_Pin) == GPIO_PIN_RESET)
+		SCH_SetTask(1 << CFG_TASK_SENSOR_DRAIN_ID, CFG_SCH_PRIO_0);
+}
+
+// RUN_MS of the scenario after the link is up
+static void vTimeline(Scenario eScenario, Timeline *pTimeline) {
+	BleHostStats stats;
+	uint16_t conn;
+
+	memset(pTimeline, 0, sizeof(*pTimeline));
+	vBleHostInit();
+	vMax30102EmuInit();
+	vSsd1306EmuInit();
+	SSD1306_Init();
+	vOledBleClearScreen();
+	vHostI2cSetBitNs(I2C_BIT_NS);
+	// a DATA subscriber switches to the BLE screen
+	ucOledStatusFlag = eScenario == SCENARIO_DISPLAY_OFF ? OLED_STATUS_SHUT_DOWN : OLED_STATUS_MAX30102;
+	SCH_RegTask(CFG_TASK_SENSOR_DRAIN_ID, vReadSensorData);
+	SCH_RegTask(CFG_TASK_DISPLAY_ID, vDisplayTask);
+	APPE_Periodic_Register(CFG_TASK_DISPLAY_ID, DISPLAY_PERIOD, DISPLAY_PERIOD);
+	APPE_Periodic_Enable(CFG_TASK_DISPLAY_ID, 1);
+	uiSamples = 0;
+	uiDrained = 0;
+	vBleHostIrq(SAMPLE_US, vSensorIrq);
+
+	if (eScenario != SCENARIO_ADVERTISING && eScenario != SCENARIO_DISPLAY_OFF) {
+		conn = usBleHostConnect(&tPhone);
+		if (eScenario == SCENARIO_HR)
+			vCpu2HostSubscribe(conn, usBleHostChar(BLE_HOST_HR), 1);
+		else if (eScenario == SCENARIO_DATA)
+			vCpu2HostSubscribe(conn, usBleHostChar(BLE_HOST_DATA), 1);
+	}
+	vBleHostRun(DISPLAY_PERIOD);
+	uiSamples = 0;
+	uiDrained = 0;
+	vBleHostClearStats();
+	vBleHostRun(RUN_MS);
+	vBleHostGetStats(&stats);
+	vBleHostIrq(0, NULL);
+	pTimeline->uiSleepPermille = (uint32_t) (stats.ulSleepUs / RUN_MS);
+	pTimeline->uiAwakeMaxUs = stats.uiAwakeMaxUs;
+	pTimeline->uiWakeupsPerS = stats.uiWakeups * 1000 / RUN_MS;
+	pTimeline->uiSamples = uiSamples;
+	pTimeline->uiDrained = uiDrained;
+	CHECK_EQ(ucMax30102EmuOverflow(), 0);
+}
+
+// sleep fraction and wakeups per scenario, each wakeup from a known source
+static void test_timeline(void) {
+	static Timeline timeline;
+	uint32_t sources;
+	uint8_t s;
+
+	// the shipped configuration reaches Stop2
+	CHECK_EQ(CFG_LOW_POWER, 1);
+	CHECK_EQ(CFG_LPM_SUPPORTED, 1);
+	CHECK_EQ(CFG_DEBUG_APP_TRACE + CFG_DEBUG_BLE_TRACE, 0);
+
+	printf("%-12s %7s %10s %9s  idle in %s\n", "scenario", "asleep", "wakeups/s", "awake us",
+			CFG_LPM_SUPPORTED ? "Stop2" : "Sleep");
+	for (s = 0; s < SCENARIO_COUNT; s++) {
+		vTimeline((Scenario) s, &timeline);
+		printf("%-12s %5u.%u%% %10u %9u\n", apcScenarioName[s],
+				(unsigned) (timeline.uiSleepPermille / 10), (unsigned) (timeline.uiSleepPermille % 10),
+				(unsigned) timeline.uiWakeupsPerS, (unsigned) timeline.uiAwakeMaxUs);
+
+		// every sample drained, the last one may still wait for its task
+		CHECK(timeline.uiDrained + 1 >= timeline.uiSamples);
+		// the INT and the display at least, CPU2 events of the link on top
+		sources = PPG_STREAM_RATE_HZ + 1000 / DISPLAY_PERIOD;
+		CHECK(timeline.uiWakeupsPerS >= PPG_STREAM_RATE_HZ);
+		if (s == SCENARIO_ADVERTISING || s == SCENARIO_DISPLAY_OFF)
+			CHECK(timeline.uiWakeupsPerS <= sources + 1);
+		else
+			CHECK(timeline.uiWakeupsPerS <= sources + 1000 / NOTIFY_TICK_MS
+					+ 1000 * 4 / (tPhone.usInterval * 5));
+		CHECK(timeline.uiSleepPermille >= 900);
+		// the longest a refresh of the MAX30102 screen keeps it awake
+		CHECK(timeline.uiAwakeMaxUs < DISPLAY_PERIOD * 1000 / 4);
+	}
+}
+
+int main(void) {
+	UNIT_RUN(test_timeline);
+	return UNIT_END();
+}
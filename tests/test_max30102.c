@@ -0,0 +1,110 @@
+/*
+ * test_max30102.c
+ *
+ * vMax30102ReadData() against the emulated sensor FIFO. After a stall up to
+ * 31 samples wait, every one of them has to reach the PPG stream in order.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "max30102_emu.h"
+#include "max30102.h"
+#include "ppg_stream.h"
+
+#define SAMPLES_MAX 64
+
+static uint32_t auiRed[SAMPLES_MAX];
+static uint32_t auiIred[SAMPLES_MAX];
+
+// local function prototypes
+static void vSensorReset(void);
+static uint16_t usStreamCollect(uint32_t *red, uint32_t *ired);
+
+//local functions
+static void vSensorReset(void) {
+	vHostReset();
+	vMax30102EmuInit();
+	vPpgStreamStart(PPG_STREAM_FRAME_MAX, NULL);
+}
+
+// everything pushed so far, decoded from the frames the stream closes
+static uint16_t usStreamCollect(uint32_t *red, uint32_t *ired) {
+	PpgStreamHeader header;
+	uint8_t *frame;
+	uint16_t len, n = 0;
+
+	vHostAdvance(PPG_STREAM_DEADLINE_MS);
+	vPpgStreamPoll();
+	while ((frame = pPpgStreamPeek(&len)) != NULL) {
+		n += ucPpgStreamDecode(frame, len, &header, &red[n], &ired[n]);
+		vPpgStreamRelease();
+	}
+	return n;
+}
+
+// more samples pending than one FIFO read takes
+static void test_drain_chunks(void) {
+	static const uint8_t aPending[] = { 1, 5, 6, 12, 23, 31 };
+	uint32_t red[SAMPLES_MAX], ired[SAMPLES_MAX];
+	uint16_t n;
+	uint8_t i, k;
+
+	for (i = 0; i < sizeof(aPending); i++) {
+		vSensorReset();
+		for (k = 0; k < aPending[i]; k++) {
+			auiRed[k] = 90000 + 37 * k * (i + 1);
+			auiIred[k] = 120000 - 53 * k * (i + 1);
+			vMax30102EmuPush(auiRed[k], auiIred[k]);
+		}
+		CHECK_EQ(ucMax30102EmuUnread(), aPending[i]);
+		vMax30102ReadData();
+		CHECK_EQ(ucMax30102EmuUnread(), 0);
+		CHECK_EQ(uiMax30102EmuFifoBytes(), 6 * aPending[i]);
+
+		n = usStreamCollect(red, ired);
+		CHECK_EQ(n, aPending[i]);
+		for (k = 0; k < n; k++) {
+			CHECK_EQ(red[k], auiRed[k]);
+			CHECK_EQ(ired[k], auiIred[k]);
+		}
+	}
+}
+
+// a full FIFO lost its oldest samples, the ones left still come out in order
+static void test_overflowed_fifo(void) {
+	uint32_t red[SAMPLES_MAX], ired[SAMPLES_MAX];
+	uint16_t n;
+	uint8_t k;
+
+	vSensorReset();
+	for (k = 0; k < 40; k++) {
+		auiRed[k] = 70000 + k;
+		auiIred[k] = 80000 + k;
+		vMax30102EmuPush(auiRed[k], auiIred[k]);
+	}
+	CHECK_EQ(ucMax30102EmuUnread(), MAX30102_EMU_FIFO - 1);
+	CHECK(ucMax30102EmuOverflow() > 0);
+	vMax30102ReadData();
+	CHECK_EQ(ucMax30102EmuUnread(), 0);
+
+	n = usStreamCollect(red, ired);
+	CHECK_EQ(n, MAX30102_EMU_FIFO - 1);
+	for (k = 0; k < n; k++) {
+		CHECK_EQ(red[k], auiRed[40 - n + k]);
+		CHECK_EQ(ired[k], auiIred[40 - n + k]);
+	}
+}
+
+// INT high: nothing is read
+static void test_int_idle(void) {
+	vSensorReset();
+	vMax30102ReadData();
+	CHECK_EQ(uiMax30102EmuFifoBytes(), 0);
+}
+
+int main(void) {
+	UNIT_RUN(test_drain_chunks);
+	UNIT_RUN(test_overflowed_fifo);
+	UNIT_RUN(test_int_idle);
+	return UNIT_END();
+}
@@ -0,0 +1,218 @@
+/*
+ * test_multi_link.c
+ *
+ * Two virtual centrals on the host CPU2, a phone and a logging gateway. The
+ * second connects while the first still negotiates and each link ends up
+ * with its own MTU, data length and PHY. Subscriptions are per link and per
+ * characteristic: an update goes to exactly the links subscribed to it, with
+ * the same bytes, one unsubscribing leaves the other and the other
+ * characteristics alone, and the notification task only runs while anybody
+ * listens. A link going away leaves the parameters of the other one intact.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "app_ble.h"
+#include "smart_watch_stm.h"
+#include "sch_periodic.h"
+
+#include <string.h>
+
+// the ST headers define NULL as a plain 0
+#undef NULL
+#define NULL ((void *) 0)
+
+#define VALUE_LEN 100
+
+static const Cpu2HostCentral tPhone = { 512, 251, 1, 24, -55 };
+static const Cpu2HostCentral tGateway = { 185, 27, 0, 40, -70 };
+static uint8_t aValue[VALUE_LEN];
+
+// local function prototypes
+static void vConnectBoth(uint16_t *pPhone, uint16_t *pGateway);
+static void vSend(uint8_t ucSeed);
+static uint8_t ucNotifiedTo(uint16_t usConn);
+static uint32_t uiNotifyReleases(void);
+
+//local functions
+// the gateway connects before the phone's MTU exchange is answered
+static void vConnectBoth(uint16_t *pPhone, uint16_t *pGateway) {
+	vBleHostInit();
+	*pPhone = usCpu2HostConnect(&tPhone);
+	vBleHostRun(5);
+	*pGateway = usBleHostConnect(&tGateway);
+	vCpu2HostClearNotifications();
+}
+
+static void vSend(uint8_t ucSeed) {
+	uint16_t i;
+
+	for (i = 0; i < VALUE_LEN; i++)
+		aValue[i] = (uint8_t) (i ^ ucSeed);
+	vCpu2HostClearNotifications();
+	CHECK_EQ(SMART_WATCH_STM_App_Update_Data(aValue, VALUE_LEN), BLE_STATUS_SUCCESS);
+}
+
+// notifications to usConn of the last vSend(), each checked against the value
+static uint8_t ucNotifiedTo(uint16_t usConn) {
+	const Cpu2HostNotify *notify;
+	uint16_t i;
+	uint8_t n = 0;
+
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		notify = pCpu2HostNotification(i);
+		if (notify->usConn != usConn || notify->usHandle != usBleHostChar(BLE_HOST_DATA))
+			continue;
+		CHECK_EQ(notify->usLen, VALUE_LEN);
+		CHECK(memcmp(notify->aData, aValue, VALUE_LEN) == 0);
+		n++;
+	}
+	return n;
+}
+
+static uint32_t uiNotifyReleases(void) {
+	SchPeriodicStats stats;
+
+	ucSchPeriodicGetStats(CFG_MY_TASK_NOTIFY_DATA, &stats);
+	return stats.uiReleases;
+}
+
+// each link negotiates its own parameters, the payload fits the smaller one
+static void test_link_params(void) {
+	const APP_BLE_LinkParams_t *phone, *gateway;
+	uint16_t a, b;
+
+	vConnectBoth(&a, &b);
+	phone = APP_BLE_Get_Link_Params(a);
+	gateway = APP_BLE_Get_Link_Params(b);
+	CHECK(phone != NULL && gateway != NULL);
+	if (phone == NULL || gateway == NULL)
+		return;
+	CHECK_EQ(phone->Step, APP_BLE_LINK_DONE);
+	CHECK_EQ(phone->Att_Mtu, 512);
+	CHECK_EQ(phone->Max_Tx_Octets, 251);
+	CHECK_EQ(phone->Tx_Phy, 2);
+	CHECK_EQ(gateway->Step, APP_BLE_LINK_DONE);
+	CHECK_EQ(gateway->Att_Mtu, 185);
+	CHECK_EQ(gateway->Max_Tx_Octets, APP_BLE_DEFAULT_TX_OCTETS);
+	CHECK_EQ(gateway->Tx_Phy, 1);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GATT_EXCHANGE_CONFIG), 2);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_DATA_LENGTH), 2);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_LE_SET_PHY), 2);
+	CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), 182);
+
+	// the gateway leaves, the phone keeps what it negotiated
+	vCpu2HostDisconnect(b, 0x13);
+	vBleHostRun(100);
+	CHECK(APP_BLE_Get_Link_Params(b) == NULL);
+	phone = APP_BLE_Get_Link_Params(a);
+	CHECK(phone != NULL && phone->Att_Mtu == 512 && phone->Max_Tx_Octets == 251);
+	CHECK_EQ(APP_BLE_Get_Notify_Payload_Max(), APP_BLE_MAX_TX_OCTETS - APP_BLE_NOTIFY_OVERHEAD);
+	CHECK_EQ(uiCpu2HostCount(CPU2_HOST_GATT_EXCHANGE_CONFIG), 2);
+}
+
+// subscribe and unsubscribe in turn, the fan-out follows
+static void test_subscriptions(void) {
+	uint16_t a, b, data, history;
+	uint32_t releases;
+
+	vConnectBoth(&a, &b);
+	data = usBleHostChar(BLE_HOST_DATA);
+	history = usBleHostChar(BLE_HOST_HISTORY);
+	CHECK(data != 0 && history != 0);
+
+	// nobody listens, the value is only stored, no notification task
+	releases = uiNotifyReleases();
+	vBleHostRun(1000);
+	CHECK_EQ(uiNotifyReleases(), releases);
+	vSend(1);
+	CHECK_EQ(usCpu2HostNotifications(), 0);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 0);
+
+	vCpu2HostSubscribe(a, data, 1);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 1 << 0);
+	vSend(2);
+	CHECK_EQ(ucNotifiedTo(a), 1);
+	CHECK_EQ(ucNotifiedTo(b), 0);
+	releases = uiNotifyReleases();
+	vBleHostRun(1000);
+	CHECK(uiNotifyReleases() > releases);
+
+	vCpu2HostSubscribe(b, data, 1);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), (1 << 0) | (1 << 1));
+	vSend(3);
+	CHECK_EQ(ucNotifiedTo(a), 1);
+	CHECK_EQ(ucNotifiedTo(b), 1);
+
+	// the phone subscribes HISTORY too and drops it again, DATA stays on
+	vCpu2HostSubscribe(a, history, 1);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HISTORY), 1 << 0);
+	vCpu2HostSubscribe(a, history, 0);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_HISTORY), 0);
+	vSend(4);
+	CHECK_EQ(ucNotifiedTo(a), 1);
+	CHECK_EQ(ucNotifiedTo(b), 1);
+
+	// the phone unsubscribes, the gateway goes on alone
+	vCpu2HostSubscribe(a, data, 0);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 1 << 1);
+	vSend(5);
+	CHECK_EQ(ucNotifiedTo(a), 0);
+	CHECK_EQ(ucNotifiedTo(b), 1);
+	releases = uiNotifyReleases();
+	vBleHostRun(1000);
+	CHECK(uiNotifyReleases() > releases);
+
+	// the last one unsubscribes, the task stops
+	vCpu2HostSubscribe(b, data, 0);
+	vBleHostRun(10);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 0);
+	vSend(6);
+	CHECK_EQ(ucNotifiedTo(a) + ucNotifiedTo(b), 0);
+	releases = uiNotifyReleases();
+	vBleHostRun(1000);
+	CHECK_EQ(uiNotifyReleases(), releases);
+}
+
+// a subscribed link that disconnects takes its subscriptions along
+static void test_disconnect_subscribed(void) {
+	uint16_t a, b, data;
+	uint32_t releases;
+
+	vConnectBoth(&a, &b);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(a, data, 1);
+	vCpu2HostSubscribe(b, data, 1);
+	vBleHostRun(10);
+
+	vCpu2HostDisconnect(a, 0x08);
+	vBleHostRun(100);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 1 << 1);
+	vSend(7);
+	CHECK_EQ(ucNotifiedTo(b), 1);
+	CHECK_EQ(usCpu2HostNotifications(), 1);
+
+	vCpu2HostDisconnect(b, 0x13);
+	vBleHostRun(100);
+	CHECK_EQ(SMART_WATCH_STM_Subscribers(SWITCH_DATA), 0);
+	releases = uiNotifyReleases();
+	vBleHostRun(1000);
+	CHECK_EQ(uiNotifyReleases(), releases);
+	// both slots free again, advertising for the next central
+	CHECK(ucCpu2HostAdvertising());
+}
+
+int main(void) {
+	UNIT_RUN(test_link_params);
+	UNIT_RUN(test_subscriptions);
+	UNIT_RUN(test_disconnect_subscribed);
+	return UNIT_END();
+}
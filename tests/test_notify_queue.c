@@ -0,0 +1,249 @@
+/*
+ * test_notify_queue.c
+ *
+ * Back-pressure of notify_queue.c. A mock ACI refuses N out of every M
+ * updates for lack of TX buffers and the pool event resumes the queue: a
+ * producer that only pushes into free slots has to get every value out
+ * exactly once and in order, with one stall per refusal. A full queue drops
+ * and counts, another refusal fails the value without blocking the rest, and
+ * dropping the values of one characteristic keeps the others in order.
+ * The last test runs the same through the smart watch service, the async
+ * update path and the host CPU2 refusing N of M notifying updates.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "notify_queue.h"
+#include "smart_watch_stm.h"
+#include "scheduler.h"
+
+#include <string.h>
+
+#define VALUES 200
+#define VALUE_LEN 20
+
+static uint8_t ucRefuseN, ucRefuseM;
+static uint32_t uiCalls;
+static uint8_t ucFailNext;
+static uint16_t ausSent[VALUES];
+static uint16_t usSent;
+
+// local function prototypes
+static uint8_t ucMockSend(uint16_t usChar, uint8_t *pData, uint16_t usLength);
+static void vMockReset(uint8_t ucN, uint8_t ucM);
+static void vValue(uint8_t *pData, uint16_t usIndex);
+
+//local functions
+// the first N of every M calls find the TX pool empty
+static uint8_t ucMockSend(uint16_t usChar, uint8_t *pData, uint16_t usLength) {
+	(void) usChar;
+	CHECK_EQ(usLength, VALUE_LEN);
+	if (ucRefuseM && (uiCalls++ % ucRefuseM) < ucRefuseN)
+		return BLE_STATUS_INSUFFICIENT_RESOURCES;
+	if (ucFailNext) {
+		ucFailNext = 0;
+		return BLE_STATUS_INVALID_PARAMS;
+	}
+	if (usSent < VALUES)
+		ausSent[usSent++] = (uint16_t) (pData[0] | (pData[1] << 8));
+	return BLE_STATUS_SUCCESS;
+}
+
+static void vMockReset(uint8_t ucN, uint8_t ucM) {
+	ucRefuseN = ucN;
+	ucRefuseM = ucM;
+	uiCalls = 0;
+	ucFailNext = 0;
+	usSent = 0;
+	vNotifyQueueInit(ucMockSend);
+}
+
+// index in the first two bytes, a pattern of it in the rest
+static void vValue(uint8_t *pData, uint16_t usIndex) {
+	uint16_t i;
+
+	pData[0] = (uint8_t) usIndex;
+	pData[1] = (uint8_t) (usIndex >> 8);
+	for (i = 2; i < VALUE_LEN; i++)
+		pData[i] = (uint8_t) (usIndex * 3 + i);
+}
+
+// lossless up to the link: every value once, in order, one stall per refusal
+static void test_refuse_n_of_m(void) {
+	static const uint8_t aNM[][2] = { { 0, 1 }, { 1, 2 }, { 1, 5 }, { 2, 3 }, { 3, 4 }, { 7, 8 } };
+	NotifyQueueStats stats;
+	uint8_t value[VALUE_LEN];
+	uint16_t pushed, i;
+	uint8_t k;
+
+	for (k = 0; k < sizeof(aNM) / sizeof(aNM[0]); k++) {
+		vMockReset(aNM[k][0], aNM[k][1]);
+		pushed = 0;
+		while (usSent < VALUES) {
+			while (pushed < VALUES && ucNotifyQueueFree()) {
+				vValue(value, pushed++);
+				CHECK(ucNotifyQueuePush(1, value, VALUE_LEN));
+			}
+			vNotifyQueueDrain();
+			if (ucNotifyQueueStalled())
+				vNotifyQueueResume(1);
+		}
+		for (i = 0; i < VALUES; i++)
+			CHECK_EQ(ausSent[i], i);
+		vNotifyQueueGetStats(&stats);
+		CHECK_EQ(stats.uiQueued, VALUES);
+		CHECK_EQ(stats.uiSent, VALUES);
+		CHECK_EQ(stats.uiDropped, 0);
+		CHECK_EQ(stats.uiFailed, 0);
+		CHECK_EQ(stats.uiStalls, uiCalls - VALUES);
+		CHECK_EQ(stats.ucDepth, 0);
+		CHECK(stats.ucHighWater <= NOTIFY_QUEUE_SLOTS);
+		printf("refuse %u of %u: %u sends for %u values, %u stalls, high water %u\n",
+				aNM[k][0], aNM[k][1], (unsigned) uiCalls, VALUES,
+				(unsigned) stats.uiStalls, stats.ucHighWater);
+	}
+}
+
+// a stalled queue fills, what does not fit is dropped and counted
+static void test_full(void) {
+	NotifyQueueStats stats;
+	uint8_t value[VALUE_LEN];
+	uint16_t i;
+
+	vMockReset(1, 1);
+	for (i = 0; i < NOTIFY_QUEUE_SLOTS + 2; i++) {
+		vValue(value, i);
+		CHECK_EQ(ucNotifyQueuePush(1, value, VALUE_LEN), i < NOTIFY_QUEUE_SLOTS);
+		vNotifyQueueDrain();
+	}
+	CHECK(ucNotifyQueueStalled());
+	// stalled, no more sends until the pool event
+	CHECK_EQ(uiCalls, 1);
+	vNotifyQueueGetStats(&stats);
+	CHECK_EQ(stats.uiDropped, 2);
+	CHECK_EQ(stats.ucDepth, NOTIFY_QUEUE_SLOTS);
+	CHECK_EQ(stats.ucHighWater, NOTIFY_QUEUE_SLOTS);
+
+	ucRefuseM = 0;
+	vNotifyQueueResume(5);
+	vNotifyQueueDrain();
+	CHECK_EQ(usSent, NOTIFY_QUEUE_SLOTS);
+	for (i = 0; i < NOTIFY_QUEUE_SLOTS; i++)
+		CHECK_EQ(ausSent[i], i);
+	vNotifyQueueGetStats(&stats);
+	CHECK_EQ(stats.usPoolBuffers, 5);
+	CHECK_EQ(stats.uiStalls, 1);
+	CHECK_EQ(stats.ucDepth, 0);
+}
+
+// any other refusal drops that value, the next ones still go
+static void test_failed(void) {
+	NotifyQueueStats stats;
+	uint8_t value[VALUE_LEN];
+	uint16_t i;
+
+	vMockReset(0, 0);
+	for (i = 0; i < 3; i++) {
+		vValue(value, i);
+		ucNotifyQueuePush(1, value, VALUE_LEN);
+	}
+	ucFailNext = 1;
+	vNotifyQueueDrain();
+	CHECK_EQ(usSent, 2);
+	CHECK_EQ(ausSent[0], 1);
+	CHECK_EQ(ausSent[1], 2);
+	vNotifyQueueGetStats(&stats);
+	CHECK_EQ(stats.uiFailed, 1);
+	CHECK_EQ(stats.uiSent, 2);
+	CHECK(!ucNotifyQueueStalled());
+}
+
+// flushing one characteristic leaves the others queued in order
+static void test_flush_char(void) {
+	uint8_t value[VALUE_LEN];
+	uint16_t i;
+
+	vMockReset(1, 1);
+	for (i = 0; i < NOTIFY_QUEUE_SLOTS; i++) {
+		vValue(value, i);
+		CHECK(ucNotifyQueuePush(1 + i % 2, value, VALUE_LEN));
+		vNotifyQueueDrain();
+	}
+	CHECK(ucNotifyQueueStalled());
+	// the stalled head is not one of them, it stays stalled
+	CHECK_EQ(ucNotifyQueueFlushChar(2), 0);
+	CHECK(ucNotifyQueueStalled());
+	CHECK_EQ(ucNotifyQueueFree(), NOTIFY_QUEUE_SLOTS - 2);
+	for (i = NOTIFY_QUEUE_SLOTS; i < NOTIFY_QUEUE_SLOTS + 2; i++) {
+		vValue(value, i);
+		CHECK(ucNotifyQueuePush(1 + i % 2, value, VALUE_LEN));
+	}
+	// the head goes with them, the rest is sent without waiting for the pool
+	CHECK_EQ(ucNotifyQueueFlushChar(1), 1);
+	CHECK(!ucNotifyQueueStalled());
+	ucRefuseM = 0;
+	vNotifyQueueDrain();
+	CHECK_EQ(usSent, 1);
+	CHECK_EQ(ausSent[0], NOTIFY_QUEUE_SLOTS + 1);
+	CHECK_EQ(ucNotifyQueueFree(), NOTIFY_QUEUE_SLOTS);
+}
+
+// the service path: async updates, CPU2 refusing 2 of 5, its pool event
+static void test_stack(void) {
+	static const Cpu2HostCentral central = { 247, 251, 1, 24, -60 };
+	const Cpu2HostNotify *notify;
+	NotifyQueueStats stats;
+	Cpu2HostStats cpu2;
+	uint8_t value[VALUE_LEN];
+	uint16_t conn, data, pushed = 0, i;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&central);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	vCpu2HostSetLatency(200);
+	vCpu2HostRefuse(2, 5, 3000);
+	vNotifyQueueGetStats(&stats);
+	CHECK_EQ(stats.uiQueued, 0);
+
+	while (usCpu2HostNotifications() < VALUES && ulHostUs() < 60000000ULL) {
+		while (pushed < VALUES && ucNotifyQueueFree()) {
+			vValue(value, pushed++);
+			CHECK(ucNotifyQueuePush(SWITCH_DATA, value, VALUE_LEN));
+		}
+		SCH_SetTask(1 << CFG_MY_TASK_NOTIFY_DATA, CFG_SCH_PRIO_0);
+		vBleHostRun(1);
+	}
+	CHECK_EQ(usCpu2HostNotifications(), VALUES);
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		notify = pCpu2HostNotification(i);
+		vValue(value, i);
+		CHECK_EQ(notify->usLen, VALUE_LEN);
+		CHECK(memcmp(notify->aData, value, VALUE_LEN) == 0);
+	}
+	vNotifyQueueGetStats(&stats);
+	vCpu2HostGetStats(&cpu2);
+	CHECK_EQ(stats.uiSent, VALUES);
+	CHECK_EQ(stats.uiDropped, 0);
+	CHECK_EQ(stats.uiFailed, 0);
+	CHECK(cpu2.uiRefused > 0);
+	CHECK_EQ(stats.uiStalls, cpu2.uiRefused);
+	printf("stack refusing 2 of 5: %u values in %u ms, %u stalls, high water %u\n",
+			VALUES, (unsigned) (pCpu2HostNotification(VALUES - 1)->ulUs / 1000
+			- pCpu2HostNotification(0)->ulUs / 1000), (unsigned) stats.uiStalls,
+			stats.ucHighWater);
+}
+
+int main(void) {
+	UNIT_RUN(test_refuse_n_of_m);
+	UNIT_RUN(test_full);
+	UNIT_RUN(test_failed);
+	UNIT_RUN(test_flush_char);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
@@ -0,0 +1,380 @@
+/*
+ * test_notify_sched.c
+ *
+ * notify_sched.c over notify_queue.c on a virtual clock, with a mock sender
+ * that takes SEND_MS per value, one at a time as the asynchronous update
+ * does, every REFUSE_EVERY-th one refused for lack of TX buffers with the
+ * pool event POOL_MS later. A waveform producer that always has a frame keeps
+ * the queue at its bulk limit, a summary falls due every period and alarms
+ * are raised, one into a free slot and one into a queue that a stall let
+ * fill up. Every frame taken from a producer has to reach the sender exactly
+ * once and in order, an alarm has to be the first value sent after it was
+ * raised but the head the stack refused, a summary has to go out within a
+ * stall and one queue of sends, and two runs have to give the same sends at
+ * the same times. Through the stack the HR characteristic alarms on a heart
+ * rate above MAX_BPM_THRESHOLD while the PPG waveform streams on DATA behind
+ * a CPU2 that runs out of TX buffers.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "main.h"
+#include "notify_queue.h"
+#include "notify_sched.h"
+#include "max30102.h"
+#include "max30102_emu.h"
+#include "ppg_stream.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+#define CHAR_BULK 1
+#define CHAR_SUMMARY 2
+#define TICK_MS 10
+#define REFUSE_EVERY 8
+#define POOL_MS 30
+#define SUMMARY_PERIOD_MS 100
+#define RUN_MS 3000
+#define TRACE_MAX 4096
+#define HR_NORMAL 70
+#define HR_HIGH 150
+// value: sequence, ms produced, heart rate
+#define VALUE_LEN 7
+// OFFSET_HR of smart_watch_app.c, big endian
+#define HR_VALUE_OFFSET 0
+// one sample every 20 ms at PPG_STREAM_RATE_HZ
+#define SAMPLE_MS (1000 / PPG_STREAM_RATE_HZ)
+// NOTIFY_TICK_PERIOD of smart_watch_app.c
+#define NOTIFY_TICK_MS 100
+
+typedef struct {
+	uint32_t uiMs;
+	uint16_t usChar;
+	uint16_t usSeq;
+	uint32_t uiProduced;
+	uint8_t ucHR;
+} Send;
+
+static Send aTrace[TRACE_MAX];
+static Send aFirst[TRACE_MAX];
+static uint16_t usSends;
+static uint32_t uiNow;
+static uint32_t uiSendMs;
+static uint32_t uiDoneAt;
+static uint32_t uiPoolAt;
+static uint32_t uiCompleted;
+static uint8_t ucInFlight;
+static uint8_t ucPool;
+static uint16_t usBulkSeq, usSummarySeq;
+static uint8_t ucHR;
+
+// local function prototypes
+static uint8_t ucMockSend(uint16_t usChar, uint8_t *pData, uint16_t usLength);
+static uint16_t usValue(uint8_t *pValue, uint16_t usSeq);
+static uint16_t usProduceBulk(uint8_t *pValue, uint16_t usMax);
+static uint16_t usProduceSummary(uint8_t *pValue, uint16_t usMax);
+static void vModelReset(uint32_t uiSend);
+static void vModelMs(void);
+static void vModelEnd(void);
+static uint32_t uiAlarm(uint8_t ucFull);
+static void vAlarmSent(uint32_t uiRaised, uint32_t *pLatency, uint16_t *pBefore);
+static uint32_t uiHrValue(const uint8_t *pData);
+
+//local functions
+// takes the value, its status comes uiSendMs later as from the async update
+static uint8_t ucMockSend(uint16_t usChar, uint8_t *pData, uint16_t usLength) {
+	Send *s = &aTrace[usSends < TRACE_MAX ? usSends++ : TRACE_MAX - 1];
+
+	CHECK_EQ(usLength, VALUE_LEN);
+	CHECK(!ucInFlight);
+	s->uiMs = uiNow;
+	s->usChar = usChar;
+	s->usSeq = (uint16_t) (pData[0] | (pData[1] << 8));
+	s->uiProduced = (uint32_t) pData[2] | ((uint32_t) pData[3] << 8)
+			| ((uint32_t) pData[4] << 16) | ((uint32_t) pData[5] << 24);
+	s->ucHR = pData[6];
+	ucInFlight = 1;
+	uiDoneAt = uiNow + uiSendMs;
+	return BLE_STATUS_PENDING;
+}
+
+static uint16_t usValue(uint8_t *pValue, uint16_t usSeq) {
+	pValue[0] = (uint8_t) usSeq;
+	pValue[1] = (uint8_t) (usSeq >> 8);
+	pValue[2] = (uint8_t) uiNow;
+	pValue[3] = (uint8_t) (uiNow >> 8);
+	pValue[4] = (uint8_t) (uiNow >> 16);
+	pValue[5] = (uint8_t) (uiNow >> 24);
+	pValue[6] = ucHR;
+	return VALUE_LEN;
+}
+
+// a waveform that never runs dry
+static uint16_t usProduceBulk(uint8_t *pValue, uint16_t usMax) {
+	CHECK(usMax >= VALUE_LEN);
+	return usValue(pValue, usBulkSeq++);
+}
+
+// the summary and the alarm of the same characteristic, as SWITCH_HR
+static uint16_t usProduceSummary(uint8_t *pValue, uint16_t usMax) {
+	CHECK(usMax >= VALUE_LEN);
+	return usValue(pValue, usSummarySeq++);
+}
+
+static void vModelReset(uint32_t uiSend) {
+	usSends = 0;
+	uiNow = 0;
+	uiSendMs = uiSend;
+	ucInFlight = 0;
+	ucPool = 0;
+	uiCompleted = 0;
+	usBulkSeq = 0;
+	usSummarySeq = 0;
+	ucHR = HR_NORMAL;
+	vNotifyQueueInit(ucMockSend);
+	vNotifySchedInit();
+	ucNotifySchedRegister(CHAR_BULK, 0, NOTIFY_SCHED_BULK, usProduceBulk);
+	ucNotifySchedRegister(CHAR_SUMMARY, SUMMARY_PERIOD_MS, NOTIFY_SCHED_SUMMARY, usProduceSummary);
+	vNotifySchedEnable(CHAR_BULK, 1, 0);
+	vNotifySchedEnable(CHAR_SUMMARY, 1, 0);
+	vNotifySchedRaise(CHAR_BULK, 0);
+}
+
+// one ms: the completion or pool event due, then the task as the tick or the event runs it
+static void vModelMs(void) {
+	uint8_t run = (uiNow % TICK_MS) == 0;
+
+	if (ucInFlight && uiNow >= uiDoneAt) {
+		ucInFlight = 0;
+		run = 1;
+		if (++uiCompleted % REFUSE_EVERY == 0) {
+			// not taken, the same value comes again after the pool event
+			usSends--;
+			ucPool = 1;
+			uiPoolAt = uiNow + POOL_MS;
+			vNotifyQueueSent(BLE_STATUS_INSUFFICIENT_RESOURCES);
+		} else {
+			vNotifyQueueSent(BLE_STATUS_SUCCESS);
+		}
+	}
+	if (ucPool && uiNow >= uiPoolAt) {
+		ucPool = 0;
+		run = 1;
+		vNotifyQueueResume(1);
+	}
+	if (run) {
+		vNotifySchedRun(uiNow);
+		vNotifyQueueDrain();
+	}
+	uiNow++;
+}
+
+// producers off, runs until the queue is empty
+static void vModelEnd(void) {
+	vNotifySchedEnable(CHAR_BULK, 0, uiNow);
+	vNotifySchedEnable(CHAR_SUMMARY, 0, uiNow);
+	while (ucNotifyQueueFree() != NOTIFY_QUEUE_SLOTS && uiNow < 2 * RUN_MS)
+		vModelMs();
+}
+
+// runs to the next point where the queue is sending with room, or is full, and raises there
+static uint32_t uiAlarm(uint8_t ucFull) {
+	while (uiNow < RUN_MS && (ucFull ? ucNotifyQueueFree() != 0
+			: ucNotifyQueueFree() == 0 || ucNotifyQueueStalled()))
+		vModelMs();
+	CHECK(uiNow < RUN_MS);
+	ucHR = HR_HIGH;
+	vNotifySchedAlarm(CHAR_SUMMARY, uiNow);
+	vNotifySchedRun(uiNow);
+	vNotifyQueueDrain();
+	return uiNow;
+}
+
+// latency of the first HR_HIGH value sent, and how many other values went ahead of it
+static void vAlarmSent(uint32_t uiRaised, uint32_t *pLatency, uint16_t *pBefore) {
+	uint16_t i;
+
+	*pBefore = 0;
+	*pLatency = 0xFFFFFFFFUL;
+	for (i = 0; i < usSends; i++) {
+		if (aTrace[i].uiMs < uiRaised)
+			continue;
+		if (aTrace[i].ucHR == HR_HIGH) {
+			*pLatency = aTrace[i].uiMs - uiRaised;
+			return;
+		}
+		(*pBefore)++;
+	}
+}
+
+static uint32_t uiHrValue(const uint8_t *pData) {
+	return ((uint32_t) pData[HR_VALUE_OFFSET] << 24) | ((uint32_t) pData[HR_VALUE_OFFSET + 1] << 16)
+			| ((uint32_t) pData[HR_VALUE_OFFSET + 2] << 8) | pData[HR_VALUE_OFFSET + 3];
+}
+
+// waveform, summaries and two alarms, bounds against the send and stall times
+static void test_overload(void) {
+	static const uint32_t auiSendMs[] = { 2, 5, 20 };
+	NotifyQueueStats stats;
+	uint32_t raised, latency, latencyFull, summaryMax, gapMax, lastSummary;
+	uint16_t before, beforeFull, bulk, summaries, i;
+	uint8_t k;
+
+	for (k = 0; k < sizeof(auiSendMs) / sizeof(auiSendMs[0]); k++) {
+		vModelReset(auiSendMs[k]);
+		while (uiNow < RUN_MS / 3)
+			vModelMs();
+
+		// a slot free behind the value in flight
+		raised = uiAlarm(0);
+		while (uiNow < raised + SUMMARY_PERIOD_MS)
+			vModelMs();
+		vAlarmSent(raised, &latency, &before);
+		ucHR = HR_NORMAL;
+		while (uiNow < 2 * RUN_MS / 3)
+			vModelMs();
+
+		// every slot taken in a stall, the alarm waits for the first one to free
+		raised = uiAlarm(1);
+		vNotifyQueueGetStats(&stats);
+		CHECK_EQ(stats.ucDepth, NOTIFY_QUEUE_SLOTS);
+		while (uiNow < RUN_MS)
+			vModelMs();
+		vAlarmSent(raised, &latencyFull, &beforeFull);
+		vModelEnd();
+
+		CHECK_EQ(before, 0);
+		CHECK(latency <= auiSendMs[k]);
+		// the refused head goes again first
+		CHECK(beforeFull <= 1);
+		CHECK(latencyFull <= POOL_MS + auiSendMs[k]);
+
+		// every frame taken from the producer sent once, in order
+		bulk = summaries = 0;
+		summaryMax = gapMax = lastSummary = 0;
+		for (i = 0; i < usSends; i++) {
+			if (aTrace[i].usChar == CHAR_BULK) {
+				CHECK_EQ(aTrace[i].usSeq, bulk);
+				bulk++;
+				continue;
+			}
+			if (aTrace[i].uiMs - aTrace[i].uiProduced > summaryMax)
+				summaryMax = aTrace[i].uiMs - aTrace[i].uiProduced;
+			if (summaries && aTrace[i].uiMs - lastSummary > gapMax)
+				gapMax = aTrace[i].uiMs - lastSummary;
+			lastSummary = aTrace[i].uiMs;
+			summaries++;
+		}
+		vNotifyQueueGetStats(&stats);
+		CHECK_EQ(stats.uiDropped, 0);
+		CHECK_EQ(stats.uiFailed, 0);
+		CHECK_EQ(stats.ucDepth, 0);
+		CHECK_EQ(usBulkSeq, bulk);
+		CHECK(usSends < TRACE_MAX);
+		// a stall, then behind at most the other slots
+		CHECK(summaryMax <= POOL_MS + NOTIFY_QUEUE_SLOTS * auiSendMs[k]);
+		CHECK(gapMax <= SUMMARY_PERIOD_MS + POOL_MS + NOTIFY_QUEUE_SLOTS * auiSendMs[k]);
+		printf("send %2u ms: %4u frames, %2u summaries %3u ms late at most, alarm %2u ms, into a full queue %2u ms\n",
+				(unsigned) auiSendMs[k], bulk, summaries, (unsigned) summaryMax,
+				(unsigned) latency, (unsigned) latencyFull);
+	}
+}
+
+// the same inputs give the same sends at the same times
+static void test_repeatable(void) {
+	uint16_t first;
+
+	vModelReset(5);
+	while (uiNow < RUN_MS / 2)
+		vModelMs();
+	uiAlarm(1);
+	while (uiNow < RUN_MS)
+		vModelMs();
+	vModelEnd();
+	first = usSends;
+	memcpy(aFirst, aTrace, sizeof(aFirst));
+
+	vModelReset(5);
+	while (uiNow < RUN_MS / 2)
+		vModelMs();
+	uiAlarm(1);
+	while (uiNow < RUN_MS)
+		vModelMs();
+	vModelEnd();
+	CHECK_EQ(usSends, first);
+	CHECK(memcmp(aFirst, aTrace, first * sizeof(Send)) == 0);
+}
+
+// HR above the threshold during the PPG stream, CPU2 refusing 1 of 3 updates
+static void test_stack(void) {
+	static const Cpu2HostCentral central = { 247, 251, 1, 24, -60 };
+	const Cpu2HostNotify *notify;
+	NotifyQueueStats stats;
+	PpgStreamStats stream;
+	uint32_t ms, crossed = 0, alarmed = 0, sample = 0, period;
+	uint16_t conn, data, hr, i, frames = 0, gaps = 0, seq = 0;
+
+	vBleHostInit();
+	vMax30102EmuInit();
+	conn = usBleHostConnect(&central);
+	data = usBleHostChar(BLE_HOST_DATA);
+	hr = usBleHostChar(BLE_HOST_HR);
+	CHECK(hr != 0);
+	vCpu2HostSubscribe(conn, data, 1);
+	vCpu2HostSubscribe(conn, hr, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	vCpu2HostSetLatency(300);
+	vCpu2HostRefuse(1, 3, 20000);
+
+	// a beat every 40 samples, 75 bpm, then every 20, 150 bpm
+	for (ms = 0; ms < 20000; ms += SAMPLE_MS) {
+		period = ms < 12000 ? 40 : 20;
+		vMax30102EmuPush(90000 + (sample % period) * 100, 100000 + (sample % period) * 200);
+		sample++;
+		vMax30102ReadData();
+		if (ms > 10000 && ms < 12000)
+			CHECK(ucGetMax30102HR() <= MAX_BPM_THRESHOLD);
+		if (ms >= 12000 && !crossed && ucGetMax30102HR() > MAX_BPM_THRESHOLD)
+			crossed = (uint32_t) (ulHostUs() / 1000);
+		vBleHostRun(SAMPLE_MS);
+	}
+	CHECK(crossed != 0);
+
+	for (i = 0; i < usCpu2HostNotifications(); i++) {
+		notify = pCpu2HostNotification(i);
+		if (notify->usHandle == hr) {
+			if (!alarmed && crossed && notify->ulUs / 1000 >= crossed
+					&& uiHrValue(notify->aData) > MAX_BPM_THRESHOLD)
+				alarmed = (uint32_t) (notify->ulUs / 1000);
+			continue;
+		}
+		if (notify->usHandle != data)
+			continue;
+		if (frames && (uint16_t) ((notify->aData[0] << 8) | notify->aData[1]) != (uint16_t) (seq + 1))
+			gaps++;
+		seq = (uint16_t) ((notify->aData[0] << 8) | notify->aData[1]);
+		frames++;
+	}
+	vNotifyQueueGetStats(&stats);
+	vPpgStreamGetStats(&stream);
+	CHECK(alarmed >= crossed);
+	// the next notification tick, a refused update and its pool event
+	CHECK(alarmed - crossed <= NOTIFY_TICK_MS + 20 + 10);
+	CHECK(frames > 0);
+	CHECK_EQ(stats.uiDropped, 0);
+	CHECK_EQ(gaps, stream.uiDropped);
+	printf("HR above %u bpm at %u ms, notified at %u ms, %u PPG frames, %u lost in the stream\n",
+			MAX_BPM_THRESHOLD, (unsigned) crossed, (unsigned) alarmed, frames,
+			(unsigned) stream.uiDropped);
+}
+
+int main(void) {
+	UNIT_RUN(test_overload);
+	UNIT_RUN(test_repeatable);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
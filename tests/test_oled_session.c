@@ -0,0 +1,120 @@
+/*
+ * test_oled_session.c
+ *
+ * A scripted 60 s watch session through vOledScreenProcess() at the display
+ * task period: the MAX30102 screen before a central picks one, the BLE data
+ * screen, shut down and back. Widget redraws, screen changes and I2C bytes
+ * are counted per phase.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ssd1306_emu.h"
+#include "ssd1306.h"
+#include "oled.h"
+#include "oled_widget.h"
+
+#define SESSION_PERIOD_MS 50 // DISPLAY_PERIOD in main.c
+#define SESSION_STATUS_BOOT 7 // ucOledStatusFlag before a central writes it
+
+typedef struct {
+	const char *pName;
+	uint32_t uiEndMs;
+	uint8_t ucStatus;
+	uint8_t ucWave;          // PPG diff changes every period
+} Phase;
+
+typedef struct {
+	uint32_t uiRedraws;
+	uint32_t uiBytes;
+	uint32_t uiEnters;
+} PhaseCount;
+
+static const Phase aPhases[] = {
+	{ "boot, max30102", 10000, SESSION_STATUS_BOOT, 0 },
+	{ "max30102 + wave", 20000, OLED_STATUS_MAX30102, 1 },
+	{ "ble data", 30000, OLED_STATUS_BLE, 0 },
+	{ "shut down", 35000, OLED_STATUS_SHUT_DOWN, 0 },
+	{ "default", 45000, OLED_STATUS_DEF, 0 },
+	{ "max30102 steady", 60000, OLED_STATUS_MAX30102, 0 },
+};
+
+#define SESSION_PHASES (sizeof(aPhases) / sizeof(aPhases[0]))
+
+// local function prototypes
+static uint8_t ucSessionHR(uint32_t ms, const Phase *phase);
+
+//local functions
+// a new reading once a second, steady in the last phase
+static uint8_t ucSessionHR(uint32_t ms, const Phase *phase) {
+	if (phase == &aPhases[SESSION_PHASES - 1])
+		return 64;
+	return 60 + (ms / 1000) % 8;
+}
+
+static void test_session(void) {
+	PhaseCount count[SESSION_PHASES] = { { 0 } };
+	Ssd1306EmuStats stats;
+	OledScreen *last = NULL;
+	uint32_t ms, redraws;
+	uint16_t diff = 40;
+	uint8_t p = 0;
+
+	vHostReset();
+	vSsd1306EmuInit();
+	SSD1306_Init();
+	vOledBleClearScreen();
+	vSsd1306EmuStatsReset();
+
+	for (ms = 0; ms < 60000; ms += SESSION_PERIOD_MS) {
+		if (ms >= aPhases[p].uiEndMs)
+			p++;
+		if (aPhases[p].ucWave)
+			diff = 20 + (ms / SESSION_PERIOD_MS) * 7 % 80;
+		redraws = uiOledScreenRedraws();
+		vSsd1306EmuStatsReset();
+		vOledScreenProcess(aPhases[p].ucStatus, ucSessionHR(ms, &aPhases[p]),
+				97, diff);
+		vSsd1306EmuStats(&stats);
+		count[p].uiRedraws += uiOledScreenRedraws() - redraws;
+		count[p].uiBytes += stats.uiBytes;
+		CHECK_EQ(stats.uiViolations, 0);
+		if (pOledScreenCurrent() != last)
+			count[p].uiEnters++;
+		last = pOledScreenCurrent();
+		vHostAdvance(SESSION_PERIOD_MS);
+	}
+
+	printf("%-18s %8s %8s %8s\n", "phase", "redraws", "bytes", "screens");
+	for (p = 0; p < SESSION_PHASES; p++)
+		printf("%-18s %8u %8u %8u\n", aPhases[p].pName,
+				(unsigned) count[p].uiRedraws, (unsigned) count[p].uiBytes,
+				(unsigned) count[p].uiEnters);
+
+	// one screen per phase, entered once, never flipping per tick
+	CHECK_EQ(count[0].uiEnters, 1);
+	CHECK_EQ(count[1].uiEnters, 0);
+	CHECK_EQ(count[2].uiEnters, 1);
+	CHECK_EQ(count[3].uiEnters, 1);
+	CHECK_EQ(count[4].uiEnters, 1);
+	CHECK_EQ(count[5].uiEnters, 0);
+
+	// entering draws 11 widgets, then the blank band fills with the flat
+	// trace and the HR digits change once a second
+	CHECK(count[0].uiRedraws <= 11 + SSD1306_WIDTH + 10 * 2);
+	// the waveform moves every period
+	CHECK(count[1].uiRedraws >= 200);
+	// BLE stars step every OLED_COUNTER_TIME_OUT periods, 200 periods
+	CHECK(count[2].uiRedraws <= 3 + 200 / OLED_COUNTER_TIME_OUT);
+	// shut down is one cleared frame
+	CHECK_EQ(count[3].uiRedraws, 0);
+	CHECK(count[3].uiBytes > 1024 && count[3].uiBytes < 2 * 1024);
+	// unchanged values cost nothing, no drawing and no bus traffic
+	CHECK_EQ(count[5].uiRedraws, 0);
+	CHECK_EQ(count[5].uiBytes, 0);
+}
+
+int main(void) {
+	UNIT_RUN(test_session);
+	return UNIT_END();
+}
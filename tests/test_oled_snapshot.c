@@ -0,0 +1,150 @@
+/*
+ * test_oled_snapshot.c
+ *
+ * The vOled* page drawing and the hal_lcd screens through the shared
+ * framebuffer, compared with tests/golden/snapshot_*.pbm. Those images were
+ * taken from the build that still had three display stacks (oled_cache with
+ * its own flush, the 32 line SSD1306_Buffer, the oled_logo copy), so a match
+ * means the panel shows what it showed before.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ssd1306_emu.h"
+#include "ssd1306.h"
+#include "oled.h"
+#include "hal_lcd.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+typedef struct {
+	const char *pName;
+	void (*pfDraw)(void);
+} Scene;
+
+// local function prototypes
+static void vScenePanel(void);
+
+//local functions
+static void vScenePanel(void) {
+	vHostReset();
+	vSsd1306EmuInit();
+	vOledInit();
+}
+
+// the chart runs first, its column is global state
+static void vSceneChart(void) {
+	uint8_t i;
+
+	vOledClear();
+	for (i = 0; i < 140; i++)
+		vOledDrawChart(60.0f * sinf(i * 0.2f) + 20.0f);
+	vWriteToScreen(&hi2c3);
+}
+
+static void vSceneMax30102(void) {
+	vOledClear();
+	vMax30102String();
+	vOledShowHeart(1);
+	vSetBPM();
+	vSetSPO2();
+	vSetPercentage();
+	vOledShowNum(0, 1);
+	vOledShowNum(1, 2);
+	vOledShowNum(2, 3);
+	vOledShowNum(3, 0);
+	vOledShowNum(4, 9);
+	vOledShowNum(5, 7);
+	vWriteToScreen(&hi2c3);
+}
+
+static void vSceneDigits(void) {
+	uint8_t i;
+
+	vOledClear();
+	for (i = 0; i < 6; i++)
+		vOledShowNum(i, i + 4);
+	vOledShowString(font8x8Hunter, 0, 0, (uint8_t*) "0123456789ABCDEF");
+	vOledShowString(font6x8, 0, 6, (uint8_t*) "abcdefghijklmnopqrstu");
+	vWriteToScreen(&hi2c3);
+}
+
+static void vSceneHeartOff(void) {
+	vOledClear();
+	vOledShowHeart(1);
+	vOledShowHeart(0);
+	vMax30003String();
+	vOledShowHR();
+	vOledShowRR();
+	vWriteToScreen(&hi2c3);
+}
+
+static void vSceneThread(void) {
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	LCD_PrintLabel("Thread");
+	LCD_THREAD_PrintPanId(0x1234);
+	LCD_THREAD_PrintRole("Leader");
+	LCD_THREAD_PrintRLOC(0xABCD);
+}
+
+static void vSceneBleConnected(void) {
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	LCD_BLE_PrintLogo();
+	LCD_BLE_PrintLocalName("LPulsefex");
+	LCD_BLE_PrintStatus("CONNECTED");
+}
+
+static void vSceneError(void) {
+	LCD_BLE_HTS_PrintTemperature(0);
+}
+
+static const Scene aScenes[] = {
+	{ "snapshot_chart", vSceneChart },
+	{ "snapshot_max30102", vSceneMax30102 },
+	{ "snapshot_digits", vSceneDigits },
+	{ "snapshot_heart_off", vSceneHeartOff },
+	{ "snapshot_thread", vSceneThread },
+	{ "snapshot_ble_connected", vSceneBleConnected },
+	{ "snapshot_error", vSceneError },
+};
+
+static void test_snapshots(void) {
+	char path[512];
+	int32_t diff;
+	uint8_t i;
+
+	for (i = 0; i < sizeof(aScenes) / sizeof(aScenes[0]); i++) {
+		vScenePanel();
+		aScenes[i].pfDraw();
+		snprintf(path, sizeof(path), "%s/%s.pbm", GOLDEN_DIR, aScenes[i].pName);
+		diff = iSsd1306EmuComparePbm(path);
+		if (diff != 0) {
+			printf("%s: %d pixels differ\n", aScenes[i].pName, (int) diff);
+			snprintf(path, sizeof(path), "%s.actual.pbm", aScenes[i].pName);
+			ucSsd1306EmuWritePbm(path);
+		}
+		CHECK_EQ(diff, 0);
+	}
+}
+
+// one buffer for every screen, sized from ssd1306_conf.h
+static void test_single_framebuffer(void) {
+	uint8_t *fb = SSD1306_GetBuffer();
+
+	CHECK_EQ(SSD1306_BUFFER_SIZE, SSD1306_WIDTH * SSD1306_HEIGHT / 8);
+	vScenePanel();
+	vSetBPM();
+	CHECK_EQ(fb[4 * SSD1306_WIDTH + 58], 0x3E);
+	SSD1306_DrawPixel(0, 63, SSD1306_COLOR_WHITE);
+	CHECK_EQ(fb[7 * SSD1306_WIDTH], 0x80);
+	vWriteToScreen(&hi2c3);
+	CHECK_EQ(ucSsd1306EmuRam(4, 58), 0x3E);
+	CHECK_EQ(ucSsd1306EmuPixel(0, 63), 1);
+}
+
+int main(void) {
+	UNIT_RUN(test_snapshots);
+	UNIT_RUN(test_single_framebuffer);
+	return UNIT_END();
+}
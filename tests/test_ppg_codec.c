@@ -0,0 +1,188 @@
+/*
+ * test_ppg_codec.c
+ *
+ * Block delta coder of ppg_codec.c: bodies decode bit exact for signals from
+ * flat to full scale swings, no block width goes past PPG_CODEC_WIDTH_MAX
+ * even for samples wider than 18 bits, which come back cut to their low 18.
+ * The benchmark codes synthetic PPG through ppg_stream.c at the frame sizes
+ * the links give and prints the ratio against raw 18 bit packing and the
+ * encode cost per sample pair, host ns where the target counts DWT cycles.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ppg_codec.h"
+#include "ppg_stream.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_PAIRS 64
+#define BENCH_SAMPLES 3000
+
+typedef enum {
+	SIGNAL_FLAT,
+	SIGNAL_PULSE,
+	SIGNAL_NOISY,
+	SIGNAL_SPIKES,
+	SIGNAL_FULL_SCALE,
+	SIGNAL_WIDE,
+	SIGNALS
+} Signal;
+
+static const char *apSignalName[SIGNALS] = {
+	"flat", "pulse", "pulse +-20 noise", "pulse + 2% spikes", "full scale", "32 bit",
+};
+static uint32_t auiRed[BENCH_SAMPLES];
+static uint32_t auiIred[BENCH_SAMPLES];
+
+// local function prototypes
+static void vSignal(Signal eSignal, uint16_t usCount);
+static uint16_t usEncode(uint8_t *pBody, uint16_t usPairs, uint8_t *pWidthMax);
+static void vBench(uint16_t usFrame, Signal eSignal, double *pRatio);
+
+//local functions
+static void vSignal(Signal eSignal, uint16_t usCount) {
+	uint16_t k;
+	float pulse;
+
+	srand(7);
+	for (k = 0; k < usCount; k++) {
+		pulse = sinf(k * 2 * 3.14159f * 1.2f / PPG_STREAM_RATE_HZ);
+		switch (eSignal) {
+		case SIGNAL_FLAT:
+			auiRed[k] = 110000;
+			auiIred[k] = 140000;
+			break;
+		case SIGNAL_PULSE:
+			auiRed[k] = (uint32_t) (110000 + 1800 * pulse);
+			auiIred[k] = (uint32_t) (140000 + 2600 * pulse);
+			break;
+		case SIGNAL_NOISY:
+		case SIGNAL_SPIKES:
+			auiRed[k] = (uint32_t) (110000 + 1800 * pulse + rand() % 41 - 20);
+			auiIred[k] = (uint32_t) (140000 + 2600 * pulse + rand() % 41 - 20);
+			if (eSignal == SIGNAL_SPIKES && rand() % 100 < 2) {
+				auiRed[k] = rand() & PPG_CODEC_SAMPLE_MASK;
+				auiIred[k] = rand() & PPG_CODEC_SAMPLE_MASK;
+			}
+			break;
+		case SIGNAL_FULL_SCALE:
+			auiRed[k] = (k & 1) ? PPG_CODEC_SAMPLE_MASK : 0;
+			auiIred[k] = (k & 1) ? 0 : PPG_CODEC_SAMPLE_MASK;
+			break;
+		default:
+			auiRed[k] = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+			auiIred[k] = (k & 1) ? 0xFFFFFFFFUL : 0;
+			break;
+		}
+	}
+}
+
+// base and blocks as ppg_stream.c lays them out, returns the body bits
+static uint16_t usEncode(uint8_t *pBody, uint16_t usPairs, uint8_t *pWidthMax) {
+	uint32_t prevRed = auiRed[0], prevIred = auiIred[0];
+	uint16_t bit, k;
+	uint8_t n, wRed, wIred;
+
+	*pWidthMax = 0;
+	bit = usPpgCodecPutBase(pBody, 0, auiRed[0], auiIred[0]);
+	for (k = 1; k < usPairs; k += n) {
+		n = usPairs - k < PPG_CODEC_BLOCK ? usPairs - k : PPG_CODEC_BLOCK;
+		usPpgCodecBlockBits(&auiRed[k], &auiIred[k], n, prevRed, prevIred, &wRed, &wIred);
+		if (wRed > *pWidthMax)
+			*pWidthMax = wRed;
+		if (wIred > *pWidthMax)
+			*pWidthMax = wIred;
+		bit = usPpgCodecPutBlock(pBody, bit, &auiRed[k], &auiIred[k], n, wRed, wIred,
+				&prevRed, &prevIred);
+	}
+	return bit;
+}
+
+// ratio of raw 18 bit pairs to the coded bodies, encode ns per pair
+static void vBench(uint16_t usFrame, Signal eSignal, double *pRatio) {
+	PpgStreamStats stats;
+	uint16_t k, len;
+
+	vHostReset();
+	vSignal(eSignal, BENCH_SAMPLES);
+	vPpgStreamStart(usFrame, NULL);
+	for (k = 0; k < BENCH_SAMPLES; k++) {
+		vHostAdvance(1000 / PPG_STREAM_RATE_HZ);
+		vPpgStreamPush(auiRed[k], auiIred[k]);
+		while (pPpgStreamPeek(&len) != NULL)
+			vPpgStreamRelease();
+	}
+	vPpgStreamGetStats(&stats);
+	vPpgStreamStop();
+	*pRatio = (double) stats.uiSamples * PPG_STREAM_PAIR_BITS / stats.uiBodyBits;
+	printf("%3u byte frames, %-18s %.2fx, encode %u ns per pair\n", usFrame,
+			apSignalName[eSignal], *pRatio,
+			(unsigned) (stats.uiEncodeCycles / stats.uiSamples));
+}
+
+// every signal decodes to what was coded, cut to 18 bits
+static void test_round_trip(void) {
+	static uint8_t body[(CODEC_PAIRS * (2 * PPG_CODEC_WIDTH_MAX + 2 * PPG_CODEC_SAMPLE_BITS)
+			+ PPG_CODEC_MIN_BITS * CODEC_PAIRS) / 8];
+	uint32_t red[CODEC_PAIRS], ired[CODEC_PAIRS];
+	uint16_t bits, k;
+	uint8_t widest;
+	Signal s;
+
+	for (s = SIGNAL_FLAT; s < SIGNALS; s++) {
+		vSignal(s, CODEC_PAIRS);
+		memset(body, 0, sizeof(body));
+		bits = usEncode(body, CODEC_PAIRS, &widest);
+		CHECK(widest <= PPG_CODEC_WIDTH_MAX);
+		CHECK_EQ(ucPpgCodecDecode(body, bits, CODEC_PAIRS, red, ired), CODEC_PAIRS);
+		for (k = 0; k < CODEC_PAIRS; k++) {
+			CHECK_EQ(red[k], auiRed[k] & PPG_CODEC_SAMPLE_MASK);
+			CHECK_EQ(ired[k], auiIred[k] & PPG_CODEC_SAMPLE_MASK);
+		}
+		if (s == SIGNAL_FLAT)
+			CHECK_EQ(widest, 0);
+	}
+}
+
+// a body cut short is refused, not read past its end
+static void test_truncated(void) {
+	static uint8_t body[CODEC_PAIRS * 8];
+	uint32_t red[CODEC_PAIRS], ired[CODEC_PAIRS];
+	uint16_t bits, cut;
+	uint8_t widest;
+
+	vSignal(SIGNAL_SPIKES, CODEC_PAIRS);
+	memset(body, 0, sizeof(body));
+	bits = usEncode(body, CODEC_PAIRS, &widest);
+	for (cut = 0; cut < bits; cut++)
+		CHECK_EQ(ucPpgCodecDecode(body, cut, CODEC_PAIRS, red, ired), 0);
+}
+
+// the frame sizes of a 512/251 link, a 64 byte MTU and the default MTU
+static void test_benchmark(void) {
+	static const uint16_t ausFrame[] = { PPG_STREAM_FRAME_MAX, 60, 20 };
+	double ratio;
+	uint8_t i;
+	Signal s;
+
+	for (i = 0; i < sizeof(ausFrame) / sizeof(ausFrame[0]); i++) {
+		for (s = SIGNAL_PULSE; s <= SIGNAL_SPIKES; s++) {
+			vBench(ausFrame[i], s, &ratio);
+			// a new base per frame, the 20 byte frames barely beat raw packing
+			CHECK(ratio > (ausFrame[i] > 20 ? 1.4 : 1.0));
+		}
+	}
+	// nothing to gain, the escapes and headers must not cost more than a little
+	vBench(PPG_STREAM_FRAME_MAX, SIGNAL_FULL_SCALE, &ratio);
+	CHECK(ratio > 0.8);
+}
+
+int main(void) {
+	UNIT_RUN(test_round_trip);
+	UNIT_RUN(test_truncated);
+	UNIT_RUN(test_benchmark);
+	return UNIT_END();
+}
@@ -0,0 +1,184 @@
+/*
+ * test_ppg_stream.c
+ *
+ * PPG frames from vPpgStreamPush() through ucPpgStreamDecode(): every sample
+ * comes back bit exact with the tick it was taken at, lost frames show as
+ * sequence gaps that match the drop count, and the encode and decode cost
+ * per sample on the host.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ppg_stream.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_SAMPLES 3000
+#define STREAM_PERIOD_MS (1000 / PPG_STREAM_RATE_HZ)
+#define STREAM_T0 STREAM_PERIOD_MS
+
+typedef struct {
+	uint32_t uiSamples;      // decoded samples that matched what was pushed
+	uint32_t uiErrors;       // decoded samples that did not
+	uint32_t uiFrames;
+	uint32_t uiGaps;         // frames missing by sequence number
+	uint32_t uiBytes;
+	int32_t iLastSeq;
+	uint8_t aucSeen[STREAM_SAMPLES];
+} Sink;
+
+static uint32_t auiRed[STREAM_SAMPLES];
+static uint32_t auiIred[STREAM_SAMPLES];
+
+// local function prototypes
+static void vStreamSignal(void);
+static void vSinkReset(Sink *sink);
+static void vSinkDrain(Sink *sink);
+static void vStreamRun(Sink *sink, uint16_t stallFrom, uint16_t stallTo);
+
+//local functions
+// a pulse wave around a finger's DC level with some sensor noise
+static void vStreamSignal(void) {
+	uint16_t k;
+
+	srand(1);
+	for (k = 0; k < STREAM_SAMPLES; k++) {
+		auiRed[k] = (uint32_t) (110000 + 1800 * sinf(k * 0.13f)
+				+ rand() % 64) & 0x3FFFF;
+		auiIred[k] = (uint32_t) (140000 + 2600 * sinf(k * 0.13f + 0.4f)
+				+ rand() % 64) & 0x3FFFF;
+	}
+}
+
+static void vSinkReset(Sink *sink) {
+	memset(sink, 0, sizeof(*sink));
+	sink->iLastSeq = -1;
+}
+
+// the central side: decode, place every sample by its tick, count gaps
+static void vSinkDrain(Sink *sink) {
+	PpgStreamHeader header;
+	uint32_t red[PPG_STREAM_COUNT_MASK], ired[PPG_STREAM_COUNT_MASK];
+	uint32_t index;
+	uint8_t *frame;
+	uint16_t len;
+	uint8_t n, i;
+
+	while ((frame = pPpgStreamPeek(&len)) != NULL) {
+		n = ucPpgStreamDecode(frame, len, &header, red, ired);
+		CHECK_EQ(n, header.ucCount);
+		CHECK_EQ(header.ucRate, PPG_STREAM_RATE_HZ);
+		if (sink->iLastSeq >= 0)
+			sink->uiGaps += (uint16_t) (header.usSeq - sink->iLastSeq - 1);
+		sink->iLastSeq = header.usSeq;
+		sink->uiFrames++;
+		sink->uiBytes += len;
+		for (i = 0; i < n; i++) {
+			index = (header.uiTimestamp - STREAM_T0) / STREAM_PERIOD_MS + i;
+			if (index < STREAM_SAMPLES && red[i] == auiRed[index]
+					&& ired[i] == auiIred[index] && !sink->aucSeen[index]) {
+				sink->aucSeen[index] = 1;
+				sink->uiSamples++;
+			} else {
+				sink->uiErrors++;
+			}
+		}
+		vPpgStreamRelease();
+	}
+}
+
+// one sample per period, the central takes frames except while stalled
+static void vStreamRun(Sink *sink, uint16_t stallFrom, uint16_t stallTo) {
+	uint16_t k;
+
+	vHostReset();
+	vSinkReset(sink);
+	vPpgStreamStart(PPG_STREAM_FRAME_MAX, NULL);
+	for (k = 0; k < STREAM_SAMPLES; k++) {
+		vHostAdvance(STREAM_PERIOD_MS);
+		vPpgStreamPush(auiRed[k], auiIred[k]);
+		if (k < stallFrom || k >= stallTo)
+			vSinkDrain(sink);
+	}
+	vHostAdvance(PPG_STREAM_DEADLINE_MS);
+	vPpgStreamPoll();
+	vSinkDrain(sink);
+}
+
+static void test_round_trip(void) {
+	static Sink sink;
+	PpgStreamStats stats;
+
+	vStreamRun(&sink, STREAM_SAMPLES, STREAM_SAMPLES);
+	vPpgStreamGetStats(&stats);
+	CHECK_EQ(sink.uiErrors, 0);
+	CHECK_EQ(sink.uiSamples, STREAM_SAMPLES);
+	CHECK_EQ(sink.uiGaps, 0);
+	CHECK_EQ(stats.uiDropped, 0);
+	CHECK_EQ(stats.uiSamples, STREAM_SAMPLES);
+	CHECK_EQ(sink.uiFrames, stats.uiFrames);
+	printf("%u samples in %u frames, %u bytes, %.2f bytes per pair\n",
+			(unsigned) sink.uiSamples, (unsigned) sink.uiFrames,
+			(unsigned) sink.uiBytes, (double) sink.uiBytes / sink.uiSamples);
+}
+
+// a central that stops reading loses whole frames, the gaps say how many
+static void test_gap_detection(void) {
+	static Sink sink;
+	PpgStreamStats stats;
+	uint32_t missing = 0;
+	uint16_t k;
+
+	vStreamRun(&sink, 1000, 1600);
+	vPpgStreamGetStats(&stats);
+	CHECK_EQ(sink.uiErrors, 0);
+	CHECK(stats.uiDropped > 0);
+	CHECK_EQ(sink.uiGaps, stats.uiDropped);
+	CHECK_EQ(sink.uiFrames + stats.uiDropped, stats.uiFrames);
+	for (k = 0; k < STREAM_SAMPLES; k++) {
+		if (sink.aucSeen[k])
+			continue;
+		missing++;
+		// only samples from the stalled stretch can be missing
+		CHECK(k >= 1000 - PPG_STREAM_COUNT_MASK && k < 1600);
+	}
+	CHECK_EQ(sink.uiSamples + missing, STREAM_SAMPLES);
+	printf("stalled 600 samples: %u frames dropped, %u samples lost\n",
+			(unsigned) stats.uiDropped, (unsigned) missing);
+}
+
+static void test_throughput(void) {
+	PpgStreamHeader header;
+	uint32_t red[PPG_STREAM_COUNT_MASK], ired[PPG_STREAM_COUNT_MASK];
+	uint32_t pushNs = 0, decodeNs = 0, start, decoded = 0;
+	uint8_t *frame;
+	uint16_t k, len;
+
+	vHostReset();
+	vPpgStreamStart(PPG_STREAM_FRAME_MAX, NULL);
+	for (k = 0; k < STREAM_SAMPLES; k++) {
+		vHostAdvance(STREAM_PERIOD_MS);
+		start = uiHostNs();
+		vPpgStreamPush(auiRed[k], auiIred[k]);
+		pushNs += uiHostNs() - start;
+		while ((frame = pPpgStreamPeek(&len)) != NULL) {
+			start = uiHostNs();
+			decoded += ucPpgStreamDecode(frame, len, &header, red, ired);
+			decodeNs += uiHostNs() - start;
+			vPpgStreamRelease();
+		}
+	}
+	CHECK(decoded > STREAM_SAMPLES - 2 * PPG_STREAM_COUNT_MASK);
+	printf("host: push %u ns, decode %u ns per sample pair\n",
+			(unsigned) (pushNs / STREAM_SAMPLES), (unsigned) (decodeNs / decoded));
+}
+
+int main(void) {
+	vStreamSignal();
+	UNIT_RUN(test_round_trip);
+	UNIT_RUN(test_gap_detection);
+	UNIT_RUN(test_throughput);
+	return UNIT_END();
+}
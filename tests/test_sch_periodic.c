@@ -0,0 +1,237 @@
+/*
+ * test_sch_periodic.c
+ *
+ * sch_periodic.c on a simulated clock. The release jitter runs it the way
+ * app_entry.c does: one timer server timer armed for the next release in
+ * ticks of the 32768 Hz RTC / CFG_RTCCLK_DIV, HAL_GetTick() in whole ms. A
+ * timer armed with the ticks rounded down can expire short of the release
+ * and only re-arm, rounded up no expiry may be wasted and each release has
+ * to come within a ms and a tick of its time, plus what CFG_TS_TICK_VAL
+ * rounded to a whole us drifts, and never early, for the periods the
+ * application uses. Miss counting is checked case by case: on time, a run
+ * past its deadline, a release while the job still waits, releases skipped
+ * for a late timer, disable and enable, and the earliest deadline picked.
+ * Through the scheduler and the timer of the host stack a periodic task has
+ * to be released every period without a miss, and one that overruns its
+ * deadline has to miss every job.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "sch_periodic.h"
+#include "scheduler.h"
+#include "app_entry.h"
+
+#include <string.h>
+
+#define SIM_MS 60000
+// RTC tick in 1/32 us, 16 / 32768 s
+#define RTC_TICK_32US (15625ULL * CFG_RTCCLK_DIV / 16)
+// PERIODIC_TICKS() of app_entry.c before and after rounding up
+#define TICKS_DOWN(ms) ((ms) * 1000 / CFG_TS_TICK_VAL)
+#define TICKS_UP(ms) (((ms) * 1000 + CFG_TS_TICK_VAL - 1) / CFG_TS_TICK_VAL)
+// us a timer of ms runs long, CFG_TS_TICK_VAL is the tick rounded to a whole us
+#define TICK_DRIFT_US(ms) ((ms) * 1000ULL * (RTC_TICK_32US - 32 * CFG_TS_TICK_VAL) \
+		/ (32 * CFG_TS_TICK_VAL) + 1)
+#define TASK_A 3
+#define TASK_B 9
+#define STACK_PERIOD 50
+#define STACK_RUN_MS 10000
+
+typedef struct {
+	uint32_t uiReleases;
+	uint32_t uiExpiries;
+	uint32_t uiWasted;         // expiries that released nothing
+	uint32_t uiJitterMaxUs;    // release after its time
+	uint32_t uiEarly;          // released before its time
+	uint32_t uiMisses;
+} Sim;
+
+static const uint32_t auiPeriods[] = { 7, 50, 100, 500, 1000 };
+static uint32_t uiStackRunUs;
+
+// local function prototypes
+static void vSimulate(uint8_t ucRoundUp, uint32_t uiPeriod, Sim *pSim);
+static void vStackTask(void);
+
+//local functions
+// the timer armed as Periodic_Arm() does, the task run at once
+static void vSimulate(uint8_t ucRoundUp, uint32_t uiPeriod, Sim *pSim) {
+	SchPeriodicStats stats;
+	uint64_t t32 = 0, due32;
+	uint32_t next, ticks, ms;
+
+	memset(pSim, 0, sizeof(*pSim));
+	vSchPeriodicInit();
+	ucSchPeriodicRegister(TASK_A, uiPeriod, uiPeriod);
+	vSchPeriodicEnable(TASK_A, 1, 0);
+	while (t32 < SIM_MS * 32000ULL) {
+		next = uiSchPeriodicNext((uint32_t) (t32 / 32000));
+		if (next != 0) {
+			ticks = ucRoundUp ? TICKS_UP(next) : TICKS_DOWN(next);
+			if (ticks == 0)
+				ticks = 1;
+			t32 += ticks * RTC_TICK_32US;
+			pSim->uiExpiries++;
+		}
+		ms = (uint32_t) (t32 / 32000);
+		if (uiSchPeriodicRelease(ms) == 0) {
+			pSim->uiWasted++;
+			continue;
+		}
+		pSim->uiReleases++;
+		due32 = (uint64_t) pSim->uiReleases * uiPeriod * 32000;
+		if (t32 < due32)
+			pSim->uiEarly++;
+		else if ((t32 - due32) / 32 > pSim->uiJitterMaxUs)
+			pSim->uiJitterMaxUs = (uint32_t) ((t32 - due32) / 32);
+		vSchPeriodicStart(TASK_A, ms);
+		vSchPeriodicDone(TASK_A, ms);
+	}
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	pSim->uiMisses = stats.uiMisses;
+	CHECK_EQ(stats.uiReleases, pSim->uiReleases);
+}
+
+static void vStackTask(void) {
+	vHostAdvanceUs(uiStackRunUs);
+}
+
+// rounded up every expiry releases, late by a ms, a tick and the drift, never early
+static void test_jitter(void) {
+	Sim down, up;
+	uint32_t wasted = 0;
+	uint8_t i;
+
+	printf("%6s %8s | %7s %6s %9s | %7s %6s %9s\n", "period", "releases", "expiry", "wasted",
+			"jitter us", "expiry", "wasted", "jitter us");
+	for (i = 0; i < sizeof(auiPeriods) / sizeof(auiPeriods[0]); i++) {
+		vSimulate(0, auiPeriods[i], &down);
+		vSimulate(1, auiPeriods[i], &up);
+		printf("%6u %8u | %7u %6u %9u | %7u %6u %9u\n", (unsigned) auiPeriods[i],
+				(unsigned) up.uiReleases, (unsigned) down.uiExpiries, (unsigned) down.uiWasted,
+				(unsigned) down.uiJitterMaxUs, (unsigned) up.uiExpiries, (unsigned) up.uiWasted,
+				(unsigned) up.uiJitterMaxUs);
+		// the last expiry may land past the end
+		CHECK(up.uiReleases >= SIM_MS / auiPeriods[i] && up.uiReleases <= SIM_MS / auiPeriods[i] + 1);
+		CHECK_EQ(up.uiWasted, 0);
+		CHECK_EQ(up.uiExpiries, up.uiReleases);
+		CHECK_EQ(up.uiEarly, 0);
+		CHECK_EQ(up.uiMisses, 0);
+		CHECK(up.uiJitterMaxUs < 1000 + CFG_TS_TICK_VAL + TICK_DRIFT_US(auiPeriods[i]));
+		CHECK_EQ(down.uiEarly, 0);
+		wasted += down.uiWasted;
+	}
+	// what rounding down cost
+	CHECK(wasted > 0);
+}
+
+// each way a job can miss, counted once
+static void test_misses(void) {
+	SchPeriodicStats stats;
+
+	vSchPeriodicInit();
+	CHECK_EQ(ucSchPeriodicRegister(TASK_A, 100, 20), 1);
+	CHECK_EQ(ucSchPeriodicRegister(TASK_A, 100, 20), 0);
+	CHECK_EQ(ucSchPeriodicRegister(TASK_B, 0, 20), 0);
+	CHECK_EQ(uiSchPeriodicNext(0), SCH_PERIODIC_IDLE);
+	vSchPeriodicEnable(TASK_A, 1, 0);
+	CHECK_EQ(uiSchPeriodicNext(0), 100);
+	CHECK_EQ(uiSchPeriodicRelease(99), 0);
+
+	// on time
+	CHECK_EQ(uiSchPeriodicRelease(100), 1UL << TASK_A);
+	vSchPeriodicStart(TASK_A, 105);
+	vSchPeriodicDone(TASK_A, 120);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 0);
+	CHECK_EQ(stats.uiLatencyMax, 5);
+	CHECK_EQ(stats.uiResponseMax, 20);
+
+	// done past the deadline
+	uiSchPeriodicRelease(200);
+	vSchPeriodicStart(TASK_A, 200);
+	vSchPeriodicDone(TASK_A, 221);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 1);
+
+	// released again while waiting, one run serves both, a miss each
+	uiSchPeriodicRelease(300);
+	uiSchPeriodicRelease(400);
+	vSchPeriodicStart(TASK_A, 401);
+	vSchPeriodicDone(TASK_A, 402);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 2);
+	CHECK_EQ(stats.uiReleases, 4);
+
+	// the timer 3 periods late, the skipped releases miss
+	CHECK_EQ(uiSchPeriodicRelease(850), 1UL << TASK_A);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 5);
+	CHECK_EQ(stats.uiReleases, 5);
+	CHECK_EQ(uiSchPeriodicNext(850), 50);
+	vSchPeriodicStart(TASK_A, 850);
+	vSchPeriodicDone(TASK_A, 850);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 6);
+
+	// disabled the pending job is dropped, enabled the phase restarts
+	uiSchPeriodicRelease(900);
+	vSchPeriodicEnable(TASK_A, 0, 905);
+	CHECK_EQ(uiSchPeriodicNext(905), SCH_PERIODIC_IDLE);
+	vSchPeriodicDone(TASK_A, 2000);
+	vSchPeriodicEnable(TASK_A, 1, 2000);
+	CHECK_EQ(uiSchPeriodicNext(2000), 100);
+	ucSchPeriodicGetStats(TASK_A, &stats);
+	CHECK_EQ(stats.uiMisses, 6);
+
+	// the earliest deadline first, an event task leaves it to the round robin
+	CHECK_EQ(ucSchPeriodicRegister(TASK_B, 30, 5), 1);
+	vSchPeriodicEnable(TASK_B, 1, 2070);
+	CHECK_EQ(uiSchPeriodicRelease(2100), (1UL << TASK_A) | (1UL << TASK_B));
+	CHECK_EQ(ucSchPeriodicPick((1UL << TASK_A) | (1UL << TASK_B)), TASK_B);
+	CHECK_EQ(ucSchPeriodicPick(1UL << TASK_A), TASK_A);
+	CHECK_EQ(ucSchPeriodicPick((1UL << TASK_A) | 1), SCH_PERIODIC_NONE);
+	CHECK(ucSchPeriodicGetStats(TASK_B + 1, &stats) == 0);
+}
+
+// through SCH_Run() and the periodic timer of the host stack
+static void test_stack(void) {
+	SchPeriodicStats stats;
+
+	vBleHostInit();
+	SCH_RegTask(CFG_TASK_DISPLAY_ID, vStackTask);
+	CHECK_EQ(APPE_Periodic_Register(CFG_TASK_DISPLAY_ID, STACK_PERIOD, STACK_PERIOD), 1);
+	uiStackRunUs = 2000;
+	APPE_Periodic_Enable(CFG_TASK_DISPLAY_ID, 1);
+	vBleHostRun(STACK_RUN_MS);
+	ucSchPeriodicGetStats(CFG_TASK_DISPLAY_ID, &stats);
+	printf("stack: %u releases, %u misses, latency %u ms, response %u ms\n",
+			(unsigned) stats.uiReleases, (unsigned) stats.uiMisses,
+			(unsigned) stats.uiLatencyMax, (unsigned) stats.uiResponseMax);
+	// the release due at the end comes a tick later
+	CHECK(stats.uiReleases + 1 >= STACK_RUN_MS / STACK_PERIOD);
+	CHECK_EQ(stats.uiMisses, 0);
+	CHECK(stats.uiLatencyMax <= 1);
+	CHECK(stats.uiResponseMax <= 3);
+
+	// 30 ms runs for a 20 ms deadline, every job misses and none is lost
+	vBleHostInit();
+	SCH_RegTask(CFG_TASK_DISPLAY_ID, vStackTask);
+	APPE_Periodic_Register(CFG_TASK_DISPLAY_ID, STACK_PERIOD, 20);
+	uiStackRunUs = 30000;
+	APPE_Periodic_Enable(CFG_TASK_DISPLAY_ID, 1);
+	vBleHostRun(STACK_RUN_MS);
+	ucSchPeriodicGetStats(CFG_TASK_DISPLAY_ID, &stats);
+	CHECK(stats.uiReleases + 1 >= STACK_RUN_MS / STACK_PERIOD);
+	CHECK(stats.uiMisses + 1 >= stats.uiReleases && stats.uiMisses <= stats.uiReleases);
+}
+
+int main(void) {
+	UNIT_RUN(test_jitter);
+	UNIT_RUN(test_misses);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
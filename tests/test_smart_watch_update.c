@@ -0,0 +1,233 @@
+/*
+ * test_smart_watch_update.c
+ *
+ * Characteristic updates of smart_watch_stm.c down to the ACI commands CPU2
+ * takes: values longer than one command go in aci_gatt_update_char_value_ext()
+ * chunks at their offsets, only the last one notifies, once per subscribed
+ * link, and the value CPU2 ends up with and notifies is the one written. A
+ * link refused for lack of TX buffers is retried alone. The asynchronous
+ * path sends the same commands without stalling the main loop.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "smart_watch_stm.h"
+
+#include <string.h>
+
+// Value_Length of one aci_gatt_update_char_value_ext()
+#define UPDATE_CHUNK_MAX (BLE_CMD_MAX_PARAM_LEN - 12)
+
+static const Cpu2HostCentral tCentral = { 512, 251, 1, 24, -60 };
+static uint8_t aValue[SMART_WATCH_DATA_CHAR_SIZE];
+static tBleStatus eAsyncStatus;
+static uint8_t ucAsyncDone;
+
+// local function prototypes
+static uint16_t usConnected(void);
+static void vValueFill(uint16_t usLen, uint8_t ucSeed);
+static void vCheckChunks(uint16_t usHandle, uint16_t usLen, uint16_t usFirst);
+static void vAsyncDone(tBleStatus Status);
+
+//local functions
+static uint16_t usConnected(void) {
+	uint16_t conn;
+
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	CHECK_EQ(usCpu2HostLinkMtu(conn), 512);
+	return conn;
+}
+
+static void vValueFill(uint16_t usLen, uint8_t ucSeed) {
+	uint16_t i;
+
+	for (i = 0; i < usLen; i++)
+		aValue[i] = (uint8_t) (i * 7 + ucSeed);
+}
+
+// the leading chunks store, from usFirst on the updates carry the last one
+static void vCheckChunks(uint16_t usHandle, uint16_t usLen, uint16_t usFirst) {
+	const Cpu2HostUpdate *update;
+	uint16_t i, offset = 0;
+
+	for (i = 0; i < usFirst; i++) {
+		update = pCpu2HostUpdate(i);
+		CHECK_EQ(update->usHandle, usHandle);
+		CHECK_EQ(update->ucType, 0);
+		CHECK_EQ(update->usConn, 0);
+		CHECK_EQ(update->usCharLen, usLen);
+		CHECK_EQ(update->usOffset, offset);
+		CHECK_EQ(update->ucLen, UPDATE_CHUNK_MAX);
+		offset += update->ucLen;
+	}
+	for (i = usFirst; i < usCpu2HostUpdates(); i++) {
+		update = pCpu2HostUpdate(i);
+		CHECK_EQ(update->usCharLen, usLen);
+		CHECK_EQ(update->usOffset, offset);
+		CHECK_EQ(update->ucLen, usLen - offset);
+	}
+}
+
+static void vAsyncDone(tBleStatus Status) {
+	eAsyncStatus = Status;
+	ucAsyncDone = 1;
+}
+
+// every length from one octet to the declared size, one subscriber
+static void test_chunks(void) {
+	static const uint16_t ausLen[] = { 1, 20, UPDATE_CHUNK_MAX - 1, UPDATE_CHUNK_MAX,
+			UPDATE_CHUNK_MAX + 1, SMART_WATCH_DATA_CHAR_SIZE - 1, SMART_WATCH_DATA_CHAR_SIZE };
+	const Cpu2HostNotify *notify;
+	const uint8_t *stored;
+	uint16_t conn, data, len, chunks;
+	uint8_t i;
+
+	conn = usConnected();
+	data = usBleHostChar(BLE_HOST_DATA);
+	CHECK(data != 0);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10);
+
+	for (i = 0; i < sizeof(ausLen) / sizeof(ausLen[0]); i++) {
+		vCpu2HostClearNotifications();
+		vValueFill(ausLen[i], i);
+		CHECK_EQ(SMART_WATCH_STM_App_Update_Data(aValue, ausLen[i]), BLE_STATUS_SUCCESS);
+
+		chunks = (ausLen[i] + UPDATE_CHUNK_MAX - 1) / UPDATE_CHUNK_MAX;
+		CHECK_EQ(usCpu2HostUpdates(), chunks);
+		vCheckChunks(data, ausLen[i], chunks - 1);
+		CHECK_EQ(pCpu2HostUpdate(chunks - 1)->ucType, 1);
+		CHECK_EQ(pCpu2HostUpdate(chunks - 1)->usConn, conn);
+
+		stored = pCpu2HostValue(data, &len);
+		CHECK_EQ(len, ausLen[i]);
+		CHECK(memcmp(stored, aValue, ausLen[i]) == 0);
+		CHECK_EQ(usCpu2HostNotifications(), 1);
+		notify = pCpu2HostNotification(0);
+		CHECK_EQ(notify->usConn, conn);
+		CHECK_EQ(notify->usLen, ausLen[i]);
+		CHECK(memcmp(notify->aData, aValue, ausLen[i]) == 0);
+	}
+
+	// longer than declared: refused before anything reaches the stack
+	vCpu2HostClearNotifications();
+	CHECK_EQ(SMART_WATCH_STM_App_Update_Data(aValue, SMART_WATCH_DATA_CHAR_SIZE + 1),
+			BLE_STATUS_INVALID_PARAMS);
+	CHECK_EQ(usCpu2HostUpdates(), 0);
+}
+
+// the value is kept for reads, nobody is notified
+static void test_no_subscriber(void) {
+	const uint8_t *stored;
+	uint16_t data, len;
+
+	usConnected();
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostClearNotifications();
+	vValueFill(SMART_WATCH_DATA_CHAR_SIZE, 3);
+	CHECK_EQ(SMART_WATCH_STM_App_Update_Char(SWITCH_DATA, aValue), BLE_STATUS_SUCCESS);
+	CHECK_EQ(usCpu2HostUpdates(), 2);
+	vCheckChunks(data, SMART_WATCH_DATA_CHAR_SIZE, 1);
+	CHECK_EQ(pCpu2HostUpdate(1)->ucType, 0);
+	CHECK_EQ(usCpu2HostNotifications(), 0);
+	stored = pCpu2HostValue(data, &len);
+	CHECK_EQ(len, SMART_WATCH_DATA_CHAR_SIZE);
+	CHECK(memcmp(stored, aValue, len) == 0);
+}
+
+// a refused link is retried alone, the leading chunk is stored again each time
+static void test_refused_retry(void) {
+	static const Cpu2HostCentral second = { 512, 251, 1, 40, -70 };
+	const uint8_t *stored;
+	uint16_t conn, other, data, len, i, leading = 0;
+	uint8_t pending, calls = 0;
+	tBleStatus status;
+
+	conn = usConnected();
+	other = usBleHostConnect(&second);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(conn, data, 1);
+	vCpu2HostSubscribe(other, data, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	// the first and the third notifying update find no TX buffer
+	vCpu2HostRefuse(1, 2, 1000);
+
+	vValueFill(UPDATE_CHUNK_MAX + 1, 5);
+	pending = SMART_WATCH_STM_Subscribers(SWITCH_DATA);
+	CHECK_EQ(pending, 3);
+	do {
+		status = SMART_WATCH_STM_App_Update_Value(SWITCH_DATA, aValue, UPDATE_CHUNK_MAX + 1, &pending);
+		calls++;
+	} while (status == BLE_STATUS_INSUFFICIENT_RESOURCES && calls < 5);
+	CHECK_EQ(status, BLE_STATUS_SUCCESS);
+	CHECK_EQ(calls, 3);
+	CHECK_EQ(pending, 0);
+
+	for (i = 0; i < usCpu2HostUpdates(); i++)
+		if (pCpu2HostUpdate(i)->usOffset == 0) {
+			CHECK_EQ(pCpu2HostUpdate(i)->ucType, 0);
+			leading++;
+		}
+	CHECK_EQ(leading, calls);
+	stored = pCpu2HostValue(data, &len);
+	CHECK_EQ(len, UPDATE_CHUNK_MAX + 1);
+	CHECK(memcmp(stored, aValue, len) == 0);
+	// each link notified once, with the whole value
+	CHECK_EQ(usCpu2HostNotifications(), 2);
+	CHECK(pCpu2HostNotification(0)->usConn != pCpu2HostNotification(1)->usConn);
+	for (i = 0; i < 2; i++)
+		CHECK(memcmp(pCpu2HostNotification(i)->aData, aValue, UPDATE_CHUNK_MAX + 1) == 0);
+}
+
+// same commands through hci_send_req_async(), the caller does not wait
+static void test_async(void) {
+	uint8_t pending;
+	uint16_t conn, data, len;
+	const uint8_t *stored;
+	BleHostStats stats;
+
+	conn = usConnected();
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostSubscribe(conn, data, 1);
+	vBleHostRun(10);
+	vCpu2HostClearNotifications();
+	vCpu2HostSetLatency(300);
+	vBleHostClearStats();
+
+	vValueFill(SMART_WATCH_DATA_CHAR_SIZE, 9);
+	pending = SMART_WATCH_STM_Subscribers(SWITCH_DATA);
+	ucAsyncDone = 0;
+	CHECK_EQ(SMART_WATCH_STM_App_Update_Value_Async(SWITCH_DATA, aValue, SMART_WATCH_DATA_CHAR_SIZE,
+			&pending, vAsyncDone), BLE_STATUS_PENDING);
+	CHECK_EQ(ucAsyncDone, 0);
+	vBleHostRun(5);
+	CHECK_EQ(ucAsyncDone, 1);
+	CHECK_EQ(eAsyncStatus, BLE_STATUS_SUCCESS);
+	CHECK_EQ(pending, 0);
+
+	CHECK_EQ(usCpu2HostUpdates(), 2);
+	vCheckChunks(data, SMART_WATCH_DATA_CHAR_SIZE, 1);
+	CHECK_EQ(pCpu2HostUpdate(1)->ucType, 1);
+	stored = pCpu2HostValue(data, &len);
+	CHECK(memcmp(stored, aValue, SMART_WATCH_DATA_CHAR_SIZE) == 0);
+	CHECK_EQ(usCpu2HostNotifications(), 1);
+	CHECK(memcmp(pCpu2HostNotification(0)->aData, aValue, SMART_WATCH_DATA_CHAR_SIZE) == 0);
+
+	vBleHostGetStats(&stats);
+	CHECK_EQ(stats.uiStalls, 0);
+	printf("async 450 octets: 2 commands at 300 us each, main loop stalled %u us\n",
+			(unsigned) stats.ulStallUs);
+}
+
+int main(void) {
+	UNIT_RUN(test_chunks);
+	UNIT_RUN(test_no_subscriber);
+	UNIT_RUN(test_refused_retry);
+	UNIT_RUN(test_async);
+	return UNIT_END();
+}
@@ -0,0 +1,368 @@
+/*
+ * test_ssd1306_emu.c
+ *
+ * The display stack against the emulated controller: command interpreter
+ * checks, golden images of every screen and the I2C and CPU cost of a frame.
+ *
+ * SSD1306_GOLDEN_UPDATE=1 rewrites the images in tests/golden instead of
+ * comparing, a mismatch leaves <name>.actual.pbm in the working directory.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ssd1306_emu.h"
+#include "ssd1306.h"
+#include "oled.h"
+#include "oled_widget.h"
+#include "hal_lcd.h"
+#include "logo.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RUNS 200
+#define WAVE_STEPS 100
+
+typedef struct {
+	const char *pName;
+	void (*pfDraw)(void);
+} Screen;
+
+// local function prototypes
+static void vPanelReset(void);
+static void vSendCommands(const uint8_t *pCmds, uint16_t usLen);
+static void vSendData(const uint8_t *pData, uint16_t usLen);
+static uint64_t ulNowNs(void);
+
+//local functions
+static void vPanelReset(void) {
+	vHostReset();
+	vSsd1306EmuInit();
+	vOledScreenLeave();
+	SSD1306_Init();
+	vSsd1306EmuStatsReset();
+}
+
+static void vSendCommands(const uint8_t *pCmds, uint16_t usLen) {
+	ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x00, (uint8_t*) pCmds, usLen);
+}
+
+static void vSendData(const uint8_t *pData, uint16_t usLen) {
+	ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x40, (uint8_t*) pData, usLen);
+}
+
+static uint64_t ulNowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// screens as the firmware draws them
+static void vDrawBootLogo(void) {
+	SSD1306_DrawRle(0, 0, LOGO_WIDTH, LOGO_PAGES, logo_rle);
+	SSD1306_UpdateScreen();
+}
+
+static void vDrawBleAdvertising(void) {
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	LCD_BLE_PrintLogo();
+	LCD_BLE_PrintLocalName("LPulsefex");
+	LCD_BLE_PrintStatus("ADVERTISING");
+}
+
+static void vDrawSelect(void) {
+	LCD_Print("SELECT", "CHARACTER");
+}
+
+static void vDrawMax30102(void) {
+	vOledBleMaxInit30102();
+	vOledBlePrintMax30102(72, 98, 40);
+}
+
+static void vDrawData(void) {
+	vOledBlePrintData();
+	vOledBlePrintData();
+}
+
+static void vDrawLux(void) {
+	vOledBlePrintLux(321);
+}
+
+static void vDrawSi7021(void) {
+	vOledBlePrintSi7021(23.5f, 41.25f);
+}
+
+static void vDrawMax30003(void) {
+	vOledBlePrintMax30003(100, 72, 840);
+}
+
+static const Screen aScreens[] = {
+	{ "boot_logo", vDrawBootLogo },
+	{ "ble_advertising", vDrawBleAdvertising },
+	{ "select", vDrawSelect },
+	{ "max30102", vDrawMax30102 },
+	{ "data", vDrawData },
+	{ "lux", vDrawLux },
+	{ "si7021", vDrawSi7021 },
+	{ "max30003", vDrawMax30003 },
+};
+
+static void test_init_sequence(void) {
+	Ssd1306EmuStats stats;
+
+	vPanelReset();
+	vSsd1306EmuStats(&stats);
+	CHECK_EQ(stats.uiViolations, 0);
+	// 0xD5 0xF0 and 0xD9 0x22 on 64 lines, ~107 Hz
+	CHECK_EQ(uiSsd1306EmuFrameUs(), 9340);
+	CHECK_EQ(ucSsd1306EmuPixel(0, 0), 0);
+	SSD1306_DrawPixel(0, 0, SSD1306_COLOR_WHITE);
+	SSD1306_DrawPixel(127, 63, SSD1306_COLOR_WHITE);
+	SSD1306_UpdateScreen();
+	CHECK_EQ(ucSsd1306EmuPixel(0, 0), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(127, 63), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(1, 0), 0);
+}
+
+static void test_addressing_modes(void) {
+	static const uint8_t horizontal[] = { 0x20, 0x00, 0x21, 10, 11, 0x22, 2, 3 };
+	static const uint8_t vertical[] = { 0x20, 0x01, 0x21, 20, 21, 0x22, 4, 5 };
+	static const uint8_t page[] = { 0x20, 0x02, 0xB6, 0x0E, 0x17 };
+	static const uint8_t bytes[] = { 1, 2, 3, 4, 5 };
+
+	vPanelReset();
+	// wraps to the window start, the fifth byte lands on the first column again
+	vSendCommands(horizontal, sizeof(horizontal));
+	vSendData(bytes, 5);
+	CHECK_EQ(ucSsd1306EmuRam(2, 10), 5);
+	CHECK_EQ(ucSsd1306EmuRam(2, 11), 2);
+	CHECK_EQ(ucSsd1306EmuRam(3, 10), 3);
+	CHECK_EQ(ucSsd1306EmuRam(3, 11), 4);
+
+	vSendCommands(vertical, sizeof(vertical));
+	vSendData(bytes, 4);
+	CHECK_EQ(ucSsd1306EmuRam(4, 20), 1);
+	CHECK_EQ(ucSsd1306EmuRam(5, 20), 2);
+	CHECK_EQ(ucSsd1306EmuRam(4, 21), 3);
+	CHECK_EQ(ucSsd1306EmuRam(5, 21), 4);
+
+	// column 0x7E of page 6, the pointer wraps to the column start in page mode
+	vSendCommands(page, sizeof(page));
+	vSendData(bytes, 3);
+	CHECK_EQ(ucSsd1306EmuRam(6, 126), 3);
+	CHECK_EQ(ucSsd1306EmuRam(6, 127), 2);
+	CHECK_EQ(ucSsd1306EmuRam(7, 0), 0);
+}
+
+static void test_control_byte_continuation(void) {
+	// Co set: one command, one data byte, then a data stream
+	static const uint8_t stream[] = { 0x80, 0x20, 0x80, 0x02, 0x80, 0xB1, 0x80, 0x00, 0x80, 0x10,
+			0xC0, 0xAA, 0x40, 0x55, 0x66 };
+
+	vPanelReset();
+	ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, stream[0], (uint8_t*) &stream[1], sizeof(stream) - 1);
+	CHECK_EQ(ucSsd1306EmuRam(1, 0), 0xAA);
+	CHECK_EQ(ucSsd1306EmuRam(1, 1), 0x55);
+	CHECK_EQ(ucSsd1306EmuRam(1, 2), 0x66);
+}
+
+static void test_multiplex_offset_invert(void) {
+	static const uint8_t mux32[] = { 0xA8, 31 };
+	static const uint8_t mux64[] = { 0xA8, 63 };
+	static const uint8_t start8[] = { 0x48 };
+	static const uint8_t offset4[] = { 0xD3, 4 };
+
+	vPanelReset();
+	SSD1306_DrawPixel(5, 40, SSD1306_COLOR_WHITE);
+	SSD1306_DrawPixel(5, 8, SSD1306_COLOR_WHITE);
+	SSD1306_UpdateScreen();
+	CHECK_EQ(ucSsd1306EmuPixel(5, 40), 1);
+
+	// only 32 COMs are driven, the lower half goes dark
+	vSendCommands(mux32, sizeof(mux32));
+	CHECK_EQ(ucSsd1306EmuPixel(5, 40), 0);
+	CHECK_EQ(ucSsd1306EmuPixel(5, 8), 1);
+	vSendCommands(mux64, sizeof(mux64));
+
+	// start line 8 moves RAM line 8 to the top row
+	vSendCommands(start8, sizeof(start8));
+	CHECK_EQ(ucSsd1306EmuPixel(5, 0), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(5, 32), 1);
+	vSendCommands((const uint8_t*) "\x40", 1);
+
+	// offset 4 maps the display start to COM4
+	vSendCommands(offset4, sizeof(offset4));
+	CHECK_EQ(ucSsd1306EmuPixel(5, 12), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(5, 8), 0);
+	vSendCommands((const uint8_t*) "\xD3\x00", 2);
+
+	vSendCommands((const uint8_t*) "\xA7", 1);
+	CHECK_EQ(ucSsd1306EmuPixel(5, 8), 0);
+	CHECK_EQ(ucSsd1306EmuPixel(6, 8), 1);
+	vSendCommands((const uint8_t*) "\xA6\xA5", 2);
+	CHECK_EQ(ucSsd1306EmuPixel(6, 8), 1);
+	vSendCommands((const uint8_t*) "\xA4\xAE", 2);
+	CHECK_EQ(ucSsd1306EmuPixel(5, 8), 0);
+}
+
+// the controller scroll the init sequence turns off, as the emulator models it
+static void test_scroll(void) {
+	static const uint8_t scroll[] = { 0x2E, 0x27, 0x00, 5, 0x05, 7, 0x00, 0xFF, 0x2F };
+	Ssd1306EmuStats stats;
+	uint32_t frame;
+
+	vPanelReset();
+	SSD1306_DrawPixel(0, 40, SSD1306_COLOR_WHITE);
+	SSD1306_DrawPixel(64, 0, SSD1306_COLOR_WHITE);
+	SSD1306_UpdateScreen();
+	vSendCommands(scroll, sizeof(scroll));
+	CHECK(ucSsd1306EmuScrolling());
+	frame = uiSsd1306EmuFrameUs();
+
+	// three frames leave the band alone, the fourth steps it one column left
+	vSsd1306EmuRun(3 * frame);
+	CHECK_EQ(ucSsd1306EmuPixel(0, 40), 1);
+	vSsd1306EmuRun(frame);
+	CHECK_EQ(ucSsd1306EmuPixel(0, 40), 0);
+	CHECK_EQ(ucSsd1306EmuPixel(127, 40), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(64, 0), 1);
+
+	// RAM writes under a running scroll are not allowed, one violation per byte
+	vSsd1306EmuStatsReset();
+	vSendData((const uint8_t*) "\x01\x02\x03", 3);
+	vSsd1306EmuStats(&stats);
+	CHECK_EQ(stats.uiViolations, 3);
+
+	// once stopped the band is rewritten from the framebuffer
+	vSendCommands((const uint8_t*) "\x2E", 1);
+	CHECK(!ucSsd1306EmuScrolling());
+	CHECK_EQ(SSD1306_UpdateRect(0, SSD1306_WIDTH - 1, 5, 7), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(0, 40), 1);
+	CHECK_EQ(ucSsd1306EmuPixel(127, 40), 0);
+}
+
+// the waveform band scrolls with the display task, not the panel oscillator:
+// every column is where the pushes put it at the datasheet oscillator range
+static void test_waveform(void) {
+	static const uint32_t aOscHz[] = { 333000, 370000, 407000 };
+	Ssd1306EmuStats stats;
+	int16_t y[WAVE_STEPS + 1];
+	uint16_t diff;
+	uint8_t o, k, x, row, lit, y0, y1;
+
+	for (o = 0; o < sizeof(aOscHz) / sizeof(aOscHz[0]); o++) {
+		vPanelReset();
+		vSsd1306EmuSetOsc(aOscHz[o]);
+		vDrawMax30102();
+		vSsd1306EmuStatsReset();
+		y[0] = 10;
+		for (k = 1; k <= WAVE_STEPS; k++) {
+			vHostAdvance(50);
+			diff = (k * 37) % 110;
+			y[k] = (int16_t) (diff * 0.12) + 10;
+			vOledBlePrintMax30102(72, 98, diff);
+		}
+		vSsd1306EmuStats(&stats);
+		CHECK_EQ(stats.uiViolations, 0);
+		CHECK_EQ(stats.uiScrollSteps, 0);
+		CHECK(!ucSsd1306EmuScrolling());
+
+		// push k is the column WAVE_STEPS - k from the right edge, lit from
+		// the previous point to its own, counted up from the bottom row
+		for (k = 1; k <= WAVE_STEPS; k++) {
+			x = SSD1306_WIDTH - 1 - (WAVE_STEPS - k);
+			y0 = (uint8_t) (y[k] < y[k - 1] ? y[k] : y[k - 1]);
+			y1 = (uint8_t) (y[k] < y[k - 1] ? y[k - 1] : y[k]);
+			if (y1 == y0)
+				y1 = y0 + 1;
+			for (row = 40; row < 64; row++) {
+				lit = (row >= 64 - y1) && (row < 64 - y0);
+				if (ucSsd1306EmuPixel(x, row) != lit) {
+					printf("osc %u: column %u row %u\n", (unsigned) aOscHz[o],
+							x, row);
+					CHECK_EQ(ucSsd1306EmuPixel(x, row), lit);
+					return;
+				}
+			}
+		}
+		// the older part of the band is still blank
+		for (row = 40; row < 64; row++)
+			CHECK_EQ(ucSsd1306EmuPixel(0, row), 0);
+	}
+	printf("waveform step: %u bytes\n",
+			(unsigned) (stats.uiBytes / WAVE_STEPS));
+}
+
+static void test_golden_screens(void) {
+	const char *update = getenv("SSD1306_GOLDEN_UPDATE");
+	char path[512];
+	int32_t diff;
+	uint8_t i;
+
+	for (i = 0; i < sizeof(aScreens) / sizeof(aScreens[0]); i++) {
+		vPanelReset();
+		aScreens[i].pfDraw();
+		snprintf(path, sizeof(path), "%s/%s.pbm", GOLDEN_DIR, aScreens[i].pName);
+		if (update != NULL && update[0] == '1') {
+			CHECK(ucSsd1306EmuWritePbm(path));
+			continue;
+		}
+		diff = iSsd1306EmuComparePbm(path);
+		if (diff != 0) {
+			printf("%s: %d pixels differ\n", aScreens[i].pName, (int) diff);
+			snprintf(path, sizeof(path), "%s.actual.pbm", aScreens[i].pName);
+			ucSsd1306EmuWritePbm(path);
+		}
+		CHECK_EQ(diff, 0);
+	}
+}
+
+// first frame of each screen on the bus, CPU time averaged over BENCH_RUNS redraws
+static void test_frame_cost(void) {
+	Ssd1306EmuStats stats;
+	uint64_t start;
+	uint32_t ns;
+	uint16_t run;
+	uint8_t i;
+
+	printf("%-18s %8s %8s %8s\n", "screen", "bytes", "i2c txn", "cpu ns");
+	for (i = 0; i < sizeof(aScreens) / sizeof(aScreens[0]); i++) {
+		vPanelReset();
+		aScreens[i].pfDraw();
+		vSsd1306EmuStats(&stats);
+		start = ulNowNs();
+		for (run = 0; run < BENCH_RUNS; run++) {
+			vOledScreenLeave();
+			aScreens[i].pfDraw();
+		}
+		ns = (uint32_t) ((ulNowNs() - start) / BENCH_RUNS);
+		printf("%-18s %8u %8u %8u\n", aScreens[i].pName, (unsigned) stats.uiBytes,
+				(unsigned) stats.uiTransactions, (unsigned) ns);
+		CHECK_EQ(stats.uiViolations, 0);
+		CHECK(stats.uiBytes > 0);
+	}
+
+	// a retained screen with unchanged values costs nothing on the bus
+	vPanelReset();
+	vDrawMax30102();
+	vSsd1306EmuStatsReset();
+	vOledBlePrintMax30102(72, 98, 40);
+	vSsd1306EmuStats(&stats);
+	printf("%-18s %8u %8u\n", "max30102 unchanged", (unsigned) stats.uiBytes,
+			(unsigned) stats.uiTransactions);
+	CHECK_EQ(stats.uiBytes, 0);
+}
+
+int main(void) {
+	UNIT_RUN(test_init_sequence);
+	UNIT_RUN(test_addressing_modes);
+	UNIT_RUN(test_control_byte_continuation);
+	UNIT_RUN(test_multiplex_offset_invert);
+	UNIT_RUN(test_scroll);
+	UNIT_RUN(test_waveform);
+	UNIT_RUN(test_golden_screens);
+	UNIT_RUN(test_frame_cost);
+	return UNIT_END();
+}
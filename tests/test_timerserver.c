@@ -0,0 +1,422 @@
+/*
+ * test_timerserver.c
+ *
+ * hw_timerserver.c on the RTC of rtc_host.c, next to the sorted list timer
+ * server it replaced, built from host/rtc/hw_timerserver_list.c on its own
+ * RTC. A timer alone has to wake the CPU once, on its expiry, and
+ * HW_TS_RTC_ReadLeftTicksToCount() has to count down to that expiry and not
+ * to a slot of the wheel. On random traces of starts, stops and restarts,
+ * from the main loop and from the callbacks, both servers have to expire
+ * the same timers on the same ticks in the same order. The ticks left of
+ * the wheel may never reach past the first expiry, and fall short, at the
+ * cost of a wakeup, only when the timer expiring first was stopped next to
+ * others of its slot. The list always counts to the expiry. With the
+ * interrupt taken a few ticks late no timer may expire early or get lost.
+ * The cost of a restart and the wakeups per expiry are printed for the
+ * CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER of the build, which CMakeLists.txt
+ * builds with 6, 16, 32 and 128 timers.
+ */
+
+#include "unit.h"
+#include "app_common.h"
+#include "hw_conf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TIMERS CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER
+// hw_timerserver.c, the wakeup timer counts at most this far before it reloads
+#define WAKEUP_MAX (0xFFFF - CFG_HW_TS_RTC_HANDLER_MAX_DELAY)
+// one start or stop every TRACE_EVERY ticks of the trace, one in TRACE_STOP a stop
+#define TRACE_EVERY 20
+#define TRACE_STOP 4
+#define TRACE_TICKS 500000
+// a callback restarts a timer one time in CALLBACK_RESTART
+#define CALLBACK_RESTART 8
+#define LATENCY_MAX 3
+#define BENCH_RESTARTS 200000
+#define WAKEUP_TICKS 2000000
+#define FNV_PRIME 0x100000001B3ULL
+// a stopped head leaves the wheel counting to its slot, that costs a wakeup now and then
+#define WAKEUP_EXTRA_PERCENT 1
+#define LEFT_EXACT_PERCENT 80
+// vSetup() creates the timers hw_ts_SingleShot, hw_ts_Repeated or in random modes
+#define MODE_RANDOM 2
+
+typedef struct {
+	RtcHost *pRtc;
+	void (*pInit)(HW_TS_InitMode_t eMode, RTC_HandleTypeDef *pHrtc);
+	HW_TS_ReturnStatus_t (*pCreate)(uint32_t uiProcessId, uint8_t *pId, HW_TS_Mode_t eMode,
+			HW_TS_pTimerCb_t pCallback);
+	void (*pStart)(uint8_t ucId, uint32_t uiTicks);
+	void (*pStop)(uint8_t ucId);
+	void (*pHandler)(void);
+	uint16_t (*pLeft)(void);
+} TimerServer;
+
+typedef struct {
+	uint32_t uiExpiries;
+	uint32_t uiWakeups;
+	uint32_t uiErrors;         // early, late, not running or lost
+	uint64_t ulHash;           // tick and timer of each expiry, in order
+	uint32_t uiLefts;          // ticks left read after a start or stop
+	uint32_t uiLeftExact;      // to the first expiry
+	uint32_t uiLeftLate;       // past it
+} Run;
+
+// hw_timerserver_list.c, its symbols renamed by CMakeLists.txt
+void HW_TS_List_Init(HW_TS_InitMode_t TimerInitMode, RTC_HandleTypeDef *hrtc);
+HW_TS_ReturnStatus_t HW_TS_List_Create(uint32_t TimerProcessID, uint8_t *pTimerId, HW_TS_Mode_t TimerMode,
+		HW_TS_pTimerCb_t pTimerCallBack);
+void HW_TS_List_Stop(uint8_t TimerID);
+void HW_TS_List_Start(uint8_t TimerID, uint32_t timeout_ticks);
+void HW_TS_List_RTC_Wakeup_Handler(void);
+uint16_t HW_TS_List_RTC_ReadLeftTicksToCount(void);
+void HW_TS_List_RTC_Int_AppNot(uint32_t TimerProcessID, uint8_t TimerID, HW_TS_pTimerCb_t pTimerCallBack);
+void HW_TS_List_RTC_CountUpdated_AppNot(void);
+
+static const TimerServer tWheel = {
+	&tRtcHost, HW_TS_Init, HW_TS_Create, HW_TS_Start, HW_TS_Stop,
+	HW_TS_RTC_Wakeup_Handler, HW_TS_RTC_ReadLeftTicksToCount,
+};
+static const TimerServer tList = {
+	&tRtcList, HW_TS_List_Init, HW_TS_List_Create, HW_TS_List_Start, HW_TS_List_Stop,
+	HW_TS_List_RTC_Wakeup_Handler, HW_TS_List_RTC_ReadLeftTicksToCount,
+};
+// the longest timeout of a trace, in the first slots, across the levels, past the wakeup timer
+static const uint32_t auiTraceMax[] = { 64, 5000, 200000 };
+
+static const TimerServer *pServer;
+static RTC_HandleTypeDef tHrtc;
+static Run *pRun;
+static uint64_t ulTick;
+static uint64_t ulIrqAt;
+static uint8_t ucLatency;
+static uint8_t aucId[TIMERS];
+static uint8_t aucMode[TIMERS];
+static uint8_t aucRunning[TIMERS];
+static uint64_t aulExpect[TIMERS];
+static uint32_t auiPeriod[TIMERS];
+static uint32_t uiCallbackMax;     // longest timeout a callback restarts with, 0 for none
+
+// local function prototypes
+static void vCallback(void);
+static void vExpired(uint32_t uiTimer);
+static void vSetup(const TimerServer *pTs, Run *pR, uint8_t ucMode);
+static void vAdvance(uint64_t ulTo);
+static void vInterrupts(void);
+static void vStart(uint8_t ucTimer, uint32_t uiTicks);
+static void vStop(uint8_t ucTimer);
+static uint64_t ulNextExpect(void);
+static void vTrace(const TimerServer *pTs, uint32_t uiSeed, uint32_t uiMax, Run *pR);
+static double dRestartNs(const TimerServer *pTs);
+static void vPeriodic(const TimerServer *pTs, Run *pR);
+
+//local functions
+static void vCallback(void) {
+}
+
+// both servers notify here, checked against the model
+static void vExpired(uint32_t uiTimer) {
+	uint8_t j;
+
+	pRun->uiExpiries++;
+	pRun->ulHash = (pRun->ulHash ^ (ulTick * TIMERS + uiTimer)) * FNV_PRIME;
+	if (!aucRunning[uiTimer] || ulTick < aulExpect[uiTimer] || ulTick > aulExpect[uiTimer] + ucLatency)
+		pRun->uiErrors++;
+	if (aucMode[uiTimer] == hw_ts_Repeated) {
+		aulExpect[uiTimer] += auiPeriod[uiTimer];
+		// too late for the period, restarted from now
+		if (aulExpect[uiTimer] <= ulTick)
+			aulExpect[uiTimer] = ulTick + auiPeriod[uiTimer];
+	} else {
+		aucRunning[uiTimer] = 0;
+	}
+	if (uiCallbackMax && rand() % CALLBACK_RESTART == 0) {
+		j = (uint8_t) (rand() % TIMERS);
+		vStart(j, 1 + rand() % uiCallbackMax);
+	}
+}
+
+void HW_TS_RTC_Int_AppNot(uint32_t TimerProcessID, uint8_t TimerID, HW_TS_pTimerCb_t pTimerCallBack) {
+	(void) TimerID;
+	(void) pTimerCallBack;
+	vExpired(TimerProcessID);
+}
+
+void HW_TS_List_RTC_Int_AppNot(uint32_t TimerProcessID, uint8_t TimerID, HW_TS_pTimerCb_t pTimerCallBack) {
+	(void) TimerID;
+	(void) pTimerCallBack;
+	vExpired(TimerProcessID);
+}
+
+void HW_TS_RTC_CountUpdated_AppNot(void) {
+}
+
+void HW_TS_List_RTC_CountUpdated_AppNot(void) {
+}
+
+// a server from scratch at tick 0, every timer created
+static void vSetup(const TimerServer *pTs, Run *pR, uint8_t ucMode) {
+	uint8_t i;
+
+	pServer = pTs;
+	pRun = pR;
+	memset(pR, 0, sizeof(*pR));
+	memset(aucRunning, 0, sizeof(aucRunning));
+	ulTick = 0;
+	ulIrqAt = 0;
+	vRtcHostSetTick(0);
+	vRtcHostInit(pTs->pRtc);
+	tHrtc.Instance = pTs->pRtc;
+	pTs->pInit(hw_ts_InitMode_Full, &tHrtc);
+	for (i = 0; i < TIMERS; i++) {
+		aucMode[i] = ucMode == MODE_RANDOM ? (uint8_t) (rand() % 2) : ucMode;
+		CHECK_EQ(pTs->pCreate(i, &aucId[i], aucMode[i], vCallback), hw_ts_Successful);
+	}
+}
+
+static void vAdvance(uint64_t ulTo) {
+	while (ulTick < ulTo) {
+		ulTick++;
+		vRtcHostSetTick(ulTick);
+		vInterrupts();
+	}
+}
+
+// the handler when RTC_WKUP is pending and enabled, ucLatency ticks late at most
+static void vInterrupts(void) {
+	RtcHost *rtc = pServer->pRtc;
+
+	while (rtc->ucPending && rtc->ucIrqEnabled && uiHostPrimask == 0) {
+		if (ucLatency) {
+			if (ulIrqAt == 0)
+				ulIrqAt = ulTick + rand() % (ucLatency + 1);
+			if (ulTick < ulIrqAt)
+				return;
+			ulIrqAt = 0;
+		}
+		rtc->ucPending = 0;
+		pRun->uiWakeups++;
+		pServer->pHandler();
+	}
+}
+
+static void vStart(uint8_t ucTimer, uint32_t uiTicks) {
+	pServer->pStart(aucId[ucTimer], uiTicks);
+	aucRunning[ucTimer] = 1;
+	aulExpect[ucTimer] = ulTick + uiTicks;
+	auiPeriod[ucTimer] = uiTicks;
+}
+
+static void vStop(uint8_t ucTimer) {
+	pServer->pStop(aucId[ucTimer]);
+	aucRunning[ucTimer] = 0;
+}
+
+static uint64_t ulNextExpect(void) {
+	uint64_t next = 0xFFFFFFFFFFFFFFFFULL;
+	uint8_t i;
+
+	for (i = 0; i < TIMERS; i++) {
+		if (aucRunning[i] && aulExpect[i] < next)
+			next = aulExpect[i];
+	}
+	return next;
+}
+
+// random starts, stops and restarts, timeouts up to uiMax
+static void vTrace(const TimerServer *pTs, uint32_t uiSeed, uint32_t uiMax, Run *pR) {
+	uint32_t ticks, left;
+	uint64_t next;
+	uint8_t i;
+
+	srand(uiSeed);
+	vSetup(pTs, pR, MODE_RANDOM);
+	uiCallbackMax = uiMax;
+	while (ulTick < TRACE_TICKS) {
+		vAdvance(ulTick + 1 + rand() % (2 * TRACE_EVERY));
+		i = (uint8_t) (rand() % TIMERS);
+		if (rand() % TRACE_STOP == 0) {
+			vStop(i);
+		} else {
+			// now and then one due at once or within a slot
+			ticks = rand() % 3 == 0 ? (uint32_t) (rand() % 40) : 1 + rand() % uiMax;
+			if (aucMode[i] == hw_ts_Repeated && ticks == 0)
+				ticks = 1;
+			vStart(i, ticks);
+		}
+		vInterrupts();
+		next = ulNextExpect();
+		if (ucLatency == 0 && next > ulTick && next - ulTick <= WAKEUP_MAX / 2) {
+			// WUTR holds one tick less than it counts
+			left = pTs->pLeft() + 1U;
+			pR->uiLefts++;
+			pR->uiLeftExact += left == next - ulTick;
+			pR->uiLeftLate += left > next - ulTick;
+		}
+	}
+	// whatever still runs has its expiry ahead
+	for (i = 0; i < TIMERS; i++) {
+		if (aucRunning[i] && aulExpect[i] + ucLatency < ulTick)
+			pR->uiErrors++;
+	}
+	uiCallbackMax = 0;
+}
+
+// ns per restart of a running timer, every timer running
+static double dRestartNs(const TimerServer *pTs) {
+	struct timespec from, to;
+	Run run;
+	uint32_t r = 1, i;
+
+	srand(1);
+	vSetup(pTs, &run, hw_ts_SingleShot);
+	for (i = 0; i < TIMERS; i++)
+		vStart((uint8_t) i, 1000 + rand() % 100000);
+	clock_gettime(CLOCK_MONOTONIC, &from);
+	for (i = 0; i < BENCH_RESTARTS; i++) {
+		r = r * 1103515245 + 12345;
+		pTs->pStart(aucId[(r >> 8) % TIMERS], 1000 + (r >> 12) % 100000);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &to);
+	return ((to.tv_sec - from.tv_sec) * 1e9 + (to.tv_nsec - from.tv_nsec)) / BENCH_RESTARTS;
+}
+
+// every timer repeated, periods from a few ticks to past the wakeup timer
+static void vPeriodic(const TimerServer *pTs, Run *pR) {
+	uint8_t i;
+
+	srand(7);
+	vSetup(pTs, pR, hw_ts_Repeated);
+	for (i = 0; i < TIMERS; i++)
+		vStart(i, (uint32_t) (16 + rand() % (i % 2 ? 5000 : 150000)));
+	vAdvance(WAKEUP_TICKS);
+}
+
+// one wakeup on the expiry, the ticks left count down to it
+static void test_expiry(void) {
+	static const uint32_t timeouts[] = { 1, 31, 32, 33, 1000, 1023, 1024, 30000, WAKEUP_MAX / 2 };
+	const TimerServer *servers[] = { &tWheel, &tList };
+	Run run;
+	uint64_t step;
+	uint8_t s, t;
+
+	ucLatency = 0;
+	for (s = 0; s < 2; s++) {
+		for (t = 0; t < sizeof(timeouts) / sizeof(timeouts[0]); t++) {
+			vSetup(servers[s], &run, hw_ts_SingleShot);
+			// the timer base away from 0 so that the expiry is not aligned
+			vAdvance(12345);
+			vStart(0, timeouts[t]);
+			step = timeouts[t] / 4 + 1;
+			while (aucRunning[0]) {
+				// WUTR holds one tick less than it counts
+				CHECK_EQ(servers[s]->pLeft() + 1, aulExpect[0] - ulTick);
+				vAdvance(ulTick + step < aulExpect[0] ? ulTick + step : aulExpect[0]);
+			}
+			CHECK_EQ(run.uiExpiries, 1);
+			CHECK_EQ(run.uiWakeups, 1);
+			CHECK_EQ(run.uiErrors, 0);
+			CHECK_EQ(servers[s]->pLeft(), 0xFFFF);
+		}
+	}
+}
+
+// the head of a slot stopped, one wakeup to move the others down, then exact
+static void test_stopped_head(void) {
+	Run run;
+	uint32_t left;
+
+	ucLatency = 0;
+	vSetup(&tWheel, &run, hw_ts_SingleShot);
+	vAdvance(12345);
+	// both on level 1 of a wheel started at 0, in its last slot
+	vStart(0, 1000);
+	vStart(1, 1010);
+	vStop(0);
+	left = tWheel.pLeft() + 1U;
+	CHECK(left <= aulExpect[1] - ulTick);
+	vAdvance(ulTick + left);
+	CHECK_EQ(run.uiWakeups, 1);
+	CHECK_EQ(run.uiExpiries, 0);
+	CHECK_EQ(tWheel.pLeft() + 1, aulExpect[1] - ulTick);
+	vAdvance(aulExpect[1]);
+	CHECK_EQ(run.uiExpiries, 1);
+	CHECK_EQ(run.uiWakeups, 2);
+	CHECK_EQ(run.uiErrors, 0);
+}
+
+// random traces expire alike on both servers, at their tick, none lost
+static void test_equivalence(void) {
+	Run wheel, list;
+	uint32_t seed;
+	uint8_t m;
+
+	ucLatency = 0;
+	printf("%8s %6s | %8s %8s %6s | %8s %8s\n", "max", "seed", "expiries", "wakeups", "exact", "expiries",
+			"wakeups");
+	for (m = 0; m < sizeof(auiTraceMax) / sizeof(auiTraceMax[0]); m++) {
+		for (seed = 1; seed <= 3; seed++) {
+			vTrace(&tWheel, seed, auiTraceMax[m], &wheel);
+			vTrace(&tList, seed, auiTraceMax[m], &list);
+			printf("%8u %6u | %8u %8u %5u%% | %8u %8u\n", (unsigned) auiTraceMax[m], (unsigned) seed,
+					(unsigned) wheel.uiExpiries, (unsigned) wheel.uiWakeups,
+					(unsigned) (wheel.uiLeftExact * 100ULL / wheel.uiLefts), (unsigned) list.uiExpiries,
+					(unsigned) list.uiWakeups);
+			CHECK(wheel.uiExpiries > 0);
+			CHECK_EQ(wheel.uiErrors, 0);
+			CHECK_EQ(list.uiErrors, 0);
+			CHECK_EQ(wheel.uiExpiries, list.uiExpiries);
+			CHECK(wheel.ulHash == list.ulHash);
+			CHECK_EQ(wheel.uiLeftLate, 0);
+			CHECK(wheel.uiLeftExact * 100ULL >= wheel.uiLefts * (uint64_t) LEFT_EXACT_PERCENT);
+			CHECK_EQ(list.uiLeftExact, list.uiLefts);
+			CHECK(wheel.uiWakeups * 100ULL <= list.uiWakeups * (100ULL + WAKEUP_EXTRA_PERCENT));
+		}
+	}
+}
+
+// the interrupt taken late, nothing early or lost
+static void test_latency(void) {
+	Run wheel;
+	uint8_t m;
+
+	ucLatency = LATENCY_MAX;
+	for (m = 0; m < sizeof(auiTraceMax) / sizeof(auiTraceMax[0]); m++) {
+		vTrace(&tWheel, 11, auiTraceMax[m], &wheel);
+		CHECK(wheel.uiExpiries > 0);
+		CHECK_EQ(wheel.uiErrors, 0);
+	}
+	ucLatency = 0;
+}
+
+// restart cost and wakeups per expiry with every timer running
+static void test_bench(void) {
+	Run wheel, list;
+	double wheelNs, listNs;
+
+	ucLatency = 0;
+	wheelNs = dRestartNs(&tWheel);
+	listNs = dRestartNs(&tList);
+	vPeriodic(&tWheel, &wheel);
+	vPeriodic(&tList, &list);
+	printf("%3u timers: restart wheel %.0f ns, list %.0f ns; %u expiries, wakeups wheel %u, list %u\n",
+			TIMERS, wheelNs, listNs, (unsigned) wheel.uiExpiries, (unsigned) wheel.uiWakeups,
+			(unsigned) list.uiWakeups);
+	CHECK_EQ(wheel.uiErrors, 0);
+	CHECK_EQ(list.uiErrors, 0);
+	CHECK_EQ(wheel.uiExpiries, list.uiExpiries);
+	CHECK(wheel.ulHash == list.ulHash);
+	CHECK(wheel.uiWakeups <= list.uiWakeups);
+}
+
+int main(void) {
+	UNIT_RUN(test_expiry);
+	UNIT_RUN(test_stopped_head);
+	UNIT_RUN(test_equivalence);
+	UNIT_RUN(test_latency);
+	UNIT_RUN(test_bench);
+	return UNIT_END();
+}
@@ -0,0 +1,245 @@
+/*
+ * test_tl_pool.c
+ *
+ * Bursty event traces replayed through the mailbox to size the event pool
+ * CPU2 fills: writes arriving back to back while the main loop is stuck in
+ * a task, as when it redraws the display, long writes, a second central
+ * connecting in the middle and a random mix of all of them. The host CPU2
+ * takes every event from the pool by its size, the way CPU2 does, and
+ * delays it while no room is left. Each trace is replayed once per pool of
+ * 1 to CFG_TLBLE_EVT_QUEUE_LENGTH full size events; the smallest pool no
+ * event had to wait for is the CFG_TLBLE_EVT_QUEUE_LENGTH the trace needs.
+ * The DIAG record has to report the peak CPU1 held and suggest at least that
+ * length, the shipped length has to cover every trace, and a pool too small
+ * may delay events but not lose any.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "tl.h"
+#include "hci_tl.h"
+#include "main.h"
+#include "app_ble.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// pool bytes one unit of CFG_TLBLE_EVT_QUEUE_LENGTH gives
+#define POOL_UNIT (4U * DIVC((sizeof(TL_PacketHeader_t) + TL_BLE_EVENT_FRAME_SIZE), 4U))
+#define BURSTS_MAX 64
+// write commands of one connection event
+#define WRITE_GAP_US 250
+// link setup of a central connected by the trace and the last events
+#define TRACE_TAIL_MS (BLE_HOST_LINK_SETUP_MS + 100)
+// DATA value that selects no screen, the last write of a trace another one
+#define WRITE_KEEP 0x07
+#define WRITE_LAST 0x03
+
+typedef enum {
+	TRACE_STEADY,
+	TRACE_DISPLAY,
+	TRACE_LONG,
+	TRACE_CONNECT,
+	TRACE_MIXED,
+	TRACE_COUNT,
+} Trace;
+
+typedef struct {
+	uint16_t usAtMs;           // from the start of the trace
+	uint8_t ucWrites;          // WRITE_GAP_US apart
+	uint8_t ucLen;             // of each write
+	uint8_t ucBusyMs;          // main loop stuck from the first write, 0 if free
+	uint8_t ucConnect;         // a second central connects first
+} Burst;
+
+typedef struct {
+	uint32_t uiEvents;
+	uint32_t uiDelayed;
+	uint32_t uiWaitMaxUs;
+	uint16_t usHeldMax;        // host CPU2
+	uint16_t usBytesMax;
+	uint8_t aRecord[APP_BLE_TL_STATS_SIZE];
+} Replay;
+
+static const char *const apcTraceName[TRACE_COUNT] = {
+	"steady", "display", "long", "connect", "mixed",
+};
+static const Cpu2HostCentral tCentral = { 247, 251, 1, 6, -60 };
+static const Cpu2HostCentral tSecond = { 185, 251, 1, 24, -70 };
+static Burst aBursts[BURSTS_MAX];
+static uint8_t ucBursts;
+
+// local function prototypes
+static void vTrace(Trace eTrace);
+static void vReplay(uint16_t usPoolBytes, Replay *pReplay);
+
+//local functions
+static void vTrace(Trace eTrace) {
+	uint8_t i;
+
+	memset(aBursts, 0, sizeof(aBursts));
+	srand(11);
+	switch (eTrace) {
+	case TRACE_STEADY:
+		// a short write every connection event of 7.5 ms
+		ucBursts = 60;
+		for (i = 0; i < ucBursts; i++) {
+			aBursts[i].usAtMs = (uint16_t) (i * 15 / 2);
+			aBursts[i].ucWrites = 1;
+			aBursts[i].ucLen = 20;
+		}
+		break;
+	case TRACE_DISPLAY:
+		// 16 writes into an 8 ms display refresh, five times a second
+		ucBursts = 10;
+		for (i = 0; i < ucBursts; i++) {
+			aBursts[i].usAtMs = (uint16_t) (i * 200);
+			aBursts[i].ucWrites = 16;
+			aBursts[i].ucLen = 20;
+			aBursts[i].ucBusyMs = 8;
+		}
+		break;
+	case TRACE_LONG:
+		// values as long as the MTU allows, a few per busy window
+		ucBursts = 10;
+		for (i = 0; i < ucBursts; i++) {
+			aBursts[i].usAtMs = (uint16_t) (i * 200);
+			aBursts[i].ucWrites = 4;
+			aBursts[i].ucLen = 244;
+			aBursts[i].ucBusyMs = 6;
+		}
+		break;
+	case TRACE_CONNECT:
+		// a second central connects into a 20 ms task, the first keeps writing
+		ucBursts = 1;
+		aBursts[0].ucWrites = 8;
+		aBursts[0].ucLen = 20;
+		aBursts[0].ucBusyMs = 20;
+		aBursts[0].ucConnect = 1;
+		break;
+	default:
+		// up to 8 writes of up to half the MTU, the main loop busy up to 8 ms
+		ucBursts = 40;
+		for (i = 0; i < ucBursts; i++) {
+			aBursts[i].usAtMs = (uint16_t) (i * 50);
+			aBursts[i].ucWrites = (uint8_t) (1 + rand() % 8);
+			aBursts[i].ucLen = (uint8_t) (1 + rand() % 122);
+			aBursts[i].ucBusyMs = (uint8_t) (rand() % 9);
+		}
+		break;
+	}
+}
+
+/*
+ * The trace on a fresh stack with one central connected, events limited to
+ * the first usPoolBytes of the pool. Checks that each event got through.
+ */
+static void vReplay(uint16_t usPoolBytes, Replay *pReplay) {
+	Cpu2HostStats cpu2;
+	TL_MM_Stats_t mm;
+	uint64_t start, at;
+	uint32_t busyUs, writes = 0;
+	uint16_t conn, data, second = 0;
+	uint8_t value[244], i, w;
+
+	memset(pReplay, 0, sizeof(*pReplay));
+	memset(value, WRITE_KEEP, sizeof(value));
+	vBleHostInit();
+	conn = usBleHostConnect(&tCentral);
+	data = usBleHostChar(BLE_HOST_DATA);
+	vCpu2HostPoolLimit(usPoolBytes);
+	vCpu2HostClearStats();
+	APP_BLE_Tl_Stats_Reset();
+
+	start = ulHostUs();
+	for (i = 0; i < ucBursts; i++) {
+		at = start + aBursts[i].usAtMs * 1000ULL;
+		if (at > ulHostUs())
+			vBleHostRunUs((uint32_t) (at - ulHostUs()));
+		if (aBursts[i].ucConnect)
+			second = usCpu2HostConnect(&tSecond);
+		busyUs = aBursts[i].ucBusyMs * 1000U;
+		for (w = 0; w < aBursts[i].ucWrites; w++) {
+			if (i == ucBursts - 1 && w == aBursts[i].ucWrites - 1)
+				value[0] = WRITE_LAST;
+			vCpu2HostWrite(conn, data, value, aBursts[i].ucLen);
+			writes++;
+			if (busyUs) {
+				vBleHostBusyUs(WRITE_GAP_US);
+				busyUs = busyUs > WRITE_GAP_US ? busyUs - WRITE_GAP_US : 0;
+			} else {
+				vBleHostRunUs(WRITE_GAP_US);
+			}
+		}
+		if (busyUs)
+			vBleHostBusyUs(busyUs);
+	}
+	vBleHostRun(TRACE_TAIL_MS);
+
+	vCpu2HostGetStats(&cpu2);
+	TL_MM_GetStats(&mm);
+	APP_BLE_Tl_Stats_Encode(pReplay->aRecord);
+	pReplay->uiEvents = cpu2.uiEvents;
+	pReplay->uiDelayed = cpu2.uiEventsDelayed;
+	pReplay->uiWaitMaxUs = (uint32_t) cpu2.ulPoolWaitUs;
+	pReplay->usHeldMax = cpu2.usHeldMax;
+	pReplay->usBytesMax = cpu2.usPoolUsedMax;
+
+	// delayed, never lost: all handed over and back, the last write applied
+	CHECK(cpu2.uiEvents >= writes);
+	CHECK_EQ(mm.EvtReceived, cpu2.uiEvents);
+	CHECK_EQ(mm.Held, 0);
+	CHECK_EQ(ucOledStatusFlag, WRITE_LAST);
+	if (second)
+		CHECK_EQ(usCpu2HostLinkMtu(second), tSecond.usMtu);
+}
+
+// smallest pool per trace, against the DIAG record and the shipped length
+static void test_replay(void) {
+	static Replay replay, full;
+	uint32_t delayed[CFG_TLBLE_EVT_QUEUE_LENGTH];
+	uint8_t t, length, needed;
+	uint16_t bytesHeld;
+
+	printf("%-8s %6s %4s %5s %4s  delayed events, pool of 1..%u %s\n", "trace", "events",
+			"held", "bytes", "diag", CFG_TLBLE_EVT_QUEUE_LENGTH, "-> length");
+	for (t = 0; t < TRACE_COUNT; t++) {
+		vTrace((Trace) t);
+		vReplay(0, &full);
+		CHECK_EQ(full.uiDelayed, 0);
+		// what CPU1 counted is what the host CPU2 lent it, headers not rounded up
+		bytesHeld = (uint16_t) (full.aRecord[2] | (full.aRecord[3] << 8));
+		CHECK_EQ(full.aRecord[1], full.usHeldMax);
+		CHECK(bytesHeld <= full.usBytesMax);
+		CHECK(bytesHeld + 3 * full.usHeldMax >= full.usBytesMax);
+		CHECK_EQ(full.aRecord[4], CFG_TLBLE_EVT_QUEUE_LENGTH);
+
+		needed = 0;
+		for (length = 1; length <= CFG_TLBLE_EVT_QUEUE_LENGTH; length++) {
+			vReplay((uint16_t) (length * POOL_UNIT), &replay);
+			delayed[length - 1] = replay.uiDelayed;
+			// the same trace, however long the events waited
+			CHECK(replay.uiEvents >= full.uiEvents - 2 && replay.uiEvents <= full.uiEvents + 2);
+			if (replay.uiDelayed == 0 && needed == 0)
+				needed = length;
+			if (replay.uiDelayed && length > 1)
+				CHECK(replay.uiWaitMaxUs > 0);
+		}
+		printf("%-8s %6u %4u %5u %4u ", apcTraceName[t], (unsigned) full.uiEvents,
+				full.usHeldMax, full.usBytesMax, full.aRecord[5]);
+		for (length = 0; length < CFG_TLBLE_EVT_QUEUE_LENGTH; length++)
+			printf(" %4u", (unsigned) delayed[length]);
+		printf(" -> %u\n", needed);
+
+		CHECK(needed != 0);
+		CHECK(full.aRecord[5] >= needed);
+	}
+}
+
+int main(void) {
+	UNIT_RUN(test_replay);
+	return UNIT_END();
+}
@@ -0,0 +1,242 @@
+/*
+ * test_tx_power.c
+ *
+ * RSSI traces replayed through tx_power.c one sample per link tick, as
+ * app_ble.c feeds it: a central on a desk, one walked away and back, a body
+ * fading the signal in and out, reads that fail now and then, and plain
+ * noise. On each trace the level has to settle, then never step back against
+ * its last change within FLIP_SAMPLES, a jump on a failed read aside, and keep the signal the central gets from
+ * us above TX_POWER_TARGET_DBM but for the samples the average lags. The
+ * table prints changes, flips, samples short of the target and the mean
+ * power against CFG_TX_POWER. Through app_ble.c and CPU2 the PA level set
+ * follows the weakest of two centrals with one command per change, and goes
+ * back to the ceiling when the last one leaves.
+ */
+
+#include "unit.h"
+#include "hal_host.h"
+#include "ble_host.h"
+#include "app_common.h"
+#include "ble.h"
+#include "app_ble.h"
+#include "tx_power.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// LINK_TICK_PERIOD of app_ble.c
+#define TICK_MS 500
+#define TRACE_SAMPLES 240
+// a change undone this soon is an oscillation
+#define FLIP_SAMPLES 10
+// 30 s to settle from the ceiling, the worst average released
+#define SETTLE_SAMPLES 60
+
+typedef enum {
+	TRACE_DESK,
+	TRACE_WALK,
+	TRACE_FADING,
+	TRACE_DROPOUTS,
+	TRACE_NOISY,
+	TRACE_COUNT,
+} Trace;
+
+typedef struct {
+	uint32_t uiChanges;
+	uint32_t uiSettledChanges; // after SETTLE_SAMPLES
+	uint32_t uiFlips;          // after SETTLE_SAMPLES, loss jumps left out
+	uint32_t uiShort;          // true signal at the central below target, under the ceiling
+	int32_t iMeanPower;        // 0.1 dBm
+	int32_t iSettledPower;     // mean after SETTLE_SAMPLES
+	uint8_t aucLevel[TRACE_SAMPLES];
+} Replay;
+
+static const char *const apcTraceName[TRACE_COUNT] = {
+	"desk", "walk", "fading", "dropouts", "noisy",
+};
+static int8_t acRssi[TRACE_SAMPLES]; // as read, noise and failed reads included
+static int8_t acTrue[TRACE_SAMPLES]; // the path as it is
+
+// local function prototypes
+static void vTrace(Trace eTrace);
+static void vReplay(Replay *pReplay);
+
+//local functions
+// one RSSI per link tick, dBm
+static void vTrace(Trace eTrace) {
+	uint16_t i;
+	int16_t base;
+
+	srand(7 + eTrace);
+	for (i = 0; i < TRACE_SAMPLES; i++) {
+		switch (eTrace) {
+		case TRACE_DESK:
+			acTrue[i] = -55;
+			acRssi[i] = (int8_t) (-55 + rand() % 9 - 4);
+			break;
+		case TRACE_WALK:
+			// -50 to -85 dBm and back, one minute each way
+			base = (int16_t) (i < TRACE_SAMPLES / 2 ? i : TRACE_SAMPLES - i);
+			acTrue[i] = (int8_t) (-50 - (35 * base) / (TRACE_SAMPLES / 2));
+			acRssi[i] = (int8_t) (acTrue[i] + rand() % 7 - 3);
+			break;
+		case TRACE_FADING:
+			// 12 dB body loss for 3 s out of every 6
+			acTrue[i] = (int8_t) ((i / 6) % 2 ? -72 : -60);
+			acRssi[i] = acTrue[i];
+			break;
+		case TRACE_DROPOUTS:
+			acTrue[i] = -50;
+			acRssi[i] = (int8_t) (i % 40 == 20 ? TX_POWER_RSSI_NONE : -50 + rand() % 5 - 2);
+			break;
+		default:
+			acTrue[i] = -60;
+			acRssi[i] = (int8_t) (-60 + rand() % 21 - 10);
+			break;
+		}
+	}
+}
+
+static void vReplay(Replay *pReplay) {
+	TxPowerStats stats;
+	uint32_t now;
+	int64_t power = 0, settled = 0;
+	uint16_t i, lastChange = 0;
+	int8_t lastDir = 0, dir;
+	int16_t before;
+
+	memset(pReplay, 0, sizeof(*pReplay));
+	vTxPowerInit(CFG_TX_POWER, 0);
+	for (i = 0; i < TRACE_SAMPLES; i++) {
+		now = i * TICK_MS;
+		vTxPowerGetStats(&stats, now);
+		before = stats.sPower;
+		if (ucTxPowerSample(acRssi[i], now)) {
+			vTxPowerGetStats(&stats, now);
+			dir = stats.sPower > before ? 1 : -1;
+			pReplay->uiChanges++;
+			if (i >= SETTLE_SAMPLES)
+				pReplay->uiSettledChanges++;
+			if (acRssi[i] != TX_POWER_RSSI_NONE) {
+				if (i >= SETTLE_SAMPLES && lastDir && dir != lastDir && i - lastChange < FLIP_SAMPLES)
+					pReplay->uiFlips++;
+				lastDir = dir;
+				lastChange = i;
+			}
+		}
+		vTxPowerGetStats(&stats, now);
+		pReplay->aucLevel[i] = stats.ucLevel;
+		power += stats.sPower;
+		if (i >= SETTLE_SAMPLES)
+			settled += stats.sPower;
+		if (stats.ucLevel != CFG_TX_POWER
+				&& stats.sPower + acTrue[i] * 10 < TX_POWER_TARGET_DBM * 10)
+			pReplay->uiShort++;
+	}
+	pReplay->iMeanPower = (int32_t) (power / TRACE_SAMPLES);
+	pReplay->iSettledPower = (int32_t) (settled / (TRACE_SAMPLES - SETTLE_SAMPLES));
+}
+
+// every trace settles without flipping and keeps the central above target
+static void test_replay(void) {
+	static Replay replay;
+	TxPowerStats ceiling;
+	uint16_t i, k;
+	uint8_t t;
+
+	vTxPowerInit(CFG_TX_POWER, 0);
+	vTxPowerGetStats(&ceiling, 0);
+	printf("%-9s %7s %7s %5s %5s %9s\n", "trace", "changes", "settled", "flips", "short",
+			"mean dBm");
+	for (t = 0; t < TRACE_COUNT; t++) {
+		vTrace((Trace) t);
+		vReplay(&replay);
+		printf("%-9s %7u %7u %5u %5u %5d.%u\n", apcTraceName[t], (unsigned) replay.uiChanges,
+				(unsigned) replay.uiSettledChanges, (unsigned) replay.uiFlips,
+				(unsigned) replay.uiShort, (int) (replay.iMeanPower / 10),
+				(unsigned) abs(replay.iMeanPower % 10));
+		CHECK_EQ(replay.uiFlips, 0);
+		CHECK(replay.iMeanPower <= ceiling.sPower);
+
+		switch (t) {
+		case TRACE_DESK:
+			// settled 6 dB under the ceiling and left there
+			CHECK_EQ(replay.uiSettledChanges, 0);
+			CHECK(replay.iSettledPower <= ceiling.sPower - 60);
+			CHECK_EQ(replay.uiShort, 0);
+			break;
+		case TRACE_WALK:
+			// up while walking away, full power at the far end, down on the way back
+			CHECK_EQ(replay.aucLevel[TRACE_SAMPLES / 2], CFG_TX_POWER);
+			CHECK(replay.aucLevel[TRACE_SAMPLES - 1] < CFG_TX_POWER);
+			CHECK(replay.uiShort <= TRACE_SAMPLES / 20);
+			break;
+		case TRACE_FADING:
+			// on the level that covers the fades
+			CHECK_EQ(replay.uiSettledChanges, 0);
+			break;
+		case TRACE_DROPOUTS:
+			// a failed read goes to the ceiling and holds
+			for (i = 20; i < TRACE_SAMPLES; i += 40)
+				for (k = i; k < i + TX_POWER_LOSS_HOLD && k < TRACE_SAMPLES; k++)
+					CHECK_EQ(replay.aucLevel[k], CFG_TX_POWER);
+			CHECK_EQ(replay.uiShort, 0);
+			break;
+		default:
+			CHECK(replay.uiSettledChanges <= TRACE_SAMPLES / 10);
+			break;
+		}
+	}
+}
+
+// through the link tick of app_ble.c, one command per change, the weakest link leads
+static void test_stack(void) {
+	static const Cpu2HostCentral near = { 247, 251, 1, 24, -55 };
+	static const Cpu2HostCentral far = { 247, 251, 1, 24, -84 };
+	TxPowerStats stats;
+	uint32_t commands;
+	uint16_t conn, other, i;
+	uint8_t settled;
+
+	vBleHostInit();
+	CHECK_EQ(ucCpu2HostTxPower(), CFG_TX_POWER);
+	conn = usBleHostConnect(&near);
+	commands = uiCpu2HostCount(CPU2_HOST_HAL_SET_TX_POWER_LEVEL);
+	APP_BLE_Get_Tx_Power_Stats(&stats);
+	vTrace(TRACE_WALK);
+	for (i = 0; i < TRACE_SAMPLES; i++) {
+		vCpu2HostSetRssi(conn, acRssi[i]);
+		vBleHostRun(TICK_MS);
+		if (i == TRACE_SAMPLES / 2)
+			CHECK_EQ(ucCpu2HostTxPower(), CFG_TX_POWER);
+	}
+	settled = ucCpu2HostTxPower();
+	CHECK(settled < CFG_TX_POWER);
+	commands = uiCpu2HostCount(CPU2_HOST_HAL_SET_TX_POWER_LEVEL) - commands;
+	i = (uint16_t) stats.uiChanges;
+	APP_BLE_Get_Tx_Power_Stats(&stats);
+	CHECK_EQ(commands, stats.uiChanges - i);
+	CHECK_EQ(stats.ucLevel, settled);
+	printf("walk through app_ble.c: %u PA level commands, settled at 0x%02X\n",
+			(unsigned) commands, settled);
+
+	// a far central pulls the shared level up, it leaving lets it down again
+	other = usBleHostConnect(&far);
+	vBleHostRun(5 * TICK_MS);
+	CHECK_EQ(ucCpu2HostTxPower(), CFG_TX_POWER);
+	vCpu2HostDisconnect(other, 0x13);
+	vCpu2HostSetRssi(conn, -55);
+	vBleHostRun(60 * TICK_MS);
+	CHECK(ucCpu2HostTxPower() < CFG_TX_POWER);
+
+	// advertising again at the ceiling
+	vCpu2HostDisconnect(conn, 0x13);
+	vBleHostRun(TICK_MS);
+	CHECK_EQ(ucCpu2HostTxPower(), CFG_TX_POWER);
+}
+
+int main(void) {
+	UNIT_RUN(test_replay);
+	UNIT_RUN(test_stack);
+	return UNIT_END();
+}
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Compress a monochrome bitmap into the page major RLE stream drawn by
+SSD1306_DrawRle().
+
+The bitmap is first laid out like the SSD1306 GDDRAM: one byte holds 8
+vertical pixels (LSB on top), pages of `width` bytes follow each other.
+That byte stream is then packed:
+
+    0x00..0x7F  copy the next (n + 1) bytes
+    0x80..0xFF  repeat the next byte (n - 0x80 + 2) times
+
+Input formats:
+    rows   LCD Assistant style C array, rows of (width + 7) / 8 bytes, MSB left
+    words  one integer per row, leftmost pixel in bit (bits - 1)
+
+Every stream is decoded again and compared pixel by pixel with the input
+before it is written out.
+
+    bitmap_rle.py rows  Inc/logo.h 128 64 logo_rle
+    bitmap_rle.py words Src/bluetooth_logo.c 22 32 bluetooth_logo_rle --bits 24
+"""
+
+import argparse
+import re
+import sys
+
+
+def parse_numbers(path):
+    text = open(path).read()
+    body = text[text.index('{') + 1:text.index('}')]
+    body = re.sub(r'//[^\n]*', '', body)
+    return [int(v, 0) for v in re.findall(r'0[xX][0-9a-fA-F]+|\d+', body)]
+
+
+def pixels_from_rows(data, width, height):
+    stride = (width + 7) // 8
+    return [[(data[y * stride + x // 8] >> (7 - x % 8)) & 1
+             for x in range(width)] for y in range(height)]
+
+
+def pixels_from_words(data, width, height, bits):
+    return [[(data[y] >> (bits - 1 - x)) & 1
+             for x in range(width)] for y in range(height)]
+
+
+def to_pages(pixels, width, height):
+    out = []
+    for page in range((height + 7) // 8):
+        for x in range(width):
+            b = 0
+            for bit in range(8):
+                y = page * 8 + bit
+                if y < height and pixels[y][x]:
+                    b |= 1 << bit
+            out.append(b)
+    return out
+
+
+def encode(data):
+    out = []
+    literal = []
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 129:
+            run += 1
+        if run >= 2:
+            if literal:
+                out += [len(literal) - 1] + literal
+                literal = []
+            out += [0x80 + run - 2, data[i]]
+            i += run
+        else:
+            literal.append(data[i])
+            if len(literal) == 128:
+                out += [len(literal) - 1] + literal
+                literal = []
+            i += 1
+    if literal:
+        out += [len(literal) - 1] + literal
+    return out
+
+
+def decode(stream, size):
+    out = []
+    i = 0
+    while len(out) < size:
+        n = stream[i]
+        if n & 0x80:
+            out += [stream[i + 1]] * (n - 0x80 + 2)
+            i += 2
+        else:
+            out += stream[i + 1:i + 2 + n]
+            i += n + 2
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('format', choices=['rows', 'words'])
+    ap.add_argument('source')
+    ap.add_argument('width', type=int)
+    ap.add_argument('height', type=int)
+    ap.add_argument('name')
+    ap.add_argument('--bits', type=int, default=32)
+    args = ap.parse_args()
+
+    data = parse_numbers(args.source)
+    if args.format == 'rows':
+        pixels = pixels_from_rows(data, args.width, args.height)
+    else:
+        pixels = pixels_from_words(data, args.width, args.height, args.bits)
+    pages = to_pages(pixels, args.width, args.height)
+    stream = encode(pages)
+
+    if decode(stream, len(pages)) != pages:
+        sys.exit('round trip mismatch')
+
+    print('// %dx%d, %d page bytes packed to %d' %
+          (args.width, args.height, len(pages), len(stream)))
+    print('const uint8_t %s[] = {' % args.name)
+    for i in range(0, len(stream), 16):
+        print('  ' + ', '.join('0x%02X' % b for b in stream[i:i + 16]) + ',')
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
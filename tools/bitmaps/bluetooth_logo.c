@@ -0,0 +1,39 @@
+/* USER CODE BEGIN */
+
+#include "bluetooth_logo.h"
+
+const long int bluetooth_logo[] = {
+  0x0003FF00, // ......##########........
+  0x000FFFC0, // ....##############......
+  0x001FFFE0, // ...################.....
+  0x003FFFF0, // ..##################....
+  0x003FFFF0, // ..##################....
+  0x007F9FF8, // .########..##########...
+  0x007F8FF8, // .########...#########...
+  0x00FF87FC, // #########....#########..
+  0x00FF93FC, // #########..#..########..
+  0x00FF99FC, // #########..##..#######..
+  0x00F39CFC, // ####..###..###..######..
+  0x00F99CFC, // #####..##..###..######..
+  0x00FC99FC, // ######..#..##..#######..
+  0x00FE13FC, // #######....#..########..
+  0x00FF07FC, // ########.....#########..
+  0x00FF8FFC, // #########...##########..
+  0x00FF8FFC, // #########...##########..
+  0x00FF07FC, // ########.....#########..
+  0x00FE13FC, // #######....#..########..
+  0x00FC99FC, // ######..#..##..#######..
+  0x00F99CFC, // #####..##..###..######..
+  0x00F39CFC, // ####..###..###..######..
+  0x00FF99FC, // #########..##..#######..
+  0x00FF93FC, // #########..#..########..
+  0x00FF87FC, // #########....#########..
+  0x007F8FF8, // .########...#########...
+  0x007F9FF8, // .########..##########...
+  0x003FFFF0, // ..##################....
+  0x003FFFF0, // ..##################....
+  0x001FFFE0, // ...################.....
+  0x000FFFC0, // ....##############......
+  0x0003FF00 // ......##########........
+};
+/* USER CODE END */